@@ -0,0 +1,24 @@
+{
+  'targets': [{
+    'target_name': 'benchmarks',
+    'type': 'executable',
+    'dependencies': [
+      'libadblockplus.gyp:libadblockplus'
+    ],
+    'sources': [
+      '../shell/src/Latency.cpp',
+      '../shell/src/Latency.h',
+      'src/Benchmark.cpp',
+      'src/Benchmark.h',
+      'src/Main.cpp'
+    ],
+    'xcode_settings': {
+      'OTHER_LDFLAGS': ['-stdlib=libstdc++'],
+    },
+    'msvs_settings': {
+      'VCLinkerTool': {
+        'SubSystem': '1',   # Console
+      },
+    },
+  }]
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "Benchmark.h"
+
+void LatencyRecorder::Add(const Duration& duration)
+{
+  durations.push_back(duration);
+}
+
+void LatencyRecorder::Report(const std::string& name) const
+{
+  if (durations.empty())
+  {
+    std::cout << std::left << std::setw(40) << name << "no operations" << std::endl;
+    return;
+  }
+  std::vector<Duration> sorted(durations);
+  std::sort(sorted.begin(), sorted.end());
+  std::cout << std::left << std::setw(40) << name << sorted.size() << " ops, "
+            << FormatPercentiles(sorted) << std::endl;
+}
+
+void ReportThroughput(const std::string& name, size_t operationCount,
+  const Duration& elapsed)
+{
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << std::left << std::setw(40) << name << std::fixed << std::setprecision(0)
+            << (seconds > 0 ? operationCount / seconds : 0) << " ops/s" << std::endl;
+}
+
+void ReportDuration(const std::string& name, const Duration& elapsed)
+{
+  std::cout << std::left << std::setw(40) << name << std::fixed << std::setprecision(1)
+            << std::chrono::duration<double, std::milli>(elapsed).count()
+            << " ms" << std::endl;
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../../shell/src/Latency.h"
+
+/**
+ * Collects the durations of single operations and reports their
+ * distribution.
+ */
+class LatencyRecorder
+{
+public:
+  /**
+   * Performs and times a single operation.
+   */
+  template<typename Operation>
+  void Measure(Operation operation)
+  {
+    auto start = std::chrono::steady_clock::now();
+    operation();
+    Add(std::chrono::steady_clock::now() - start);
+  }
+
+  void Add(const Duration& duration);
+
+  /**
+   * Prints the number of operations and the 50th, 95th and 99th percentile
+   * of their durations.
+   */
+  void Report(const std::string& name) const;
+
+private:
+  std::vector<Duration> durations;
+};
+
+/**
+ * Prints the number of operations performed per second.
+ */
+void ReportThroughput(const std::string& name, size_t operationCount,
+  const Duration& elapsed);
+
+/**
+ * Prints the duration of a single operation.
+ */
+void ReportDuration(const std::string& name, const Duration& elapsed);
+
+#endif
@@ -0,0 +1,420 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus.h>
+#include <AdblockPlus/DefaultFileSystem.h>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "../../src/UrlTokenizer.h"
+
+namespace
+{
+  const std::string EASYLIST_URL = "https://benchmark.invalid/easylist.txt";
+  const std::string EXCEPTION_RULES_URL = "https://benchmark.invalid/exceptionrules.txt";
+  // Files written by the filter engine, removed for a cold start.
+  const char* const DATA_FILES[] = {"patterns.ini", "prefs.json", "scripts.cache", 0};
+  const size_t GENERATED_REQUEST_COUNT = 20000;
+
+  struct Options
+  {
+    Options()
+      : dataDir("."), threadCount(std::thread::hardware_concurrency()),
+        repetitions(5)
+    {
+    }
+
+    std::string dataDir;
+    std::string easyList;
+    std::string exceptionRules;
+    std::string requests;
+    unsigned int threadCount;
+    int repetitions;
+  };
+
+  struct Request
+  {
+    std::string url;
+    AdblockPlus::FilterEngine::ContentType contentType;
+    std::vector<std::string> documentUrls;
+  };
+
+  // Serves the filter lists from local files, all other requests fail.
+  class LocalWebRequest : public AdblockPlus::IWebRequest
+  {
+  public:
+    explicit LocalWebRequest(const std::map<std::string, std::string>& files)
+      : files(files)
+    {
+    }
+
+    void GET(const std::string& url, const AdblockPlus::HeaderList& requestHeaders,
+      const GetCallback& getCallback) override
+    {
+      AdblockPlus::ServerResponse response;
+      response.status = NS_ERROR_FAILURE;
+      auto it = files.find(url);
+      if (it != files.end())
+      {
+        std::ifstream file(it->second, std::ios_base::binary);
+        std::stringstream content;
+        content << file.rdbuf();
+        if (file)
+        {
+          response.status = NS_OK;
+          response.responseStatus = 200;
+          response.responseText = content.str();
+        }
+      }
+      // Complete asynchronously like the real implementations.
+      std::thread([getCallback, response]
+      {
+        getCallback(response);
+      }).detach();
+    }
+
+  private:
+    std::map<std::string, std::string> files;
+  };
+
+  void Usage()
+  {
+    std::cerr << "Usage: benchmarks [--easylist=FILE] [--exceptionrules=FILE]"
+                 " [--requests=FILE] [--threads=N] [--repetitions=N]"
+                 " [--data-dir=DIR]" << std::endl
+              << "FILE of --requests lists a request per line:"
+                 " URL CONTENT_TYPE DOCUMENT_URL" << std::endl
+              << "The filter engine data in DIR is overwritten." << std::endl;
+  }
+
+  bool ParseOptions(int argc, char* argv[], Options& options)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      std::string argument(argv[i]);
+      size_t separator = argument.find('=');
+      std::string name = argument.substr(0, separator);
+      std::string value = separator == std::string::npos ? "" : argument.substr(separator + 1);
+      if (name == "--easylist")
+        options.easyList = value;
+      else if (name == "--exceptionrules")
+        options.exceptionRules = value;
+      else if (name == "--requests")
+        options.requests = value;
+      else if (name == "--threads")
+        options.threadCount = std::atoi(value.c_str());
+      else if (name == "--repetitions")
+        options.repetitions = std::atoi(value.c_str());
+      else if (name == "--data-dir")
+        options.dataDir = value;
+      else
+        return false;
+    }
+    return options.threadCount > 0 && options.repetitions > 0;
+  }
+
+  std::vector<Request> ReadRequests(const std::string& path)
+  {
+    std::vector<Request> requests;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+      std::istringstream lineStream(line);
+      Request request;
+      std::string contentType;
+      std::string documentUrl;
+      lineStream >> request.url >> contentType >> documentUrl;
+      if (request.url.empty() || documentUrl.empty())
+        continue;
+      try
+      {
+        request.contentType = AdblockPlus::FilterEngine::StringToContentType(contentType);
+      }
+      catch (const std::invalid_argument&)
+      {
+        continue;
+      }
+      request.documentUrls.push_back(documentUrl);
+      requests.push_back(request);
+    }
+    return requests;
+  }
+
+  // Deterministic mix of requests, for lack of a recorded one.
+  std::vector<Request> GenerateRequests()
+  {
+    static const char* const words[] = {"ad", "ads", "banner", "images",
+      "static", "js", "track", "pixel", "content", "media", "api", "cdn",
+      "assets", "main", "style", "sponsor", "widget", "video"};
+    static const char* const extensions[] = {".js", ".css", ".png", ".gif",
+      ".html", ""};
+    static const AdblockPlus::FilterEngine::ContentType contentTypes[] = {
+      AdblockPlus::FilterEngine::CONTENT_TYPE_SCRIPT,
+      AdblockPlus::FilterEngine::CONTENT_TYPE_STYLESHEET,
+      AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE,
+      AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE,
+      AdblockPlus::FilterEngine::CONTENT_TYPE_SUBDOCUMENT,
+      AdblockPlus::FilterEngine::CONTENT_TYPE_XMLHTTPREQUEST};
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+    const size_t typeCount = sizeof(extensions) / sizeof(extensions[0]);
+
+    std::mt19937 random(42);
+    std::vector<Request> requests(GENERATED_REQUEST_COUNT);
+    for (auto& request : requests)
+    {
+      size_t type = random() % typeCount;
+      request.url = "http://" + std::string(random() % 2 ? "www." : "cdn.") +
+        words[random() % wordCount] + std::to_string(random() % 500) + ".com/" +
+        words[random() % wordCount] + "/" + words[random() % wordCount] +
+        std::to_string(random() % 100) + extensions[type];
+      request.contentType = contentTypes[type];
+      request.documentUrls.push_back("http://www.site" +
+        std::to_string(random() % 200) + ".com/");
+    }
+    return requests;
+  }
+
+  std::string GetHost(const std::string& url)
+  {
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    return url.substr(start, url.find_first_of("/:", start) - start);
+  }
+
+  void RemoveDataFiles(const Options& options)
+  {
+    AdblockPlus::DefaultFileSystem fileSystem;
+    fileSystem.SetBasePath(options.dataDir);
+    for (int i = 0; DATA_FILES[i]; i++)
+    {
+      if (fileSystem.Stat(DATA_FILES[i]).exists)
+        fileSystem.Remove(DATA_FILES[i]);
+    }
+  }
+
+  AdblockPlus::FilterEnginePtr CreateFilterEngine(const Options& options)
+  {
+    AdblockPlus::AppInfo appInfo;
+    appInfo.version = "1.0";
+    appInfo.name = "benchmarks";
+    appInfo.application = "standalone";
+    appInfo.applicationVersion = "1.0";
+    appInfo.locale = "en-US";
+    std::map<std::string, std::string> files;
+    files[EASYLIST_URL] = options.easyList;
+    files[EXCEPTION_RULES_URL] = options.exceptionRules;
+    AdblockPlus::JsEnginePtr jsEngine = AdblockPlus::JsEngine::New(appInfo,
+      AdblockPlus::CreateDefaultTimer(),
+      AdblockPlus::WebRequestPtr(new LocalWebRequest(files)));
+    auto fileSystem = std::make_shared<AdblockPlus::DefaultFileSystem>();
+    fileSystem->SetBasePath(options.dataDir);
+    jsEngine->SetFileSystem(fileSystem);
+
+    AdblockPlus::FilterEngine::CreationParameters params;
+    params.preconfiguredPrefs.emplace("first_run_subscription_auto_select",
+      jsEngine->NewValue(false));
+    params.scriptCacheEnabled = true;
+    return AdblockPlus::FilterEngine::Create(jsEngine, params);
+  }
+
+  void WaitForDownload(const AdblockPlus::Subscription& subscription)
+  {
+    while (subscription.IsUpdating())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  void BenchmarkStartup(const Options& options)
+  {
+    LatencyRecorder cold;
+    LatencyRecorder warm;
+    for (int i = 0; i < options.repetitions; i++)
+    {
+      RemoveDataFiles(options);
+      cold.Measure([&options]
+      {
+        CreateFilterEngine(options);
+      });
+      // The second start reuses the script cache written by the first one.
+      warm.Measure([&options]
+      {
+        CreateFilterEngine(options);
+      });
+    }
+    cold.Report("FilterEngine::Create cold");
+    warm.Report("FilterEngine::Create warm");
+  }
+
+  void BenchmarkSubscriptionParsing(const Options& options,
+    AdblockPlus::FilterEngine& filterEngine)
+  {
+    const std::string* urls[] = {&EASYLIST_URL, &EXCEPTION_RULES_URL};
+    const std::string* paths[] = {&options.easyList, &options.exceptionRules};
+    for (int i = 0; i < 2; i++)
+    {
+      if (paths[i]->empty())
+        continue;
+      auto subscription = filterEngine.GetSubscription(*urls[i]);
+      auto start = std::chrono::steady_clock::now();
+      subscription.AddToList();
+      WaitForDownload(subscription);
+      ReportDuration("Load " + *paths[i], std::chrono::steady_clock::now() - start);
+      if (subscription.GetProperty("filters").AsList().empty())
+        std::cerr << "No filters loaded from " << *paths[i] << std::endl;
+    }
+  }
+
+  void BenchmarkMatching(const Options& options,
+    const AdblockPlus::FilterEngine& filterEngine,
+    const std::vector<Request>& requests)
+  {
+    LatencyRecorder latency;
+    size_t blocked = 0;
+    for (const auto& request : requests)
+    {
+      latency.Measure([&]
+      {
+        if (filterEngine.Matches(request.url, request.contentType, request.documentUrls))
+          ++blocked;
+      });
+    }
+    latency.Report("Matches latency");
+    std::cout << "  " << blocked << " of " << requests.size()
+              << " requests matched" << std::endl;
+
+    for (unsigned int threadCount = 1; threadCount <= options.threadCount; threadCount *= 2)
+    {
+      std::atomic<size_t> next(0);
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (unsigned int i = 0; i < threadCount; i++)
+      {
+        threads.push_back(std::thread([&]
+        {
+          for (size_t j = next++; j < requests.size(); j = next++)
+          {
+            const Request& request = requests[j];
+            filterEngine.GetMatchResult(request.url, request.contentType,
+              request.documentUrls);
+          }
+        }));
+      }
+      for (auto& thread : threads)
+        thread.join();
+      ReportThroughput("GetMatchResult, " + std::to_string(threadCount) + " thread(s)",
+        requests.size(), std::chrono::steady_clock::now() - start);
+    }
+  }
+
+  void BenchmarkTokenizer(const Options& options,
+    const std::vector<Request>& requests)
+  {
+    typedef void (*Tokenize)(const std::string&, AdblockPlus::UrlTokenizer::Tokens&);
+    const Tokenize implementations[] = {
+      AdblockPlus::UrlTokenizer::TokenizeScalar,
+      AdblockPlus::UrlTokenizer::Tokenize
+    };
+    const std::string names[] = {
+      "scalar",
+      AdblockPlus::UrlTokenizer::GetImplementation()
+    };
+    for (int i = 0; i < 2; i++)
+    {
+      AdblockPlus::UrlTokenizer::Tokens tokens;
+      size_t tokenCount = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (int repetition = 0; repetition < options.repetitions; repetition++)
+      {
+        for (const auto& request : requests)
+        {
+          implementations[i](request.url, tokens);
+          tokenCount += tokens.tokens.size();
+        }
+      }
+      ReportThroughput("Tokenize URL, " + names[i],
+        requests.size() * options.repetitions,
+        std::chrono::steady_clock::now() - start);
+      std::cout << "  " << tokenCount << " tokens" << std::endl;
+    }
+  }
+
+  void BenchmarkElementHiding(const AdblockPlus::FilterEngine& filterEngine,
+    const std::vector<Request>& requests)
+  {
+    std::map<std::string, bool> domains;
+    for (const auto& request : requests)
+      domains[GetHost(request.documentUrls[0])] = true;
+    LatencyRecorder uncached;
+    LatencyRecorder cached;
+    for (const auto& domain : domains)
+    {
+      uncached.Measure([&]
+      {
+        filterEngine.GetElementHidingSelectors(domain.first);
+      });
+      cached.Measure([&]
+      {
+        filterEngine.GetElementHidingSelectors(domain.first);
+      });
+    }
+    uncached.Report("GetElementHidingSelectors");
+    cached.Report("GetElementHidingSelectors cached");
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    Usage();
+    return 1;
+  }
+  try
+  {
+    std::vector<Request> requests = options.requests.empty() ?
+      GenerateRequests() : ReadRequests(options.requests);
+    if (requests.empty())
+    {
+      std::cerr << "No requests to check" << std::endl;
+      return 1;
+    }
+
+    BenchmarkTokenizer(options, requests);
+    BenchmarkStartup(options);
+
+    RemoveDataFiles(options);
+    auto filterEngine = CreateFilterEngine(options);
+    BenchmarkSubscriptionParsing(options, *filterEngine);
+    BenchmarkMatching(options, *filterEngine, requests);
+    BenchmarkElementHiding(*filterEngine, requests);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -4,7 +4,9 @@
 import sys
 import os
 import codecs
+import hashlib
 import re
+import zlib
 import json
 import argparse
 import xml.dom.minidom as minidom
@@ -16,21 +18,57 @@ from abp_rewrite import doRewrite
 
 class CStringArray:
     def __init__(self):
-        self._buffer = []
         self._strings = []
+        self._hash = hashlib.sha1()
 
     def add(self, string):
         string = string.encode('utf-8').replace('\r', '')
-        self._strings.append('std::string(buffer + %i, %i)' % (len(self._buffer), len(string)))
-        self._buffer.extend(map(lambda c: str(ord(c)), string))
+        self._hash.update(string + '\0')
+        self._strings.append(string)
+
+    def _offsets(self):
+        offsets = []
+        offset = 0
+        for string in self._strings:
+            offsets.append(offset)
+            offset += len(string) + 1
+        return offsets
 
     def write(self, outHandle, arrayName):
-        print >>outHandle, '#include <string>'
+        # Plain constant data, unlike std::string objects it doesn't have to be
+        # copied to the heap during the static initialization.
+        data = ''.join(map(lambda string: string + '\0', self._strings))
+        print >>outHandle, '#include <cstddef>'
         print >>outHandle, 'namespace'
         print >>outHandle, '{'
-        print >>outHandle, '  const char buffer[] = {%s};' % ', '.join(self._buffer)
+        print >>outHandle, '  const char buffer[] = {%s};' % ', '.join(map(lambda c: str(ord(c)), data))
         print >>outHandle, '}'
-        print >>outHandle, 'std::string %s[] = {%s, std::string()};' % (arrayName, ', '.join(self._strings))
+        print >>outHandle, 'extern const char* const %s[] = {%s, NULL};' % (arrayName, ', '.join(map(lambda offset: 'buffer + %i' % offset, self._offsets())))
+        print >>outHandle, 'extern const char %sHash[] = "%s";' % (arrayName, self._hash.hexdigest())
+
+    def writeCompressed(self, outHandle, arrayName):
+        # The strings are stored as one zlib stream, src/JsSources.cpp
+        # inflates it on first use.
+        data = ''.join(map(lambda string: string + '\0', self._strings))
+        compressed = zlib.compress(data, 9)
+        print >>outHandle, '#include <cstddef>'
+        print >>outHandle, 'extern const unsigned char %sCompressed[] = {%s};' % (arrayName, ', '.join(map(lambda c: str(ord(c)), compressed)))
+        print >>outHandle, 'extern const size_t %sCompressedSize = %i;' % (arrayName, len(compressed))
+        print >>outHandle, 'extern const size_t %sSize = %i;' % (arrayName, len(data))
+        print >>outHandle, 'extern const size_t %sOffsets[] = {%s};' % (arrayName, ', '.join(map(str, self._offsets())))
+        print >>outHandle, 'extern const size_t %sCount = %i;' % (arrayName, len(self._strings))
+        print >>outHandle, 'extern const char %sHash[] = "%s";' % (arrayName, self._hash.hexdigest())
+
+    def writeSizeReport(self, outHandle):
+        # Strings are added in pairs of file name and source.
+        total = 0
+        for i in range(0, len(self._strings) - 1, 2):
+            size = len(self._strings[i + 1])
+            total += size
+            print >>outHandle, '%10i  %s' % (size, self._strings[i])
+        data = ''.join(map(lambda string: string + '\0', self._strings))
+        print >>outHandle, '%10i  total' % total
+        print >>outHandle, '%10i  total compressed' % len(zlib.compress(data, 9))
 
 
 def addFilesVerbatim(array, files):
@@ -41,7 +79,22 @@ def addFilesVerbatim(array, files):
         fileHandle.close()
 
 
-def convertXMLFile(array, file):
+def getModuleName(file):
+    fileName = os.path.basename(file)
+    if fileName.endswith('.js'):
+        return fileName[:-len('.js')]
+    return fileName
+
+
+def addModule(array, file, source, lazy):
+    if lazy:
+        # Only evaluated when required for the first time, see lib/compat.js
+        source = 'require.lazyScopes["%s"] = function()\n{\n%s\n};' % (getModuleName(file), source)
+    array.add(os.path.basename(file))
+    array.add(source)
+
+
+def convertXMLFile(array, file, lazy):
     fileHandle = codecs.open(file, 'rb', encoding='utf-8')
     doc = minidom.parse(file)
     fileHandle.close()
@@ -54,43 +107,60 @@ def convertXMLFile(array, file):
         for name, value in node.attributes.items():
             result[name] = value
         data.append(result)
-        fileName = os.path.basename(file)
-    array.add(fileName)
-    array.add('require.scopes["%s"] = %s;' % (fileName, json.dumps(data)))
-    fileHandle.close()
+    fileName = os.path.basename(file)
+    addModule(array, file, 'require.scopes["%s"] = %s;' % (fileName, json.dumps(data)), lazy)
 
 
-def convertJsFile(array, file):
+def convertJsFile(array, file, lazy):
     converted = doRewrite([os.path.abspath(file)], ['module=true', 'source_repo=https://hg.adblockplus.org/adblockpluscore/'])
-    array.add(os.path.basename(file))
-    array.add(converted)
+    addModule(array, file, converted, lazy)
 
 
-def convert(verbatimBefore, convertFiles, verbatimAfter, outFile):
+def convertModules(array, files, lazy):
+    for file in files:
+        if file.endswith('.xml'):
+            convertXMLFile(array, file, lazy)
+        else:
+            convertJsFile(array, file, lazy)
+
+
+def convert(verbatimBefore, convertFiles, convertLazyFiles, verbatimAfter, outFile, compress=False, sizeReportFile=None):
     array = CStringArray()
     addFilesVerbatim(array, verbatimBefore)
 
-    for file in convertFiles:
-        if file.endswith('.xml'):
-            convertXMLFile(array, file)
-        else:
-            convertJsFile(array, file)
+    convertModules(array, convertFiles, False)
+    convertModules(array, convertLazyFiles or [], True)
 
     addFilesVerbatim(array, verbatimAfter)
 
     outHandle = open(outFile, 'wb')
-    array.write(outHandle, 'jsSources')
+    if compress:
+        array.writeCompressed(outHandle, 'jsSources')
+    else:
+        array.write(outHandle, 'jsSources')
     outHandle.close()
 
+    if sizeReportFile:
+        reportHandle = open(sizeReportFile, 'wb')
+        array.writeSizeReport(reportHandle)
+        reportHandle.close()
+
 if __name__ == '__main__':
     parser = argparse.ArgumentParser(description='Convert JavaScript files')
     parser.add_argument('--before', metavar='verbatim_file', nargs='+',
                         help='JavaScript file to include verbatim at the beginning')
     parser.add_argument('--convert', metavar='file_to_convert', nargs='+',
                         help='JavaScript files to convert')
+    parser.add_argument('--convert-lazy', metavar='file_to_convert', nargs='+',
+                        help='JavaScript files to convert, evaluated on first use')
     parser.add_argument('--after', metavar='verbatim_file', nargs='+',
                         help='JavaScript file to include verbatim at the end')
+    parser.add_argument('--compress', action='store_true',
+                        help='store the sources compressed with zlib')
+    parser.add_argument('--size-report', metavar='report_file',
+                        help='file to write the size of each module to')
     parser.add_argument('output_file',
                         help='output from the conversion')
     args = parser.parse_args()
-    convert(args.before, args.convert, args.after, args.output_file)
+    convert(args.before, args.convert, args.convert_lazy, args.after,
+            args.output_file, args.compress, args.size_report)
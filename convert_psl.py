@@ -0,0 +1,63 @@
+#!/usr/bin/env python
+# coding: utf-8
+
+import argparse
+import codecs
+import json
+import re
+
+
+def toPunycode(suffix):
+    labels = []
+    for label in suffix.split('.'):
+        try:
+            label.encode('ascii')
+            labels.append(label)
+        except UnicodeError:
+            labels.append('xn--' + label.encode('punycode').decode('ascii'))
+    return '.'.join(labels)
+
+
+def toCString(string):
+    return '"%s"' % ''.join(
+        c if 0x20 <= ord(c) < 0x7F and c not in '"\\?' else '\\%03o' % ord(c)
+        for c in map(chr, bytearray(string.encode('utf-8'))))
+
+
+def readPublicSuffixes(file):
+    fileHandle = codecs.open(file, 'rb', encoding='utf-8')
+    source = fileHandle.read()
+    fileHandle.close()
+    match = re.search(r'\{.*\}', source, re.S)
+    return json.loads(match.group(0))
+
+
+def convert(inFile, outFile):
+    publicSuffixes = readPublicSuffixes(inFile)
+    entries = {}
+    for suffix, offset in publicSuffixes.items():
+        # Hosts can be either punycode encoded or not, basedomain.js decodes
+        # them before the lookup. Store both forms instead.
+        entries[suffix] = offset
+        entries[toPunycode(suffix)] = offset
+
+    outHandle = open(outFile, 'w')
+    outHandle.write('// Generated from %s by convert_psl.py, do not edit.\n' % inFile)
+    outHandle.write('#include <cstddef>\n')
+    outHandle.write('extern const char* const publicSuffixList[] = {\n')
+    for suffix in sorted(entries):
+        outHandle.write('  %s,\n' % toCString(suffix))
+    outHandle.write('  NULL\n};\n')
+    outHandle.write('extern const int publicSuffixOffsets[] = {\n')
+    outHandle.write(',\n'.join('  %i' % entries[suffix] for suffix in sorted(entries)))
+    outHandle.write('\n};\n')
+    outHandle.close()
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Convert the public suffix list')
+    parser.add_argument('input_file',
+                        help='JavaScript file defining publicSuffixes')
+    parser.add_argument('output_file',
+                        help='output from the conversion')
+    args = parser.parse_args()
+    convert(args.input_file, args.output_file)
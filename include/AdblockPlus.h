@@ -31,6 +31,8 @@
 #define ADBLOCK_PLUS_ADBLOCK_PLUS_H
 
 #include <AdblockPlus/AppInfo.h>
+#include <AdblockPlus/AsyncLogSystem.h>
+#include <AdblockPlus/ConcurrentReferrerMapping.h>
 #include <AdblockPlus/FileSystem.h>
 #include <AdblockPlus/DefaultLogSystem.h>
 #include <AdblockPlus/DefaultFileSystem.h>
@@ -40,6 +42,8 @@
 #include <AdblockPlus/JsEngine.h>
 #include <AdblockPlus/JsValue.h>
 #include <AdblockPlus/ReferrerMapping.h>
+#include <AdblockPlus/SharedMatcher.h>
+#include <AdblockPlus/UpdateCoordinator.h>
 #include <AdblockPlus/WebRequest.h>
 #include "AdblockPlus/Notification.h"
 
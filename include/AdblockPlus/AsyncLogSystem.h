@@ -0,0 +1,85 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_ASYNC_LOG_SYSTEM_H
+#define ADBLOCK_PLUS_ASYNC_LOG_SYSTEM_H
+
+#include <memory>
+#include <stdint.h>
+#include <thread>
+#include "LogSystem.h"
+
+namespace AdblockPlus
+{
+  /**
+   * `LogSystem` implementation that copies the messages into a bounded
+   * ring buffer and writes them to another `LogSystem` on a background
+   * thread, so that logging doesn't block the caller, e.g.\ JavaScript
+   * holding the engine lock. Adding a message takes no lock. If the buffer
+   * is full the message is dropped, the number of dropped messages is
+   * reported with the next written message.
+   */
+  class AsyncLogSystem : public LogSystem
+  {
+  public:
+    /**
+     * @param target `LogSystem` writing the messages, it is only called on
+     *        the background thread.
+     * @param minLevel Messages of lower levels are neither formatted nor
+     *        written, see `IsEnabled()`.
+     * @param capacity Maximal number of pending messages, rounded up to a
+     *        power of two.
+     */
+    explicit AsyncLogSystem(const LogSystemPtr& target,
+      LogLevel minLevel = LOG_LEVEL_TRACE, size_t capacity = 1024);
+
+    /**
+     * Writes the pending messages and stops the background thread.
+     */
+    ~AsyncLogSystem();
+
+    void operator()(LogLevel logLevel, const std::string& message,
+          const std::string& source) override;
+
+    bool IsEnabled(LogLevel logLevel) const override;
+
+    /**
+     * Blocks until all messages added so far have been written.
+     */
+    void Flush();
+
+    /**
+     * @return Number of messages dropped because the buffer was full.
+     */
+    uint64_t GetDroppedCount() const;
+
+  private:
+    AsyncLogSystem(const AsyncLogSystem&);
+    AsyncLogSystem& operator=(const AsyncLogSystem&);
+
+    class Buffer;
+
+    void ThreadFunc();
+
+    const LogSystemPtr target;
+    const LogLevel minLevel;
+    std::unique_ptr<Buffer> buffer;
+    std::thread thread;
+  };
+}
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_CONCURRENT_REFERRER_MAPPING_H
+#define ADBLOCK_PLUS_CONCURRENT_REFERRER_MAPPING_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "ReferrerMapping.h"
+
+namespace AdblockPlus
+{
+  /**
+   * Thread-safe variant of `ReferrerMapping` for request handlers running on
+   * several threads. The URLs are distributed over shards by hash, each
+   * with its own lock and least recently used list, so concurrent requests
+   * rarely wait for each other.
+   *
+   * The mappings can also be scoped, e.g.\ by tab or frame: each scope has
+   * its own capacity, so a busy tab doesn't evict the referrers of the
+   * others.
+   */
+  class ConcurrentReferrerMapping
+  {
+  public:
+    /**
+     * Identifies a scope, e.g.\ a tab.
+     */
+    typedef int64_t ScopeId;
+
+    /**
+     * Constructor.
+     * @param maxCachedUrls Number of unscoped URL mappings to store, split
+     *        evenly among the shards.
+     * @param shardCount Number of shards of the unscoped mappings.
+     * @param maxCachedUrlsPerScope Number of URL mappings to store per
+     *        scope.
+     */
+    explicit ConcurrentReferrerMapping(int maxCachedUrls = 5000,
+      int shardCount = 16, int maxCachedUrlsPerScope = 1000);
+    ~ConcurrentReferrerMapping();
+
+    /**
+     * Records the referrer for a URL, see `ReferrerMapping::Add()`.
+     * @param url Request URL.
+     * @param referrer Request referrer.
+     */
+    void Add(const std::string& url, const std::string& referrer);
+
+    /**
+     * Builds a chain of referrers for the supplied URL, see
+     * `ReferrerMapping::BuildReferrerChain()`.
+     * @param url URL to build the chain for.
+     * @return List of URLs, starting with the outermost referrer and ending
+     *         with `url`.
+     */
+    std::vector<std::string> BuildReferrerChain(const std::string& url) const;
+
+    /**
+     * Records the referrer for a URL in a scope, the scope is created on
+     * demand.
+     * @param scope Scope of the request, e.g.\ its tab.
+     * @param url Request URL.
+     * @param referrer Request referrer.
+     */
+    void Add(ScopeId scope, const std::string& url, const std::string& referrer);
+
+    /**
+     * Builds a chain of referrers for the supplied URL from the mappings of
+     * a scope.
+     * @param scope Scope of the request, e.g.\ its tab.
+     * @param url URL to build the chain for.
+     * @return List of URLs, starting with the outermost referrer and ending
+     *         with `url`.
+     */
+    std::vector<std::string> BuildReferrerChain(ScopeId scope,
+      const std::string& url) const;
+
+    /**
+     * Same as BuildReferrerChain(ScopeId, const std::string&) const, but
+     * the chain references the URLs stored in the scope, see
+     * `ReferrerMapping::BuildReferrerChain(const std::string&, SharedUrlList&) const`.
+     * @param scope Scope of the request, e.g.\ its tab.
+     * @param url URL to build the chain for.
+     * @param referrerChain Receives the list of URLs.
+     */
+    void BuildReferrerChain(ScopeId scope, const std::string& url,
+      SharedUrlList& referrerChain) const;
+
+    /**
+     * Drops the mappings of a scope, e.g.\ when its tab is closed.
+     * @param scope Scope to remove.
+     */
+    void RemoveScope(ScopeId scope);
+
+  private:
+    ConcurrentReferrerMapping(const ConcurrentReferrerMapping&);
+    ConcurrentReferrerMapping& operator=(const ConcurrentReferrerMapping&);
+
+    struct Shard
+    {
+      explicit Shard(int maxCachedUrls);
+
+      mutable std::mutex mutex;
+      ReferrerMapping mapping;
+    };
+    typedef std::shared_ptr<Shard> ShardPtr;
+
+    const Shard& GetShard(const std::string& url) const;
+    Shard& GetShard(const std::string& url);
+    ShardPtr GetScope(ScopeId scope) const;
+
+    std::vector<ShardPtr> shards;
+    const int maxCachedUrlsPerScope;
+    mutable std::mutex scopesMutex;
+    std::map<ScopeId, ShardPtr> scopes;
+  };
+}
+
+#endif
@@ -19,6 +19,7 @@
 #define ADBLOCK_PLUS_DEFAULT_FILE_SYSTEM_H
 
 #include "FileSystem.h"
+#include "IExecutor.h"
 
 #ifdef _WIN32
 #define PATH_SEPARATOR '\\'
@@ -38,8 +39,18 @@ namespace AdblockPlus
   {
   public:
     std::shared_ptr<std::istream> Read(const std::string& path) const;
+    /**
+     * Maps the file into memory.
+     */
+    FileViewPtr ReadMapped(const std::string& path) const;
     void Write(const std::string& path, std::istream& data);
+    void Write(const std::string& path, const char* data, size_t size);
     void Move(const std::string& fromPath, const std::string& toPath);
+    /**
+     * Lets the operating system copy the file, on Linux the copy shares the
+     * data blocks of the original (reflink) if the file system supports it.
+     */
+    void Copy(const std::string& fromPath, const std::string& toPath);
     void Remove(const std::string& path);
     StatResult Stat(const std::string& path) const;
     std::string Resolve(const std::string& path) const;
@@ -53,6 +64,37 @@ namespace AdblockPlus
   protected:
     std::string basePath;
   };
+
+  /**
+   * `IFileSystem` implementation running the operations of a synchronous
+   * `FileSystem` on an executor, e.g. a `DefaultFileSystem` on the thread
+   * pool created by `CreateDefaultIoExecutor()`. Operations are dispatched
+   * with their path (the source path for moves) as key, so operations on
+   * the same file complete in the order they were requested.
+   */
+  class DefaultAsyncFileSystem : public IFileSystem
+  {
+  public:
+    DefaultAsyncFileSystem(const FileSystemPtr& syncImpl,
+      const std::shared_ptr<IExecutor>& executor);
+
+    void Read(const std::string& path, const ReadCallback& callback) override;
+    void ReadRange(const std::string& path, uint64_t offset, size_t size,
+      const ReadCallback& callback) override;
+    void Write(const std::string& path, IoBuffer&& data,
+      const Callback& callback) override;
+    void Move(const std::string& fromPath, const std::string& toPath,
+      const Callback& callback) override;
+    void Copy(const std::string& fromPath, const std::string& toPath,
+      const Callback& callback) override;
+    void Remove(const std::string& path, const Callback& callback) override;
+    void Stat(const std::string& path, const StatCallback& callback) override;
+    std::string Resolve(const std::string& path) const override;
+
+  private:
+    FileSystemPtr syncImpl;
+    std::shared_ptr<IExecutor> executor;
+  };
 }
 
 #endif
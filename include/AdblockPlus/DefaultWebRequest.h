@@ -22,25 +22,58 @@
 
 namespace AdblockPlus
 {
+  class WorkQueue;
+
   /**
    * `WebRequest` implementation that uses `WinInet` on Windows and libcurl
    * on other platforms. A dummy implementation that always reports failure is
-   * used if libcurl is not available.
+   * used if libcurl is not available. With libcurl, DNS results, TLS sessions
+   * and connections are shared by all requests, so requests to the same host
+   * reuse the connection.
    */
   class DefaultWebRequestSync : public WebRequest
   {
     ServerResponse GET(const std::string& url, const HeaderList& requestHeaders) const;
+    ServerResponse GET(const std::string& url, const HeaderList& requestHeaders,
+      const IWebRequest::DataCallback& dataCallback) const;
   };
 
+  /**
+   * `IWebRequest` implementation performing the requests of a synchronous
+   * `WebRequest` on a pool of threads. Identical requests (same URL and
+   * headers) made while an earlier one is still waiting to be performed are
+   * joined with it, all callbacks receive the result of a single transfer.
+   * Requests of several engines are joined if each of them is passed an
+   * `IWebRequest` forwarding to the same instance.
+   */
   class DefaultWebRequest : public IWebRequest
   {
   public:
-    explicit DefaultWebRequest(const WebRequestSharedPtr& syncImpl);
+    /**
+     * @param syncImpl Implementation performing the requests.
+     * @param maxConcurrentRequests Maximal number of requests performed at
+     *        the same time, further requests wait until one of them is done.
+     * @param maxRequestsPerHost Maximal number of requests to the same host
+     *        performed at the same time.
+     */
+    explicit DefaultWebRequest(const WebRequestSharedPtr& syncImpl,
+      size_t maxConcurrentRequests = 4, size_t maxRequestsPerHost = 2);
     ~DefaultWebRequest();
 
     void GET(const std::string& url, const HeaderList& requestHeaders, const GetCallback& getCallback) override;
+    void GET(const std::string& url, const HeaderList& requestHeaders,
+      const DataCallback& dataCallback, const GetCallback& getCallback) override;
   private:
-    WebRequestSharedPtr syncImpl;
+    struct Request;
+    struct State;
+    typedef std::shared_ptr<Request> RequestPtr;
+    typedef std::shared_ptr<State> StatePtr;
+
+    static void Start(const StatePtr& state, const RequestPtr& request);
+    static void Perform(const StatePtr& state, const RequestPtr& request);
+
+    StatePtr state;
+    std::unique_ptr<WorkQueue> workQueue;
   };
 }
 
@@ -18,15 +18,42 @@
 #ifndef ADBLOCK_PLUS_FILE_SYSTEM_H
 #define ADBLOCK_PLUS_FILE_SYSTEM_H
 
+#include <cstddef>
 #include <istream>
 #include <stdint.h>
 #include <string>
 #include <memory>
+#include "IFileSystem.h"
 
 namespace AdblockPlus
 {
   /**
-   * File system interface.
+   * Read-only view of the contents of a file, see `FileSystem::ReadMapped()`.
+   */
+  class FileView
+  {
+  public:
+    virtual ~FileView() {}
+
+    /**
+     * @return Pointer to the first byte of the file contents.
+     */
+    virtual const char* GetData() const = 0;
+
+    /**
+     * @return Size of the file contents in bytes.
+     */
+    virtual size_t GetSize() const = 0;
+  };
+
+  /**
+   * Shared smart pointer to a `FileView` instance.
+   */
+  typedef std::shared_ptr<const FileView> FileViewPtr;
+
+  /**
+   * Synchronous file system interface, see `IFileSystem` for the
+   * asynchronous one.
    */
   class FileSystem
   {
@@ -34,36 +61,7 @@ namespace AdblockPlus
     /**
      * Result of a stat operation, i.e.\ information about a file.
      */
-    struct StatResult
-    {
-      StatResult()
-      {
-        exists = false;
-        isDirectory = false;
-        isFile = false;
-        lastModified = 0;
-      }
-
-      /**
-       * File exists.
-       */
-      bool exists;
-
-      /**
-       * File is a directory.
-       */
-      bool isDirectory;
-
-      /**
-       * File is a regular file.
-       */
-      bool isFile;
-
-      /**
-       * POSIX time of the last modification.
-       */
-      int64_t lastModified;
-    };
+    typedef IFileSystem::StatResult StatResult;
 
     virtual ~FileSystem() {}
 
@@ -75,6 +73,16 @@ namespace AdblockPlus
     virtual std::shared_ptr<std::istream>
       Read(const std::string& path) const = 0;
 
+    /**
+     * Provides the contents of a file without copying them, e.g. by mapping
+     * the file into memory. The default implementation reads the file using
+     * `Read()`.
+     * @param path File path.
+     * @return View of the file's contents, it stays valid while the view
+     *         exists.
+     */
+    virtual FileViewPtr ReadMapped(const std::string& path) const;
+
     /**
      * Writes to a file.
      * @param path File path.
@@ -83,6 +91,16 @@ namespace AdblockPlus
     virtual void Write(const std::string& path,
                        std::istream& data) = 0;
 
+    /**
+     * Writes a buffer to a file. The default implementation passes the
+     * buffer to `Write()` as a stream without copying it.
+     * @param path File path.
+     * @param data Data to write.
+     * @param size Size of the data in bytes.
+     */
+    virtual void Write(const std::string& path,
+                       const char* data, size_t size);
+
     /**
      * Moves a file (i.e.\ renames it).
      * @param fromPath Current path to the file.
@@ -91,6 +109,15 @@ namespace AdblockPlus
     virtual void Move(const std::string& fromPath,
                       const std::string& toPath) = 0;
 
+    /**
+     * Copies a file, replacing the target file if it exists. The default
+     * implementation writes the contents obtained via `ReadMapped()`.
+     * @param fromPath Path to the file to copy.
+     * @param toPath Path to the copy.
+     */
+    virtual void Copy(const std::string& fromPath,
+                      const std::string& toPath);
+
     /**
      * Removes a file.
      * @param path File path.
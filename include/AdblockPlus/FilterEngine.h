@@ -18,18 +18,33 @@
 #ifndef ADBLOCK_PLUS_FILTER_ENGINE_H
 #define ADBLOCK_PLUS_FILTER_ENGINE_H
 
+#include <chrono>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <AdblockPlus/JsEngine.h>
 #include <AdblockPlus/JsValue.h>
+#include <AdblockPlus/LatencyMetrics.h>
 #include <AdblockPlus/Notification.h>
+#include <AdblockPlus/ReferrerMapping.h>
+#include <AdblockPlus/UpdateCoordinator.h>
 
 namespace AdblockPlus
 {
   class FilterEngine;
   typedef std::shared_ptr<FilterEngine> FilterEnginePtr;
+  class CompiledRuleset;
+  class ElemHideCache;
+  class FilterHitStatistics;
+  class LatencyHistogram;
+  class MatchCache;
+  class Matcher;
+  class MatcherFilter;
+  class PrefsCache;
+  class WorkQueue;
 
   /**
    * Wrapper for an Adblock Plus filter object.
@@ -181,6 +196,114 @@ namespace AdblockPlus
    */
   typedef std::unique_ptr<Filter> FilterPtr;
 
+  /**
+   * Whitelisting state of a document, computed once by
+   * `FilterEngine::CreateDocumentContext()` and then used to check all the
+   * resources requested by the document.
+   */
+  class DocumentContext
+  {
+    friend class FilterEngine;
+  public:
+    /**
+     * Retrieves the chain of document URLs the context was created for.
+     * @return Chain of document URLs.
+     */
+    const std::vector<std::string>& GetDocumentUrls() const
+    {
+      return documentUrls;
+    }
+
+    /**
+     * Checks whether all the requests of the document are whitelisted.
+     * @return `true` if the document is whitelisted.
+     */
+    bool IsDocumentWhitelisted() const
+    {
+      return !!documentWhitelistingFilter;
+    }
+
+    /**
+     * Checks whether element hiding is disabled for the document.
+     * @return `true` if element hiding is whitelisted for the document.
+     */
+    bool IsElemhideWhitelisted() const
+    {
+      return elemhideWhitelisted;
+    }
+
+    /**
+     * Checks whether generic blocking filters are disabled for the document.
+     * @return `true` if the document is whitelisted with `$genericblock`.
+     */
+    bool IsGenericblockWhitelisted() const
+    {
+      return genericblockWhitelisted;
+    }
+
+  private:
+    DocumentContext();
+
+    std::vector<std::string> documentUrls;
+    std::shared_ptr<const MatcherFilter> documentWhitelistingFilter;
+    bool elemhideWhitelisted;
+    bool genericblockWhitelisted;
+  };
+
+  /**
+   * Shared smart pointer to an immutable `DocumentContext` instance.
+   */
+  typedef std::shared_ptr<const DocumentContext> DocumentContextPtr;
+
+  /**
+   * Plain result of a request check, which unlike `FilterPtr` doesn't
+   * reference any JavaScript object, see `FilterEngine::GetMatchResult()`.
+   */
+  struct MatchResult
+  {
+    /**
+     * Values of the `thirdParty` filter option.
+     */
+    enum ThirdParty {THIRD_PARTY_ANY, THIRD_PARTY_ONLY, FIRST_PARTY_ONLY};
+
+    /**
+     * Values of the `collapse` filter option, `COLLAPSE_DEFAULT` means that
+     * the `hidePlaceholders` pref applies.
+     */
+    enum Collapse {COLLAPSE_DEFAULT, COLLAPSE_ALWAYS, COLLAPSE_NEVER};
+
+    MatchResult();
+
+    /**
+     * Checks whether a filter matched.
+     * @return `true` if there was a match.
+     */
+    bool IsMatch() const
+    {
+      return type != Filter::TYPE_INVALID;
+    }
+
+    /**
+     * Type of the matching filter, `Filter::TYPE_BLOCKING` or
+     * `Filter::TYPE_EXCEPTION`, or `Filter::TYPE_INVALID` if there was no
+     * match.
+     */
+    Filter::Type type;
+    /**
+     * Text of the matching filter, use FilterEngine::GetFilter() to retrieve
+     * the `Filter` object.
+     */
+    std::string text;
+    /**
+     * Third-party restriction of the matching filter.
+     */
+    ThirdParty thirdParty;
+    /**
+     * Collapse option of the matching filter.
+     */
+    Collapse collapse;
+  };
+
   /**
    * Main component of libadblockplus.
    * It handles:
@@ -191,8 +314,9 @@ namespace AdblockPlus
   class FilterEngine
   {
   public:
-    // Make sure to keep ContentType in sync with FilterEngine::contentTypes
-    // and with RegExpFilter.typeMap from filterClasses.js.
+    // Make sure to keep ContentType in sync with the table in
+    // src/ContentTypes.cpp and with RegExpFilter.typeMap from
+    // filterClasses.js.
     /**
      * Possible resource content types.
      */
@@ -240,6 +364,9 @@ namespace AdblockPlus
      * [FilterNotifier.triggerListeners](https://adblockplus.org/jsdoc/adblockpluscore/FilterNotifier.html#.triggerListeners)
      * for the full list).
      * The second parameter is the filter/subscription object affected, if any.
+     * Filters changed by `AddFilters()` and `RemoveFilters()` are reported
+     * once per call, with the action `"filters.added"` or
+     * `"filters.removed"` and an array of the affected filters.
      */
     typedef std::function<void(const std::string&, JsValue&&)> FilterChangeCallback;
 
@@ -261,11 +388,46 @@ namespace AdblockPlus
      */
     typedef std::function<void(const std::string* allowedConnectionType, const std::function<void(bool)>&)> IsConnectionAllowedAsyncCallback;
 
+    /**
+     * Shared immutable list of CSS selectors, see
+     * `GetSharedElementHidingSelectors()`.
+     */
+    typedef std::shared_ptr<const std::vector<std::string>> ElementHidingSelectorsPtr;
+
+    /**
+     * Callback type invoked when the stored filters are loaded, see
+     * `CreationParameters::filtersLoadedCallback`.
+     */
+    typedef std::function<void(const FilterEnginePtr&)> FiltersLoadedCallback;
+
+    /**
+     * When the element hiding filters of the subscriptions are indexed, see
+     * `CreationParameters::elemHideIndexing`.
+     */
+    enum ElemHideIndexing
+    {
+      /**
+       * While the filters are loaded, the default.
+       */
+      ELEM_HIDE_INDEXING_EAGER,
+      /**
+       * On the first call to `GetElementHidingSelectors()`.
+       */
+      ELEM_HIDE_INDEXING_LAZY,
+      /**
+       * Never, `GetElementHidingSelectors()` only returns the selectors of
+       * `CreationParameters::precompiledRuleset`.
+       */
+      ELEM_HIDE_INDEXING_DISABLED
+    };
+
     /**
      * FilterEngine creation parameters.
      */
     struct CreationParameters
     {
+      CreationParameters();
+
       /**
        * `AdblockPlus::FilterEngine::Prefs` name - value list of preconfigured
        * prefs.
@@ -277,8 +439,412 @@ namespace AdblockPlus
        * on the current connection.
        */
       IsConnectionAllowedAsyncCallback isSubscriptionDowloadAllowedCallback;
+      /**
+       * Whether results of request matching are cached, `false` by default.
+       * The cache is invalidated whenever the filters change.
+       */
+      bool matchCacheEnabled;
+      /**
+       * Maximal number of cached match results, least recently used results
+       * are evicted first. 1000 by default.
+       */
+      size_t matchCacheCapacity;
+      /**
+       * Whether identical `MatchesAsync()` requests which are issued while
+       * such a request is still pending are answered by a single check,
+       * `true` by default.
+       */
+      bool coalesceAsyncMatches;
+      /**
+       * Whether a Bloom filter of the keywords of all blocking and whitelist
+       * filters is consulted before matching a request, `true` by default.
+       * Requests without any keyword of a filter are answered without
+       * further work, unless filters without a keyword apply to their
+       * content type. The results are the same either way, see also
+       * `Stats::prefilterSize`.
+       */
+      bool prefilterEnabled;
+      /**
+       * Targeted probability of a request without any matching keyword
+       * passing the prefilter, `0.01` by default.
+       */
+      double prefilterFalsePositiveRate;
+      /**
+       * Upper bound of the memory used by the prefilter in bytes, the false
+       * positive rate increases if it is reached. 1 MiB by default.
+       */
+      size_t prefilterMaxSize;
+      /**
+       * Whether the compilation data of the bundled scripts is stored in the
+       * file `scripts.cache` of the `FileSystem` and reused on the next start,
+       * `false` by default. The data is discarded when the scripts or V8
+       * change.
+       */
+      bool scriptCacheEnabled;
+      /**
+       * Path of a ruleset generated by `abpcompile` in the `FileSystem` of
+       * the `JsEngine`, empty by default. The file is mapped into memory
+       * and its blocking, whitelist and element hiding filters apply in
+       * addition to the ones of the subscriptions, without being parsed by
+       * the JavaScript engine. They are not listed by `GetListedFilters()`
+       * or the subscriptions, so the compiled lists shouldn't be added as
+       * subscriptions as well.
+       */
+      std::string precompiledRuleset;
+      /**
+       * Optional callback invoked as soon as the stored filters are loaded,
+       * before the `FilterEngine` creation is complete. The `FilterEngine`
+       * passed to it can already be used for matching, e.g. `Matches()` or
+       * `GetElementHidingSelectors()`, while prefs, first run subscriptions
+       * and `IsFirstRun()` are only ready when the creation is complete.
+       */
+      FiltersLoadedCallback filtersLoadedCallback;
+      /**
+       * Time in milliseconds by which writing the prefs is delayed after a
+       * pref changed, all changes within that time are written at once.
+       * `0` by default, i.e. the prefs are written immediately. See also
+       * `FlushPrefs()`.
+       */
+      int prefsSaveDelay;
+      /**
+       * Whether the calls of `Matches()`, `GetMatchResult()`,
+       * `IsDocumentWhitelisted()`, `GetElementHidingSelectors()`, `GetPref()`
+       * and the subscription downloads are counted and timed, see
+       * `GetMetrics()`. `false` by default, no clock is read then.
+       */
+      bool metricsEnabled;
+      /**
+       * Whether the matches of filters are counted, see `GetTopFilterHits()`.
+       * If the `savestats` pref is set, the counts are also added to the
+       * `hitCount` and `lastHit` properties of the filters every
+       * `hitStatisticsFlushInterval`. `false` by default.
+       */
+      bool hitStatisticsEnabled;
+      /**
+       * Time in milliseconds between two flushes of the counted matches to
+       * the filters, see `hitStatisticsEnabled` and `FlushFilterHits()`.
+       * `60000` by default.
+       */
+      int hitStatisticsFlushInterval;
+      /**
+       * Maximal number of filters added to or removed from the matcher in
+       * one task when a subscription is updated or filters are added. The
+       * remaining ones are processed in further tasks scheduled with the
+       * timer, so that other calls using the JavaScript engine, e.g.\
+       * `Matches()`, don't wait for the whole list. Until the last chunk is
+       * processed requests are matched against the filters processed so
+       * far. The filters stored on disk are always loaded at once. `1000` by
+       * default, `0` processes all filters at once.
+       */
+      int matcherChunkSize;
+      /**
+       * Coordinator shared with the other engines of the process, `nullptr`
+       * by default. The connection check of each download, see
+       * `isSubscriptionDowloadAllowedCallback`, is then delayed by
+       * `UpdateCoordinator::Stagger()`. The `JsEngine` should be created
+       * with the web request returned by
+       * `UpdateCoordinator::CreateWebRequest()`, so that the downloads are
+       * shared as well.
+       */
+      UpdateCoordinatorPtr updateCoordinator;
+      /**
+       * When the element hiding filters are indexed, `ELEM_HIDE_INDEXING_EAGER`
+       * by default. Deployments which only block requests save the memory
+       * and time needed for the index, which covers more than half of the
+       * lines of EasyList, with `ELEM_HIDE_INDEXING_LAZY` or
+       * `ELEM_HIDE_INDEXING_DISABLED`. The filters are stored and listed
+       * either way.
+       */
+      ElemHideIndexing elemHideIndexing;
+      /**
+       * Minimal time in milliseconds between two evaluations of the
+       * notifications by `ShowNextNotification()`, `0` by default. Calls
+       * made earlier return without showing a notification, unless the
+       * host of the URL is targeted by a notification. Notifications are
+       * then shown with a delay of up to the interval, e.g.\ when
+       * `ShowNextNotification()` is called for each navigation.
+       */
+      int notificationEvaluationInterval;
+      /**
+       * Whether the filters of disabled subscriptions are unloaded, `false`
+       * by default. They are then only kept as text, which takes a fraction
+       * of the memory of the parsed filters, and parsed again when the
+       * subscription is enabled. Until then the filters of the subscription
+       * aren't listed by `Subscription`, except for those with hit
+       * statistics, but they are still saved.
+       */
+      bool unloadDisabledSubscriptions;
+    };
+
+    /**
+     * Number of matches of a filter, see `GetTopFilterHits()`.
+     */
+    struct FilterHits
+    {
+      /**
+       * Text of the filter.
+       */
+      std::string text;
+      /**
+       * Number of matches.
+       */
+      uint64_t hitCount;
+      /**
+       * Time of the last match in milliseconds since the epoch.
+       */
+      int64_t lastHit;
+    };
+
+    /**
+     * Plain description of a filter, see `GetListedFilterPage()`.
+     */
+    struct FilterInfo
+    {
+      /**
+       * Text of the filter.
+       */
+      std::string text;
+      /**
+       * Same as `Filter::GetType()`.
+       */
+      Filter::Type type;
+    };
+
+    /**
+     * Metadata of a subscription, see `GetSubscriptionsSnapshot()`.
+     */
+    struct SubscriptionInfo
+    {
+      /**
+       * URL of the subscription.
+       */
+      std::string url;
+      /**
+       * Title of the subscription, empty if unknown.
+       */
+      std::string title;
+      /**
+       * Homepage of the subscription, empty if unknown.
+       */
+      std::string homepage;
+      /**
+       * Time of the last download attempt in seconds since the epoch, `0`
+       * if the subscription has never been downloaded.
+       */
+      int64_t lastDownload;
+      /**
+       * Time of the last successful download in seconds since the epoch,
+       * `0` if there was none.
+       */
+      int64_t lastSuccess;
+      /**
+       * Result of the last download, e.g. `"synchronize_ok"`, empty if
+       * there was none.
+       */
+      std::string downloadStatus;
+      /**
+       * Same as `Subscription::IsDisabled()`.
+       */
+      bool disabled;
+      /**
+       * Same as `Subscription::IsUpdating()`.
+       */
+      bool updating;
+      /**
+       * Same as `Subscription::IsAA()`.
+       */
+      bool acceptableAds;
+    };
+
+    /**
+     * Counters of the match result cache, see
+     * `CreationParameters::matchCacheEnabled`.
+     */
+    struct MatchCacheStats
+    {
+      /**
+       * Number of checks answered from the cache.
+       */
+      uint64_t hits;
+      /**
+       * Number of checks not found in the cache.
+       */
+      uint64_t misses;
+    };
+
+    /**
+     * Statistics of a subscription, see `Stats`.
+     */
+    struct SubscriptionStats
+    {
+      /**
+       * URL of the subscription, for special subscriptions holding the
+       * filters added by the user it begins with `~`.
+       */
+      std::string url;
+      /**
+       * Number of filters in the subscription.
+       */
+      size_t filterCount;
+      /**
+       * Rough estimate of the memory used by the filters of the
+       * subscription, in bytes.
+       */
+      size_t approximateSize;
+      /**
+       * Whether the subscription is disabled, see `Subscription::IsDisabled()`.
+       */
+      bool disabled;
+      /**
+       * Whether the filters of the disabled subscription are unloaded, see
+       * `CreationParameters::unloadDisabledSubscriptions`.
+       */
+      bool unloaded;
+    };
+
+    /**
+     * Statistics of the filter engine, see `GetStats()`.
+     */
+    struct Stats
+    {
+      /**
+       * Number of subscriptions including the special ones.
+       */
+      size_t subscriptionCount;
+      /**
+       * Number of filters in all subscriptions, a filter contained in
+       * several subscriptions is counted once per subscription.
+       */
+      size_t filterCount;
+      /**
+       * Number of results held by the match result cache.
+       */
+      size_t matchCacheSize;
+      /**
+       * Number of domains held by the element hiding selectors cache.
+       */
+      size_t elemHideCacheSize;
+      /**
+       * Number of whitelisting checks of documents held by the cache of
+       * `IsDocumentWhitelisted()` and `IsElemhideWhitelisted()`.
+       */
+      size_t whitelistCacheSize;
+      /**
+       * Memory used by the prefilter in bytes, see
+       * `CreationParameters::prefilterEnabled`.
+       */
+      size_t prefilterSize;
+      /**
+       * Estimated false positive rate of the prefilter for the current
+       * filters.
+       */
+      double prefilterFalsePositiveRate;
+      /**
+       * Number of requests which passed the prefilter and were matched.
+       */
+      uint64_t prefilterPassedCount;
+      /**
+       * Number of requests rejected by the prefilter.
+       */
+      uint64_t prefilterRejectedCount;
+      /**
+       * Number of distinct blocking and whitelist filters parsed natively
+       * in this process. Filters with the same text are parsed once and
+       * shared by all `FilterEngine` instances, e.g. those of several
+       * profiles with the same subscriptions.
+       */
+      size_t sharedFilterCount;
+      /**
+       * Per-subscription statistics.
+       */
+      std::vector<SubscriptionStats> subscriptions;
+    };
+
+    /**
+     * Evaluation time of a bundled script, see `StartupProfile`.
+     */
+    struct ScriptTiming
+    {
+      /**
+       * File name of the script, e.g. `"filterStorage.js"`.
+       */
+      std::string filename;
+      std::chrono::microseconds duration;
+    };
+
+    /**
+     * Durations of the phases of the `FilterEngine` creation, see
+     * `GetStartupProfile()`. Phases running concurrently, e.g. loading the
+     * prefs and the filters, overlap.
+     */
+    struct StartupProfile
+    {
+      StartupProfile();
+
+      /**
+       * Evaluation of each bundled script, in loading order.
+       */
+      std::vector<ScriptTiming> scripts;
+      /**
+       * Reading and parsing `prefs.json`.
+       */
+      std::chrono::microseconds prefsLoad;
+      /**
+       * Reading `patterns.ini`, excluding `filterParse`.
+       */
+      std::chrono::microseconds filtersRead;
+      /**
+       * Parsing the lines of `patterns.ini`.
+       */
+      std::chrono::microseconds filterParse;
+      /**
+       * Adding the loaded filters to the native matcher.
+       */
+      std::chrono::microseconds matcherBuild;
+      /**
+       * Time from the matcher being built until the `_init` event, which
+       * completes the creation, arrives. This includes waiting for the prefs
+       * and setting up the subscriptions on the first run.
+       */
+      std::chrono::microseconds initDelivery;
+      /**
+       * Time from the start of `CreateAsync()` until the `_init` event.
+       */
+      std::chrono::microseconds total;
+    };
+
+    /**
+     * A single request checked by `MatchesBatch()`.
+     */
+    struct MatchRequest
+    {
+      /**
+       * URL to match.
+       */
+      std::string url;
+      /**
+       * Content type mask of the requested resource.
+       */
+      ContentTypeMask contentTypeMask;
+      /**
+       * Chain of documents requesting the resource, see
+       * Matches(const std::string&, ContentTypeMask, const std::vector<std::string>&) const.
+       */
+      std::vector<std::string> documentUrls;
     };
 
+    /**
+     * Callback type invoked with the result of `MatchesAsync()`, the filter
+     * is `null` if there was no match.
+     */
+    typedef std::function<void(FilterPtr&& filter)> MatchesCallback;
+
+    /**
+     * Callback type invoked for each custom filter by
+     * `ForEachListedFilter()`.
+     */
+    typedef std::function<void(const FilterInfo& filter)> ListedFilterCallback;
+
     /**
     * Callback type invoked when FilterEngine is created.
     */
@@ -303,12 +869,30 @@ namespace AdblockPlus
     static FilterEnginePtr Create(const JsEnginePtr& jsEngine,
       const CreationParameters& params = CreationParameters());
 
+    /**
+     * Stops the worker threads of `MatchesAsync()` and of the subscription
+     * updates, waiting for a running task to finish.
+     */
+    ~FilterEngine();
+
     /**
      * Retrieves the `JsEngine` instance associated with this `FilterEngine`
      * instance.
      */
     JsEnginePtr GetJsEngine() const { return jsEngine; }
 
+    /**
+     * Retrieves the durations of the phases of the creation of this
+     * instance, to find the slowest phase and detect regressions across
+     * subscription sizes.
+     * @return `StartupProfile` of this instance, filled in before the
+     *         `OnCreatedCallback` is invoked.
+     */
+    const StartupProfile& GetStartupProfile() const
+    {
+      return startupProfile;
+    }
+
     /**
      * Checks if this is the first run of the application.
      * @return `true` if the application is running for the first time.
@@ -336,12 +920,80 @@ namespace AdblockPlus
      */
     std::vector<Filter> GetListedFilters() const;
 
+    /**
+     * Retrieves a range of the custom filters returned by
+     * `GetListedFilters()` as plain data, without creating a `Filter` for
+     * each of them.
+     * @param offset Index of the first filter to retrieve.
+     * @param limit Maximal number of filters to retrieve.
+     * @return Custom filters, empty if `offset` is past the end.
+     */
+    std::vector<FilterInfo> GetListedFilterPage(size_t offset, size_t limit) const;
+
+    /**
+     * Adds many filters to the list of custom filters at once. Unlike
+     * calling `Filter::AddToList()` for each of them, the filter list is
+     * saved once and a single `"filters.added"` change is reported, see
+     * `FilterChangeCallback`.
+     * @param texts Text representations of the filters, empty ones and
+     *        those already listed are skipped.
+     */
+    void AddFilters(const std::vector<std::string>& texts);
+
+    /**
+     * Removes many filters from the list of custom filters at once, see
+     * `AddFilters()`. A single `"filters.removed"` change is reported.
+     * @param texts Text representations of the filters, those not listed
+     *        are skipped.
+     */
+    void RemoveFilters(const std::vector<std::string>& texts);
+
+    /**
+     * Retrieves the custom filters returned by `GetListedFilters()` as
+     * text, e.g.\ for a backup to be restored with `AddFilters()`.
+     * @return Filter texts, each followed by a newline.
+     */
+    std::string ExportListedFilters() const;
+
+    /**
+     * Compiles the filters of all enabled subscriptions into a ruleset
+     * which other processes can match requests against without a
+     * JavaScript engine, see `SharedMatcher`. Each call publishes a new
+     * generation, readers switch to it on `SharedMatcher::Refresh()`. Call
+     * it again whenever the filters change, e.g.\ from the
+     * `FilterChangeCallback`. Filters loaded from
+     * `CreationParameters::precompiledRuleset` are not included.
+     * @param path Path in the `FileSystem` of the `JsEngine`, the rulesets
+     *        are written next to it.
+     * @return Generation of the published ruleset.
+     */
+    uint64_t PublishRuleset(const std::string& path) const;
+
+    /**
+     * Calls `callback` for each custom filter, in the order of
+     * `GetListedFilters()`. The filters are retrieved in pages, the
+     * JavaScript engine is not locked while `callback` runs, so it may use
+     * the `FilterEngine`. Filters added or removed meanwhile can be skipped
+     * or reported twice.
+     * @param callback Receives the filters.
+     */
+    void ForEachListedFilter(const ListedFilterCallback& callback) const;
+
     /**
      * Retrieves all subscriptions.
      * @return List of subscriptions.
      */
     std::vector<Subscription> GetListedSubscriptions() const;
 
+    /**
+     * Retrieves the metadata of all subscriptions returned by
+     * `GetListedSubscriptions()` at once. Unlike querying the properties of
+     * each `Subscription`, this enters the JavaScript engine only once.
+     * @return Metadata of the subscriptions, in the order of
+     *         `GetListedSubscriptions()`.
+     */
+    std::vector<SubscriptionInfo> GetSubscriptionsSnapshot() const;
+
     /**
      * Retrieves all recommended subscriptions.
      * @return List of recommended subscriptions.
@@ -376,12 +1028,17 @@ namespace AdblockPlus
     /**
      * Invokes the listener set via SetNotificationAvailableCallback() with the
      * next notification to be shown.
+     * The notifications are only evaluated if one of them might apply to
+     * the URL, URL-targeted notifications are looked up by host. See also
+     * `CreationParameters::notificationEvaluationInterval`.
      * @param url URL to match notifications to (optional).
      */
     void ShowNextNotification(const std::string& url = std::string()) const;
 
     /**
      * Sets the callback invoked when a notification should be shown.
+     * Notifications are only loaded and downloaded after this or
+     * `ShowNextNotification()` has been called.
      * @param callback Callback to invoke.
      */
     void SetShowNotificationCallback(const ShowNotificationCallback& value);
@@ -423,6 +1080,159 @@ namespace AdblockPlus
         ContentTypeMask contentTypeMask,
         const std::vector<std::string>& documentUrls) const;
 
+    /**
+     * Same as
+     * Matches(const std::string&, ContentTypeMask, const std::vector<std::string>&) const,
+     * but takes the chain of documents as shared URLs, e.g. built by
+     * `ReferrerMapping::BuildReferrerChain(const std::string&, SharedUrlList&) const`,
+     * so that passing it doesn't copy any URL.
+     * @param url URL to match.
+     * @param contentTypeMask Content type mask of the requested resource.
+     * @param documentUrls Chain of documents requesting the resource, none
+     *        of the elements may be `null`.
+     * @return Matching filter, or a `null` if there was no match.
+     */
+    FilterPtr Matches(const std::string& url,
+        ContentTypeMask contentTypeMask,
+        const SharedUrlList& documentUrls) const;
+
+    //@{
+    /**
+     * Computes the whitelisting state of a document, to be passed to
+     * Matches(const std::string&, ContentTypeMask, const DocumentContext&) const
+     * for all the resources requested by the document. This way the frame
+     * chain is only checked once rather than for every request.
+     * @param documentUrls Chain of documents, same as for
+     *        Matches(const std::string&, ContentTypeMask, const std::vector<std::string>&) const,
+     *        e.g. built by `ReferrerMapping::BuildReferrerChain()`.
+     * @return New `DocumentContext` instance, it isn't updated when the
+     *         filters change.
+     */
+    DocumentContextPtr CreateDocumentContext(
+        const std::vector<std::string>& documentUrls) const;
+    DocumentContextPtr CreateDocumentContext(
+        const SharedUrlList& documentUrls) const;
+    //@}
+
+    /**
+     * Checks if any active filter matches a resource requested by a
+     * document. The result is the same as for
+     * Matches(const std::string&, ContentTypeMask, const std::vector<std::string>&) const
+     * with the document's frame chain, except that generic blocking filters
+     * are ignored if the document is whitelisted with `$genericblock`.
+     * @param url URL to match.
+     * @param contentTypeMask Content type mask of the requested resource.
+     * @param documentContext Context of the document requesting the resource,
+     *        see `CreateDocumentContext()`.
+     * @return Matching filter, or `null` if there was no match.
+     */
+    FilterPtr Matches(const std::string& url,
+        ContentTypeMask contentTypeMask,
+        const DocumentContext& documentContext) const;
+
+    //@{
+    /**
+     * Same as the corresponding `Matches()` overload, but returns a plain
+     * `MatchResult` instead of a `Filter`. This doesn't enter the JavaScript
+     * engine, so it's the cheapest way to check a request. It can be called
+     * from several threads at once, lookups only serialize briefly while
+     * filters are being changed.
+     * @param url URL to match.
+     * @param contentTypeMask Content type mask of the requested resource.
+     * @param documentUrls Chain of documents requesting the resource.
+     * @param documentContext Context of the document requesting the
+     *        resource.
+     * @return Result of the check.
+     */
+    MatchResult GetMatchResult(const std::string& url,
+        ContentTypeMask contentTypeMask,
+        const std::vector<std::string>& documentUrls) const;
+    MatchResult GetMatchResult(const std::string& url,
+        ContentTypeMask contentTypeMask,
+        const SharedUrlList& documentUrls) const;
+    MatchResult GetMatchResult(const std::string& url,
+        ContentTypeMask contentTypeMask,
+        const DocumentContext& documentContext) const;
+    //@}
+
+    /**
+     * Checks many requests at once, e.g. all subresources of a page. This is
+     * equivalent to calling `Matches()` for each request, but the document
+     * whitelisting of a frame chain shared by several requests is only
+     * checked once and the JavaScript engine is entered only once to create
+     * the matching filters.
+     * @param requests Requests to check.
+     * @return Matching filters in the order of `requests`, an element is
+     *         `null` if there was no match for the corresponding request.
+     */
+    std::vector<FilterPtr> MatchesBatch(const std::vector<MatchRequest>& requests) const;
+
+    /**
+     * Asynchronous version of
+     * Matches(const std::string&, ContentTypeMask, const std::vector<std::string>&) const,
+     * the caller is not blocked while the check waits for the JavaScript
+     * engine. Requests are processed in their order on a single thread owned
+     * by the `FilterEngine`, `callback` is called on that thread. Pending
+     * requests are dropped when the `FilterEngine` is destroyed.
+     * @param url URL to match.
+     * @param contentTypeMask Content type mask of the requested resource.
+     * @param documentUrls Chain of documents requesting the resource.
+     * @param callback Receives the matching filter.
+     */
+    void MatchesAsync(const std::string& url,
+        ContentTypeMask contentTypeMask,
+        const std::vector<std::string>& documentUrls,
+        const MatchesCallback& callback) const;
+
+    /**
+     * Retrieves the counters of the match result cache.
+     * @return Cache counters, all zero if the cache is disabled.
+     */
+    MatchCacheStats GetMatchCacheStats() const;
+
+    /**
+     * Retrieves the filter and subscription counts and the sizes of the
+     * native caches, see also `JsEngine::GetMemoryStats()`.
+     * @return Current `Stats`.
+     */
+    Stats GetStats() const;
+
+    /**
+     * Retrieves the call counts and durations of the instrumented APIs, see
+     * `CreationParameters::metricsEnabled`. The entries are named
+     * `"Matches"` (including `GetMatchResult()`), `"IsDocumentWhitelisted"`,
+     * `"GetElementHidingSelectors"` (including
+     * `GetSharedElementHidingSelectors()`), `"GetPref"` and
+     * `"SubscriptionUpdate"`, the latter measures the time from the start of
+     * a subscription download until its result is known.
+     * @return Current metrics, empty if metrics are disabled.
+     */
+    std::vector<LatencyMetrics> GetMetrics() const;
+
+    /**
+     * Resets all counters of `GetMetrics()` to zero.
+     */
+    void ResetMetrics();
+
+    /**
+     * Retrieves the filters matched most often since the creation of this
+     * instance, see `CreationParameters::hitStatisticsEnabled`. Matches of
+     * `Matches()`, `MatchesAsync()`, `MatchesBatch()`, `GetMatchResult()`,
+     * `IsDocumentWhitelisted()` and `IsElemhideWhitelisted()` are counted.
+     * @param count Maximal number of filters to return.
+     * @return Filters sorted by descending number of matches, empty if the
+     *         statistics are disabled.
+     */
+    std::vector<FilterHits> GetTopFilterHits(size_t count) const;
+
+    /**
+     * Adds the matches counted since the last flush to the `hitCount` and
+     * `lastHit` properties of the filters, if the `savestats` pref is set.
+     * This happens periodically anyway, see
+     * `CreationParameters::hitStatisticsFlushInterval`.
+     */
+    void FlushFilterHits() const;
+
     /**
      * Checks whether the document at the supplied URL is whitelisted.
      * @param url URL of the document.
@@ -460,12 +1270,49 @@ namespace AdblockPlus
     std::vector<std::string> GetElementHidingSelectors(const std::string& domain) const;
 
     /**
-     * Retrieves a preference value.
+     * Same as `GetElementHidingSelectors()`, but stores the selectors in a
+     * vector of the caller, so that repeated calls reuse its capacity.
+     * @param domain Domain to retrieve CSS selectors for.
+     * @param selectors Vector to store the CSS selectors in, its previous
+     *        content is replaced.
+     */
+    void GetElementHidingSelectors(const std::string& domain,
+      std::vector<std::string>& selectors) const;
+
+    /**
+     * Same as `GetElementHidingSelectors()`, but returns a list shared with
+     * other callers instead of a copy. The selectors are cached per domain
+     * until element hiding filters change, so that repeated navigations to a
+     * domain don't enter the JavaScript engine.
+     * @param domain Domain to retrieve CSS selectors for.
+     * @return List of CSS selectors.
+     */
+    ElementHidingSelectorsPtr GetSharedElementHidingSelectors(const std::string& domain) const;
+
+    /**
+     * Retrieves a preference value. Boolean, string and integer
+     * preferences are mirrored natively once the preferences are loaded,
+     * their values are created without calling into JavaScript.
      * @param pref Preference name.
      * @return Preference value, or `null` if it doesn't exist.
      */
     JsValue GetPref(const std::string& pref) const;
 
+    //@{
+    /**
+     * Retrieves the native copy of a preference, see `GetPref()`. This
+     * doesn't enter the JavaScript engine, so it's suitable for
+     * preferences read on every request, e.g.\ `enabled`.
+     * @param pref Preference name.
+     * @param value Receives the preference value.
+     * @return `true` if the preference is mirrored and has the type of
+     *         `value`, `false` e.g.\ before the preferences are loaded.
+     */
+    bool GetCachedPref(const std::string& pref, bool& value) const;
+    bool GetCachedPref(const std::string& pref, int64_t& value) const;
+    bool GetCachedPref(const std::string& pref, std::string& value) const;
+    //@}
+
     /**
      * Sets a preference value.
      * @param pref Preference name.
@@ -474,7 +1321,16 @@ namespace AdblockPlus
     void SetPref(const std::string& pref, const JsValue& value);
 
     /**
-     * Extracts the host from a URL.
+     * Writes pending pref changes immediately, see
+     * `CreationParameters::prefsSaveDelay`. Blocks until the prefs are
+     * written, so it must not be called from callbacks of the `FilterEngine`
+     * or `JsEngine`.
+     */
+    void FlushPrefs();
+
+    /**
+     * Extracts the host from a URL. Internationalized hosts are returned in
+     * their punycode form, e.g.\ `xn--mnchen-3ya.de`.
      * @param url URL to extract the host from.
      * @return Extracted host.
      */
@@ -482,6 +1338,8 @@ namespace AdblockPlus
 
     /**
      * Sets the callback invoked when an application update becomes available.
+     * The automatic update checks only start with the first call of this or
+     * `ForceUpdateCheck()`.
      * @param callback Callback to invoke.
      */
     void SetUpdateAvailableCallback(const UpdateAvailableCallback& callback);
@@ -494,9 +1352,9 @@ namespace AdblockPlus
 
     /**
      * Forces an immediate update check.
-     * `FilterEngine` will automatically check for updates in regular intervals,
-     * so applications should only call this when the user triggers an update
-     * check manually.
+     * Once `SetUpdateAvailableCallback()` has been called `FilterEngine` will
+     * automatically check for updates in regular intervals, so applications
+     * should only call this when the user triggers an update check manually.
      * @param callback Optional callback to invoke when the update check is
      *        finished. The string parameter will be empty when the update check
      *        succeeded, or contain an error message if it failed.
@@ -563,17 +1421,86 @@ namespace AdblockPlus
     JsEnginePtr jsEngine;
     bool firstRun;
     int updateCheckId;
-    static const std::map<ContentType, std::string> contentTypes;
+    std::shared_ptr<Matcher> matcher;
+    std::shared_ptr<MatchCache> matchCache;
+    std::shared_ptr<ElemHideCache> elemHideCache;
+    /// Results of `GetWhitelistingFilter()` for frame chains.
+    std::shared_ptr<MatchCache> whitelistCache;
+    std::shared_ptr<PrefsCache> prefsCache;
+    std::shared_ptr<const CompiledRuleset> ruleset;
+    bool coalesceAsyncMatches;
+    ElemHideIndexing elemHideIndexing;
+    /// Summary of the notifications which might be shown, reported by
+    /// lib/notificationShowRegistration.js.
+    struct NotificationCandidates
+    {
+      /// Whether there are notifications without URL filters.
+      bool general;
+      /// Whether there are notifications with URL filters.
+      bool urlTargeted;
+      /// Whether all URL filters target a host starting with one of
+      /// `hosts`.
+      bool hostsComplete;
+      std::vector<std::string> hosts;
+    };
+    mutable std::mutex notificationMutex;
+    /// `null` until the notifications were loaded.
+    std::shared_ptr<const NotificationCandidates> notificationCandidates;
+    std::chrono::milliseconds notificationEvaluationInterval;
+    mutable bool notificationsEvaluated;
+    mutable std::chrono::steady_clock::time_point lastNotificationEvaluation;
+    std::mutex flushPrefsMutex;
+    mutable std::mutex asyncMatchesMutex;
+    /// Callbacks of the pending `MatchesAsync()` requests by request key.
+    mutable std::map<std::string, std::vector<MatchesCallback>> pendingAsyncMatches;
+    /// Created on the first `MatchesAsync()` call, reset first by the
+    /// destructor since its tasks use the other members.
+    mutable std::shared_ptr<WorkQueue> asyncMatchesQueue;
+    /// Publishes the subscription updates of `matcher`, created on the first
+    /// update. Only accessed with the JavaScript engine locked.
+    std::shared_ptr<WorkQueue> matcherUpdateQueue;
+    /// Indexes of the histograms in `metrics`.
+    enum MetricsApi
+    {
+      METRICS_MATCHES, METRICS_IS_DOCUMENT_WHITELISTED,
+      METRICS_GET_ELEMENT_HIDING_SELECTORS, METRICS_GET_PREF,
+      METRICS_SUBSCRIPTION_UPDATE, METRICS_API_COUNT
+    };
+    StartupProfile startupProfile;
+    /// Array of `METRICS_API_COUNT` histograms, `null` if metrics are disabled.
+    std::shared_ptr<LatencyHistogram> metrics;
+    /// `null` if the hit statistics are disabled.
+    std::shared_ptr<FilterHitStatistics> hitStatistics;
 
     explicit FilterEngine(const JsEnginePtr& jsEngine);
 
-    FilterPtr CheckFilterMatch(const std::string& url,
+    LatencyHistogram* GetMetricsHistogram(MetricsApi api) const;
+    bool ShouldEvaluateNotifications(const std::string& url) const;
+    void EndMatcherUpdate();
+    const std::shared_ptr<const MatcherFilter>& RecordFilterHit(
+      const std::shared_ptr<const MatcherFilter>& match) const;
+    FilterPtr GetFilterForMatch(const std::shared_ptr<const MatcherFilter>& match) const;
+    void RunAsyncMatch(const std::string& url, ContentTypeMask contentTypeMask,
+      const std::vector<std::string>& documentUrls, const std::string& key,
+      std::vector<MatchesCallback>&& callbacks) const;
+    template<typename Url>
+    std::shared_ptr<const MatcherFilter> MatchesInternal(const std::string& url,
+      ContentTypeMask contentTypeMask,
+      const std::vector<Url>& documentUrls) const;
+    std::shared_ptr<const MatcherFilter> MatchesInternal(const std::string& url,
+      ContentTypeMask contentTypeMask,
+      const DocumentContext& documentContext) const;
+    template<typename Url>
+    std::shared_ptr<const MatcherFilter> CheckDocumentChain(
+      const std::vector<Url>& documentUrls) const;
+    std::shared_ptr<const MatcherFilter> CheckFilterMatch(const std::string& url,
                                ContentTypeMask contentTypeMask,
-                               const std::string& documentUrl) const;
+                               const std::string& documentUrl,
+                               bool specificOnly = false) const;
     void FilterChanged(const FilterChangeCallback& callback, JsValueList&& params) const;
-    FilterPtr GetWhitelistingFilter(const std::string& url,
+    std::shared_ptr<const MatcherFilter> GetWhitelistingFilter(const std::string& url,
       ContentTypeMask contentTypeMask, const std::string& documentUrl) const;
-    FilterPtr GetWhitelistingFilter(const std::string& url,
+    std::shared_ptr<const MatcherFilter> GetWhitelistingFilter(const std::string& url,
       ContentTypeMask contentTypeMask,
       const std::vector<std::string>& documentUrls) const;
   };
@@ -0,0 +1,55 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_EXECUTOR_H
+#define ADBLOCK_PLUS_EXECUTOR_H
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace AdblockPlus
+{
+  /**
+   * Interface of an executor running tasks asynchronously, e.g. on a thread
+   * pool.
+   */
+  struct IExecutor
+  {
+    /**
+     * Task type run by the executor.
+     */
+    typedef std::function<void()> Task;
+    virtual ~IExecutor() {};
+
+    /**
+     * Runs a task asynchronously.
+     * @param task Task to run.
+     * @param key Tasks with the same non-empty key must not run at the same
+     *        time and have to run in the order they were dispatched, e.g.
+     *        operations on the same file.
+     */
+    virtual void Dispatch(const Task& task, const std::string& key) = 0;
+  };
+
+  /**
+   * Unique smart pointer to an instance of `IExecutor` implementation.
+   */
+  typedef std::unique_ptr<IExecutor> ExecutorPtr;
+}
+
+#endif
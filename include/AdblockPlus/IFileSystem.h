@@ -0,0 +1,172 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_IFILE_SYSTEM_H
+#define ADBLOCK_PLUS_IFILE_SYSTEM_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Asynchronous file system interface. The operations return immediately
+   * and invoke their callback, possibly on another thread, once they are
+   * done.
+   */
+  struct IFileSystem
+  {
+    /**
+     * Result of a stat operation, i.e.\ information about a file.
+     */
+    struct StatResult
+    {
+      StatResult()
+      {
+        exists = false;
+        isDirectory = false;
+        isFile = false;
+        lastModified = 0;
+      }
+
+      /**
+       * File exists.
+       */
+      bool exists;
+
+      /**
+       * File is a directory.
+       */
+      bool isDirectory;
+
+      /**
+       * File is a regular file.
+       */
+      bool isFile;
+
+      /**
+       * POSIX time of the last modification.
+       */
+      int64_t lastModified;
+    };
+
+    /**
+     * Contents of a file.
+     */
+    typedef std::vector<uint8_t> IoBuffer;
+
+    /**
+     * Callback type invoked when an operation finished.
+     * The parameter is the error message, empty on success.
+     */
+    typedef std::function<void(const std::string& error)> Callback;
+
+    /**
+     * Callback type invoked when a file has been read.
+     * The parameters are the file's contents and the error message, empty on
+     * success.
+     */
+    typedef std::function<void(IoBuffer&& data, const std::string& error)> ReadCallback;
+
+    /**
+     * Callback type invoked when the information about a file is available.
+     * The parameters are the file information and the error message, empty
+     * on success.
+     */
+    typedef std::function<void(const StatResult& result, const std::string& error)> StatCallback;
+
+    virtual ~IFileSystem() {}
+
+    /**
+     * Reads from a file.
+     * @param path File path.
+     * @param callback Callback to invoke with the file's contents.
+     */
+    virtual void Read(const std::string& path, const ReadCallback& callback) = 0;
+
+    /**
+     * Reads a part of a file, so that large files can be processed without
+     * keeping all of their contents in memory.
+     * @param path File path.
+     * @param offset Position of the first byte to read.
+     * @param size Maximal number of bytes to read.
+     * @param callback Callback to invoke with the bytes read, these are
+     *        fewer than `size` (possibly none) at the end of the file.
+     */
+    virtual void ReadRange(const std::string& path, uint64_t offset,
+      size_t size, const ReadCallback& callback) = 0;
+
+    /**
+     * Writes to a file.
+     * @param path File path.
+     * @param data Data to write, the implementation takes it over so that it
+     *        doesn't need to be copied.
+     * @param callback Callback to invoke when the data is written.
+     */
+    virtual void Write(const std::string& path, IoBuffer&& data,
+      const Callback& callback) = 0;
+
+    /**
+     * Moves a file (i.e.\ renames it).
+     * @param fromPath Current path to the file.
+     * @param toPath New path to the file.
+     * @param callback Callback to invoke when the file is moved.
+     */
+    virtual void Move(const std::string& fromPath, const std::string& toPath,
+      const Callback& callback) = 0;
+
+    /**
+     * Copies a file, replacing the target file if it exists.
+     * @param fromPath Path to the file to copy.
+     * @param toPath Path to the copy.
+     * @param callback Callback to invoke when the file is copied.
+     */
+    virtual void Copy(const std::string& fromPath, const std::string& toPath,
+      const Callback& callback) = 0;
+
+    /**
+     * Removes a file.
+     * @param path File path.
+     * @param callback Callback to invoke when the file is removed.
+     */
+    virtual void Remove(const std::string& path, const Callback& callback) = 0;
+
+    /**
+     * Retrieves information about a file.
+     * @param path File path.
+     * @param callback Callback to invoke with the file information.
+     */
+    virtual void Stat(const std::string& path, const StatCallback& callback) = 0;
+
+    /**
+     * Returns the absolute path to a file, this operation is synchronous.
+     * @param path File path (can be relative or absolute).
+     * @return Absolute file path.
+     */
+    virtual std::string Resolve(const std::string& path) const = 0;
+  };
+
+  /**
+   * Shared smart pointer to an instance of `IFileSystem` implementation.
+   */
+  typedef std::shared_ptr<IFileSystem> AsyncFileSystemPtr;
+}
+
+#endif
@@ -31,11 +31,52 @@ namespace AdblockPlus
    */
   typedef std::vector<std::pair<std::string, std::string>> HeaderList;
 
+  /**
+   * Phases of a transfer, each in microseconds since the start of the
+   * request or -1 if unknown. The phases which were skipped, e.g. the
+   * connection of a reused connection, end at the time of the previous one.
+   */
+  struct TransferTiming
+  {
+    TransferTiming()
+      : dnsLookup(-1), connect(-1), tlsHandshake(-1), firstByte(-1), total(-1)
+    {
+    }
+
+    /**
+     * Until the host name was resolved.
+     */
+    int64_t dnsLookup;
+    /**
+     * Until the connection to the server was established.
+     */
+    int64_t connect;
+    /**
+     * Until the TLS handshake was completed, equal to `connect` for plain
+     * HTTP.
+     */
+    int64_t tlsHandshake;
+    /**
+     * Until the first byte of the response was received.
+     */
+    int64_t firstByte;
+    /**
+     * Until the response was received completely.
+     */
+    int64_t total;
+  };
+
   /**
    * HTTP response.
    */
   struct ServerResponse
   {
+    ServerResponse()
+      : status(0), responseStatus(0), receivedBytes(-1),
+        connectionReused(false)
+    {
+    }
+
     //@{
     /**
      * [Mozilla status code](https://developer.mozilla.org/en/docs/Table_Of_Errors#Network_Errors)
@@ -64,6 +105,30 @@ namespace AdblockPlus
      * Body text of the response.
      */
     std::string responseText;
+
+    /**
+     * Number of body bytes received from the server, i.e.\ before decoding a
+     * compressed `Content-Encoding`, or -1 if unknown. The decoded size is
+     * the size of `responseText`.
+     */
+    int64_t receivedBytes;
+
+    /**
+     * Durations of the phases of the transfer, see `TransferTiming`.
+     */
+    TransferTiming timing;
+
+    /**
+     * Whether an existing connection was reused for the request. `false` if
+     * unknown.
+     */
+    bool connectionReused;
+
+    /**
+     * HTTP version of the response, e.g.\ `"HTTP/1.1"` or `"HTTP/2"`, empty
+     * if unknown.
+     */
+    std::string protocolVersion;
   };
 
   /**
@@ -99,6 +164,13 @@ namespace AdblockPlus
      * The parameter is the server response.
      */
     typedef std::function<void(const ServerResponse&)> GetCallback;
+
+    /**
+     * Callback type invoked for each received chunk of the response body.
+     * The parameters are the chunk data and its size in bytes.
+     */
+    typedef std::function<void(const char* data, size_t size)> DataCallback;
+
     virtual ~IWebRequest() {};
 
     /**
@@ -108,6 +180,37 @@ namespace AdblockPlus
      * @param getCallback to invoke when the server response is ready.
      */
     virtual void GET(const std::string& url, const HeaderList& requestHeaders, const GetCallback& getCallback) = 0;
+
+    /**
+     * Performs a GET request delivering the response body in chunks while it
+     * is being received, so that it doesn't have to be kept in memory as a
+     * whole. The `responseText` of the response passed to `getCallback` is
+     * empty, `dataCallback` is not called anymore after `getCallback`.
+     * The default implementation delivers the body of the response
+     * of `GET()` as a single chunk.
+     * @param url Request URL.
+     * @param requestHeaders Request headers.
+     * @param dataCallback to invoke for each chunk of the response body.
+     * @param getCallback to invoke when the server response is complete.
+     */
+    virtual void GET(const std::string& url, const HeaderList& requestHeaders,
+      const DataCallback& dataCallback, const GetCallback& getCallback)
+    {
+      GET(url, requestHeaders, [dataCallback, getCallback](const ServerResponse& response)
+      {
+        if (!response.responseText.empty())
+          dataCallback(response.responseText.data(), response.responseText.size());
+        ServerResponse headersOnly;
+        headersOnly.status = response.status;
+        headersOnly.responseHeaders = response.responseHeaders;
+        headersOnly.responseStatus = response.responseStatus;
+        headersOnly.receivedBytes = response.receivedBytes;
+        headersOnly.timing = response.timing;
+        headersOnly.connectionReused = response.connectionReused;
+        headersOnly.protocolVersion = response.protocolVersion;
+        getCallback(headersOnly);
+      });
+    }
   };
 
   /**
@@ -18,6 +18,9 @@
 #ifndef ADBLOCK_PLUS_JS_ENGINE_H
 #define ADBLOCK_PLUS_JS_ENGINE_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <map>
 #include <list>
@@ -29,14 +32,17 @@
 #include <AdblockPlus/LogSystem.h>
 #include <AdblockPlus/FileSystem.h>
 #include <AdblockPlus/JsValue.h>
+#include <AdblockPlus/LatencyMetrics.h>
 #include <AdblockPlus/WebRequest.h>
 #include <AdblockPlus/ITimer.h>
+#include <AdblockPlus/IExecutor.h>
 
 namespace v8
 {
   class Arguments;
   class Isolate;
   class Value;
+  class Array;
   class Context;
   template<class T> class Handle;
   typedef Handle<Value>(*InvocationCallback)(const Arguments &args);
@@ -45,6 +51,9 @@ namespace v8
 namespace AdblockPlus
 {
   class JsEngine;
+  class LatencyHistogram;
+  class WebRequestMetrics;
+  class WorkQueue;
 
   /**
    * Shared smart pointer to a `JsEngine` instance.
@@ -52,15 +61,85 @@ namespace AdblockPlus
   typedef std::shared_ptr<JsEngine> JsEnginePtr;
 
   /**
-   * A factory to construct DefaultTimer.
+   * A factory to construct DefaultTimer. All instances existing at the same
+   * time share a single thread.
+   * @param slack Time by which the timers may be delayed, so that timers of
+   *        all instances due within this window fire together.
    */
-  TimerPtr CreateDefaultTimer();
+  TimerPtr CreateDefaultTimer(const std::chrono::milliseconds& slack = std::chrono::milliseconds::zero());
 
   /**
    * A factory to construct DefaultWebRequest.
    */
   WebRequestPtr CreateDefaultWebRequest();
 
+#ifdef _WIN32
+  /**
+   * A factory to construct an asynchronous web request based on WinHTTP,
+   * sharing the connections of all requests. Unlike `DefaultWebRequest` it
+   * neither joins concurrent requests to the same URL nor limits the
+   * requests per host.
+   */
+  WebRequestPtr CreateWinHttpWebRequest();
+#endif
+
+  /**
+   * A factory to construct the default executor of file system operations,
+   * a pool of threads.
+   * @param threadCount Number of threads.
+   */
+  ExecutorPtr CreateDefaultIoExecutor(size_t threadCount = 4);
+
+  /**
+   * Limits of the JavaScript heap of an isolate. Sizes of zero keep the
+   * defaults of V8.
+   */
+  struct HeapLimits
+  {
+    /**
+     * Callback type invoked when the used heap size exceeds
+     * `nearHeapLimitRatio` of the heap size limit after a garbage collection.
+     * The parameters are the used heap size and the heap size limit in bytes.
+     * It is called on a dedicated thread once the garbage collection
+     * finished, so it may call into the engine, e.g.\ to release caches.
+     * It is called again only once the used size fell below the ratio.
+     */
+    typedef std::function<void(size_t usedHeapSize, size_t heapSizeLimit)> NearHeapLimitCallback;
+
+    HeapLimits()
+      : maxYoungSpaceSize(0), maxOldSpaceSize(0), maxExecutableSize(0),
+        nearHeapLimitRatio(0.8)
+    {
+    }
+
+    /**
+     * Maximal size of the young generation in bytes.
+     */
+    size_t maxYoungSpaceSize;
+
+    /**
+     * Maximal size of the old generation in bytes, an isolate which runs out
+     * of it is terminated by V8.
+     */
+    size_t maxOldSpaceSize;
+
+    /**
+     * Maximal size of the generated code in bytes.
+     */
+    size_t maxExecutableSize;
+
+    /**
+     * Share of the heap size limit above which `nearHeapLimitCallback` is
+     * called.
+     */
+    double nearHeapLimitRatio;
+
+    /**
+     * Optional callback, see `NearHeapLimitCallback`.
+     */
+    NearHeapLimitCallback nearHeapLimitCallback;
+  };
+
   /**
    * Scope based isolate manager. Creates a new isolate instance on
    * constructing and disposes it on destructing.
@@ -68,7 +147,10 @@ namespace AdblockPlus
   class ScopedV8Isolate
   {
   public:
-    ScopedV8Isolate();
+    /**
+     * @param heapLimits Limits of the JavaScript heap of the isolate.
+     */
+    explicit ScopedV8Isolate(const HeapLimits& heapLimits = HeapLimits());
     ~ScopedV8Isolate();
     v8::Isolate* Get()
     {
@@ -94,12 +176,23 @@ namespace AdblockPlus
     friend class JsValue;
     friend class JsContext;
 
-    struct JsWeakValuesList
+    /// Slots of the lists stored by `StoreJsValues()`, only accessed while
+    /// the isolate is locked.
+    struct JsWeakValuesStore
+    {
+      ~JsWeakValuesStore();
+      /// JavaScript array holding the list of each used slot.
+      std::unique_ptr<v8::Persistent<v8::Array>> lists;
+      /// Incremented when a slot is released, to detect stale IDs.
+      std::vector<uint32_t> generations;
+      std::vector<uint32_t> freeSlots;
+    };
+
+    struct JsApiFunctions
     {
-      ~JsWeakValuesList();
-      std::vector<std::unique_ptr<v8::Persistent<v8::Value>>> values;
+      ~JsApiFunctions();
+      std::map<std::string, std::unique_ptr<v8::Persistent<v8::Value>>> values;
     };
-    typedef std::list<JsWeakValuesList> JsWeakValuesLists;
   public:
     /**
      * Event callback function.
@@ -118,7 +211,122 @@ namespace AdblockPlus
     class JsWeakValuesID
     {
       friend class JsEngine;
-      JsWeakValuesLists::const_iterator iterator;
+      uint32_t slot;
+      uint32_t generation;
+    };
+
+    /**
+     * Memory statistics, see `GetMemoryStats()`.
+     */
+    struct MemoryStats
+    {
+      /**
+       * Size of the live objects on the JavaScript heap, in bytes.
+       */
+      size_t usedHeapSize;
+      /**
+       * Size of the memory reserved for the JavaScript heap, in bytes.
+       */
+      size_t totalHeapSize;
+      /**
+       * Maximum size of the JavaScript heap, in bytes.
+       */
+      size_t heapSizeLimit;
+      /**
+       * Memory outside of the JavaScript heap kept alive by JavaScript
+       * objects as reported to V8, in bytes.
+       */
+      size_t externalMemorySize;
+      /**
+       * Number of `JsValue` instances of this engine, each of them holds a
+       * persistent handle.
+       */
+      size_t jsValueCount;
+      /**
+       * Number of lists stored by `StoreJsValues()`, see
+       * `GetStoredJsValuesCount()`.
+       */
+      size_t storedJsValuesCount;
+      /**
+       * Number of scheduled timers which neither fired nor were cancelled.
+       */
+      size_t pendingTimerCount;
+      /**
+       * See `GetPendingWebRequestCount()`.
+       */
+      size_t pendingWebRequestCount;
+      /**
+       * Number of functions created by `NewCallback()` which weren't garbage
+       * collected yet.
+       */
+      size_t callbackCount;
+    };
+
+    /**
+     * Counters of operations whose number per API call should stay constant,
+     * see `GetOperationCounts()`.
+     */
+    struct OperationCounts
+    {
+      /**
+       * Number of times the engine was locked and entered. Nested entries
+       * on a thread already holding the lock are not counted.
+       */
+      uint64_t contextEntries;
+      /**
+       * Number of scripts compiled by `Evaluate()` and its variants.
+       */
+      uint64_t scriptCompilations;
+      /**
+       * Number of JavaScript functions called from native code.
+       */
+      uint64_t functionCalls;
+      /**
+       * Number of times a timer, file system or web request callback
+       * waited for API calls to enter the engine first, see
+       * `SetApiPriority()`.
+       */
+      uint64_t deferredBackgroundEntries;
+    };
+
+    /**
+     * Levels of memory pressure, see `NotifyMemoryPressure()`.
+     */
+    enum MemoryPressureLevel
+    {
+      /**
+       * Memory is getting low, caches that can be rebuilt should be dropped.
+       */
+      MEMORY_PRESSURE_MODERATE,
+      /**
+       * Memory is about to run out, as much memory as possible should be
+       * released even if that takes a while.
+       */
+      MEMORY_PRESSURE_CRITICAL
+    };
+
+    /**
+     * Code paths locking the JavaScript engine, see `GetLockMetrics()`.
+     */
+    enum LockSite
+    {
+      /**
+       * Calls of the `FilterEngine` and `JsEngine` API by the application.
+       */
+      LOCK_SITE_API,
+      /**
+       * Timer tasks scheduled by the scripts.
+       */
+      LOCK_SITE_TIMER,
+      /**
+       * Completion callbacks of file system operations.
+       */
+      LOCK_SITE_FILE_SYSTEM,
+      /**
+       * Data and completion callbacks of web requests.
+       */
+      LOCK_SITE_WEB_REQUEST,
+      LOCK_SITE_COUNT
     };
 
     /**
@@ -126,15 +334,30 @@ namespace AdblockPlus
      * @param appInfo Information about the app.
      * @param timer Implementation of timer.
      * @param webRequest Implementation of web request.
-     * @param isolate v8::Isolate wrapper. This parameter should be considered
-     *        as a temporary hack for tests, it will go away. Issue #3593.
+     * @param ioExecutor Executor of the file system operations unless
+     *        `SetAsyncFileSystem()` is used, see `DefaultAsyncFileSystem`.
+     * @param callbackExecutor Executor of the callbacks entering JavaScript
+     *        on completion of timers, file system operations and web
+     *        requests. It has to run the tasks one after another in the
+     *        order they were dispatched, e.g.\ `CreateDefaultIoExecutor(1)`
+     *        runs them on a single dedicated thread, so that the isolate
+     *        lock isn't passed between the threads completing the
+     *        operations. If null, which is the default, the callbacks are
+     *        called on the thread completing the operation.
+     * @param isolate v8::Isolate wrapper, pass an instance created with
+     *        `HeapLimits` to constrain the memory used by the engine. Engines
+     *        sharing an isolate share its heap.
      * @return New `JsEngine` instance.
      */
     static JsEnginePtr New(const AppInfo& appInfo = AppInfo(),
       TimerPtr timer = CreateDefaultTimer(),
       WebRequestPtr webRequest = CreateDefaultWebRequest(),
+      ExecutorPtr ioExecutor = CreateDefaultIoExecutor(),
+      ExecutorPtr callbackExecutor = ExecutorPtr(),
       const ScopedV8IsolatePtr& isolate = ScopedV8IsolatePtr(new ScopedV8Isolate()));
 
+    ~JsEngine();
+
     /**
      * Registers the callback function for an event.
      * @param eventName Event name. Note that this can be any string - it's a
@@ -166,11 +389,162 @@ namespace AdblockPlus
     JsValue Evaluate(const std::string& source,
         const std::string& filename = "");
 
+    /**
+     * Evaluates a JavaScript expression like `Evaluate()`, reusing the
+     * compilation data of an earlier evaluation of the same source.
+     * @param source JavaScript expression to evaluate.
+     * @param filename File name for the expression, used in error messages.
+     * @param cachedData Data produced by an earlier call for `source`, can be
+     *        empty. If it's empty or unusable it's replaced by new data which
+     *        can be stored and passed on the next start.
+     * @return Result of the evaluated expression.
+     */
+    JsValue EvaluateCached(const std::string& source,
+        const std::string& filename, std::string& cachedData);
+
+    /**
+     * Evaluates JavaScript source compiled into the binary like `Evaluate()`.
+     * A source of ASCII characters only is read by V8 from the supplied
+     * buffer instead of being copied to the JavaScript heap, so it has to
+     * stay valid and unchanged as long as the engine exists, e.g.\ a string
+     * literal.
+     * @param source Null-terminated JavaScript source to evaluate.
+     * @param filename File name for the source, used in error messages.
+     * @param cachedData Optional compilation data, see `EvaluateCached()`.
+     * @return Result of the evaluated source.
+     */
+    JsValue EvaluateStatic(const char* source, const std::string& filename,
+        std::string* cachedData = nullptr);
+
+    /**
+     * Returns a function of the global `API` object defined by the bundled
+     * scripts. The function is only resolved on the first call, later calls
+     * return the cached function without compiling any script.
+     * @param name Name of the function, e.g. `"getPref"`.
+     * @return The `API` function.
+     */
+    JsValue GetApiFunction(const std::string& name);
+
     /**
      * Initiates a garbage collection.
+     * This returns only once V8 has nothing left to collect, which can take
+     * a while, see `Gc(const std::chrono::steady_clock::time_point&)`.
      */
     void Gc();
 
+    /**
+     * Performs garbage collection work in steps until there is nothing left
+     * to collect or the deadline is reached, e.g.\ from an idle callback.
+     * A step in progress is completed, so the deadline can be exceeded
+     * slightly.
+     * @param deadline Time after which no further step is started.
+     * @return `true` if there is nothing left to collect.
+     */
+    bool Gc(const std::chrono::steady_clock::time_point& deadline);
+
+    /**
+     * Releases memory in response to memory pressure reported by the
+     * platform.
+     * The `_memoryPressure` event is triggered with the level as parameter,
+     * `FilterEngine` drops its caches in response. At
+     * `MEMORY_PRESSURE_CRITICAL` V8 additionally performs a full garbage
+     * collection, which blocks the calling thread and JavaScript execution.
+     * @param level Current `MemoryPressureLevel`.
+     */
+    void NotifyMemoryPressure(MemoryPressureLevel level);
+
+    /**
+     * Retrieves the heap statistics of the isolate and the counters of the
+     * objects held by the engine. Exporting these regularly allows to spot
+     * leaks.
+     * @return Current `MemoryStats`.
+     */
+    MemoryStats GetMemoryStats();
+
+    /**
+     * Starts recording a sampling profile of the JavaScript execution, see
+     * `StopCpuProfile()`.
+     * @throw `std::runtime_error` if a profile is already being recorded.
+     */
+    void StartCpuProfile();
+
+    /**
+     * Stops recording the profile started by `StartCpuProfile()`.
+     * @return The profile in the `.cpuprofile` JSON format, which the
+     *         Chrome DevTools can load: the call tree with the number of
+     *         samples hitting each function, and the sampled nodes.
+     * @throw `std::runtime_error` if no profile is being recorded.
+     */
+    std::string StopCpuProfile();
+
+    /**
+     * Takes a snapshot of the JavaScript heap and writes it to a file in the
+     * `.heapsnapshot` JSON format of the Chrome DevTools. The file is
+     * written through the `FileSystem`, see `SetFileSystem()`. The engine is
+     * blocked while the snapshot is taken, which can take a while.
+     * @param path Path of the file to write.
+     */
+    void WriteHeapSnapshot(const std::string& path);
+
+    /**
+     * Enables or disables measuring how long the JavaScript engine lock is
+     * waited for and held, by `LockSite`. Disabled by default. Only the
+     * outermost lock of a thread is measured.
+     * @param enabled Whether to measure lock times from now on.
+     */
+    void SetLockMetricsEnabled(bool enabled);
+
+    /**
+     * Retrieves the lock times measured since `SetLockMetricsEnabled()` or
+     * `ResetLockMetrics()`. There are two entries per `LockSite`, e.g.
+     * `"ApiLockWait"` and `"ApiLockHold"`, followed by the ones for
+     * `"Timer"`, `"FileSystem"` and `"WebRequest"`.
+     * @return Current metrics in the order of `LockSite`.
+     */
+    std::vector<LatencyMetrics> GetLockMetrics() const;
+
+    /**
+     * Resets all counters of `GetLockMetrics()` to zero.
+     */
+    void ResetLockMetrics();
+
+    /**
+     * Makes the callbacks of timers, file system operations and web
+     * requests wait while calls of the API, e.g.\ `FilterEngine::Matches()`,
+     * are waiting for the engine, so that the application isn't held up by
+     * background work queued before it. The time a callback is deferred
+     * is part of its `"LockWait"` in `GetLockMetrics()` and counted in
+     * `OperationCounts::deferredBackgroundEntries`.
+     * @param maxBackgroundDelay Maximal time a callback waits, so that
+     *        frequent API calls don't starve background work. `100`
+     *        milliseconds by default, zero disables the prioritization.
+     */
+    void SetApiPriority(const std::chrono::milliseconds& maxBackgroundDelay);
+
+    /**
+     * Retrieves the number of operations performed since the creation of
+     * the engine. Unlike timings these don't depend on the machine, so
+     * comparing them before and after a call reveals regressions like an
+     * accidental `Evaluate()` in a hot path.
+     * @return Current `OperationCounts`.
+     */
+    OperationCounts GetOperationCounts() const;
+
+    /**
+     * Retrieves the transfers of the web requests completed since the
+     * creation of the engine or `ResetWebRequestMetrics()`, aggregated by
+     * host. The timings, the connection reuse and the protocol version are
+     * only known if the `IWebRequest` implementation reports them in the
+     * `ServerResponse`.
+     * @return One entry per host, sorted by host name.
+     */
+    std::vector<WebRequestHostMetrics> GetWebRequestMetrics() const;
+
+    /**
+     * Resets all counters of `GetWebRequestMetrics()`.
+     */
+    void ResetWebRequestMetrics();
+
     //@{
     /**
      * Creates a new JavaScript value.
@@ -207,7 +581,8 @@ namespace AdblockPlus
      * @param callback C++ callback to invoke. The callback receives a
      *        `v8::Arguments` object and can use `FromArguments()` to retrieve
      *        the current `JsEngine`.
-     * @return New `JsValue` instance.
+     * @return New `JsValue` instance. The native state of the function is
+     *         released when it is garbage collected.
      */
     JsValue NewCallback(const v8::InvocationCallback& callback);
 
@@ -236,17 +611,33 @@ namespace AdblockPlus
     /**
      * Extracts and removes from `JsEngine` earlier stored `JsValue`s.
      * The method is thread-safe.
-     * @param id `JsWeakValuesID` of values.
+     * @param id `JsWeakValuesID` of values, it must not have been taken yet.
      * @return `JsValueList` of stored values.
      */
     JsValueList TakeJsValues(const JsWeakValuesID& id);
 
+    /**
+     * Returns the number of lists stored by `StoreJsValues()` and not taken
+     * yet, e.g.\ of pending timers and web requests. A growing number
+     * indicates a leak.
+     * @return Number of stored lists.
+     */
+    size_t GetStoredJsValuesCount();
+
     /*
      * Private functionality required to implement timers.
      * @param arguments `v8::Arguments` is the arguments received in C++
      * callback associated for global setTimeout method.
+     * @return ID of the timer which can be passed to clearTimeout.
+     */
+    static int64_t ScheduleTimer(const v8::Arguments& arguments);
+
+    /*
+     * Private functionality required to implement timers.
+     * @param arguments `v8::Arguments` is the arguments received in C++
+     * callback associated for global clearTimeout method.
      */
-    static void ScheduleTimer(const v8::Arguments& arguments);
+    static void CancelTimer(const v8::Arguments& arguments);
 
     /*
      * Private functionality required to implement web requests.
@@ -276,14 +667,39 @@ namespace AdblockPlus
      */
     void SetFileSystem(const FileSystemPtr& val);
 
+    /**
+     * @see `SetAsyncFileSystem()`. If a callback executor was passed to
+     * `New()`, the returned instance dispatches the completion callbacks
+     * to it.
+     */
+    AsyncFileSystemPtr GetAsyncFileSystem() const;
+
+    /**
+     * Sets the `IFileSystem` implementation used for the file I/O of the
+     * scripts. Setting this is optional, by default the engine runs the
+     * operations of the `FileSystem` (see `SetFileSystem()`) on the I/O
+     * executor passed to `New()`.
+     * @param The `IFileSystem` instance to use.
+     */
+    void SetAsyncFileSystem(const AsyncFileSystemPtr& val);
+
     /**
      * Sets the `WebRequest` implementation used for XMLHttpRequests.
      * Setting this is optional, the engine will use a `DefaultWebRequest`
      * instance by default, which might be sufficient.
+     * The requests are performed on a small pool of threads, further
+     * requests are queued, see `GetPendingWebRequestCount()`.
      * @param The `WebRequest` instance to use.
      */
     void SetWebRequest(const WebRequestSharedPtr& val);
 
+    /**
+     * Returns the number of requests of the `WebRequest` passed to
+     * `SetWebRequest()` waiting for a free thread.
+     * @return Number of queued requests.
+     */
+    size_t GetPendingWebRequestCount() const;
+
     /**
      * @see `SetLogSystem()`.
      */
@@ -314,26 +730,73 @@ namespace AdblockPlus
     }
 
   private:
-    void CallTimerTask(const JsWeakValuesID& timerParamsID);
+    void CallTimerTask(int64_t timerId);
 
-    explicit JsEngine(const ScopedV8IsolatePtr& isolate, TimerPtr timer, WebRequestPtr webRequest);
+    /**
+     * Runs a callback entering JavaScript on the callback executor or
+     * immediately if there is none.
+     */
+    void DispatchCallback(const IExecutor::Task& task);
+
+    explicit JsEngine(const ScopedV8IsolatePtr& isolate, TimerPtr timer,
+      WebRequestPtr webRequest, ExecutorPtr ioExecutor,
+      ExecutorPtr callbackExecutor);
 
     JsValue GetGlobalObject();
 
+    struct CallbackRegistry;
+
     /// Isolate must be disposed only after disposing of all objects which are
     /// using it.
     ScopedV8IsolatePtr isolate;
 
     FileSystemPtr fileSystem;
+    AsyncFileSystemPtr asyncFileSystem;
     LogSystemPtr logSystem;
     std::unique_ptr<v8::Persistent<v8::Context>> context;
+    /// Only accessed while the isolate is locked.
+    JsApiFunctions apiFunctions;
     EventMap eventCallbacks;
     std::mutex eventCallbacksMutex;
-    JsWeakValuesLists jsWeakValuesLists;
-    std::mutex jsWeakValuesListsMutex;
+    /// Data of the functions created by `NewCallback()`, shared with them so
+    /// that it outlives the engine while any of them wasn't collected yet.
+    std::shared_ptr<CallbackRegistry> callbackRegistry;
+    JsWeakValuesStore jsWeakValues;
+    /// Parameters of the pending timers by timer ID, removed when a timer
+    /// fires or is cancelled.
+    std::map<int64_t, JsWeakValuesID> timerParams;
+    int64_t lastTimerId;
+    std::mutex timerParamsMutex;
+    /// Maintained by `JsValue`.
+    std::atomic<size_t> jsValueCount;
+    std::atomic<bool> lockMetricsEnabled;
+    /// Counters of `GetOperationCounts()`.
+    std::atomic<uint64_t> contextEntries;
+    std::atomic<uint64_t> scriptCompilations;
+    std::atomic<uint64_t> functionCalls;
+    std::atomic<uint64_t> deferredBackgroundEntries;
+    /// Outermost API entries waiting for the lock, background entries wait
+    /// on `priorityCondition` while there are any, see `JsContext`.
+    std::atomic<int> waitingApiEntries;
+    std::atomic<int64_t> maxBackgroundDelayMillis;
+    std::mutex priorityMutex;
+    std::condition_variable priorityCondition;
+    /// Only accessed while the isolate is locked.
+    bool cpuProfileRunning;
+    /// Wait and hold histograms of each `LockSite`, maintained by
+    /// `JsContext`.
+    std::unique_ptr<LatencyHistogram[]> lockMetrics;
+    /// Maintained by `ScheduleWebRequest()`.
+    std::unique_ptr<WebRequestMetrics> webRequestMetrics;
     TimerPtr timer;
     WebRequestPtr webRequest;
     WebRequestSharedPtr webRequestLegacy;
+    /// Performs the requests of `webRequestLegacy`.
+    std::unique_ptr<WorkQueue> webRequestLegacyQueue;
+    std::shared_ptr<IExecutor> ioExecutor;
+    std::shared_ptr<IExecutor> callbackExecutor;
+    /// Runs the operations of `fileSystem` on `ioExecutor`.
+    AsyncFileSystemPtr defaultAsyncFileSystem;
   };
 }
 
@@ -51,6 +51,7 @@ namespace AdblockPlus
   class JsValue
   {
     friend class JsEngine;
+    friend class JsContext;
   public:
     JsValue(JsValue&& src);
     JsValue(const JsValue& src);
@@ -71,6 +72,18 @@ namespace AdblockPlus
     bool AsBool() const;
     JsValueList AsList() const;
 
+    //@{
+    /**
+     * Converts an array (see `IsArray()`) of strings without creating a
+     * `JsValue` per element.
+     * @param result Vector to store the strings in, its previous content is
+     *        replaced while its capacity is reused.
+     * @return List of strings.
+     */
+    std::vector<std::string> AsStringVector() const;
+    void AsStringVector(std::vector<std::string>& result) const;
+    //@}
+
     /**
      * Returns a list of property names if this is an object (see `IsObject()`).
      * @return List of property names.
@@ -144,9 +157,9 @@ namespace AdblockPlus
   private:
     JsValue(JsEnginePtr jsEngine, v8::Handle<v8::Value> value);
     void SetProperty(const std::string& name, v8::Handle<v8::Value> val);
-    // Parameter args is not const because a pointer to its internal arrays is
-    // passed to v8::Function::Call but the latter does not expect a const pointer.
-    JsValue Call(std::vector<v8::Handle<v8::Value>>& args, v8::Local<v8::Object> thisObj) const;
+    // Parameter argv is not const because it is passed to v8::Function::Call
+    // but the latter does not expect a const pointer.
+    JsValue Call(int argc, v8::Handle<v8::Value> argv[], v8::Local<v8::Object> thisObj) const;
 
     std::unique_ptr<v8::Persistent<v8::Value>> value;
   };
@@ -0,0 +1,98 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_LATENCY_METRICS_H
+#define ADBLOCK_PLUS_LATENCY_METRICS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Snapshot of the calls of an operation and their durations, see
+   * `FilterEngine::GetMetrics()`.
+   */
+  struct LatencyMetrics
+  {
+    /**
+     * Name of the measured operation, e.g. `"Matches"`.
+     */
+    std::string name;
+    /**
+     * Number of calls.
+     */
+    uint64_t count;
+    /**
+     * Sum of the durations of all calls, in microseconds.
+     */
+    uint64_t totalMicroseconds;
+    /**
+     * Duration of the slowest call, in microseconds.
+     */
+    uint64_t maxMicroseconds;
+    /**
+     * Logarithmic histogram of the call durations. The first bucket counts
+     * calls which took less than 1 microsecond, bucket `i` counts calls
+     * which took at least `2^(i-1)` and less than `2^i` microseconds. The
+     * last bucket also counts all slower calls.
+     */
+    std::vector<uint64_t> histogram;
+  };
+
+  /**
+   * Aggregated web requests to a host, see `JsEngine::GetWebRequestMetrics()`.
+   */
+  struct WebRequestHostMetrics
+  {
+    /**
+     * Host name the requests were sent to.
+     */
+    std::string host;
+    /**
+     * Number of completed requests.
+     */
+    uint64_t requestCount;
+    /**
+     * Number of requests which failed on the network level, i.e.\ without
+     * a `ServerResponse::status` of `NS_OK`.
+     */
+    uint64_t failedCount;
+    /**
+     * Number of requests which reused an existing connection.
+     */
+    uint64_t reusedConnectionCount;
+    /**
+     * Sum of the known `ServerResponse::receivedBytes`.
+     */
+    uint64_t receivedBytes;
+    /**
+     * HTTP version of the last response reporting it, empty if none did.
+     */
+    std::string protocolVersion;
+    /**
+     * Durations of the transfer phases reported by the requests, named
+     * `"DnsLookup"`, `"Connect"`, `"TlsHandshake"`, `"FirstByte"` and
+     * `"Total"`, see `TransferTiming`. Requests not reporting a phase are
+     * not counted in it.
+     */
+    std::vector<LatencyMetrics> timings;
+  };
+}
+
+#endif
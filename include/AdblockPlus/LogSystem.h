@@ -45,6 +45,17 @@ namespace AdblockPlus
      */
     virtual void operator()(LogLevel logLevel, const std::string& message,
           const std::string& source) = 0;
+
+    /**
+     * Checks whether messages of a level are written at all. Callers skip
+     * formatting the messages of disabled levels.
+     * @param logLevel Log level.
+     * @return `true` by default.
+     */
+    virtual bool IsEnabled(LogLevel logLevel) const
+    {
+      return true;
+    }
   };
 
   /**
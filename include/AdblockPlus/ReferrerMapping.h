@@ -19,12 +19,25 @@
 #define ADBLOCK_PLUS_REFERRER_MAPPING_H
 
 #include <list>
-#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace AdblockPlus
 {
+  /**
+   * Shared immutable URL, e.g.\ stored once by `ReferrerMapping` and then
+   * used by every chain it occurs in.
+   */
+  typedef std::shared_ptr<const std::string> SharedUrl;
+
+  /**
+   * Chain of shared URLs, see
+   * `ReferrerMapping::BuildReferrerChain(const std::string&, SharedUrlList&) const`.
+   */
+  typedef std::vector<SharedUrl> SharedUrlList;
+
   /**
    * Stores a mapping between URLs and their referrers.
    * This can be used to build a chain of referrers for any URL
@@ -57,10 +70,64 @@ namespace AdblockPlus
      */
     std::vector<std::string> BuildReferrerChain(const std::string& url) const;
 
+    /**
+     * Same as BuildReferrerChain(const std::string&) const, but the chain
+     * references the URLs stored in the mapping instead of copying them.
+     * Reusing `referrerChain` for several calls, nothing is allocated unless
+     * `url` itself is not mapped. The chain can be passed to
+     * `FilterEngine::Matches()` and stays valid when the mapping changes.
+     * @param url URL to build the chain for.
+     * @param referrerChain Receives the list of URLs, in the same order as
+     *        returned by BuildReferrerChain(const std::string&) const.
+     */
+    void BuildReferrerChain(const std::string& url,
+      SharedUrlList& referrerChain) const;
+
+    /**
+     * Looks up the referrer recorded for a URL.
+     * @param url Request URL.
+     * @param referrer Receives the referrer if there is one.
+     * @return `true` if a referrer was recorded for the URL.
+     */
+    bool GetReferrer(const std::string& url, std::string& referrer) const;
+
   private:
+    // URLs are stored once and shared, e.g. by the entry of a document and
+    // as the referrer of its subresources.
+    struct SharedUrlHash
+    {
+      size_t operator()(const SharedUrl& url) const
+      {
+        return std::hash<std::string>()(*url);
+      }
+    };
+
+    struct SharedUrlEqual
+    {
+      bool operator()(const SharedUrl& a, const SharedUrl& b) const
+      {
+        return *a == *b;
+      }
+    };
+
+    typedef std::list<SharedUrl> UrlList;
+
+    struct Entry
+    {
+      SharedUrl referrer;
+      /// Position in `cachedUrls`.
+      UrlList::iterator cachedUrl;
+    };
+
+    typedef std::unordered_map<SharedUrl, Entry, SharedUrlHash, SharedUrlEqual> Mapping;
+
     const int maxCachedUrls;
-    std::map<std::string, std::string> mapping;
-    std::list<std::string> cachedUrls;
+    Mapping mapping;
+    /// Least recently added first.
+    UrlList cachedUrls;
+
+    Mapping::const_iterator Find(const std::string& url) const;
+    SharedUrl Intern(const std::string& url) const;
   };
 }
 
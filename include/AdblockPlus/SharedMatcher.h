@@ -0,0 +1,122 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_SHARED_MATCHER_H
+#define ADBLOCK_PLUS_SHARED_MATCHER_H
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "FileSystem.h"
+#include "FilterEngine.h"
+
+namespace AdblockPlus
+{
+  class CompiledRuleset;
+  class Matcher;
+
+  /**
+   * Read-only matcher for processes which don't run a `FilterEngine`, e.g.\
+   * the renderer processes of a multi-process browser. It maps the ruleset
+   * published by `FilterEngine::PublishRuleset()` in the process owning the
+   * engine, so all processes share the same pages and no JavaScript engine
+   * is created. Updates are picked up by `Refresh()`, which switches to the
+   * new generation atomically, lookups running concurrently keep using the
+   * ruleset they started with.
+   *
+   * All methods are thread-safe.
+   */
+  class SharedMatcher
+  {
+  public:
+    /**
+     * Constructor, loads the current generation if one was published.
+     * @param fileSystem File system the ruleset was published to, e.g.\
+     *        a `DefaultFileSystem` with the same base path.
+     * @param path Path passed to `FilterEngine::PublishRuleset()`.
+     * @throw std::runtime_error If the published ruleset is invalid.
+     */
+    SharedMatcher(const FileSystemPtr& fileSystem, const std::string& path);
+    ~SharedMatcher();
+
+    /**
+     * Switches to the latest generation if it changed. If the new ruleset
+     * can't be loaded the current one stays in use.
+     * @return `true` if a new generation was loaded.
+     * @throw std::runtime_error If the published ruleset is invalid.
+     */
+    bool Refresh();
+
+    /**
+     * Returns the generation in use, 0 if no ruleset was published yet.
+     */
+    uint64_t GetGeneration() const;
+
+    /**
+     * Checks whether a request should be blocked, same as
+     * `FilterEngine::GetMatchResult()`.
+     * @param url URL to match.
+     * @param contentTypeMask Content type mask of the requested resource.
+     * @param documentUrls Chain of documents requesting the resource,
+     *        starting with the current resource's parent frame, ending with
+     *        the top-level frame.
+     * @return Result of the check, see `MatchResult`.
+     */
+    MatchResult GetMatchResult(const std::string& url,
+      FilterEngine::ContentTypeMask contentTypeMask,
+      const std::vector<std::string>& documentUrls) const;
+
+    /**
+     * Same as the other overload, for a request without a document.
+     */
+    MatchResult GetMatchResult(const std::string& url,
+      FilterEngine::ContentTypeMask contentTypeMask) const;
+
+    /**
+     * Retrieves the CSS selectors for elements to hide on a domain, same
+     * as `FilterEngine::GetElementHidingSelectors()`.
+     * @param domain Domain to retrieve CSS selectors for.
+     * @return List of CSS selectors.
+     */
+    std::vector<std::string> GetElementHidingSelectors(
+      const std::string& domain) const;
+
+  private:
+    SharedMatcher(const SharedMatcher&);
+    SharedMatcher& operator=(const SharedMatcher&);
+
+    struct State
+    {
+      uint64_t generation;
+      std::shared_ptr<const CompiledRuleset> ruleset;
+      std::shared_ptr<Matcher> matcher;
+    };
+    typedef std::shared_ptr<const State> StatePtr;
+
+    StatePtr GetState() const;
+
+    FileSystemPtr fileSystem;
+    const std::string path;
+    // Refresh() is serialized, the state is replaced atomically.
+    std::mutex refreshMutex;
+    StatePtr state;
+  };
+}
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_UPDATE_COORDINATOR_H
+#define ADBLOCK_PLUS_UPDATE_COORDINATOR_H
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "IWebRequest.h"
+#include "ITimer.h"
+
+namespace AdblockPlus
+{
+  class UpdateCoordinator;
+
+  /**
+   * Shared smart pointer to an `UpdateCoordinator` instance.
+   */
+  typedef std::shared_ptr<UpdateCoordinator> UpdateCoordinatorPtr;
+
+  /**
+   * Coordinates the downloads of all `FilterEngine` instances of a process,
+   * so that many engines, or many hosts started from the same image, don't
+   * download their subscriptions at the same time:
+   * - The connection check of each download, see
+   *   `FilterEngine::CreationParameters::isSubscriptionDowloadAllowedCallback`,
+   *   is delayed by a random time of up to `Settings::maxJitter`. The check
+   *   and thereby `allowed_connection_type` applies to the connection the
+   *   download starts on.
+   * - At most `Settings::maxConcurrentDownloads` requests are performed at
+   *   once, further ones are queued.
+   * - Requests to the same URL, ignoring the download statistics query
+   *   parameters (`addonName`, `downloadCount` etc.) which differ between
+   *   engines, share one download. A successful response is also passed to
+   *   requests made within `Settings::resultLifetime`, except for updates
+   *   requested via `Subscription::UpdateFilters()`.
+   *
+   * An engine takes part by passing the web request returned by
+   * `CreateWebRequest()` to `JsEngine::New()` and the coordinator to
+   * `FilterEngine::CreationParameters::updateCoordinator`.
+   *
+   * All methods are thread-safe.
+   */
+  class UpdateCoordinator : public std::enable_shared_from_this<UpdateCoordinator>
+  {
+  public:
+    /**
+     * Configuration of the coordinator.
+     */
+    struct Settings
+    {
+      Settings();
+
+      /**
+       * Upper bound of the random delay of each download, one minute by
+       * default. `0` starts downloads immediately.
+       */
+      std::chrono::milliseconds maxJitter;
+      /**
+       * Maximal number of downloads performed at once, `2` by default.
+       */
+      size_t maxConcurrentDownloads;
+      /**
+       * Time a successful response is reused for requests to the same URL,
+       * ten minutes by default. `0` only shares downloads which are still
+       * in progress.
+       */
+      std::chrono::milliseconds resultLifetime;
+    };
+
+    /**
+     * Counters of the coordinator, see `GetStats()`.
+     */
+    struct Stats
+    {
+      Stats()
+        : requests(0), downloads(0), sharedResponses(0), activeDownloads(0),
+          queuedDownloads(0)
+      {
+      }
+
+      /**
+       * Number of requests made by the engines.
+       */
+      uint64_t requests;
+      /**
+       * Number of requests actually performed.
+       */
+      uint64_t downloads;
+      /**
+       * Number of requests answered by the download of another request.
+       */
+      uint64_t sharedResponses;
+      /**
+       * Number of downloads in progress.
+       */
+      size_t activeDownloads;
+      /**
+       * Number of downloads waiting for one in progress to finish.
+       */
+      size_t queuedDownloads;
+    };
+
+    /**
+     * Creates a new coordinator, usually one per process.
+     * @param settings Configuration, see `Settings`.
+     * @param webRequest Implementation performing the downloads, `nullptr`
+     *        for the one returned by `CreateDefaultWebRequest()`.
+     * @param timer Implementation of the delays, `nullptr` for the one
+     *        returned by `CreateDefaultTimer()`.
+     * @return New coordinator.
+     */
+    static UpdateCoordinatorPtr New(const Settings& settings = Settings(),
+      WebRequestPtr webRequest = nullptr, TimerPtr timer = nullptr);
+
+    /**
+     * Creates a web request for one `JsEngine`, its requests are performed
+     * by the coordinator. It keeps the coordinator alive.
+     * @return New web request.
+     */
+    WebRequestPtr CreateWebRequest();
+
+    /**
+     * Calls `task` after a random delay of up to `Settings::maxJitter`, on
+     * the thread of the timer. Called by `FilterEngine` before checking the
+     * connection of a download.
+     * @param task Function to call.
+     */
+    void Stagger(const std::function<void()>& task);
+
+    /**
+     * Drops the stored response of a URL, so that the next request to it is
+     * downloaded again. Called by `FilterEngine` when an update is requested
+     * explicitly via `Subscription::UpdateFilters()`.
+     * @param url URL of the subscription.
+     */
+    void DiscardResult(const std::string& url);
+
+    /**
+     * Returns the current counters.
+     * @return Counters, see `Stats`.
+     */
+    Stats GetStats() const;
+
+  private:
+    struct Download;
+    typedef std::shared_ptr<Download> DownloadPtr;
+    class CoordinatedWebRequest;
+
+    UpdateCoordinator(const Settings& settings, WebRequestPtr webRequest,
+      TimerPtr timer);
+    UpdateCoordinator(const UpdateCoordinator&);
+    UpdateCoordinator& operator=(const UpdateCoordinator&);
+
+    void GET(const std::string& url, const HeaderList& requestHeaders,
+      const IWebRequest::GetCallback& getCallback);
+    void Start(const DownloadPtr& download);
+    void Finish(const DownloadPtr& download, const ServerResponse& response);
+
+    struct CachedResult
+    {
+      std::chrono::steady_clock::time_point expires;
+      ServerResponse response;
+    };
+
+    const Settings settings;
+    WebRequestPtr webRequest;
+    TimerPtr timer;
+    mutable std::mutex mutex;
+    std::minstd_rand random;
+    /// Queued and active downloads by URL without the download statistics
+    /// parameters.
+    std::map<std::string, DownloadPtr> downloads;
+    std::deque<DownloadPtr> queuedDownloads;
+    std::map<std::string, CachedResult> results;
+    Stats stats;
+  };
+}
+
+#endif
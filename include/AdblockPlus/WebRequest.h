@@ -37,6 +37,25 @@ namespace AdblockPlus
      * @return HTTP response.
      */
     virtual ServerResponse GET(const std::string& url, const HeaderList& requestHeaders) const = 0;
+
+    /**
+     * Performs a GET request delivering the response body in chunks, see
+     * `IWebRequest::GET()`. The default implementation delivers the body
+     * of the response of `GET()` as a single chunk.
+     * @param url Request URL.
+     * @param requestHeaders Request headers.
+     * @param dataCallback to invoke for each chunk of the response body.
+     * @return HTTP response with an empty `responseText`.
+     */
+    virtual ServerResponse GET(const std::string& url, const HeaderList& requestHeaders,
+      const IWebRequest::DataCallback& dataCallback) const
+    {
+      ServerResponse response = GET(url, requestHeaders);
+      if (!response.responseText.empty())
+        dataCallback(response.responseText.data(), response.responseText.size());
+      std::string().swap(response.responseText);
+      return response;
+    }
   };
 
   /**
@@ -21,12 +21,53 @@ var API = (function()
   var Subscription = require("subscriptionClasses").Subscription;
   var SpecialSubscription = require("subscriptionClasses").SpecialSubscription;
   var FilterStorage = require("filterStorage").FilterStorage;
-  var defaultMatcher = require("matcher").defaultMatcher;
   var ElemHide = require("elemHide").ElemHide;
   var Synchronizer = require("synchronizer").Synchronizer;
   var Prefs = require("prefs").Prefs;
-  var checkForUpdates = require("updater").checkForUpdates;
-  var Notification = require("notification").Notification;
+  var getUnloadedStats = require("subscriptionUnloading").getUnloadedStats;
+
+  // Notifications and the updater are only loaded when used, see
+  // lazy_library_files in libadblockplus.gyp.
+  function getNotification()
+  {
+    require("notificationShowRegistration");
+    return require("notification").Notification;
+  }
+
+  // Applies many filter changes at once: the filter list is saved only once
+  // and a single change event is reported for the filters returned by
+  // change().
+  function changeFilters(action, change)
+  {
+    var saveToDisk = FilterStorage.saveToDisk;
+    var saveRequested = false;
+    FilterStorage.saveToDisk = function()
+    {
+      saveRequested = true;
+    };
+    try
+    {
+      require("filterUpdateRegistration").batchFilterChanges(action, change);
+    }
+    finally
+    {
+      FilterStorage.saveToDisk = saveToDisk;
+    }
+    if (saveRequested)
+      FilterStorage.saveToDisk();
+  }
+
+  // Filter matches are counted natively, see
+  // FilterEngine::CreationParameters::hitStatisticsEnabled.
+  if (typeof _filterHitsFlushInterval == "number" && _filterHitsFlushInterval > 0)
+  {
+    var flushFilterHits = function()
+    {
+      _triggerEvent("_flushFilterHits");
+      setTimeout(flushFilterHits, _filterHitsFlushInterval);
+    };
+    setTimeout(flushFilterHits, _filterHitsFlushInterval);
+  }
 
   return {
     getFilterFromText: function(text)
@@ -77,6 +118,77 @@ var API = (function()
       });
     },
 
+    addFilters: function(texts)
+    {
+      changeFilters("filters.added", function()
+      {
+        var added = [];
+        for (var i = 0; i < texts.length; i++)
+        {
+          var text = Filter.normalize(texts[i]);
+          if (!text)
+            continue;
+          var filter = Filter.fromText(text);
+          if (API.isListedFilter(filter))
+            continue;
+          FilterStorage.addFilter(filter);
+          added.push(filter);
+        }
+        return added;
+      });
+    },
+
+    removeFilters: function(texts)
+    {
+      changeFilters("filters.removed", function()
+      {
+        var removed = [];
+        for (var i = 0; i < texts.length; i++)
+        {
+          var text = Filter.normalize(texts[i]);
+          if (!text)
+            continue;
+          var filter = Filter.fromText(text);
+          if (!API.isListedFilter(filter))
+            continue;
+          FilterStorage.removeFilter(filter);
+          removed.push(filter);
+        }
+        return removed;
+      });
+    },
+
+    exportListedFilters: function()
+    {
+      return API.getListedFilters().map(function(filter)
+      {
+        return filter.text + "\n";
+      }).join("");
+    },
+
+    getActiveFilterTexts: function()
+    {
+      var texts = {};
+      for (var i = 0; i < FilterStorage.subscriptions.length; i++)
+      {
+        var subscription = FilterStorage.subscriptions[i];
+        if (subscription.disabled)
+          continue;
+        for (var j = 0; j < subscription.filters.length; j++)
+        {
+          var filter = subscription.filters[j];
+          if (!filter.disabled)
+            texts[filter.text] = true;
+        }
+      }
+      return Object.keys(texts);
+    },
+
+    getListedFilterPage: function(offset, limit)
+    {
+      return API.getListedFilters().slice(offset, offset + limit);
+    },
+
     getSubscriptionFromUrl: function(url)
     {
       return Subscription.fromURL(url);
@@ -102,6 +214,8 @@ var API = (function()
 
     updateSubscription: function(subscription)
     {
+      // Explicit updates must not be answered by a shared earlier download.
+      _triggerEvent("_subscriptionUpdateRequested", subscription.url);
       Synchronizer.execute(subscription);
     },
 
@@ -118,6 +232,42 @@ var API = (function()
       });
     },
 
+    getSubscriptionsSnapshot: function()
+    {
+      return API.getListedSubscriptions().map(function(subscription)
+      {
+        return [
+          subscription.url,
+          subscription.title || "",
+          subscription.homepage || "",
+          subscription.lastDownload || 0,
+          subscription.lastSuccess || 0,
+          subscription.downloadStatus || "",
+          !!subscription.disabled,
+          API.isSubscriptionUpdating(subscription),
+          API.isAASubscription(subscription)
+        ];
+      });
+    },
+
+    getSubscriptionStats: function()
+    {
+      return FilterStorage.subscriptions.map(function(subscription)
+      {
+        var unloaded = getUnloadedStats(subscription);
+        if (unloaded)
+        {
+          return [subscription.url, unloaded.count, unloaded.size,
+                  !!subscription.disabled, true];
+        }
+        var textLength = 0;
+        for (var i = 0; i < subscription.filters.length; i++)
+          textLength += subscription.filters[i].text.length;
+        return [subscription.url, subscription.filters.length, textLength,
+                !!subscription.disabled, false];
+      });
+    },
+
     getRecommendedSubscriptions: function()
     {
       var subscriptions = require("subscriptions.xml");
@@ -168,31 +318,40 @@ var API = (function()
       return aaSubscription && !aaSubscription.disabled;
     },
 
+    startNotifications: function()
+    {
+      getNotification();
+    },
+
     showNextNotification: function(url)
     {
-      Notification.showNext(url);
+      getNotification().showNext(url);
     },
 
     getNotificationTexts: function(notification)
     {
-      return Notification.getLocalizedTexts(notification);
+      return getNotification().getLocalizedTexts(notification);
     },
 
     markNotificationAsShown: function(id)
     {
-      Notification.markAsShown(id);
+      getNotification().markAsShown(id);
     },
-    checkFilterMatch: function(url, contentTypeMask, documentUrl)
+    getElementHidingSelectors: function(domain)
     {
-      var requestHost = extractHostFromURL(url);
-      var documentHost = extractHostFromURL(documentUrl);
-      var thirdParty = isThirdParty(requestHost, documentHost);
-      return defaultMatcher.matchesAny(url, contentTypeMask, documentHost, thirdParty);
+      return ElemHide.getSelectorsForDomain(domain, false);
     },
 
-    getElementHidingSelectors: function(domain)
+    addFilterHits: function(text, hitCount, lastHit)
     {
-      return ElemHide.getSelectorsForDomain(domain, false);
+      // Same conditions as FilterStorage.increaseHitCount().
+      if (!Prefs.savestats)
+        return;
+      var filter = Filter.fromText(text);
+      if (!("hitCount" in filter))
+        return;
+      filter.hitCount += hitCount;
+      filter.lastHit = Math.max(filter.lastHit, lastHit);
     },
 
     getPref: function(pref)
@@ -205,14 +364,23 @@ var API = (function()
       Prefs[pref] = value;
     },
 
-    forceUpdateCheck: function(eventName)
+    flushPrefs: function()
     {
-      checkForUpdates(eventName ? _triggerEvent.bind(null, eventName) : null);
+      Prefs.flush(function()
+      {
+        _triggerEvent("_prefsFlushed");
+      });
+    },
+
+    startUpdater: function()
+    {
+      require("updater");
     },
 
-    getHostFromUrl: function(url)
+    forceUpdateCheck: function(eventName)
     {
-      return extractHostFromURL(url);
+      var checkForUpdates = require("updater").checkForUpdates;
+      checkForUpdates(eventName ? _triggerEvent.bind(null, eventName) : null);
     },
 
     compareVersions: function(v1, v2)
@@ -23,9 +23,17 @@ var window = this;
 
 function require(module)
 {
+  if (!(module in require.scopes) && module in require.lazyScopes)
+  {
+    // Modules converted as lazy are only evaluated on first use
+    var evaluate = require.lazyScopes[module];
+    delete require.lazyScopes[module];
+    evaluate();
+  }
   return require.scopes[module];
 }
 require.scopes = {__proto__: null};
+require.lazyScopes = {__proto__: null};
 
 function importAll(module, globalObj)
 {
@@ -250,16 +258,26 @@ FakeTimer.prototype =
 {
   delay: 0,
   callback: null,
+  timerId: null,
   initWithCallback: function(callback, delay)
   {
+    this.cancel();
     this.callback = callback;
     this.delay = delay;
     this.scheduleTimeout();
   },
+  cancel: function()
+  {
+    if (this.timerId !== null)
+    {
+      clearTimeout(this.timerId);
+      this.timerId = null;
+    }
+  },
   scheduleTimeout: function()
   {
     var me = this;
-    setTimeout(function()
+    var timerId = setTimeout(function()
     {
       try
       {
@@ -269,8 +287,11 @@ FakeTimer.prototype =
       {
         Cu.reportError(e);
       }
-      me.scheduleTimeout();
+      // The callback might have cancelled or restarted the timer
+      if (me.timerId === timerId)
+        me.scheduleTimeout();
     }, this.delay);
+    this.timerId = timerId;
   }
 };
 
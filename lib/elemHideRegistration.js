@@ -0,0 +1,118 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+let {ElemHide} = require("elemHide");
+let {CSSRules} = require("cssRules");
+
+// Element hiding filters are indexed as usual ("eager"), only once
+// FilterEngine::GetElementHidingSelectors() is called for the first time
+// ("lazy") or never ("disabled"), see
+// FilterEngine::CreationParameters::elemHideIndexing. The filters stay in
+// FilterStorage either way.
+let indexing = (typeof _elemHideIndexing == "string" ? _elemHideIndexing : "eager");
+
+// Filters waiting to be indexed by text, null once they are indexed.
+let pendingFilters = (indexing == "lazy" ? Object.create(null) : null);
+
+function deferIndexing(module, notify)
+{
+  let {add, remove, clear} = module;
+
+  module.add = function(filter)
+  {
+    if (indexing == "disabled")
+      return;
+    if (pendingFilters)
+    {
+      pendingFilters[filter.text] = {add: add, module: this, filter: filter};
+      return;
+    }
+    add.call(this, filter);
+    notify();
+  };
+
+  module.remove = function(filter)
+  {
+    if (indexing == "disabled")
+      return;
+    if (pendingFilters)
+    {
+      delete pendingFilters[filter.text];
+      return;
+    }
+    remove.call(this, filter);
+    notify();
+  };
+
+  module.clear = function()
+  {
+    if (pendingFilters)
+    {
+      for (let text in pendingFilters)
+      {
+        if (pendingFilters[text].add == add)
+          delete pendingFilters[text];
+      }
+    }
+    clear.call(this);
+    notify();
+  };
+}
+
+// Notify FilterEngine about element hiding filter changes, so that it can
+// discard the selectors it cached per domain.
+deferIndexing(ElemHide, function()
+{
+  _triggerEvent("_elemHideChanged");
+});
+deferIndexing(CSSRules, function()
+{
+});
+
+function indexPendingFilters()
+{
+  if (!pendingFilters)
+    return;
+  // Nothing was cached yet, so there is nothing to discard.
+  let filters = pendingFilters;
+  pendingFilters = null;
+  for (let text in filters)
+  {
+    let entry = filters[text];
+    entry.add.call(entry.module, entry.filter);
+  }
+}
+
+let {getSelectorsForDomain} = ElemHide;
+
+ElemHide.getSelectorsForDomain = function()
+{
+  if (indexing == "disabled")
+    return [];
+  indexPendingFilters();
+  return getSelectorsForDomain.apply(this, arguments);
+};
+
+let {getRulesForDomain} = CSSRules;
+
+CSSRules.getRulesForDomain = function()
+{
+  if (indexing == "disabled")
+    return [];
+  indexPendingFilters();
+  return getRulesForDomain.apply(this, arguments);
+};
@@ -17,7 +17,44 @@
 
 let {FilterNotifier} = require("filterNotifier");
 
+// Changes made by API.addFilters() and API.removeFilters() are reported
+// once for the whole batch, see FilterEngine::AddFilters().
+let batchDepth = 0;
+
+FilterNotifier.addListener(function(action, item)
+{
+  if (!batchDepth)
+    _triggerEvent("filterChange", action, item);
+});
+
+exports.batchFilterChanges = function(action, change)
+{
+  let items;
+  batchDepth++;
+  try
+  {
+    items = change();
+  }
+  finally
+  {
+    batchDepth--;
+  }
+  if (items.length)
+    _triggerEvent("filterChange", action, items);
+};
+
+// Report the duration of subscription downloads, see FilterEngine::GetMetrics.
+let downloadStartTimes = new Map();
+
 FilterNotifier.addListener(function(action, item)
 {
-  _triggerEvent("filterChange", action, item);
+  if (action == "subscription.downloading")
+    downloadStartTimes.set(item.url, Date.now());
+  else if (action == "subscription.downloadStatus" &&
+      downloadStartTimes.has(item.url))
+  {
+    let duration = Date.now() - downloadStartTimes.get(item.url);
+    downloadStartTimes.delete(item.url);
+    _triggerEvent("_subscriptionUpdated", item.url, duration);
+  }
 });
@@ -40,6 +40,12 @@ FilterNotifier.addListener(function(action)
 {
   if (action === "load")
   {
+    // filterListener.js is loaded before this module and its listener has put
+    // the stored filters into the matcher already. Matching doesn't have to
+    // wait for the rest of the initialization.
+    _triggerEvent("_matcherCommit");
+    _triggerEvent("_filtersLoaded");
+
     let {FilterStorage} = require("filterStorage");
     if (FilterStorage.firstRun)
     {
@@ -26,15 +26,24 @@ var IO = exports.IO =
 
   readFromFile: function(file, listener, callback, timeLineID)
   {
-    _fileSystem.read(file.path, function(result)
+    // Lines arrive in batches, the whole file is never kept in memory. The
+    // time spent reading and parsing is reported in
+    // FilterEngine::GetStartupProfile().
+    _triggerEvent("_startupPhase", "fileRead", true);
+    _fileSystem.readLines(file.path, function(batch)
     {
-      if (result.error)
-        callback(result.error);
+      _triggerEvent("_startupPhase", "fileParse", true);
+      var lines = batch.split("\n");
+      for (var i = 0; i < lines.length; i++)
+        listener.process(lines[i]);
+      _triggerEvent("_startupPhase", "fileParse", false);
+    }, function(error)
+    {
+      _triggerEvent("_startupPhase", "fileRead", false);
+      if (error)
+        callback(error);
       else
       {
-        var lines = result.content.split(/[\r\n]+/);
-        for (var i = 0; i < lines.length; i++)
-          listener.process(lines[i]);
         listener.process(null);
         callback(null);
       }
@@ -43,27 +52,14 @@ var IO = exports.IO =
 
   writeToFile: function(file, data, callback, timeLineID)
   {
-    var content = data.join(this.lineBreak) + this.lineBreak;
-    _fileSystem.write(file.path, content, callback);
+    // The lines are converted natively, there is no need to join them.
+    _fileSystem.write(file.path, data, callback);
   },
 
   copyFile: function(fromFile, toFile, callback)
   {
-    // Simply combine read and write operations
-    var data = [];
-    this.readFromFile(fromFile, {
-      process: function(line)
-      {
-        if (line !== null)
-          data.push(line);
-      }
-    }, function(e)
-    {
-      if (e)
-        callback(e);
-      else
-        this.writeToFile(toFile, data, callback);
-    }.bind(this));
+    // The file is copied natively, its contents never get into JavaScript.
+    _fileSystem.copy(fromFile.path, toFile.path, callback);
   },
 
   renameFile: function(fromFile, newName, callback)
@@ -0,0 +1,166 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+let {defaultMatcher} = require("matcher");
+let {FilterNotifier} = require("filterNotifier");
+let {FilterStorage} = require("filterStorage");
+
+// Mirror all changes of the JavaScript matcher into the native one used by
+// FilterEngine::Matches().
+let {add, remove, clear} = defaultMatcher;
+
+// Large changes, e.g. a subscription update, are applied in chunks of
+// _matcherChunkSize filters with the timer running in between, so that API
+// calls waiting for the JavaScript engine don't have to wait for the whole
+// list, see FilterEngine::CreationParameters::matcherChunkSize. The stored
+// filters are loaded at once, matching has to wait for them anyway.
+let chunkSize = (typeof _matcherChunkSize == "number" ? _matcherChunkSize : 0);
+let chunkingEnabled = false;
+let pendingChanges = [];
+let changesInTask = 0;
+let nextChunkScheduled = false;
+
+FilterNotifier.addListener(function(action)
+{
+  if (action == "load")
+    chunkingEnabled = chunkSize > 0;
+});
+
+// Changes usually come in bursts, e.g. when a subscription is updated. Have
+// the native matcher publish them once the burst is over.
+let commitScheduled = false;
+
+function scheduleCommit()
+{
+  if (commitScheduled)
+    return;
+  commitScheduled = true;
+  setTimeout(function()
+  {
+    commitScheduled = false;
+    // The last chunk schedules another commit, updates are published by
+    // finishUpdate().
+    if (!pendingChanges.length && !updateStarted)
+      _triggerEvent("_matcherCommit");
+  }, 0);
+}
+
+// A subscription update removes all filters of the list and adds the new
+// ones. The native matcher keeps matching against the previous filters until
+// the update, including the chunks queued for it, is applied and then
+// publishes the result at once, see Matcher::BeginUpdate().
+let updateDepth = 0;
+let updateStarted = false;
+
+function finishUpdate()
+{
+  if (updateStarted && !updateDepth && !pendingChanges.length)
+  {
+    updateStarted = false;
+    _triggerEvent("_matcherEndUpdate");
+  }
+}
+
+let {updateSubscriptionFilters} = FilterStorage;
+
+FilterStorage.updateSubscriptionFilters = function()
+{
+  if (!updateStarted)
+  {
+    updateStarted = true;
+    _triggerEvent("_matcherBeginUpdate");
+  }
+  updateDepth++;
+  try
+  {
+    return updateSubscriptionFilters.apply(this, arguments);
+  }
+  finally
+  {
+    updateDepth--;
+    finishUpdate();
+  }
+};
+
+function applyChange(change)
+{
+  if (change.added)
+  {
+    add.call(defaultMatcher, change.filter);
+    _triggerEvent("_matcherAdd", change.filter.text);
+  }
+  else
+  {
+    remove.call(defaultMatcher, change.filter);
+    _triggerEvent("_matcherRemove", change.filter.text);
+  }
+  scheduleCommit();
+}
+
+function scheduleNextChunk()
+{
+  if (nextChunkScheduled)
+    return;
+  nextChunkScheduled = true;
+  setTimeout(function()
+  {
+    nextChunkScheduled = false;
+    let chunk = pendingChanges.splice(0, chunkSize);
+    changesInTask = chunk.length;
+    chunk.forEach(applyChange);
+    finishUpdate();
+    // The next task also resets the count of changes.
+    if (pendingChanges.length || changesInTask)
+      scheduleNextChunk();
+  }, 0);
+}
+
+function queueChange(change)
+{
+  if (chunkingEnabled)
+  {
+    // Keep the order of the changes once some of them had to wait.
+    if (pendingChanges.length || changesInTask >= chunkSize)
+    {
+      pendingChanges.push(change);
+      scheduleNextChunk();
+      return;
+    }
+    changesInTask++;
+    scheduleNextChunk();
+  }
+  applyChange(change);
+}
+
+defaultMatcher.add = function(filter)
+{
+  queueChange({added: true, filter: filter});
+};
+
+defaultMatcher.remove = function(filter)
+{
+  queueChange({added: false, filter: filter});
+};
+
+defaultMatcher.clear = function()
+{
+  pendingChanges = [];
+  clear.call(this);
+  _triggerEvent("_matcherClear");
+  scheduleCommit();
+  finishUpdate();
+};
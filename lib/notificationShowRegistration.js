@@ -16,8 +16,87 @@
  */
 
 let {Notification} = require("notification");
+let {Prefs} = require("prefs");
 
 Notification.addShowListener(function(notification)
 {
   _triggerEvent("_showNotification", notification);
 });
+
+// FilterEngine::ShowNextNotification() only calls showNext() if one of the
+// notifications might apply to the URL. The summary includes notifications
+// which were shown or ignored already, it only has to cover all the ones
+// considered by showNext().
+let localNotifications = [];
+
+// Only URL filters anchored to a host, e.g. "||example.com^$document", are
+// indexed, any other one requires showNext() to be called for all URLs. The
+// host is a prefix: "||example.com$document" also matches example.community.
+function getTargetedHost(urlFilter)
+{
+  let match = /^\|\|([\w\-.]+)([\^\/$]|$)/.exec(urlFilter);
+  return match ? match[1].toLowerCase() : null;
+}
+
+function publishCandidates()
+{
+  let notifications = localNotifications;
+  let data = Prefs.notificationdata.data;
+  if (data && data.notifications instanceof Array)
+    notifications = notifications.concat(data.notifications);
+
+  let general = false;
+  let urlTargeted = false;
+  let hosts = [];
+  for (let notification of notifications)
+  {
+    if (!(notification.urlFilters instanceof Array))
+    {
+      general = true;
+      continue;
+    }
+    urlTargeted = true;
+    for (let urlFilter of notification.urlFilters)
+    {
+      if (typeof urlFilter != "string")
+        continue;
+      // Exceptions only prevent matches.
+      if (urlFilter.startsWith("@@"))
+        continue;
+      let host = getTargetedHost(urlFilter);
+      if (!host)
+        hosts = null;
+      else if (hosts)
+        hosts.push(host);
+    }
+  }
+  _triggerEvent("_notificationCandidates", general, urlTargeted, hosts);
+}
+
+let {addNotification, removeNotification} = Notification;
+
+Notification.addNotification = function(notification)
+{
+  addNotification.call(this, notification);
+  if (localNotifications.indexOf(notification) < 0)
+    localNotifications.push(notification);
+  publishCandidates();
+};
+
+Notification.removeNotification = function(notification)
+{
+  removeNotification.call(this, notification);
+  let index = localNotifications.indexOf(notification);
+  if (index >= 0)
+    localNotifications.splice(index, 1);
+  publishCandidates();
+};
+
+// Downloaded notifications are saved by assigning Prefs.notificationdata.
+Prefs.addListener(function(key)
+{
+  if (key == "notificationdata")
+    publishCandidates();
+});
+
+publishCandidates();
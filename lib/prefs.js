@@ -55,8 +55,24 @@ let preconfigurable = ["suppress_first_run_page", "disable_auto_updates",
 let values;
 let path = _fileSystem.resolve("prefs.json");
 let listeners = [];
+let saveDelay = typeof _prefsSaveDelay == "number" ? _prefsSaveDelay : 0;
+// Whether there are changes which weren't passed to _fileSystem.write yet.
 let isDirty = false;
 let isSaving = false;
+let isSaveScheduled = false;
+let flushCallbacks = [];
+
+// Scalar values are mirrored natively, so that FilterEngine::GetPref() can
+// read them without calling into JavaScript.
+function mirror(key)
+{
+  let value = values[key];
+  if (typeof value == "number" && (!isFinite(value) || Math.floor(value) !== value))
+    value = undefined;
+  else if (typeof value == "object")
+    value = undefined;
+  _triggerEvent("_prefChanged", key, value);
+}
 
 function defineProperty(key)
 {
@@ -73,6 +89,7 @@ function defineProperty(key)
       else
         values[key] = value;
       save();
+      mirror(key);
 
       for (let listener of listeners)
         listener(key);
@@ -83,6 +100,8 @@ function defineProperty(key)
 
 function load()
 {
+  // Reported in FilterEngine::GetStartupProfile().
+  _triggerEvent("_startupPhase", "prefsLoad", true);
   _fileSystem.read(path, function(result)
   {
     // prefs.json is expected to be missing, ignore errors reading file
@@ -101,18 +120,19 @@ function load()
       }
     }
 
+    for (let key in defaults)
+      mirror(key);
+    _triggerEvent("_startupPhase", "prefsLoad", false);
     if (typeof Prefs._initListener == "function")
       Prefs._initListener();
   });
 }
 
-function save()
+function write()
 {
+  // Changes made while writing are written once the write completes.
   if (isSaving)
-  {
-    isDirty = true;
     return;
-  }
 
   isDirty = false;
   isSaving = true;
@@ -120,10 +140,41 @@ function save()
   {
     isSaving = false;
     if (isDirty)
-      save();
+      write();
+    else
+      notifyFlushed();
   });
 }
 
+function notifyFlushed()
+{
+  let callbacks = flushCallbacks;
+  flushCallbacks = [];
+  for (let callback of callbacks)
+    callback();
+}
+
+function save()
+{
+  isDirty = true;
+  if (saveDelay <= 0)
+  {
+    write();
+    return;
+  }
+
+  // All changes made until the timeout fires are written at once.
+  if (isSaveScheduled)
+    return;
+  isSaveScheduled = true;
+  setTimeout(function()
+  {
+    isSaveScheduled = false;
+    if (isDirty)
+      write();
+  }, saveDelay);
+}
+
 let Prefs = exports.Prefs = {
   addListener: function(listener)
   {
@@ -137,6 +188,19 @@ let Prefs = exports.Prefs = {
     if (index >= 0)
       listeners.splice(index, 1);
   },
+
+  /**
+   * Writes pending changes without waiting for the save delay.
+   * @param {function} callback called once all changes are written
+   */
+  flush: function(callback)
+  {
+    flushCallbacks.push(callback);
+    if (isDirty)
+      write();
+    else if (!isSaving)
+      notifyFlushed();
+  },
 };
 
 // Update the default prefs with what was preconfigured
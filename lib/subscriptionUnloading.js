@@ -0,0 +1,166 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+let {Filter} = require("filterClasses");
+let {Subscription, DownloadableSubscription} = require("subscriptionClasses");
+let {FilterNotifier} = require("filterNotifier");
+
+// The filters of disabled subscriptions are only kept as a single string and
+// parsed again once the subscription is enabled, see
+// FilterEngine::CreationParameters::unloadDisabledSubscriptions. Filters with
+// a state of their own, e.g. hit statistics, stay loaded so that the state is
+// saved as usual.
+let enabled = (typeof _unloadDisabledSubscriptions == "boolean" &&
+               _unloadDisabledSubscriptions);
+
+// Unloaded filters by subscription URL: {texts, count, filters} with the
+// filter texts separated by line breaks and the filters left in the
+// subscription.
+let unloaded = new Map();
+
+function hasState(filter)
+{
+  return filter.disabled || filter.hitCount || filter.lastHit;
+}
+
+function removeFilterSubscription(filter, subscription)
+{
+  let index = filter.subscriptions.indexOf(subscription);
+  if (index >= 0)
+    filter.subscriptions.splice(index, 1);
+  if (!filter.subscriptions.length)
+    delete Filter.knownFilters[filter.text];
+}
+
+function addFilterSubscription(filter, subscription)
+{
+  if (filter.subscriptions.indexOf(subscription) < 0)
+    filter.subscriptions.push(subscription);
+}
+
+function unload(subscription)
+{
+  if (!(subscription instanceof DownloadableSubscription) ||
+      !subscription.disabled)
+    return;
+  let entry = unloaded.get(subscription.url);
+  if (entry && entry.filters == subscription.filters)
+    return;
+
+  let texts = [];
+  let kept = [];
+  for (let filter of subscription.filters)
+  {
+    texts.push(filter.text);
+    if (hasState(filter))
+      kept.push(filter);
+    else
+      removeFilterSubscription(filter, subscription);
+  }
+  subscription.filters = kept;
+  unloaded.set(subscription.url, {
+    texts: texts.join("\n"),
+    count: texts.length,
+    filters: kept
+  });
+}
+
+function restore(subscription, addSubscription)
+{
+  let entry = unloaded.get(subscription.url);
+  if (!entry)
+    return;
+  unloaded.delete(subscription.url);
+  let filters = [];
+  if (entry.count)
+  {
+    for (let text of entry.texts.split("\n"))
+    {
+      let filter = Filter.fromText(text);
+      if (addSubscription)
+        addFilterSubscription(filter, subscription);
+      filters.push(filter);
+    }
+  }
+  subscription.filters = filters;
+}
+
+function wrapNotifier()
+{
+  let notify = FilterNotifier.triggerListeners;
+  FilterNotifier.triggerListeners = function(action, item, newValue)
+  {
+    // Enabled subscriptions have to be complete before the listeners add
+    // their filters to the matchers.
+    if (action == "subscription.disabled" && !newValue)
+      restore(item, true);
+
+    let result = notify.apply(this, arguments);
+
+    if (action == "load")
+    {
+      let {FilterStorage} = require("filterStorage");
+      FilterStorage.subscriptions.forEach(unload);
+    }
+    else if (action == "subscription.disabled" ||
+             action == "subscription.added" ||
+             action == "subscription.updated")
+      unload(item);
+    else if (action == "subscription.removed")
+    {
+      // The filters aren't listed anymore but the subscription might be
+      // added again.
+      restore(item, false);
+    }
+    return result;
+  };
+}
+
+if (enabled)
+{
+  wrapNotifier();
+
+  // Saving the subscriptions has to include the unloaded filters.
+  let {serializeFilters} = Subscription.prototype;
+  Subscription.prototype.serializeFilters = function(buffer)
+  {
+    let entry = unloaded.get(this.url);
+    if (!entry || entry.filters != this.filters)
+      return serializeFilters.call(this, buffer);
+
+    let {filters} = this;
+    this.filters = entry.count ? entry.texts.split("\n").map(text => ({text})) : [];
+    try
+    {
+      return serializeFilters.call(this, buffer);
+    }
+    finally
+    {
+      this.filters = filters;
+    }
+  };
+}
+
+// Filter count and approximate size of the filter texts of an unloaded
+// subscription, null unless it is unloaded.
+exports.getUnloadedStats = function(subscription)
+{
+  let entry = unloaded.get(subscription.url);
+  if (!entry)
+    return null;
+  return {count: entry.count, size: entry.texts.length};
+};
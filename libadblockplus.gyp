@@ -15,7 +15,8 @@
   ]],
   'includes': ['third_party/v8/build/features.gypi',
                'third_party/v8/build/toolchain.gypi',
-               'shell/shell.gyp'],
+               'shell/shell.gyp',
+               'benchmark/benchmark.gyp'],
   'targets': [{
     'target_name': 'ensure_dependencies',
     'type': 'none',
@@ -26,37 +27,124 @@
       'action': ['python', 'ensure_dependencies.py'],
     }],
   },
+  {
+    # Matching without V8, e.g. for processes only using a SharedMatcher.
+    # Nothing in here may include v8.h.
+    'target_name': 'libadblockplus-matcher',
+    'type': 'static_library',
+    'include_dirs': [
+      'include',
+    ],
+    'sources': [
+      'include/AdblockPlus/DefaultFileSystem.h',
+      'include/AdblockPlus/FileSystem.h',
+      'include/AdblockPlus/SharedMatcher.h',
+      'src/BaseDomain.cpp',
+      'src/BaseDomain.h',
+      'src/BloomFilter.cpp',
+      'src/BloomFilter.h',
+      'src/CompiledRuleset.cpp',
+      'src/CompiledRuleset.h',
+      'src/ContentTypes.cpp',
+      'src/ContentTypes.h',
+      'src/DefaultFileSystem.cpp',
+      'src/FileSystem.cpp',
+      'src/Matcher.cpp',
+      'src/Matcher.h',
+      'src/MultiPatternMatcher.cpp',
+      'src/MultiPatternMatcher.h',
+      'src/SharedMatcher.cpp',
+      'src/StringUtils.cpp',
+      'src/StringUtils.h',
+      'src/UrlTokenizer.cpp',
+      'src/UrlTokenizer.h',
+      '<(INTERMEDIATE_DIR)/publicSuffixList.cpp'
+    ],
+    'direct_dependent_settings': {
+      'include_dirs': ['include']
+    },
+    'conditions': [
+      ['OS=="android"', {
+        'standalone_static_library': 1, # disable thin archives
+      }],
+      ['OS=="win"', {
+        'link_settings': {
+          'libraries': [ '-lshlwapi.lib' ]
+        }
+      }],
+    ],
+    'actions': [{
+      'action_name': 'convert_psl',
+      'inputs': [
+        'convert_psl.py',
+        'lib/publicSuffixList.js',
+      ],
+      'outputs': [
+        '<(INTERMEDIATE_DIR)/publicSuffixList.cpp'
+      ],
+      'action': [
+        'python',
+        'convert_psl.py',
+        'lib/publicSuffixList.js',
+        '<@(_outputs)',
+      ]
+    }]
+  },
   {
     'target_name': 'libadblockplus',
     'type': '<(library)',
-    'dependencies': ['ensure_dependencies'],
+    'dependencies': ['ensure_dependencies', 'libadblockplus-matcher'],
+    'export_dependent_settings': ['libadblockplus-matcher'],
     'include_dirs': [
       'include',
       'third_party/v8/include',
     ],
     'sources': [
+      'include/AdblockPlus/IExecutor.h',
+      'include/AdblockPlus/IFileSystem.h',
       'include/AdblockPlus/ITimer.h',
       'include/AdblockPlus/IWebRequest.h',
+      'include/AdblockPlus/LatencyMetrics.h',
+      'include/AdblockPlus/AsyncLogSystem.h',
       'include/AdblockPlus/DefaultWebRequest.h',
       'src/AppInfoJsObject.cpp',
+      'src/AsyncLogSystem.cpp',
+      'src/ConcurrentReferrerMapping.cpp',
       'src/ConsoleJsObject.cpp',
       'src/DefaultLogSystem.cpp',
-      'src/DefaultFileSystem.cpp',
+      'src/DefaultAsyncFileSystem.cpp',
       'src/DefaultTimer.cpp',
       'src/DefaultTimer.h',
       'src/DefaultWebRequest.cpp',
+      'src/ElemHideCache.cpp',
+      'src/ElemHideCache.h',
       'src/FileSystemJsObject.cpp',
       'src/FilterEngine.cpp',
+      'src/FilterHitStatistics.cpp',
+      'src/FilterHitStatistics.h',
       'src/GlobalJsObject.cpp',
       'src/JsContext.cpp',
       'src/JsEngine.cpp',
       'src/JsError.cpp',
+      'src/JsSources.cpp',
+      'src/JsSources.h',
       'src/JsValue.cpp',
+      'src/LatencyHistogram.cpp',
+      'src/LatencyHistogram.h',
+      'src/MatchCache.cpp',
+      'src/MatchCache.h',
       'src/Notification.cpp',
+      'src/PrefsCache.cpp',
+      'src/PrefsCache.h',
       'src/ReferrerMapping.cpp',
       'src/Thread.cpp',
+      'src/UpdateCoordinator.cpp',
       'src/Utils.cpp',
       'src/WebRequestJsObject.cpp',
+      'src/WebRequestMetrics.cpp',
+      'src/WebRequestMetrics.h',
+      'src/WorkQueue.cpp',
+      'src/WorkQueue.h',
       '<(INTERMEDIATE_DIR)/adblockplus.js.cpp'
     ],
     'direct_dependent_settings': {
@@ -92,6 +180,7 @@
         {
           'sources': [
             'src/DefaultWebRequestWinInet.cpp',
+            'src/WinHttpWebRequest.cpp',
           ],
           'link_settings': {
             'libraries': [ '-lshlwapi.lib', '-lwinhttp.lib' ]
@@ -105,6 +194,14 @@
           ]
         }
       ],
+      ['compress_js_sources==1',
+        {
+          'defines': ['ADBLOCK_PLUS_COMPRESSED_JS_SOURCES'],
+          'link_settings': {
+            'libraries': ['-lz']
+          }
+        }
+      ],
     ],
     'actions': [{
       'action_name': 'convert_js',
@@ -118,7 +215,6 @@
           'adblockpluscore/lib/events.js',
           'adblockpluscore/lib/coreUtils.js',
           'adblockpluscore/lib/filterNotifier.js',
-          'lib/init.js',
           'adblockpluscore/lib/filterClasses.js',
           'adblockpluscore/lib/subscriptionClasses.js',
           'adblockpluscore/lib/filterStorage.js',
@@ -126,11 +222,18 @@
           'adblockpluscore/lib/cssRules.js',
           'adblockpluscore/lib/matcher.js',
           'adblockpluscore/lib/filterListener.js',
+          'lib/matcherRegistration.js',
+          'lib/elemHideRegistration.js',
+          'lib/subscriptionUnloading.js',
+          # After filterListener.js, so its load listener runs first.
+          'lib/init.js',
           'adblockpluscore/lib/downloader.js',
-          'adblockpluscore/lib/notification.js',
-          'lib/notificationShowRegistration.js',
           'adblockpluscore/lib/synchronizer.js',
           'lib/filterUpdateRegistration.js',
+        ],
+        'lazy_library_files': [
+          'adblockpluscore/lib/notification.js',
+          'lib/notificationShowRegistration.js',
           'adblockpluscore/chrome/content/ui/subscriptions.xml',
           'lib/updater.js',
         ],
@@ -139,28 +242,35 @@
         ],
         'load_after_files': [
           'lib/api.js',
-          'lib/publicSuffixList.js',
           'lib/punycode.js',
-          'lib/basedomain.js',
         ],
       },
       'inputs': [
         'convert_js.py',
         '<@(library_files)',
+        '<@(lazy_library_files)',
         '<@(load_before_files)',
         '<@(load_after_files)',
       ],
       'outputs': [
-        '<(INTERMEDIATE_DIR)/adblockplus.js.cpp'
+        '<(INTERMEDIATE_DIR)/adblockplus.js.cpp',
+        '<(INTERMEDIATE_DIR)/adblockplus.js.sizes.txt'
       ],
       'action': [
         'python',
         'convert_js.py',
-        '<@(_outputs)',
+        '<(INTERMEDIATE_DIR)/adblockplus.js.cpp',
+        '--size-report', '<(INTERMEDIATE_DIR)/adblockplus.js.sizes.txt',
         '--before', '<@(load_before_files)',
         '--convert', '<@(library_files)',
+        '--convert-lazy', '<@(lazy_library_files)',
         '--after', '<@(load_after_files)',
-      ]
+      ],
+      'conditions': [
+        ['compress_js_sources==1', {
+          'action': ['--compress'],
+        }],
+      ],
     }]
   },
   {
@@ -174,19 +284,38 @@
       'test/BaseJsTest.h',
       'test/BaseJsTest.cpp',
       'test/AppInfoJsObject.cpp',
+      'test/AsyncLogSystem.cpp',
+      'test/BaseDomain.cpp',
+      'test/BloomFilter.cpp',
+      'test/CompiledRuleset.cpp',
+      'test/ConcurrentReferrerMapping.cpp',
       'test/ConsoleJsObject.cpp',
+      'test/ContentTypes.cpp',
       'test/DefaultFileSystem.cpp',
+      'test/DefaultTimer.cpp',
+      'test/ElemHideCache.cpp',
       'test/FileSystemJsObject.cpp',
       'test/FilterEngine.cpp',
+      'test/FilterHitStatistics.cpp',
       'test/GlobalJsObject.cpp',
       'test/JsEngine.cpp',
       'test/JsValue.cpp',
+      'test/LatencyHistogram.cpp',
+      'test/MatchCache.cpp',
+      'test/Matcher.cpp',
+      'test/MultiPatternMatcher.cpp',
       'test/Notification.cpp',
+      'test/Performance.cpp',
       'test/Prefs.cpp',
+      'test/PrefsCache.cpp',
       'test/ReferrerMapping.cpp',
+      'test/SharedMatcher.cpp',
       'test/Thread.cpp',
       'test/UpdateCheck.cpp',
-      'test/WebRequest.cpp'
+      'test/UpdateCoordinator.cpp',
+      'test/UrlTokenizer.cpp',
+      'test/WebRequest.cpp',
+      'test/WorkQueue.cpp'
     ],
     'msvs_settings': {
       'VCLinkerTool': {
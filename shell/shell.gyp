@@ -9,14 +9,33 @@
       'src/Main.cpp',
       'src/Command.cpp',
       'src/GcCommand.cpp',
+      'src/HeapSnapshotCommand.cpp',
       'src/HelpCommand.cpp',
+      'src/Latency.cpp',
       'src/FiltersCommand.cpp',
       'src/MatchesCommand.cpp',
       'src/PrefsCommand.cpp',
+      'src/ProfileCommand.cpp',
+      'src/ReplayCommand.cpp',
+      'src/ScalingCommand.cpp',
+      'src/StressCommand.cpp',
       'src/SubscriptionsCommand.cpp'
     ],
     'xcode_settings': {
       'OTHER_LDFLAGS': ['-stdlib=libstdc++'],
     },
+  },
+  {
+    'target_name': 'abpcompile',
+    'type': 'executable',
+    'dependencies': [
+      'libadblockplus.gyp:libadblockplus-matcher'
+    ],
+    'sources': [
+      'src/RulesetCompiler.cpp'
+    ],
+    'xcode_settings': {
+      'OTHER_LDFLAGS': ['-stdlib=libstdc++'],
+    },
   }]
 }
@@ -0,0 +1,58 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include "HeapSnapshotCommand.h"
+
+HeapSnapshotCommand::HeapSnapshotCommand(AdblockPlus::JsEnginePtr jsEngine)
+  : Command("heapsnapshot"), jsEngine(jsEngine)
+{
+}
+
+void HeapSnapshotCommand::operator()(const std::string& arguments)
+{
+  std::istringstream argumentStream(arguments);
+  std::string path;
+  argumentStream >> path;
+  if (!path.size())
+  {
+    ShowUsage();
+    return;
+  }
+
+  try
+  {
+    jsEngine->WriteHeapSnapshot(path);
+    std::cout << "Heap snapshot written to " << path << std::endl;
+  }
+  catch (const std::exception& e)
+  {
+    std::cout << e.what() << std::endl;
+  }
+}
+
+std::string HeapSnapshotCommand::GetDescription() const
+{
+  return "Writes a snapshot of the JavaScript heap, to be loaded in the Chrome DevTools";
+}
+
+std::string HeapSnapshotCommand::GetUsage() const
+{
+  return name + " FILE.heapsnapshot";
+}
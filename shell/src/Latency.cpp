@@ -0,0 +1,42 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iomanip>
+#include <sstream>
+
+#include "Latency.h"
+
+double ToMicroseconds(const Duration& duration)
+{
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+Duration Percentile(const std::vector<Duration>& sorted, int percent)
+{
+  size_t rank = (sorted.size() * percent + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+std::string FormatPercentiles(const std::vector<Duration>& sorted)
+{
+  std::ostringstream result;
+  result << std::fixed << std::setprecision(1)
+         << "p50 " << ToMicroseconds(Percentile(sorted, 50))
+         << " us, p95 " << ToMicroseconds(Percentile(sorted, 95))
+         << " us, p99 " << ToMicroseconds(Percentile(sorted, 99)) << " us";
+  return result.str();
+}
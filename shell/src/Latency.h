@@ -0,0 +1,41 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock::duration Duration;
+
+double ToMicroseconds(const Duration& duration);
+
+/**
+ * Nearest-rank percentile, `sorted` has to be sorted and must not be empty.
+ * @param percent Percentile between 0 and 100.
+ */
+Duration Percentile(const std::vector<Duration>& sorted, int percent);
+
+/**
+ * Formats the 50th, 95th and 99th percentile, e.g.\ "p50 1.2 us, p95 3.4 us,
+ * p99 5.6 us". `sorted` has to be sorted and must not be empty.
+ */
+std::string FormatPercentiles(const std::vector<Duration>& sorted);
+
+#endif
@@ -20,10 +20,15 @@
 #include <sstream>
 
 #include "GcCommand.h"
+#include "HeapSnapshotCommand.h"
 #include "HelpCommand.h"
 #include "FiltersCommand.h"
 #include "MatchesCommand.h"
 #include "PrefsCommand.h"
+#include "ProfileCommand.h"
+#include "ReplayCommand.h"
+#include "ScalingCommand.h"
+#include "StressCommand.h"
 #include "SubscriptionsCommand.h"
 
 namespace
@@ -66,11 +71,16 @@ int main()
 
     CommandMap commands;
     Add(commands, new GcCommand(jsEngine));
+    Add(commands, new ProfileCommand(jsEngine));
+    Add(commands, new HeapSnapshotCommand(jsEngine));
     Add(commands, new HelpCommand(commands));
     Add(commands, new FiltersCommand(*filterEngine));
     Add(commands, new SubscriptionsCommand(*filterEngine));
     Add(commands, new MatchesCommand(*filterEngine));
     Add(commands, new PrefsCommand(*filterEngine));
+    Add(commands, new ScalingCommand(*filterEngine));
+    Add(commands, new ReplayCommand(*filterEngine));
+    Add(commands, new StressCommand(*filterEngine));
 
     std::string commandLine;
     while (ReadCommandLine(commandLine))
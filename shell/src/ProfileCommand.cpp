@@ -0,0 +1,69 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "ProfileCommand.h"
+
+ProfileCommand::ProfileCommand(AdblockPlus::JsEnginePtr jsEngine)
+  : Command("profile"), jsEngine(jsEngine)
+{
+}
+
+void ProfileCommand::operator()(const std::string& arguments)
+{
+  std::istringstream argumentStream(arguments);
+  std::string action;
+  argumentStream >> action;
+  std::string path;
+  argumentStream >> path;
+  try
+  {
+    if (action == "start" && !path.size())
+    {
+      jsEngine->StartCpuProfile();
+      std::cout << "Recording a CPU profile" << std::endl;
+    }
+    else if (action == "stop" && path.size())
+    {
+      std::ofstream file(path.c_str(), std::ios_base::out | std::ios_base::binary);
+      file << jsEngine->StopCpuProfile();
+      if (!file)
+        std::cout << "Failed to write " << path << std::endl;
+      else
+        std::cout << "CPU profile written to " << path << std::endl;
+    }
+    else
+      ShowUsage();
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::cout << e.what() << std::endl;
+  }
+}
+
+std::string ProfileCommand::GetDescription() const
+{
+  return "Records a CPU profile of the JavaScript code, to be loaded in the Chrome DevTools";
+}
+
+std::string ProfileCommand::GetUsage() const
+{
+  return name + " start|stop FILE.cpuprofile";
+}
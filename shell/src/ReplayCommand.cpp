@@ -0,0 +1,176 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Latency.h"
+#include "ReplayCommand.h"
+
+namespace
+{
+  struct Request
+  {
+    std::string url;
+    AdblockPlus::FilterEngine::ContentType contentType;
+    std::vector<std::string> documentUrls;
+  };
+
+  struct Results
+  {
+    Results()
+      : blocked(0), whitelisted(0)
+    {
+    }
+
+    std::vector<Duration> latencies;
+    size_t blocked;
+    size_t whitelisted;
+  };
+
+  bool ReadRequests(const std::string& path, std::vector<Request>& requests)
+  {
+    std::ifstream file(path);
+    if (!file)
+      return false;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+      lineNumber++;
+      std::istringstream lineStream(line);
+      Request request;
+      std::string contentType;
+      std::string documentUrl;
+      lineStream >> request.url >> contentType >> documentUrl;
+      if (request.url.empty())
+        continue;
+      try
+      {
+        request.contentType = AdblockPlus::FilterEngine::StringToContentType(contentType);
+      }
+      catch (std::invalid_argument&)
+      {
+        documentUrl.clear();
+      }
+      if (documentUrl.empty())
+      {
+        std::cerr << path << ":" << lineNumber << ": invalid request" << std::endl;
+        continue;
+      }
+      request.documentUrls.push_back(documentUrl);
+      requests.push_back(request);
+    }
+    return true;
+  }
+}
+
+ReplayCommand::ReplayCommand(AdblockPlus::FilterEngine& filterEngine)
+  : Command("replay"), filterEngine(filterEngine)
+{
+}
+
+void ReplayCommand::operator()(const std::string& arguments)
+{
+  std::istringstream argumentStream(arguments);
+  std::string path;
+  argumentStream >> path;
+  int threadCount = 1;
+  argumentStream >> threadCount;
+  if (!path.size() || threadCount <= 0)
+  {
+    ShowUsage();
+    return;
+  }
+
+  std::vector<Request> requests;
+  if (!ReadRequests(path, requests))
+  {
+    std::cout << "Failed to read " << path << std::endl;
+    return;
+  }
+  if (requests.empty())
+  {
+    std::cout << "No requests in " << path << std::endl;
+    return;
+  }
+
+  // Threads take the next request from a shared index and keep their
+  // results separate, so that only the matching itself is shared.
+  std::vector<Results> threadResults(threadCount);
+  std::atomic<size_t> next(0);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; i++)
+  {
+    Results& results = threadResults[i];
+    threads.push_back(std::thread([this, &requests, &next, &results]
+    {
+      for (size_t j = next++; j < requests.size(); j = next++)
+      {
+        const Request& request = requests[j];
+        auto requestStart = std::chrono::steady_clock::now();
+        AdblockPlus::FilterPtr match = filterEngine.Matches(request.url,
+            request.contentType, request.documentUrls);
+        results.latencies.push_back(std::chrono::steady_clock::now() - requestStart);
+        if (!match)
+          continue;
+        if (match->GetType() == AdblockPlus::Filter::TYPE_EXCEPTION)
+          results.whitelisted++;
+        else
+          results.blocked++;
+      }
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  Results total;
+  for (const auto& results : threadResults)
+  {
+    total.latencies.insert(total.latencies.end(), results.latencies.begin(),
+        results.latencies.end());
+    total.blocked += results.blocked;
+    total.whitelisted += results.whitelisted;
+  }
+  std::sort(total.latencies.begin(), total.latencies.end());
+
+  std::cout << requests.size() << " requests, " << threadCount << " thread(s): "
+            << static_cast<int64_t>(requests.size() / elapsed.count())
+            << " requests/s" << std::endl;
+  std::cout << "Latency: " << FormatPercentiles(total.latencies) << std::endl;
+  std::cout << "Blocked: " << total.blocked << ", whitelisted: " << total.whitelisted
+            << ", no match: " << requests.size() - total.blocked - total.whitelisted
+            << std::endl;
+}
+
+std::string ReplayCommand::GetDescription() const
+{
+  return "Matches the requests listed in a file and reports throughput and latency";
+}
+
+std::string ReplayCommand::GetUsage() const
+{
+  return name + " FILE [THREADS]\nFILE lists a request per line: URL CONTENT_TYPE DOCUMENT_URL";
+}
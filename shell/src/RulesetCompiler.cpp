@@ -0,0 +1,71 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../src/CompiledRuleset.h"
+
+// Compiles filter lists into the ruleset format loaded via
+// FilterEngine::CreationParameters::precompiledRuleset.
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cerr << "Usage: abpcompile OUTPUT FILTER_LIST..." << std::endl;
+    return 1;
+  }
+
+  try
+  {
+    std::vector<std::string> filters;
+    for (int i = 2; i < argc; i++)
+    {
+      std::ifstream input(argv[i], std::ios_base::binary);
+      if (!input)
+        throw std::runtime_error(std::string("Failed to open ") + argv[i]);
+      std::string line;
+      while (std::getline(input, line))
+        filters.push_back(line);
+    }
+
+    std::ofstream output(argv[1], std::ios_base::binary | std::ios_base::trunc);
+    if (!output)
+      throw std::runtime_error(std::string("Failed to create ") + argv[1]);
+    AdblockPlus::CompiledRuleset::CompileStats stats =
+      AdblockPlus::CompiledRuleset::Compile(filters, output);
+    output.close();
+    if (!output)
+      throw std::runtime_error(std::string("Failed to write ") + argv[1]);
+
+    std::cout << stats.blockingFilters << " blocking filters, "
+              << stats.whitelistFilters << " whitelist filters, "
+              << stats.elemHideFilters << " element hiding filters, "
+              << stats.elemHideExceptions << " element hiding exceptions, "
+              << stats.skippedFilters << " lines skipped" << std::endl;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "ScalingCommand.h"
+
+namespace
+{
+  const int REQUESTS_PER_THREAD = 10000;
+}
+
+ScalingCommand::ScalingCommand(AdblockPlus::FilterEngine& filterEngine)
+  : Command("scaling"), filterEngine(filterEngine)
+{
+}
+
+void ScalingCommand::operator()(const std::string& arguments)
+{
+  std::istringstream argumentStream(arguments);
+  int maxThreads = 0;
+  argumentStream >> maxThreads;
+  std::string url;
+  argumentStream >> url;
+  std::string contentTypeStr;
+  argumentStream >> contentTypeStr;
+  std::string documentUrl;
+  argumentStream >> documentUrl;
+  AdblockPlus::FilterEngine::ContentType contentType;
+  try
+  {
+    contentType = AdblockPlus::FilterEngine::StringToContentType(contentTypeStr);
+  }
+  catch (std::invalid_argument& e)
+  {
+    contentTypeStr.clear();
+  }
+  if (maxThreads <= 0 || !url.size() || !contentTypeStr.size() || !documentUrl.size())
+  {
+    ShowUsage();
+    return;
+  }
+
+  const std::vector<std::string> documentUrls(1, documentUrl);
+  for (int threadCount = 1; threadCount <= maxThreads; threadCount++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; i++)
+    {
+      threads.push_back(std::thread([this, &url, contentType, &documentUrls]
+      {
+        for (int j = 0; j < REQUESTS_PER_THREAD; j++)
+          filterEngine.GetMatchResult(url, contentType, documentUrls);
+      }));
+    }
+    for (auto& thread : threads)
+      thread.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << threadCount << " thread(s): "
+              << static_cast<int64_t>(threadCount * REQUESTS_PER_THREAD / elapsed.count())
+              << " requests/s" << std::endl;
+  }
+}
+
+std::string ScalingCommand::GetDescription() const
+{
+  return "Measures how matching a URL scales with the number of threads";
+}
+
+std::string ScalingCommand::GetUsage() const
+{
+  return name + " MAX_THREADS URL CONTENT_TYPE DOCUMENT_URL";
+}
@@ -0,0 +1,177 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Latency.h"
+#include "StressCommand.h"
+
+namespace
+{
+  // Number of inconsistent results which are printed.
+  const size_t MAX_REPORTED_INCONSISTENCIES = 10;
+
+  struct Results
+  {
+    Results()
+      : inconsistent(0)
+    {
+    }
+
+    std::vector<Duration> latencies;
+    size_t inconsistent;
+  };
+
+  std::string Describe(const AdblockPlus::MatchResult& result)
+  {
+    if (!result.IsMatch())
+      return "No match";
+    else if (result.type == AdblockPlus::Filter::TYPE_EXCEPTION)
+      return "Whitelisted by " + result.text;
+    else
+      return "Blocked by " + result.text;
+  }
+}
+
+StressCommand::StressCommand(AdblockPlus::FilterEngine& filterEngine)
+  : Command("stress"), filterEngine(filterEngine)
+{
+}
+
+void StressCommand::operator()(const std::string& arguments)
+{
+  std::istringstream argumentStream(arguments);
+  int threadCount = 0;
+  argumentStream >> threadCount;
+  int seconds = 0;
+  argumentStream >> seconds;
+  std::string url;
+  argumentStream >> url;
+  std::string contentTypeStr;
+  argumentStream >> contentTypeStr;
+  std::string documentUrl;
+  argumentStream >> documentUrl;
+  AdblockPlus::FilterEngine::ContentType contentType;
+  try
+  {
+    contentType = AdblockPlus::FilterEngine::StringToContentType(contentTypeStr);
+  }
+  catch (std::invalid_argument& e)
+  {
+    contentTypeStr.clear();
+  }
+  if (threadCount <= 0 || seconds <= 0 || !url.size() || !contentTypeStr.size() ||
+      !documentUrl.size())
+  {
+    ShowUsage();
+    return;
+  }
+
+  // The filters changed in the background never match the URL, so every
+  // result has to be the same as before they are changed.
+  const std::vector<std::string> documentUrls(1, documentUrl);
+  const AdblockPlus::MatchResult expected =
+    filterEngine.GetMatchResult(url, contentType, documentUrls);
+
+  std::vector<Results> threadResults(threadCount);
+  std::vector<std::string> inconsistencies;
+  std::mutex inconsistenciesMutex;
+  std::atomic<bool> stopped(false);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; i++)
+  {
+    Results& results = threadResults[i];
+    threads.push_back(std::thread([&, this]
+    {
+      while (!stopped)
+      {
+        auto requestStart = std::chrono::steady_clock::now();
+        AdblockPlus::MatchResult result =
+          filterEngine.GetMatchResult(url, contentType, documentUrls);
+        results.latencies.push_back(std::chrono::steady_clock::now() - requestStart);
+        if (result.type == expected.type && result.text == expected.text)
+          continue;
+        results.inconsistent++;
+        std::lock_guard<std::mutex> lock(inconsistenciesMutex);
+        if (inconsistencies.size() < MAX_REPORTED_INCONSISTENCIES)
+          inconsistencies.push_back(Describe(result));
+      }
+    }));
+  }
+
+  // Same changes as `filters add` and `filters remove`, on this thread.
+  size_t filterChanges = 0;
+  auto deadline = start + std::chrono::seconds(seconds);
+  for (int i = 0; std::chrono::steady_clock::now() < deadline; i++)
+  {
+    std::ostringstream text;
+    text << "||stress" << i << ".invalid^";
+    AdblockPlus::Filter filter = filterEngine.GetFilter(text.str());
+    filter.AddToList();
+    filter.RemoveFromList();
+    filterChanges += 2;
+  }
+  stopped = true;
+  for (auto& thread : threads)
+    thread.join();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  Results total;
+  for (const auto& results : threadResults)
+  {
+    total.latencies.insert(total.latencies.end(), results.latencies.begin(),
+        results.latencies.end());
+    total.inconsistent += results.inconsistent;
+  }
+  if (total.latencies.empty())
+  {
+    std::cout << "No requests were matched" << std::endl;
+    return;
+  }
+  std::sort(total.latencies.begin(), total.latencies.end());
+
+  std::cout << total.latencies.size() << " requests, " << threadCount << " thread(s): "
+            << static_cast<int64_t>(total.latencies.size() / elapsed.count())
+            << " requests/s" << std::endl;
+  std::cout << "Latency: " << FormatPercentiles(total.latencies) << ", max "
+            << std::fixed << std::setprecision(1)
+            << ToMicroseconds(total.latencies.back()) << " us" << std::endl;
+  std::cout << "Filter changes: " << filterChanges << std::endl;
+  std::cout << "Inconsistent results: " << total.inconsistent
+            << " (expected: " << Describe(expected) << ")" << std::endl;
+  for (const auto& inconsistency : inconsistencies)
+    std::cout << "  " << inconsistency << std::endl;
+}
+
+std::string StressCommand::GetDescription() const
+{
+  return "Matches a URL from several threads while filters are changed";
+}
+
+std::string StressCommand::GetUsage() const
+{
+  return name + " THREADS SECONDS URL CONTENT_TYPE DOCUMENT_URL";
+}
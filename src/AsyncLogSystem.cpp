@@ -0,0 +1,217 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <AdblockPlus/AsyncLogSystem.h>
+
+using namespace AdblockPlus;
+
+/**
+ * Bounded multi-producer single-consumer queue, each slot has a sequence
+ * number telling whether it is free or holds a message. See Dmitry Vyukov's
+ * bounded MPMC queue.
+ */
+class AsyncLogSystem::Buffer
+{
+public:
+  struct Message
+  {
+    LogLevel level;
+    std::string text;
+    std::string source;
+  };
+
+  explicit Buffer(size_t capacity)
+    : mask(RoundUpToPowerOfTwo(capacity) - 1), slots(mask + 1),
+      enqueuePosition(0), dequeuePosition(0), publishedCount(0),
+      writtenCount(0), droppedCount(0), consumerSleeping(false),
+      shouldThreadStop(false)
+  {
+    for (size_t i = 0; i < slots.size(); i++)
+      slots[i].sequence = i;
+  }
+
+  void Push(LogLevel level, const std::string& text, const std::string& source)
+  {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;)
+    {
+      slot = &slots[position & mask];
+      std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(
+        slot->sequence.load(std::memory_order_acquire) - position);
+      if (difference == 0)
+      {
+        if (enqueuePosition.compare_exchange_weak(position, position + 1,
+            std::memory_order_relaxed))
+          break;
+      }
+      else if (difference < 0)
+      {
+        // The slot still holds the message of the previous round.
+        droppedCount++;
+        return;
+      }
+      else
+        position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+    slot->message.level = level;
+    slot->message.text = text;
+    slot->message.source = source;
+    // Sequentially consistent, so that either the consumer sees the message
+    // or this thread sees the consumer sleeping.
+    slot->sequence.store(position + 1);
+    publishedCount++;
+    if (consumerSleeping)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      conditionVariable.notify_one();
+    }
+  }
+
+  /// Only called by the consumer thread.
+  bool Pop(Message& message)
+  {
+    Slot& slot = slots[dequeuePosition & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+      return false;
+    message.level = slot.message.level;
+    message.text.swap(slot.message.text);
+    message.source.swap(slot.message.source);
+    slot.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+    dequeuePosition++;
+    return true;
+  }
+
+  /// Only called by the consumer thread.
+  bool HasMessage() const
+  {
+    return slots[dequeuePosition & mask].sequence == dequeuePosition + 1;
+  }
+
+  static size_t RoundUpToPowerOfTwo(size_t value)
+  {
+    size_t result = 1;
+    while (result < value)
+      result <<= 1;
+    return result;
+  }
+
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    Message message;
+  };
+
+  const size_t mask;
+  std::vector<Slot> slots;
+  std::atomic<size_t> enqueuePosition;
+  size_t dequeuePosition;
+  std::atomic<uint64_t> publishedCount;
+  std::atomic<uint64_t> writtenCount;
+  std::atomic<uint64_t> droppedCount;
+  std::atomic<bool> consumerSleeping;
+  /// Protects the waiting of the consumer and of `Flush()`.
+  std::mutex mutex;
+  std::condition_variable conditionVariable;
+  std::condition_variable writtenCondition;
+  bool shouldThreadStop;
+};
+
+AsyncLogSystem::AsyncLogSystem(const LogSystemPtr& target, LogLevel minLevel,
+  size_t capacity)
+  : target(target), minLevel(minLevel), buffer(new Buffer(capacity))
+{
+  thread = std::thread([this]
+  {
+    ThreadFunc();
+  });
+}
+
+AsyncLogSystem::~AsyncLogSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->shouldThreadStop = true;
+  }
+  buffer->conditionVariable.notify_one();
+  thread.join();
+}
+
+void AsyncLogSystem::operator()(LogLevel logLevel, const std::string& message,
+  const std::string& source)
+{
+  if (IsEnabled(logLevel))
+    buffer->Push(logLevel, message, source);
+}
+
+bool AsyncLogSystem::IsEnabled(LogLevel logLevel) const
+{
+  return logLevel >= minLevel && target->IsEnabled(logLevel);
+}
+
+void AsyncLogSystem::Flush()
+{
+  uint64_t published = buffer->publishedCount;
+  std::unique_lock<std::mutex> lock(buffer->mutex);
+  buffer->writtenCondition.wait(lock, [this, published]
+  {
+    return buffer->writtenCount >= published;
+  });
+}
+
+uint64_t AsyncLogSystem::GetDroppedCount() const
+{
+  return buffer->droppedCount;
+}
+
+void AsyncLogSystem::ThreadFunc()
+{
+  uint64_t reportedDroppedCount = 0;
+  Buffer::Message message;
+  for (;;)
+  {
+    while (buffer->Pop(message))
+    {
+      uint64_t droppedCount = buffer->droppedCount;
+      if (droppedCount != reportedDroppedCount)
+      {
+        (*target)(LOG_LEVEL_WARN, std::to_string(droppedCount - reportedDroppedCount) +
+          " log messages dropped, the buffer was full", "");
+        reportedDroppedCount = droppedCount;
+      }
+      (*target)(message.level, message.text, message.source);
+      buffer->writtenCount++;
+    }
+
+    std::unique_lock<std::mutex> lock(buffer->mutex);
+    buffer->writtenCondition.notify_all();
+    buffer->consumerSleeping = true;
+    if (!buffer->HasMessage())
+    {
+      if (buffer->shouldThreadStop)
+        return;
+      buffer->conditionVariable.wait(lock);
+    }
+    buffer->consumerSleeping = false;
+  }
+}
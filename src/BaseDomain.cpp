@@ -0,0 +1,508 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cctype>
+#include <limits>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+#include "BaseDomain.h"
+
+using namespace AdblockPlus;
+
+// Generated by convert_psl.py.
+extern const char* const publicSuffixList[];
+extern const int publicSuffixOffsets[];
+
+namespace
+{
+  bool IsDigits(const std::string& str)
+  {
+    if (str.empty())
+      return false;
+    for (char c : str)
+      if (!std::isdigit(static_cast<unsigned char>(c)))
+        return false;
+    return true;
+  }
+
+  bool IsHexDigits(const std::string& str)
+  {
+    if (str.empty())
+      return false;
+    for (char c : str)
+      if (!std::isxdigit(static_cast<unsigned char>(c)))
+        return false;
+    return true;
+  }
+
+  // A decimal octet as accepted by RE_V4inV6, i.e. at most three digits and a
+  // value not exceeding 255.
+  bool IsDecimalOctet(const std::string& part)
+  {
+    return IsDigits(part) && part.length() <= 3 && std::stoi(part) <= 255;
+  }
+
+  bool IsV4Octet(const std::string& part)
+  {
+    if (IsDecimalOctet(part))
+      return true;
+    if (part.length() >= 3 && part.length() <= 4 && part[0] == '0' &&
+        (part[1] == 'x' || part[1] == 'X'))
+      return IsHexDigits(part.substr(2));
+    if (part.length() == 4 && part[0] == '0')
+    {
+      for (char c : part)
+        if (c < '0' || c > '7')
+          return false;
+      return true;
+    }
+    return false;
+  }
+
+  bool SplitDottedQuad(const std::string& address, std::string parts[4])
+  {
+    std::string::size_type start = 0;
+    for (int i = 0; i < 4; i++)
+    {
+      std::string::size_type end = address.find('.', start);
+      if ((i < 3) == (end == std::string::npos))
+        return false;
+      parts[i] = address.substr(start, end == std::string::npos ? end : end - start);
+      start = end + 1;
+    }
+    return true;
+  }
+
+  std::string::size_type CountOccurrences(const std::string& str,
+    const std::string& substring)
+  {
+    std::string::size_type count = 0;
+    for (std::string::size_type pos = str.find(substring);
+         pos != std::string::npos;
+         pos = str.find(substring, pos + substring.length()))
+      count++;
+    return count;
+  }
+
+  std::string RemoveTrailingDots(const std::string& str)
+  {
+    std::string::size_type end = str.find_last_not_of('.');
+    return end == std::string::npos ? std::string() : str.substr(0, end + 1);
+  }
+
+  bool IsASCII(const std::string& str)
+  {
+    for (char c : str)
+      if (static_cast<unsigned char>(c) >= 0x80)
+        return false;
+    return true;
+  }
+
+  bool DecodeUTF8(const std::string& str, std::vector<uint32_t>& codePoints)
+  {
+    for (std::string::size_type i = 0; i < str.length();)
+    {
+      unsigned char lead = static_cast<unsigned char>(str[i++]);
+      int continuationBytes;
+      uint32_t codePoint;
+      if (lead < 0x80)
+      {
+        continuationBytes = 0;
+        codePoint = lead;
+      }
+      else if ((lead & 0xE0) == 0xC0)
+      {
+        continuationBytes = 1;
+        codePoint = lead & 0x1F;
+      }
+      else if ((lead & 0xF0) == 0xE0)
+      {
+        continuationBytes = 2;
+        codePoint = lead & 0x0F;
+      }
+      else if ((lead & 0xF8) == 0xF0)
+      {
+        continuationBytes = 3;
+        codePoint = lead & 0x07;
+      }
+      else
+        return false;
+      for (int j = 0; j < continuationBytes; j++, i++)
+      {
+        if (i >= str.length() || (static_cast<unsigned char>(str[i]) & 0xC0) != 0x80)
+          return false;
+        codePoint = (codePoint << 6) | (static_cast<unsigned char>(str[i]) & 0x3F);
+      }
+      static const uint32_t minimum[] = {0, 0x80, 0x800, 0x10000};
+      if (codePoint < minimum[continuationBytes] || codePoint > 0x10FFFF ||
+          (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+        return false;
+      codePoints.push_back(codePoint);
+    }
+    return true;
+  }
+
+  // Bootstring parameters of punycode, see RFC 3492.
+  const uint32_t PUNYCODE_BASE = 36;
+  const uint32_t PUNYCODE_TMIN = 1;
+  const uint32_t PUNYCODE_TMAX = 26;
+  const uint32_t PUNYCODE_SKEW = 38;
+  const uint32_t PUNYCODE_DAMP = 700;
+  const uint32_t PUNYCODE_INITIAL_BIAS = 72;
+  const uint32_t PUNYCODE_INITIAL_N = 0x80;
+
+  char EncodePunycodeDigit(uint32_t digit)
+  {
+    return static_cast<char>(digit < 26 ? 'a' + digit : '0' + digit - 26);
+  }
+
+  uint32_t AdaptPunycodeBias(uint32_t delta, uint32_t numPoints, bool firstTime)
+  {
+    delta = firstTime ? delta / PUNYCODE_DAMP : delta / 2;
+    delta += delta / numPoints;
+    uint32_t k = 0;
+    while (delta > ((PUNYCODE_BASE - PUNYCODE_TMIN) * PUNYCODE_TMAX) / 2)
+    {
+      delta /= PUNYCODE_BASE - PUNYCODE_TMIN;
+      k += PUNYCODE_BASE;
+    }
+    return k + (PUNYCODE_BASE - PUNYCODE_TMIN + 1) * delta / (delta + PUNYCODE_SKEW);
+  }
+
+  bool EncodePunycode(const std::vector<uint32_t>& input, std::string& output)
+  {
+    for (uint32_t codePoint : input)
+    {
+      if (codePoint < 0x80)
+        output += static_cast<char>(std::tolower(static_cast<int>(codePoint)));
+    }
+    uint32_t basicCount = static_cast<uint32_t>(output.length());
+    uint32_t handled = basicCount;
+    if (basicCount > 0)
+      output += '-';
+
+    uint32_t n = PUNYCODE_INITIAL_N;
+    uint64_t delta = 0;
+    uint32_t bias = PUNYCODE_INITIAL_BIAS;
+    while (handled < input.size())
+    {
+      uint32_t next = std::numeric_limits<uint32_t>::max();
+      for (uint32_t codePoint : input)
+      {
+        if (codePoint >= n && codePoint < next)
+          next = codePoint;
+      }
+      delta += static_cast<uint64_t>(next - n) * (handled + 1);
+      n = next;
+      for (uint32_t codePoint : input)
+      {
+        if (codePoint < n)
+          delta++;
+        if (delta > std::numeric_limits<uint32_t>::max())
+          return false;
+        if (codePoint != n)
+          continue;
+        uint32_t q = static_cast<uint32_t>(delta);
+        for (uint32_t k = PUNYCODE_BASE;; k += PUNYCODE_BASE)
+        {
+          uint32_t t = k <= bias ? PUNYCODE_TMIN :
+            k >= bias + PUNYCODE_TMAX ? PUNYCODE_TMAX : k - bias;
+          if (q < t)
+            break;
+          output += EncodePunycodeDigit(t + (q - t) % (PUNYCODE_BASE - t));
+          q = (q - t) / (PUNYCODE_BASE - t);
+        }
+        output += EncodePunycodeDigit(q);
+        bias = AdaptPunycodeBias(static_cast<uint32_t>(delta), handled + 1,
+          handled == basicCount);
+        delta = 0;
+        handled++;
+      }
+      delta++;
+      n++;
+    }
+    return true;
+  }
+
+  bool IsLabelSeparator(uint32_t codePoint)
+  {
+    // Full stop and the ideographic and fullwidth full stops of IDNA.
+    return codePoint == '.' || codePoint == 0x3002 || codePoint == 0xFF0E ||
+      codePoint == 0xFF61;
+  }
+
+  bool ConvertToASCII(const std::string& host, std::string& result)
+  {
+    std::vector<uint32_t> codePoints;
+    if (!DecodeUTF8(host, codePoints))
+      return false;
+    std::vector<uint32_t> label;
+    for (size_t i = 0; i <= codePoints.size(); i++)
+    {
+      if (i < codePoints.size() && !IsLabelSeparator(codePoints[i]))
+      {
+        label.push_back(codePoints[i]);
+        continue;
+      }
+      bool asciiLabel = true;
+      for (uint32_t codePoint : label)
+        asciiLabel = asciiLabel && codePoint < 0x80;
+      if (asciiLabel)
+      {
+        for (uint32_t codePoint : label)
+          result += static_cast<char>(codePoint);
+      }
+      else
+      {
+        std::string encoded;
+        if (!EncodePunycode(label, encoded))
+          return false;
+        result += "xn--" + encoded;
+      }
+      if (i < codePoints.size())
+        result += '.';
+      label.clear();
+    }
+    return true;
+  }
+
+  // Number of converted hosts kept by ToASCII(), the cache is dropped as a
+  // whole once it is full.
+  const size_t ASCII_HOST_CACHE_CAPACITY = 1000;
+
+  std::mutex asciiHostCacheMutex;
+  std::unordered_map<std::string, std::string> asciiHostCache;
+}
+
+bool BaseDomain::IsIPv4(const std::string& address)
+{
+  std::string parts[4];
+  if (SplitDottedQuad(address, parts))
+  {
+    bool valid = true;
+    for (const auto& part : parts)
+      valid = valid && IsV4Octet(part);
+    if (valid)
+      return true;
+  }
+  if (address.length() == 10 && address[0] == '0' &&
+      (address[1] == 'x' || address[1] == 'X') && IsHexDigits(address.substr(2)))
+    return true;
+  return IsDigits(address);
+}
+
+bool BaseDomain::IsIPv6(const std::string& input)
+{
+  std::string address = input;
+  int a4addon = 0;
+
+  // Look for an embedded IPv4 address at the end, the leftmost match wins
+  // like with RE_V4inV6.
+  std::string parts[4];
+  std::string::size_type v4Start = std::string::npos;
+  for (std::string::size_type i = 0; i < address.length(); i++)
+  {
+    if (SplitDottedQuad(address.substr(i), parts) &&
+        IsDecimalOctet(parts[0]) && IsDecimalOctet(parts[1]) &&
+        IsDecimalOctet(parts[2]) && IsDecimalOctet(parts[3]))
+    {
+      v4Start = i;
+      break;
+    }
+  }
+  if (v4Start != std::string::npos)
+  {
+    for (const auto& part : parts)
+      if (part.length() > 1 && part[0] == '0')
+        return false;
+    address.erase(v4Start);
+    if (!address.empty() && std::isdigit(static_cast<unsigned char>(address.back())))
+      return false;
+    address += parts[0] + ":" + parts[1] + ":" + parts[2] + ":" + parts[3];
+    a4addon = 2;
+  }
+
+  int hexRun = 0;
+  int colonRun = 0;
+  for (char c : address)
+  {
+    if (c == ':')
+    {
+      hexRun = 0;
+      if (++colonRun >= 3)
+        return false;
+    }
+    else if (std::isxdigit(static_cast<unsigned char>(c)))
+    {
+      colonRun = 0;
+      if (++hexRun >= 5)
+        return false;
+    }
+    else
+      return false;
+  }
+  std::string::size_type length = address.length();
+  if (length >= 2 && address[length - 1] == ':' && address[length - 2] != ':')
+    return false;
+  if (length == 2 && address[0] == ':' && address[1] != ':')
+    return false;
+
+  std::string::size_type halves = CountOccurrences(address, "::");
+  std::string::size_type colons = CountOccurrences(address, ":");
+  if (halves == 1 && colons <= static_cast<std::string::size_type>(6 + 2 + a4addon))
+    return true;
+  if (halves == 0 && colons == static_cast<std::string::size_type>(7 + a4addon))
+    return true;
+  return false;
+}
+
+std::shared_ptr<const BaseDomain::PublicSuffixes> BaseDomain::GetPublicSuffixList()
+{
+  // Built once and shared, it is never modified afterwards.
+  static const std::shared_ptr<const PublicSuffixes> list = []
+  {
+    std::shared_ptr<PublicSuffixes> result = std::make_shared<PublicSuffixes>();
+    for (int i = 0; publicSuffixList[i]; i++)
+      (*result)[publicSuffixList[i]] = publicSuffixOffsets[i];
+    return result;
+  }();
+  return list;
+}
+
+std::string BaseDomain::ToASCII(const std::string& host)
+{
+  if (IsASCII(host))
+    return host;
+  {
+    std::lock_guard<std::mutex> lock(asciiHostCacheMutex);
+    auto it = asciiHostCache.find(host);
+    if (it != asciiHostCache.end())
+      return it->second;
+  }
+
+  std::string result;
+  if (!ConvertToASCII(host, result))
+    result = host;
+
+  std::lock_guard<std::mutex> lock(asciiHostCacheMutex);
+  if (asciiHostCache.size() >= ASCII_HOST_CACHE_CAPACITY)
+    asciiHostCache.clear();
+  asciiHostCache[host] = result;
+  return result;
+}
+
+std::string BaseDomain::ExtractHostFromURL(const std::string& spec)
+{
+  // Mirrors the URI class formerly in lib/basedomain.js.
+  std::string::size_type schemeEnd = spec.find(':');
+  if (schemeEnd == std::string::npos)
+    return std::string();
+  if (spec.compare(schemeEnd + 1, 2, "//") != 0)
+    return std::string();
+  std::string::size_type hostPortStart = schemeEnd + 3;
+  if (hostPortStart == spec.length())
+    return std::string();
+
+  std::string::size_type hostPortEnd = spec.find('/', hostPortStart);
+  if (hostPortEnd == std::string::npos)
+  {
+    hostPortEnd = spec.find_first_of("?#", hostPortStart);
+    if (hostPortEnd == std::string::npos)
+      hostPortEnd = spec.length();
+  }
+
+  std::string::size_type authEnd = spec.find('@', hostPortStart);
+  if (authEnd != std::string::npos && authEnd < hostPortEnd)
+    hostPortStart = authEnd + 1;
+
+  std::string::size_type hostStart;
+  std::string::size_type hostEnd = spec.find(']', hostPortStart + 1);
+  if (hostPortStart < spec.length() && spec[hostPortStart] == '[' &&
+      hostEnd != std::string::npos && hostEnd < hostPortEnd)
+  {
+    // The host is an IPv6 literal
+    hostStart = hostPortStart + 1;
+  }
+  else
+  {
+    hostStart = hostPortStart;
+    hostEnd = spec.find(':', hostStart);
+    if (hostEnd == std::string::npos || hostEnd >= hostPortEnd)
+      hostEnd = hostPortEnd;
+  }
+  if (hostEnd < hostStart)
+    return std::string();
+  return ToASCII(spec.substr(hostStart, hostEnd - hostStart));
+}
+
+std::string BaseDomain::GetBaseDomain(const std::string& host,
+  const PublicSuffixes& publicSuffixes)
+{
+  std::string hostname = RemoveTrailingDots(host);
+
+  // return IP address untouched
+  if (IsIPv6(hostname) || IsIPv4(hostname))
+    return hostname;
+
+  // Unlike the JavaScript version we don't decode punycode hosts, the suffix
+  // list contains the punycode version of internationalized entries.
+  std::string::size_type current = 0;
+  int tld;
+  while (true)
+  {
+    auto suffix = publicSuffixes.find(hostname.substr(current));
+    if (suffix != publicSuffixes.end())
+    {
+      tld = suffix->second;
+      break;
+    }
+    std::string::size_type nextDot = hostname.find('.', current);
+    if (nextDot == std::string::npos)
+    {
+      tld = 1;
+      break;
+    }
+    current = nextDot + 1;
+  }
+
+  while (tld > 0 && current > 0)
+  {
+    std::string::size_type previousDot = current >= 2 ?
+      hostname.rfind('.', current - 2) : std::string::npos;
+    current = previousDot == std::string::npos ? 0 : previousDot + 1;
+    tld--;
+  }
+  return hostname.substr(current);
+}
+
+bool BaseDomain::IsThirdParty(const std::string& request,
+  const std::string& document, const PublicSuffixes& publicSuffixes)
+{
+  std::string requestHost = RemoveTrailingDots(request);
+  std::string documentHost = RemoveTrailingDots(document);
+
+  std::string documentDomain = GetBaseDomain(documentHost, publicSuffixes);
+  if (requestHost.length() > documentDomain.length())
+  {
+    return requestHost.compare(requestHost.length() - documentDomain.length() - 1,
+      std::string::npos, "." + documentDomain) != 0;
+  }
+  else
+    return requestHost != documentDomain;
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_BASE_DOMAIN_H
+#define ADBLOCK_PLUS_BASE_DOMAIN_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace AdblockPlus
+{
+  /**
+   * Host name and base domain helpers, these used to be implemented in
+   * JavaScript in lib/basedomain.js.
+   */
+  namespace BaseDomain
+  {
+    /**
+     * Maps a public suffix to the number of additional labels which belong to
+     * the base domain, same as the `publicSuffixes` object in
+     * lib/publicSuffixList.js.
+     */
+    typedef std::unordered_map<std::string, int> PublicSuffixes;
+
+    /**
+     * Returns the public suffix list compiled into the library from
+     * lib/publicSuffixList.js. Internationalized suffixes are present both
+     * as Unicode and punycode.
+     */
+    std::shared_ptr<const PublicSuffixes> GetPublicSuffixList();
+
+    bool IsIPv4(const std::string& address);
+    bool IsIPv6(const std::string& address);
+
+    /**
+     * Converts the labels of a UTF-8 host name containing non-ASCII
+     * characters to punycode (IDNA ToASCII), e.g.\ `münchen.de` to
+     * `xn--mnchen-3ya.de`. ASCII labels are returned unchanged, as are
+     * hosts which aren't valid UTF-8. Results are memoized per host.
+     */
+    std::string ToASCII(const std::string& host);
+
+    /**
+     * Extracts the host name from a URL, returns an empty string for URLs
+     * which cannot be parsed. Internationalized hosts are converted with
+     * `ToASCII()`.
+     */
+    std::string ExtractHostFromURL(const std::string& url);
+
+    /**
+     * Returns the base domain of the host based on the public suffix list.
+     */
+    std::string GetBaseDomain(const std::string& host,
+      const PublicSuffixes& publicSuffixes);
+
+    /**
+     * Checks whether a request is third party for the given document.
+     */
+    bool IsThirdParty(const std::string& requestHost,
+      const std::string& documentHost, const PublicSuffixes& publicSuffixes);
+  }
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "BloomFilter.h"
+#include "UrlTokenizer.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const double LN2 = 0.69314718055994530942;
+
+  // The other hashes are derived from two, see Kirsch and Mitzenmacher,
+  // "Less Hashing, Same Performance".
+  void SplitHash(uint64_t hash, uint64_t& h1, uint64_t& h2)
+  {
+    h1 = hash;
+    // Another mixing step makes the second half independent enough.
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    h2 = hash | 1;
+  }
+}
+
+BloomFilter::BloomFilter(size_t expectedCount, double falsePositiveRate,
+  size_t maxSize)
+  : count(0)
+{
+  falsePositiveRate = std::min(std::max(falsePositiveRate, 1e-9), 0.5);
+  double optimalBits = -static_cast<double>(std::max<size_t>(expectedCount, 1)) *
+    std::log(falsePositiveRate) / (LN2 * LN2);
+  double maxBits = static_cast<double>(std::max<size_t>(maxSize, 8)) * 8;
+  uint64_t words = static_cast<uint64_t>(
+    std::ceil(std::min(optimalBits, maxBits) / 64));
+  bits.assign(static_cast<size_t>(std::max<uint64_t>(words, 1)), 0);
+  bitCount = static_cast<uint64_t>(bits.size()) * 64;
+  hashCount = static_cast<int>(std::floor(
+    static_cast<double>(bitCount) / std::max<size_t>(expectedCount, 1) * LN2 + 0.5));
+  hashCount = std::min(std::max(hashCount, 1), 16);
+}
+
+void BloomFilter::Add(const std::string& str)
+{
+  AddHash(UrlTokenizer::HashToken(str.data(), str.length()));
+}
+
+void BloomFilter::AddHash(uint64_t hash)
+{
+  uint64_t h1, h2;
+  SplitHash(hash, h1, h2);
+  for (int i = 0; i < hashCount; i++)
+  {
+    uint64_t bit = (h1 + i * h2) % bitCount;
+    bits[static_cast<size_t>(bit / 64)] |= 1ULL << (bit % 64);
+  }
+  count++;
+}
+
+bool BloomFilter::MayContain(const std::string& str) const
+{
+  return MayContain(str.data(), str.length());
+}
+
+bool BloomFilter::MayContain(const char* data, size_t length) const
+{
+  return MayContainHash(UrlTokenizer::HashToken(data, length));
+}
+
+bool BloomFilter::MayContainHash(uint64_t hash) const
+{
+  uint64_t h1, h2;
+  SplitHash(hash, h1, h2);
+  for (int i = 0; i < hashCount; i++)
+  {
+    uint64_t bit = (h1 + i * h2) % bitCount;
+    if (!(bits[static_cast<size_t>(bit / 64)] & (1ULL << (bit % 64))))
+      return false;
+  }
+  return true;
+}
+
+size_t BloomFilter::GetSize() const
+{
+  return bits.size() * sizeof(uint64_t);
+}
+
+double BloomFilter::GetFalsePositiveRate() const
+{
+  // (1 - e^(-kn/m))^k
+  double fill = 1 - std::exp(-static_cast<double>(hashCount) * count / bitCount);
+  return std::pow(fill, hashCount);
+}
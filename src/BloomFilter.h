@@ -0,0 +1,74 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_BLOOM_FILTER_H
+#define ADBLOCK_PLUS_BLOOM_FILTER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Probabilistic set of strings: `MayContain()` never misses a string that
+   * was added, but can report strings which weren't.
+   */
+  class BloomFilter
+  {
+  public:
+    /**
+     * Sizes the filter for the expected number of strings.
+     * @param expectedCount Number of strings that will be added.
+     * @param falsePositiveRate Targeted probability of reporting a string
+     *        that wasn't added.
+     * @param maxSize Upper bound of the memory used by the bits, in bytes.
+     *        The false positive rate is higher if the bound is reached.
+     */
+    BloomFilter(size_t expectedCount, double falsePositiveRate,
+      size_t maxSize);
+
+    void Add(const std::string& str);
+    bool MayContain(const std::string& str) const;
+    bool MayContain(const char* data, size_t length) const;
+
+    /**
+     * Same as `Add()` and `MayContain()` for strings hashed with
+     * `UrlTokenizer::HashToken()` already.
+     */
+    void AddHash(uint64_t hash);
+    bool MayContainHash(uint64_t hash) const;
+
+    /**
+     * Returns the memory used by the bits, in bytes.
+     */
+    size_t GetSize() const;
+
+    /**
+     * Estimates the false positive rate for the strings added so far.
+     */
+    double GetFalsePositiveRate() const;
+
+  private:
+    std::vector<uint64_t> bits;
+    uint64_t bitCount;
+    int hashCount;
+    size_t count;
+  };
+}
+
+#endif
@@ -0,0 +1,695 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "CompiledRuleset.h"
+#include "UrlTokenizer.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const char MAGIC[4] = {'A', 'B', 'P', 'R'};
+  const uint32_t BYTE_ORDER_MARK = 0x01020304;
+  const int BLOCKING = 0;
+  const int WHITELIST = 1;
+  const int ELEM_HIDE = 0;
+  const int ELEM_HIDE_EXCEPTION = 1;
+
+  std::string ToLowerCase(const std::string& str)
+  {
+    std::string result(str);
+    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+  }
+
+  std::string Trim(const std::string& str)
+  {
+    std::string::size_type start = str.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos)
+      return std::string();
+    return str.substr(start, str.find_last_not_of(" \t\r\n") - start + 1);
+  }
+
+  enum ElemHideType {NOT_ELEM_HIDE, ELEM_HIDE_FILTER, ELEM_HIDE_EXCEPTION_FILTER,
+    ELEM_HIDE_EMULATION_FILTER};
+
+  // Same as ElemHideBase.fromText() with
+  // /^([^\/\*\|\@"!]*?)#([@?])?#(.+)$/
+  ElemHideType ParseElemHide(const std::string& text, std::string& domains,
+    std::string& selector)
+  {
+    std::string::size_type invalid = text.find_first_of("/*|@\"!");
+    for (std::string::size_type pos = text.find('#');
+         pos != std::string::npos && pos < invalid;
+         pos = text.find('#', pos + 1))
+    {
+      ElemHideType type = ELEM_HIDE_FILTER;
+      std::string::size_type selectorStart = pos + 2;
+      if (pos + 1 < text.length() && (text[pos + 1] == '@' || text[pos + 1] == '?'))
+      {
+        type = text[pos + 1] == '@' ? ELEM_HIDE_EXCEPTION_FILTER :
+            ELEM_HIDE_EMULATION_FILTER;
+        selectorStart++;
+      }
+      if (selectorStart > text.length() || text[selectorStart - 1] != '#' ||
+          selectorStart == text.length())
+        continue;
+      domains = ToLowerCase(text.substr(0, pos));
+      selector = text.substr(selectorStart);
+      return type;
+    }
+    return NOT_ELEM_HIDE;
+  }
+
+  // Same as ActiveFilter.isActiveOnDomain() for the domains of element
+  // hiding filters, which are separated by commas.
+  bool IsActiveOnDomain(const std::string& domains, const std::string& domain)
+  {
+    if (domains.empty())
+      return true;
+
+    std::unordered_map<std::string, bool> active;
+    bool includeByDefault = true;
+    std::string::size_type start = 0;
+    while (start <= domains.length())
+    {
+      std::string::size_type end = domains.find(',', start);
+      if (end == std::string::npos)
+        end = domains.length();
+      std::string entry = domains.substr(start, end - start);
+      if (!entry.empty() && entry[0] == '~')
+        active[entry.substr(1)] = false;
+      else if (!entry.empty())
+      {
+        active[entry] = true;
+        includeByDefault = false;
+      }
+      start = end + 1;
+    }
+    if (domain.empty())
+      return includeByDefault;
+
+    std::string::size_type suffix = 0;
+    while (true)
+    {
+      auto it = active.find(domain.substr(suffix));
+      if (it != active.end())
+        return it->second;
+      std::string::size_type nextDot = domain.find('.', suffix);
+      if (nextDot == std::string::npos)
+        return includeByDefault;
+      suffix = nextDot + 1;
+    }
+  }
+
+  uint64_t GetHash(uint32_t low, uint32_t high)
+  {
+    return (static_cast<uint64_t>(high) << 32) | low;
+  }
+
+  class StringTable
+  {
+  public:
+    template<typename Ref>
+    Ref Add(const std::string& str)
+    {
+      auto it = offsets.find(str);
+      Ref ref;
+      ref.length = static_cast<uint32_t>(str.length());
+      if (it != offsets.end())
+      {
+        ref.offset = it->second;
+        return ref;
+      }
+      ref.offset = static_cast<uint32_t>(data.length());
+      offsets[str] = ref.offset;
+      data += str;
+      return ref;
+    }
+
+    const std::string& GetData() const
+    {
+      return data;
+    }
+
+  private:
+    std::string data;
+    std::unordered_map<std::string, uint32_t> offsets;
+  };
+}
+
+template<typename T>
+T CompiledRuleset::Read(const Section& section, uint32_t index) const
+{
+  // Copied, the file contents don't have to be aligned.
+  T result;
+  std::memcpy(&result, data + section.offset + index * sizeof(T), sizeof(T));
+  return result;
+}
+
+CompiledRuleset::CompileStats CompiledRuleset::Compile(
+  const std::vector<std::string>& filterTexts, std::ostream& output)
+{
+  CompileStats stats;
+  std::memset(&stats, 0, sizeof(stats));
+  StringTable strings;
+
+  // Keywords are chosen like Matcher::KeywordIndex does: the least used one,
+  // longer ones on ties.
+  std::vector<StringRef> filters;
+  std::unordered_set<std::string> knownFilters;
+  std::unordered_map<std::string, std::vector<uint32_t>> filtersByKeyword[2];
+  std::vector<std::string> keywordOrder[2];
+  std::vector<ElemHideRecord> elemHideFilters;
+  std::map<std::string, std::vector<uint32_t>> elemHideByDomain[2];
+
+  for (const auto& line : filterTexts)
+  {
+    std::string text = Trim(line);
+    if (text.empty() || text[0] == '!' || text[0] == '[' ||
+        !knownFilters.insert(text).second)
+    {
+      stats.skippedFilters++;
+      continue;
+    }
+
+    std::string domains;
+    std::string selector;
+    ElemHideType elemHideType = ParseElemHide(text, domains, selector);
+    if (elemHideType == ELEM_HIDE_EMULATION_FILTER)
+    {
+      stats.skippedFilters++;
+      continue;
+    }
+    if (elemHideType != NOT_ELEM_HIDE)
+    {
+      int list = elemHideType == ELEM_HIDE_FILTER ? ELEM_HIDE : ELEM_HIDE_EXCEPTION;
+      uint32_t id = static_cast<uint32_t>(elemHideFilters.size());
+      ElemHideRecord record;
+      record.selector = strings.Add<StringRef>(selector);
+      record.domains = strings.Add<StringRef>(domains);
+      elemHideFilters.push_back(record);
+
+      bool hasIncludedDomain = false;
+      std::string::size_type start = 0;
+      while (start < domains.length())
+      {
+        std::string::size_type end = domains.find(',', start);
+        if (end == std::string::npos)
+          end = domains.length();
+        if (end > start && domains[start] != '~')
+        {
+          elemHideByDomain[list][domains.substr(start, end - start)].push_back(id);
+          hasIncludedDomain = true;
+        }
+        start = end + 1;
+      }
+      if (!hasIncludedDomain)
+        elemHideByDomain[list][std::string()].push_back(id);
+      if (list == ELEM_HIDE)
+        stats.elemHideFilters++;
+      else
+        stats.elemHideExceptions++;
+      continue;
+    }
+
+    MatcherFilterPtr filter = MatcherFilter::FromText(text);
+    if (!filter)
+    {
+      stats.skippedFilters++;
+      continue;
+    }
+    int list = filter->IsException() ? WHITELIST : BLOCKING;
+    std::string keyword;
+    size_t keywordCount = 0xFFFFFF;
+    for (const auto& candidate : filter->GetKeywordCandidates())
+    {
+      auto it = filtersByKeyword[list].find(candidate);
+      size_t count = it != filtersByKeyword[list].end() ? it->second.size() : 0;
+      if (count < keywordCount ||
+          (count == keywordCount && candidate.length() > keyword.length()))
+      {
+        keyword = candidate;
+        keywordCount = count;
+      }
+    }
+    std::vector<uint32_t>& ids = filtersByKeyword[list][keyword];
+    if (ids.empty())
+      keywordOrder[list].push_back(keyword);
+    ids.push_back(static_cast<uint32_t>(filters.size()));
+    filters.push_back(strings.Add<StringRef>(text));
+    if (list == WHITELIST)
+      stats.whitelistFilters++;
+    else
+      stats.blockingFilters++;
+  }
+
+  std::vector<KeywordRecord> keywords[2];
+  std::vector<uint32_t> filterIds;
+  for (int list = 0; list < 2; list++)
+  {
+    for (const auto& keyword : keywordOrder[list])
+    {
+      const std::vector<uint32_t>& ids = filtersByKeyword[list][keyword];
+      uint64_t hash = UrlTokenizer::HashToken(keyword.data(), keyword.length());
+      KeywordRecord record;
+      record.hashLow = static_cast<uint32_t>(hash);
+      record.hashHigh = static_cast<uint32_t>(hash >> 32);
+      record.keyword = strings.Add<StringRef>(keyword);
+      record.firstId = static_cast<uint32_t>(filterIds.size());
+      record.idCount = static_cast<uint32_t>(ids.size());
+      filterIds.insert(filterIds.end(), ids.begin(), ids.end());
+      keywords[list].push_back(record);
+    }
+    const std::string& stringData = strings.GetData();
+    std::sort(keywords[list].begin(), keywords[list].end(),
+      [&stringData](const KeywordRecord& a, const KeywordRecord& b)
+      {
+        uint64_t hashA = GetHash(a.hashLow, a.hashHigh);
+        uint64_t hashB = GetHash(b.hashLow, b.hashHigh);
+        if (hashA != hashB)
+          return hashA < hashB;
+        return stringData.compare(a.keyword.offset, a.keyword.length,
+          stringData, b.keyword.offset, b.keyword.length) < 0;
+      });
+  }
+
+  std::vector<DomainRecord> elemHideDomains[2];
+  std::vector<uint32_t> elemHideIds;
+  for (int list = 0; list < 2; list++)
+  {
+    for (const auto& entry : elemHideByDomain[list])
+    {
+      DomainRecord record;
+      record.domain = strings.Add<StringRef>(entry.first);
+      record.firstId = static_cast<uint32_t>(elemHideIds.size());
+      record.idCount = static_cast<uint32_t>(entry.second.size());
+      elemHideIds.insert(elemHideIds.end(), entry.second.begin(), entry.second.end());
+      elemHideDomains[list].push_back(record);
+    }
+  }
+
+  // The sections follow the header in the same order, all of them have a
+  // size which is a multiple of four.
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byteOrder = BYTE_ORDER_MARK;
+  std::string body;
+  auto addSection = [&body](Section& section, const void* records,
+    size_t count, size_t recordSize)
+  {
+    section.offset = static_cast<uint32_t>(sizeof(Header) + body.length());
+    section.count = static_cast<uint32_t>(count);
+    if (count)
+      body.append(static_cast<const char*>(records), count * recordSize);
+  };
+  addSection(header.filters, filters.data(), filters.size(), sizeof(StringRef));
+  for (int list = 0; list < 2; list++)
+  {
+    addSection(header.keywords[list], keywords[list].data(),
+      keywords[list].size(), sizeof(KeywordRecord));
+  }
+  addSection(header.filterIds, filterIds.data(), filterIds.size(), sizeof(uint32_t));
+  addSection(header.elemHideFilters, elemHideFilters.data(),
+    elemHideFilters.size(), sizeof(ElemHideRecord));
+  for (int list = 0; list < 2; list++)
+  {
+    addSection(header.elemHideDomains[list], elemHideDomains[list].data(),
+      elemHideDomains[list].size(), sizeof(DomainRecord));
+  }
+  addSection(header.elemHideIds, elemHideIds.data(), elemHideIds.size(),
+    sizeof(uint32_t));
+  const std::string& stringData = strings.GetData();
+  addSection(header.strings, stringData.data(), stringData.length(), 1);
+  if (sizeof(Header) + body.length() > 0xFFFFFFFFULL)
+    throw std::runtime_error("Ruleset exceeds 4 GiB");
+  header.size = static_cast<uint32_t>(sizeof(Header) + body.length());
+
+  output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  output.write(body.data(), body.length());
+  if (!output)
+    throw std::runtime_error("Failed to write the ruleset");
+  return stats;
+}
+
+uint64_t CompiledRuleset::Publish(FileSystem& fileSystem,
+  const std::string& path, const std::vector<std::string>& filterTexts)
+{
+  uint64_t generation = GetPublishedGeneration(fileSystem, path) + 1;
+  std::ostringstream ruleset;
+  Compile(filterTexts, ruleset);
+  const std::string& rulesetData = ruleset.str();
+  fileSystem.Write(GetPublishedPath(path, generation), rulesetData.data(),
+    rulesetData.size());
+
+  std::ostringstream pointer;
+  pointer << generation << '\n';
+  const std::string& pointerData = pointer.str();
+  const std::string tempPath = path + ".tmp";
+  fileSystem.Write(tempPath, pointerData.data(), pointerData.size());
+  try
+  {
+    fileSystem.Move(tempPath, path);
+  }
+  catch (const std::exception&)
+  {
+    // Renaming onto an existing file fails on Windows.
+    fileSystem.Remove(path);
+    fileSystem.Move(tempPath, path);
+  }
+
+  if (generation > 2)
+  {
+    try
+    {
+      fileSystem.Remove(GetPublishedPath(path, generation - 2));
+    }
+    catch (const std::exception&)
+    {
+      // Still mapped by a reader on Windows, or removed already.
+    }
+  }
+  return generation;
+}
+
+uint64_t CompiledRuleset::GetPublishedGeneration(const FileSystem& fileSystem,
+  const std::string& path)
+{
+  if (!fileSystem.Stat(path).exists)
+    return 0;
+  std::shared_ptr<std::istream> pointer = fileSystem.Read(path);
+  uint64_t generation = 0;
+  if (!(*pointer >> generation) || !generation)
+    throw std::runtime_error("Invalid published ruleset " + path);
+  return generation;
+}
+
+std::string CompiledRuleset::GetPublishedPath(const std::string& path,
+  uint64_t generation)
+{
+  std::ostringstream result;
+  result << path << '.' << generation;
+  return result.str();
+}
+
+CompiledRuleset::CompiledRuleset(const FileViewPtr& file)
+  : file(file), data(file->GetData()), keywordlessContentTypes(0)
+{
+  size_t size = file->GetSize();
+  if (size < sizeof(Header))
+    throw std::runtime_error("Ruleset is truncated");
+  std::memcpy(&header, data, sizeof(Header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)))
+    throw std::runtime_error("Not a ruleset");
+  if (header.version != VERSION || header.byteOrder != BYTE_ORDER_MARK)
+    throw std::runtime_error("Unsupported ruleset version or byte order");
+  if (header.size != size)
+    throw std::runtime_error("Ruleset is truncated");
+
+  // Check all offsets once, lookups rely on them.
+  auto checkSection = [size](const Section& section, size_t recordSize)
+  {
+    if (section.offset < sizeof(Header) || section.offset > size ||
+        static_cast<uint64_t>(section.count) * recordSize > size - section.offset)
+      throw std::runtime_error("Invalid ruleset section");
+  };
+  auto checkString = [this](const StringRef& ref)
+  {
+    if (ref.offset > header.strings.count ||
+        ref.length > header.strings.count - ref.offset)
+      throw std::runtime_error("Invalid ruleset string");
+  };
+  auto checkIds = [](uint32_t firstId, uint32_t idCount, const Section& ids)
+  {
+    if (firstId > ids.count || idCount > ids.count - firstId)
+      throw std::runtime_error("Invalid ruleset ID range");
+  };
+  checkSection(header.strings, 1);
+  checkSection(header.filters, sizeof(StringRef));
+  checkSection(header.filterIds, sizeof(uint32_t));
+  checkSection(header.elemHideFilters, sizeof(ElemHideRecord));
+  checkSection(header.elemHideIds, sizeof(uint32_t));
+  for (uint32_t i = 0; i < header.filters.count; i++)
+    checkString(Read<StringRef>(header.filters, i));
+  for (uint32_t i = 0; i < header.filterIds.count; i++)
+  {
+    if (ReadId(header.filterIds, i) >= header.filters.count)
+      throw std::runtime_error("Invalid ruleset filter ID");
+  }
+  for (uint32_t i = 0; i < header.elemHideFilters.count; i++)
+  {
+    ElemHideRecord record = Read<ElemHideRecord>(header.elemHideFilters, i);
+    checkString(record.selector);
+    checkString(record.domains);
+  }
+  for (uint32_t i = 0; i < header.elemHideIds.count; i++)
+  {
+    if (ReadId(header.elemHideIds, i) >= header.elemHideFilters.count)
+      throw std::runtime_error("Invalid ruleset element hiding filter ID");
+  }
+  for (int list = 0; list < 2; list++)
+  {
+    checkSection(header.keywords[list], sizeof(KeywordRecord));
+    for (uint32_t i = 0; i < header.keywords[list].count; i++)
+    {
+      KeywordRecord record = Read<KeywordRecord>(header.keywords[list], i);
+      checkString(record.keyword);
+      checkIds(record.firstId, record.idCount, header.filterIds);
+    }
+    checkSection(header.elemHideDomains[list], sizeof(DomainRecord));
+    for (uint32_t i = 0; i < header.elemHideDomains[list].count; i++)
+    {
+      DomainRecord record = Read<DomainRecord>(header.elemHideDomains[list], i);
+      checkString(record.domain);
+      checkIds(record.firstId, record.idCount, header.elemHideIds);
+    }
+  }
+
+  parsedFilters.resize(header.filters.count);
+  for (int list = 0; list < 2; list++)
+  {
+    KeywordRecord record;
+    if (!FindKeyword(list == WHITELIST, std::string(), record))
+      continue;
+    for (uint32_t i = 0; i < record.idCount; i++)
+    {
+      MatcherFilterPtr filter = GetFilter(ReadId(header.filterIds, record.firstId + i));
+      if (filter)
+        keywordlessContentTypes |= filter->GetContentType();
+    }
+  }
+}
+
+uint32_t CompiledRuleset::ReadId(const Section& ids, uint32_t index) const
+{
+  return Read<uint32_t>(ids, index);
+}
+
+std::string CompiledRuleset::GetString(const StringRef& ref) const
+{
+  return std::string(data + header.strings.offset + ref.offset, ref.length);
+}
+
+bool CompiledRuleset::FindKeyword(bool whitelist, const std::string& keyword,
+  KeywordRecord& record) const
+{
+  const Section& section = header.keywords[whitelist ? WHITELIST : BLOCKING];
+  uint64_t hash = UrlTokenizer::HashToken(keyword.data(), keyword.length());
+  const char* strings = data + header.strings.offset;
+  uint32_t low = 0;
+  uint32_t high = section.count;
+  while (low < high)
+  {
+    uint32_t middle = low + (high - low) / 2;
+    KeywordRecord candidate = Read<KeywordRecord>(section, middle);
+    uint64_t candidateHash = GetHash(candidate.hashLow, candidate.hashHigh);
+    int comparison = candidateHash < hash ? -1 : candidateHash > hash ? 1 :
+        -keyword.compare(0, keyword.length(), strings + candidate.keyword.offset,
+          candidate.keyword.length);
+    if (comparison == 0)
+    {
+      record = candidate;
+      return true;
+    }
+    if (comparison < 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return false;
+}
+
+bool CompiledRuleset::FindDomain(int list, const std::string& domain,
+  DomainRecord& record) const
+{
+  const Section& section = header.elemHideDomains[list];
+  const char* strings = data + header.strings.offset;
+  uint32_t low = 0;
+  uint32_t high = section.count;
+  while (low < high)
+  {
+    uint32_t middle = low + (high - low) / 2;
+    DomainRecord candidate = Read<DomainRecord>(section, middle);
+    int comparison = -domain.compare(0, domain.length(),
+      strings + candidate.domain.offset, candidate.domain.length);
+    if (comparison == 0)
+    {
+      record = candidate;
+      return true;
+    }
+    if (comparison < 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return false;
+}
+
+MatcherFilterPtr CompiledRuleset::GetFilter(uint32_t id) const
+{
+  MatcherFilterPtr filter = std::atomic_load(&parsedFilters[id]);
+  if (filter)
+    return filter;
+  filter = MatcherFilter::FromText(GetString(Read<StringRef>(header.filters, id)));
+  // Keep the instance parsed first if another thread was faster, hits are
+  // counted per instance.
+  MatcherFilterPtr expected;
+  if (filter && !std::atomic_compare_exchange_strong(&parsedFilters[id],
+      &expected, filter))
+    filter = expected;
+  return filter;
+}
+
+size_t CompiledRuleset::GetFilterCount() const
+{
+  return header.filters.count;
+}
+
+MatcherFilterPtr CompiledRuleset::CheckEntryMatch(bool whitelist,
+  const std::string& keyword, const std::string& location,
+  const std::string& lowerLocation, int32_t typeMask,
+  const std::string& docDomain, bool thirdParty, const std::string& sitekey,
+  bool specificOnly) const
+{
+  KeywordRecord record;
+  if (!FindKeyword(whitelist, keyword, record))
+    return MatcherFilterPtr();
+  for (uint32_t i = 0; i < record.idCount; i++)
+  {
+    MatcherFilterPtr filter = GetFilter(ReadId(header.filterIds, record.firstId + i));
+    if (!filter)
+      continue;
+    if (specificOnly && filter->IsGeneric() && !filter->IsException())
+      continue;
+    if (filter->Matches(location, lowerLocation, typeMask, docDomain, thirdParty, sitekey))
+      return filter;
+  }
+  return MatcherFilterPtr();
+}
+
+void CompiledRuleset::GetKeywordHashes(std::vector<uint64_t>& hashes) const
+{
+  for (int list = 0; list < 2; list++)
+  {
+    for (uint32_t i = 0; i < header.keywords[list].count; i++)
+    {
+      KeywordRecord record = Read<KeywordRecord>(header.keywords[list], i);
+      if (record.keyword.length)
+        hashes.push_back(GetHash(record.hashLow, record.hashHigh));
+    }
+  }
+}
+
+int32_t CompiledRuleset::GetKeywordlessContentTypes() const
+{
+  return keywordlessContentTypes;
+}
+
+void CompiledRuleset::GetActiveElemHideFilters(int list,
+  const std::string& domain, std::vector<uint32_t>& ids) const
+{
+  // The filters without an included domain and those of the domain and its
+  // parent domains.
+  std::string::size_type suffix = 0;
+  bool generic = true;
+  while (true)
+  {
+    DomainRecord record;
+    if (FindDomain(list, generic ? std::string() : domain.substr(suffix), record))
+    {
+      for (uint32_t i = 0; i < record.idCount; i++)
+      {
+        uint32_t id = ReadId(header.elemHideIds, record.firstId + i);
+        ElemHideRecord filter = Read<ElemHideRecord>(header.elemHideFilters, id);
+        if (IsActiveOnDomain(GetString(filter.domains), domain))
+          ids.push_back(id);
+      }
+    }
+    if (generic)
+    {
+      generic = false;
+      if (domain.empty())
+        break;
+      continue;
+    }
+    std::string::size_type nextDot = domain.find('.', suffix);
+    if (nextDot == std::string::npos)
+      break;
+    suffix = nextDot + 1;
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+void CompiledRuleset::GetElementHidingSelectors(const std::string& domain,
+  std::vector<std::string>& selectors) const
+{
+  std::string host = ToLowerCase(domain);
+  std::string::size_type end = host.find_last_not_of('.');
+  host.erase(end == std::string::npos ? 0 : end + 1);
+
+  std::vector<uint32_t> ids;
+  GetActiveElemHideFilters(ELEM_HIDE, host, ids);
+  if (ids.empty())
+    return;
+  std::vector<uint32_t> exceptionIds;
+  GetActiveElemHideFilters(ELEM_HIDE_EXCEPTION, host, exceptionIds);
+  std::unordered_set<std::string> exceptions;
+  for (uint32_t id : exceptionIds)
+  {
+    exceptions.insert(GetString(
+      Read<ElemHideRecord>(header.elemHideFilters, id).selector));
+  }
+  for (uint32_t id : ids)
+  {
+    std::string selector = GetString(
+      Read<ElemHideRecord>(header.elemHideFilters, id).selector);
+    if (exceptions.find(selector) == exceptions.end())
+      selectors.push_back(selector);
+  }
+}
@@ -0,0 +1,216 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_COMPILED_RULESET_H
+#define ADBLOCK_PLUS_COMPILED_RULESET_H
+
+#include <AdblockPlus/FileSystem.h>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Matcher.h"
+
+namespace AdblockPlus
+{
+  /**
+   * Read-only set of blocking, whitelist and element hiding filters stored
+   * in a binary file which is generated offline by `abpcompile`. The file is
+   * meant to be mapped into memory, it only contains offsets so the pages
+   * can be shared between processes and nothing needs to be parsed on load.
+   * Filters are only parsed when a request checks their keyword.
+   *
+   * The file starts with a header with the magic `ABPR`, the format version
+   * and the byte order, followed by the sections listed in the header:
+   * blocking and whitelist filters indexed by keyword, element hiding
+   * filters and exceptions indexed by domain and the string data.
+   */
+  class CompiledRuleset
+  {
+  public:
+    /**
+     * Incremented on every incompatible change of the format.
+     */
+    static const uint32_t VERSION = 1;
+
+    /**
+     * Numbers of filters written by `Compile()`.
+     */
+    struct CompileStats
+    {
+      size_t blockingFilters;
+      size_t whitelistFilters;
+      size_t elemHideFilters;
+      size_t elemHideExceptions;
+      /// Comments, invalid filters and unsupported filter types.
+      size_t skippedFilters;
+    };
+
+    /**
+     * Writes the filters in the binary format, see `Open()`.
+     * @param filterTexts Normalized filter texts, e.g. the lines of a filter
+     *        list. Lines which aren't supported filters are skipped.
+     * @param output Binary stream the ruleset is written to.
+     */
+    static CompileStats Compile(const std::vector<std::string>& filterTexts,
+      std::ostream& output);
+
+    /**
+     * Loads a ruleset written by `Compile()`.
+     * @param file Contents of the file, typically mapped by
+     *        `FileSystem::ReadMapped()`. The view is kept by the ruleset.
+     * @throw std::runtime_error If the contents are not a valid ruleset of
+     *        the current version.
+     */
+    explicit CompiledRuleset(const FileViewPtr& file);
+
+    /**
+     * Compiles the filters into a new generation of a published ruleset,
+     * which other processes load with `SharedMatcher`. The ruleset is
+     * written to `GetPublishedPath()` first, then the file at `path` is
+     * replaced with the new generation number, so readers never map a
+     * partially written ruleset. The ruleset two generations back is
+     * removed, the previous one is kept for readers which didn't switch yet.
+     * @param fileSystem File system to write to.
+     * @param path Path of the file containing the current generation.
+     * @param filterTexts Filters to compile, see `Compile()`.
+     * @return Generation of the published ruleset.
+     */
+    static uint64_t Publish(FileSystem& fileSystem, const std::string& path,
+      const std::vector<std::string>& filterTexts);
+
+    /**
+     * Reads the current generation of a ruleset published by `Publish()`.
+     * @return Generation, or 0 if no ruleset was published yet.
+     * @throw std::runtime_error If the file is invalid.
+     */
+    static uint64_t GetPublishedGeneration(const FileSystem& fileSystem,
+      const std::string& path);
+
+    /**
+     * Returns the path of a generation of a published ruleset.
+     */
+    static std::string GetPublishedPath(const std::string& path,
+      uint64_t generation);
+
+    size_t GetFilterCount() const;
+
+    /**
+     * Same as `Matcher::KeywordIndex::CheckEntryMatch()`.
+     * @param whitelist Whether to check the whitelist or the blocking
+     *        filters.
+     */
+    MatcherFilterPtr CheckEntryMatch(bool whitelist, const std::string& keyword,
+      const std::string& location, const std::string& lowerLocation,
+      int32_t typeMask, const std::string& docDomain, bool thirdParty,
+      const std::string& sitekey, bool specificOnly) const;
+
+    /**
+     * Returns the hashes of all keywords, see `UrlTokenizer::HashToken()`.
+     */
+    void GetKeywordHashes(std::vector<uint64_t>& hashes) const;
+
+    /**
+     * Content types of the blocking and whitelist filters without a keyword.
+     */
+    int32_t GetKeywordlessContentTypes() const;
+
+    /**
+     * Appends the selectors of the element hiding filters active on the
+     * domain which aren't excluded by an exception, same as
+     * `ElemHide.getSelectorsForDomain()`.
+     */
+    void GetElementHidingSelectors(const std::string& domain,
+      std::vector<std::string>& selectors) const;
+
+  private:
+    struct Section
+    {
+      uint32_t offset;
+      uint32_t count;
+    };
+
+    struct Header
+    {
+      char magic[4];
+      uint32_t version;
+      uint32_t byteOrder;
+      uint32_t size;
+      Section filters;
+      Section keywords[2];
+      Section filterIds;
+      Section elemHideFilters;
+      Section elemHideDomains[2];
+      Section elemHideIds;
+      Section strings;
+    };
+
+    struct StringRef
+    {
+      uint32_t offset;
+      uint32_t length;
+    };
+
+    // Keywords are sorted by hash, then by text.
+    struct KeywordRecord
+    {
+      uint32_t hashLow;
+      uint32_t hashHigh;
+      StringRef keyword;
+      uint32_t firstId;
+      uint32_t idCount;
+    };
+
+    struct ElemHideRecord
+    {
+      StringRef selector;
+      StringRef domains;
+    };
+
+    // Domains are sorted by text, the empty domain holds the filters without
+    // an included domain.
+    struct DomainRecord
+    {
+      StringRef domain;
+      uint32_t firstId;
+      uint32_t idCount;
+    };
+
+    template<typename T>
+    T Read(const Section& section, uint32_t index) const;
+    uint32_t ReadId(const Section& ids, uint32_t index) const;
+    std::string GetString(const StringRef& ref) const;
+    bool FindKeyword(bool whitelist, const std::string& keyword,
+      KeywordRecord& record) const;
+    bool FindDomain(int list, const std::string& domain,
+      DomainRecord& record) const;
+    void GetActiveElemHideFilters(int list, const std::string& domain,
+      std::vector<uint32_t>& ids) const;
+    MatcherFilterPtr GetFilter(uint32_t id) const;
+
+    FileViewPtr file;
+    const char* data;
+    Header header;
+    // Filters are parsed on first use, see `GetFilter()`.
+    mutable std::vector<MatcherFilterPtr> parsedFilters;
+    int32_t keywordlessContentTypes;
+  };
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <AdblockPlus/ConcurrentReferrerMapping.h>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  // Same limit as ReferrerMapping::BuildReferrerChain(), in case there's a
+  // referrer loop.
+  const int MAX_CHAIN_LENGTH = 10;
+}
+
+ConcurrentReferrerMapping::Shard::Shard(int maxCachedUrls)
+  : mapping(maxCachedUrls)
+{
+}
+
+ConcurrentReferrerMapping::ConcurrentReferrerMapping(int maxCachedUrls,
+  int shardCount, int maxCachedUrlsPerScope)
+  : maxCachedUrlsPerScope(maxCachedUrlsPerScope)
+{
+  shardCount = std::max(shardCount, 1);
+  int maxCachedUrlsPerShard = std::max(maxCachedUrls / shardCount, 1);
+  for (int i = 0; i < shardCount; i++)
+    shards.push_back(std::make_shared<Shard>(maxCachedUrlsPerShard));
+}
+
+ConcurrentReferrerMapping::~ConcurrentReferrerMapping()
+{
+}
+
+const ConcurrentReferrerMapping::Shard& ConcurrentReferrerMapping::GetShard(
+  const std::string& url) const
+{
+  return *shards[std::hash<std::string>()(url) % shards.size()];
+}
+
+ConcurrentReferrerMapping::Shard& ConcurrentReferrerMapping::GetShard(
+  const std::string& url)
+{
+  return *shards[std::hash<std::string>()(url) % shards.size()];
+}
+
+ConcurrentReferrerMapping::ShardPtr ConcurrentReferrerMapping::GetScope(
+  ScopeId scope) const
+{
+  std::lock_guard<std::mutex> lock(scopesMutex);
+  std::map<ScopeId, ShardPtr>::const_iterator it = scopes.find(scope);
+  return it == scopes.end() ? ShardPtr() : it->second;
+}
+
+void ConcurrentReferrerMapping::Add(const std::string& url,
+  const std::string& referrer)
+{
+  Shard& shard = GetShard(url);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.mapping.Add(url, referrer);
+}
+
+std::vector<std::string> ConcurrentReferrerMapping::BuildReferrerChain(
+  const std::string& url) const
+{
+  // The referrers are in different shards, only one is locked at a time.
+  std::vector<std::string> referrerChain;
+  referrerChain.push_back(url);
+  std::string referrer;
+  for (int i = 0; i < MAX_CHAIN_LENGTH; i++)
+  {
+    const Shard& shard = GetShard(referrerChain.back());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.mapping.GetReferrer(referrerChain.back(), referrer))
+      break;
+    referrerChain.push_back(referrer);
+  }
+  std::reverse(referrerChain.begin(), referrerChain.end());
+  return referrerChain;
+}
+
+void ConcurrentReferrerMapping::Add(ScopeId scope, const std::string& url,
+  const std::string& referrer)
+{
+  ShardPtr shard;
+  {
+    std::lock_guard<std::mutex> lock(scopesMutex);
+    ShardPtr& scopeShard = scopes[scope];
+    if (!scopeShard)
+      scopeShard = std::make_shared<Shard>(maxCachedUrlsPerScope);
+    shard = scopeShard;
+  }
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  shard->mapping.Add(url, referrer);
+}
+
+std::vector<std::string> ConcurrentReferrerMapping::BuildReferrerChain(
+  ScopeId scope, const std::string& url) const
+{
+  ShardPtr shard = GetScope(scope);
+  if (!shard)
+    return std::vector<std::string>(1, url);
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  return shard->mapping.BuildReferrerChain(url);
+}
+
+void ConcurrentReferrerMapping::BuildReferrerChain(ScopeId scope,
+  const std::string& url, SharedUrlList& referrerChain) const
+{
+  ShardPtr shard = GetScope(scope);
+  if (!shard)
+  {
+    referrerChain.assign(1, std::make_shared<const std::string>(url));
+    return;
+  }
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  shard->mapping.BuildReferrerChain(url, referrerChain);
+}
+
+void ConcurrentReferrerMapping::RemoveScope(ScopeId scope)
+{
+  // The mappings are released after unlocking.
+  ShardPtr shard;
+  std::lock_guard<std::mutex> lock(scopesMutex);
+  std::map<ScopeId, ShardPtr>::iterator it = scopes.find(scope);
+  if (it == scopes.end())
+    return;
+  shard = it->second;
+  scopes.erase(it);
+}
@@ -29,6 +29,9 @@ namespace
       const v8::Arguments& arguments)
   {
     AdblockPlus::JsEnginePtr jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
+    AdblockPlus::LogSystemPtr callback = jsEngine->GetLogSystem();
+    if (!callback->IsEnabled(logLevel))
+      return v8::Undefined();
     const AdblockPlus::JsContext context(*jsEngine);
     AdblockPlus::JsValueList converted = jsEngine->ConvertArguments(arguments);
 
@@ -45,7 +48,6 @@ namespace
     source << AdblockPlus::Utils::FromV8String(frame->GetScriptName());
     source << ":" << frame->GetLineNumber();
 
-    AdblockPlus::LogSystemPtr callback = jsEngine->GetLogSystem();
     (*callback)(logLevel, message.str(), source.str());
     return v8::Undefined();
   }
@@ -78,8 +80,10 @@ namespace
   v8::Handle<v8::Value> TraceCallback(const v8::Arguments& arguments)
   {
     AdblockPlus::JsEnginePtr jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
+    AdblockPlus::LogSystemPtr callback = jsEngine->GetLogSystem();
+    if (!callback->IsEnabled(AdblockPlus::LogSystem::LOG_LEVEL_TRACE))
+      return v8::Undefined();
     const AdblockPlus::JsContext context(*jsEngine);
-    AdblockPlus::JsValueList converted = jsEngine->ConvertArguments(arguments);
 
     std::stringstream traceback;
     v8::Local<v8::StackTrace> frames = v8::StackTrace::CurrentStackTrace(100);
@@ -98,7 +102,6 @@ namespace
       traceback << std::endl;
     }
 
-    AdblockPlus::LogSystemPtr callback = jsEngine->GetLogSystem();
     (*callback)(AdblockPlus::LogSystem::LOG_LEVEL_TRACE, traceback.str(), "");
     return v8::Undefined();
   }
@@ -0,0 +1,97 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cctype>
+#include <cstring>
+
+#include "ContentTypes.h"
+
+using namespace AdblockPlus;
+
+// Keep in sync with RegExpFilter.typeMap from filterClasses.js and with
+// FilterEngine::ContentType, the GENERICHIDE value doesn't fit into int32_t.
+const ContentTypes::Entry ContentTypes::table[] = {
+  {"OTHER", 1, true},
+  {"SCRIPT", 2, true},
+  {"IMAGE", 4, true},
+  {"STYLESHEET", 8, true},
+  {"OBJECT", 16, true},
+  {"SUBDOCUMENT", 32, true},
+  {"DOCUMENT", 64, true},
+  {"WEBSOCKET", 128, false},
+  {"WEBRTC", 256, false},
+  {"PING", 1024, true},
+  {"XMLHTTPREQUEST", 2048, true},
+  {"OBJECT_SUBREQUEST", 4096, true},
+  {"MEDIA", 16384, true},
+  {"FONT", 32768, true},
+  {"BACKGROUND", 4, false},
+  {"XBL", 1, false},
+  {"DTD", 1, false},
+  {"POPUP", 0x10000000, false},
+  {"GENERICBLOCK", 0x20000000, true},
+  {"ELEMHIDE", 0x40000000, true},
+  {"GENERICHIDE", static_cast<int32_t>(0x80000000), true}
+};
+
+const size_t ContentTypes::tableSize = sizeof(table) / sizeof(table[0]);
+
+const int32_t ContentTypes::defaultMask = 0x7FFFFFFF & ~(64 | 0x40000000 |
+  0x10000000 | 0x20000000);
+
+bool ContentTypes::Lookup(const std::string& name, int32_t& value)
+{
+  for (size_t i = 0; i < tableSize; i++)
+  {
+    if (name == table[i].name)
+    {
+      value = table[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ContentTypes::LookupPublic(const std::string& name, int32_t& value)
+{
+  for (size_t i = 0; i < tableSize; i++)
+  {
+    const char* entryName = table[i].name;
+    if (!table[i].isPublic || std::strlen(entryName) != name.length())
+      continue;
+    size_t j = 0;
+    while (j < name.length() &&
+        std::toupper(static_cast<unsigned char>(name[j])) == entryName[j])
+      j++;
+    if (j == name.length())
+    {
+      value = table[i].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* ContentTypes::GetPublicName(int32_t value)
+{
+  for (size_t i = 0; i < tableSize; i++)
+  {
+    if (table[i].isPublic && table[i].value == value)
+      return table[i].name;
+  }
+  return nullptr;
+}
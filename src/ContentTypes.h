@@ -0,0 +1,72 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_CONTENT_TYPES_H
+#define ADBLOCK_PLUS_CONTENT_TYPES_H
+
+#include <stdint.h>
+#include <string>
+
+namespace AdblockPlus
+{
+  namespace ContentTypes
+  {
+    struct Entry
+    {
+      /// Upper-case name as used by filter options, with `_` for `-`.
+      const char* name;
+      int32_t value;
+      /// Whether the value is a `FilterEngine::ContentType`, the first entry
+      /// with a value is its canonical name.
+      bool isPublic;
+    };
+
+    /**
+     * All content types of RegExpFilter.typeMap from filterClasses.js,
+     * including aliases. The table is constant-initialized, so it is usable
+     * during static initialization and needs no lookup structure.
+     */
+    extern const Entry table[];
+    extern const size_t tableSize;
+
+    /**
+     * Default content type mask of a filter without type options, mirrors
+     * RegExpFilter.prototype.contentType.
+     */
+    extern const int32_t defaultMask;
+
+    /**
+     * Looks up a content type by the name used in filter options.
+     * @return `true` if the name is known.
+     */
+    bool Lookup(const std::string& name, int32_t& value);
+
+    /**
+     * Looks up a `FilterEngine::ContentType` by its name, ignoring case.
+     * @return `true` if the name is one of a public content type.
+     */
+    bool LookupPublic(const std::string& name, int32_t& value);
+
+    /**
+     * Returns the canonical name of a `FilterEngine::ContentType`.
+     * @return Name or `nullptr` if the value isn't a public content type.
+     */
+    const char* GetPublicName(int32_t value);
+  }
+}
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/DefaultFileSystem.h>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  // Runs an operation, returns the error message if it fails.
+  template<typename Operation>
+  std::string Perform(const Operation& operation, const std::string& unknownError)
+  {
+    try
+    {
+      operation();
+    }
+    catch (std::exception& e)
+    {
+      return e.what();
+    }
+    catch (...)
+    {
+      return unknownError;
+    }
+    return std::string();
+  }
+}
+
+DefaultAsyncFileSystem::DefaultAsyncFileSystem(const FileSystemPtr& syncImpl,
+  const std::shared_ptr<IExecutor>& executor)
+  : syncImpl(syncImpl), executor(executor)
+{
+  if (!syncImpl)
+    throw std::runtime_error("FileSystem cannot be null");
+  if (!executor)
+    throw std::runtime_error("Executor cannot be null");
+}
+
+void DefaultAsyncFileSystem::Read(const std::string& path,
+  const ReadCallback& callback)
+{
+  auto syncImplCapture = syncImpl;
+  executor->Dispatch([syncImplCapture, path, callback]
+  {
+    IoBuffer data;
+    std::string error = Perform([&]
+    {
+      FileViewPtr file = syncImplCapture->ReadMapped(path);
+      const uint8_t* begin = reinterpret_cast<const uint8_t*>(file->GetData());
+      data.assign(begin, begin + file->GetSize());
+    }, "Unknown error while reading from " + path);
+    callback(std::move(data), error);
+  }, path);
+}
+
+void DefaultAsyncFileSystem::ReadRange(const std::string& path,
+  uint64_t offset, size_t size, const ReadCallback& callback)
+{
+  auto syncImplCapture = syncImpl;
+  executor->Dispatch([syncImplCapture, path, offset, size, callback]
+  {
+    IoBuffer data;
+    std::string error = Perform([&]
+    {
+      // Only the requested range of the file is copied from the view.
+      FileViewPtr file = syncImplCapture->ReadMapped(path);
+      if (offset < file->GetSize())
+      {
+        size_t available = file->GetSize() - static_cast<size_t>(offset);
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(file->GetData()) +
+          static_cast<size_t>(offset);
+        data.assign(begin, begin + std::min(size, available));
+      }
+    }, "Unknown error while reading from " + path);
+    callback(std::move(data), error);
+  }, path);
+}
+
+void DefaultAsyncFileSystem::Write(const std::string& path,
+  IoBuffer&& data, const Callback& callback)
+{
+  auto syncImplCapture = syncImpl;
+  // Lambdas cannot capture by move, the buffer is shared instead of copied.
+  auto dataCapture = std::make_shared<IoBuffer>(std::move(data));
+  executor->Dispatch([syncImplCapture, path, dataCapture, callback]
+  {
+    callback(Perform([&]
+    {
+      syncImplCapture->Write(path,
+        reinterpret_cast<const char*>(dataCapture->data()), dataCapture->size());
+    }, "Unknown error while writing to " + path));
+  }, path);
+}
+
+void DefaultAsyncFileSystem::Move(const std::string& fromPath,
+  const std::string& toPath, const Callback& callback)
+{
+  auto syncImplCapture = syncImpl;
+  executor->Dispatch([syncImplCapture, fromPath, toPath, callback]
+  {
+    callback(Perform([&]
+    {
+      syncImplCapture->Move(fromPath, toPath);
+    }, "Unknown error while moving " + fromPath + " to " + toPath));
+  }, fromPath);
+}
+
+void DefaultAsyncFileSystem::Copy(const std::string& fromPath,
+  const std::string& toPath, const Callback& callback)
+{
+  auto syncImplCapture = syncImpl;
+  executor->Dispatch([syncImplCapture, fromPath, toPath, callback]
+  {
+    callback(Perform([&]
+    {
+      syncImplCapture->Copy(fromPath, toPath);
+    }, "Unknown error while copying " + fromPath + " to " + toPath));
+  }, fromPath);
+}
+
+void DefaultAsyncFileSystem::Remove(const std::string& path,
+  const Callback& callback)
+{
+  auto syncImplCapture = syncImpl;
+  executor->Dispatch([syncImplCapture, path, callback]
+  {
+    callback(Perform([&]
+    {
+      syncImplCapture->Remove(path);
+    }, "Unknown error while removing " + path));
+  }, path);
+}
+
+void DefaultAsyncFileSystem::Stat(const std::string& path,
+  const StatCallback& callback)
+{
+  auto syncImplCapture = syncImpl;
+  executor->Dispatch([syncImplCapture, path, callback]
+  {
+    StatResult result;
+    std::string error = Perform([&]
+    {
+      result = syncImplCapture->Stat(path);
+    }, "Unknown error while calling stat on " + path);
+    callback(result, error);
+  }, path);
+}
+
+std::string DefaultAsyncFileSystem::Resolve(const std::string& path) const
+{
+  return syncImpl->Resolve(path);
+}
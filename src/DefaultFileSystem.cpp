@@ -28,11 +28,18 @@
 #include <Shlobj.h>
 #include <Shlwapi.h>
 #else
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 #endif
 
-#include "../src/Utils.h"
+#include "../src/StringUtils.h"
 
 using namespace AdblockPlus;
 
@@ -47,6 +54,41 @@ namespace
     }
   };
 
+  // Unmaps the file when destroyed, empty files aren't mapped.
+  class MappedFileView : public FileView
+  {
+  public:
+    MappedFileView(const void* data, size_t size)
+      : data(data), size(size)
+    {
+    }
+
+    ~MappedFileView()
+    {
+      if (!data)
+        return;
+#ifdef _WIN32
+      UnmapViewOfFile(data);
+#else
+      munmap(const_cast<void*>(data), size);
+#endif
+    }
+
+    const char* GetData() const
+    {
+      return data ? static_cast<const char*>(data) : "";
+    }
+
+    size_t GetSize() const
+    {
+      return size;
+    }
+
+  private:
+    const void* data;
+    size_t size;
+  };
+
 #ifdef WIN32
   // Paths need to be converted from UTF-8 to UTF-16 on Windows.
   std::wstring NormalizePath(const std::string& path)
@@ -75,11 +117,76 @@ DefaultFileSystem::Read(const std::string& path) const
   return result;
 }
 
+FileViewPtr DefaultFileSystem::ReadMapped(const std::string& path) const
+{
+#ifdef _WIN32
+  HANDLE file = CreateFileW(NormalizePath(path).c_str(), GENERIC_READ,
+    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Failed to open " + path);
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size))
+  {
+    CloseHandle(file);
+    throw std::runtime_error("Failed to get the size of " + path);
+  }
+  if (!size.QuadPart)
+  {
+    CloseHandle(file);
+    return FileViewPtr(new MappedFileView(nullptr, 0));
+  }
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (!mapping)
+    throw std::runtime_error("Failed to map " + path);
+  const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!data)
+    throw std::runtime_error("Failed to map " + path);
+  return FileViewPtr(new MappedFileView(data, static_cast<size_t>(size.QuadPart)));
+#else
+  int file = open(NormalizePath(path).c_str(), O_RDONLY);
+  if (file < 0)
+    throw RuntimeErrorWithErrno("Failed to open " + path);
+  struct stat nativeStat;
+  if (fstat(file, &nativeStat))
+  {
+    RuntimeErrorWithErrno error("Failed to get the size of " + path);
+    close(file);
+    throw error;
+  }
+  size_t size = static_cast<size_t>(nativeStat.st_size);
+  if (!size)
+  {
+    close(file);
+    return FileViewPtr(new MappedFileView(nullptr, 0));
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+  if (data == MAP_FAILED)
+  {
+    RuntimeErrorWithErrno error("Failed to map " + path);
+    close(file);
+    throw error;
+  }
+  // The mapping stays valid after closing the file.
+  close(file);
+  return FileViewPtr(new MappedFileView(data, size));
+#endif
+}
+
 void DefaultFileSystem::Write(const std::string& path,
                               std::istream& data)
 {
   std::ofstream file(NormalizePath(path).c_str(), std::ios_base::out | std::ios_base::binary);
-  file << Utils::Slurp(data);
+  file << data.rdbuf();
+}
+
+void DefaultFileSystem::Write(const std::string& path,
+                              const char* data, size_t size)
+{
+  std::ofstream file(NormalizePath(path).c_str(), std::ios_base::out | std::ios_base::binary);
+  file.write(data, size);
 }
 
 void DefaultFileSystem::Move(const std::string& fromPath,
@@ -89,6 +196,70 @@ void DefaultFileSystem::Move(const std::string& fromPath,
     throw RuntimeErrorWithErrno("Failed to move " + fromPath + " to " + toPath);
 }
 
+void DefaultFileSystem::Copy(const std::string& fromPath,
+                             const std::string& toPath)
+{
+#ifdef _WIN32
+  if (!CopyFileW(NormalizePath(fromPath).c_str(), NormalizePath(toPath).c_str(), FALSE))
+    throw std::runtime_error("Failed to copy " + fromPath + " to " + toPath);
+#else
+  int source = open(NormalizePath(fromPath).c_str(), O_RDONLY);
+  if (source < 0)
+    throw RuntimeErrorWithErrno("Failed to open " + fromPath);
+  int target = open(NormalizePath(toPath).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (target < 0)
+  {
+    RuntimeErrorWithErrno error("Failed to open " + toPath);
+    close(source);
+    throw error;
+  }
+#ifdef FICLONE
+  // The copy shares the data blocks with the original if the file system
+  // supports it. A hard link is no option, Write() modifies files in place
+  // and would change the copy as well.
+  if (!ioctl(target, FICLONE, source))
+  {
+    close(source);
+    close(target);
+    return;
+  }
+#endif
+  char buffer[64 * 1024];
+  std::string error;
+  while (error.empty())
+  {
+    ssize_t size = read(source, buffer, sizeof(buffer));
+    if (size < 0 && errno == EINTR)
+      continue;
+    if (size < 0)
+      error = "Failed to read " + fromPath;
+    if (size <= 0)
+      break;
+    for (const char* data = buffer; size > 0 && error.empty();)
+    {
+      ssize_t written = write(target, data, size);
+      if (written < 0 && errno != EINTR)
+        error = "Failed to write to " + toPath;
+      if (written > 0)
+      {
+        data += written;
+        size -= written;
+      }
+    }
+  }
+  if (!error.empty())
+  {
+    RuntimeErrorWithErrno runtimeError(error);
+    close(source);
+    close(target);
+    throw runtimeError;
+  }
+  close(source);
+  if (close(target))
+    throw RuntimeErrorWithErrno("Failed to write to " + toPath);
+#endif
+}
+
 void DefaultFileSystem::Remove(const std::string& path)
 {
   if (remove(NormalizePath(path).c_str()))
@@ -15,77 +15,195 @@
 * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include "DefaultTimer.h"
 
 using AdblockPlus::DefaultTimer;
 
-DefaultTimer::DefaultTimer()
-  : shouldThreadStop(false)
+namespace
 {
-  m_thread = std::thread([this]
-  {
-    ThreadFunc();
-  });
+  typedef std::chrono::steady_clock Clock;
 }
 
-DefaultTimer::~DefaultTimer()
+/// Thread firing the timers of all `DefaultTimer` instances, it exists as
+/// long as any instance does.
+class DefaultTimer::Service
 {
+public:
+  static std::shared_ptr<Service> Get()
   {
-    std::lock_guard<std::mutex> lock(mutex);
-    shouldThreadStop = true;
+    static std::mutex instanceMutex;
+    static std::weak_ptr<Service> instance;
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    std::shared_ptr<Service> result = instance.lock();
+    if (!result)
+    {
+      result = std::make_shared<Service>();
+      instance = result;
+    }
+    return result;
   }
-  conditionVariable.notify_one();
-  if (m_thread.joinable())
-    m_thread.join();
-}
 
-void DefaultTimer::SetTimer(const std::chrono::milliseconds& timeout, const TimerCallback& timerCallback)
-{
-  if (!timerCallback)
-    return;
+  Service()
+    : state(std::make_shared<State>())
   {
-    std::lock_guard<std::mutex> lock(mutex);
-    TimerUnit timer = { std::chrono::steady_clock::now() + timeout, timerCallback };
-    timers.push(timer);
+    StatePtr threadState = state;
+    thread = std::thread([threadState]
+    {
+      ThreadFunc(threadState);
+    });
   }
-  conditionVariable.notify_one();
-}
 
-void DefaultTimer::ThreadFunc()
-{
-  while (true)
+  ~Service()
   {
-    std::unique_lock<std::mutex> lock(mutex);
-    if (timers.empty())
     {
-      conditionVariable.wait(lock, [this]()->bool
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->shouldThreadStop = true;
+    }
+    state->conditionVariable.notify_all();
+    // The last instance might be destroyed by one of the callbacks.
+    if (thread.get_id() == std::this_thread::get_id())
+      thread.detach();
+    else if (thread.joinable())
+      thread.join();
+  }
+
+  void Add(const DefaultTimer* owner, const Clock::time_point& fireAt,
+    const Clock::time_point& deadline, const TimerCallback& callback)
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    TimerUnit timer = {owner, fireAt, deadline, callback};
+    state->timers.push_back(timer);
+    state->conditionVariable.notify_all();
+  }
+
+  void Remove(const DefaultTimer* owner)
+  {
+    Timers discardedTimers;
+    std::unique_lock<std::mutex> lock(state->mutex);
+    for (auto it = state->timers.begin(); it != state->timers.end();)
+    {
+      if (it->owner == owner)
+      {
+        discardedTimers.push_back(std::move(*it));
+        it = state->timers.erase(it);
+      }
+      else
+        ++it;
+    }
+    if (thread.get_id() != std::this_thread::get_id())
+    {
+      state->conditionVariable.wait(lock, [this, owner]()->bool
       {
-        return shouldThreadStop || !timers.empty();
+        return state->runningOwner != owner;
       });
     }
-    else
+    // The callbacks are released after unlocking.
+    lock.unlock();
+  }
+
+private:
+  Service(const Service&);
+  Service& operator=(const Service&);
+
+  struct TimerUnit
+  {
+    const DefaultTimer* owner;
+    Clock::time_point fireAt;
+    /// Latest time to fire the timer, `fireAt` plus the slack.
+    Clock::time_point deadline;
+    TimerCallback callback;
+  };
+  typedef std::vector<TimerUnit> Timers;
+
+  struct State
+  {
+    State()
+      : runningOwner(nullptr), shouldThreadStop(false)
     {
-      auto fireAt = timers.top().fireAt;
-      conditionVariable.wait_until(lock, fireAt);
     }
-    // execute all expired timers and remove them
-    while (!shouldThreadStop && !timers.empty() && timers.top().fireAt <= std::chrono::steady_clock::now())
+
+    std::mutex mutex;
+    std::condition_variable conditionVariable;
+    Timers timers;
+    const DefaultTimer* runningOwner;
+    bool shouldThreadStop;
+  };
+  typedef std::shared_ptr<State> StatePtr;
+
+  static void ThreadFunc(const StatePtr& state)
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (!state->shouldThreadStop)
     {
-      auto callback = timers.top().callback;
-      timers.pop();
-      // allow to put new timers while this timer is being processed
-      lock.unlock();
-      try
+      if (state->timers.empty())
+      {
+        state->conditionVariable.wait(lock);
+        continue;
+      }
+      auto wakeAt = state->timers.front().deadline;
+      for (const auto& timer : state->timers)
+        wakeAt = std::min(wakeAt, timer.deadline);
+      if (Clock::now() < wakeAt)
       {
-        callback();
+        // Woken up early if a timer is added or removed.
+        state->conditionVariable.wait_until(lock, wakeAt);
+        continue;
       }
-      catch (...)
+
+      // Fire all timers which are due, not only the ones which reached
+      // their deadline, in the order they are due. They stay in the list
+      // until they fire, so that the timers of an instance destroyed in
+      // the meantime are discarded.
+      auto now = Clock::now();
+      while (!state->shouldThreadStop)
       {
-        // do nothing, but the thread will be alive.
+        auto due = state->timers.end();
+        for (auto it = state->timers.begin(); it != state->timers.end(); ++it)
+        {
+          if (it->fireAt <= now && (due == state->timers.end() || it->fireAt < due->fireAt))
+            due = it;
+        }
+        if (due == state->timers.end())
+          break;
+        TimerCallback callback = std::move(due->callback);
+        state->runningOwner = due->owner;
+        state->timers.erase(due);
+        lock.unlock();
+        try
+        {
+          callback();
+        }
+        catch (...)
+        {
+          // do nothing, but the thread will be alive.
+        }
+        callback = TimerCallback();
+        lock.lock();
+        state->runningOwner = nullptr;
+        state->conditionVariable.notify_all();
       }
-      lock.lock();
     }
-    if (shouldThreadStop)
-      return;
   }
+
+  StatePtr state;
+  std::thread thread;
+};
+
+DefaultTimer::DefaultTimer(const std::chrono::milliseconds& slack)
+  : service(Service::Get()), slack(slack)
+{
+}
+
+DefaultTimer::~DefaultTimer()
+{
+  service->Remove(this);
+}
+
+void DefaultTimer::SetTimer(const std::chrono::milliseconds& timeout, const TimerCallback& timerCallback)
+{
+  if (!timerCallback)
+    return;
+  auto fireAt = Clock::now() + timeout;
+  service->Add(this, fireAt, fireAt + slack, timerCallback);
 }
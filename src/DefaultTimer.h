@@ -21,40 +21,39 @@
 #include <AdblockPlus/ITimer.h>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
 #include <thread>
+#include <vector>
 
 namespace AdblockPlus
 {
+  /**
+   * Timer running the callbacks on a thread shared by all instances which
+   * exist at the same time. Timers of all instances due within the slack
+   * of each other are fired together to save wakeups.
+   */
   class DefaultTimer : public ITimer
   {
-    struct TimerUnit
-    {
-      std::chrono::steady_clock::time_point fireAt;
-      TimerCallback callback;
-    };
-    struct TimerUnitComparator
-    {
-      bool operator()(const TimerUnit& t1, const TimerUnit& t2) const
-      {
-        // pay attention 2 < 1 because we need the smallest time at the top.
-        return t2.fireAt < t1.fireAt;
-      }
-    };
-    typedef std::priority_queue<TimerUnit, std::vector<TimerUnit>, TimerUnitComparator> TimerUnits;
   public:
-    DefaultTimer();
+    /**
+     * @param slack Time by which the callbacks of this instance may be
+     *        delayed to fire them together with other timers.
+     */
+    explicit DefaultTimer(const std::chrono::milliseconds& slack = std::chrono::milliseconds::zero());
+
+    /**
+     * Discards the pending timers of this instance, waiting for a running
+     * callback of it to return unless called from that callback.
+     */
     ~DefaultTimer();
     void SetTimer(const std::chrono::milliseconds& timeout, const TimerCallback& timerCallback) override;
   private:
-    void ThreadFunc();
-  private:
-    std::mutex mutex;
-    std::condition_variable conditionVariable;
-    TimerUnits timers;
-    bool shouldThreadStop;
-    std::thread m_thread;
+    DefaultTimer(const DefaultTimer&);
+    DefaultTimer& operator=(const DefaultTimer&);
+
+    class Service;
+    std::shared_ptr<Service> service;
+    std::chrono::milliseconds slack;
   };
 }
 
-#endif
\ No newline at end of file
+#endif
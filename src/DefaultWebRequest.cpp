@@ -15,27 +15,214 @@
 * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
 #include <AdblockPlus/DefaultWebRequest.h>
-#include <thread>
+#include "WorkQueue.h"
 
 using namespace AdblockPlus;
 
-DefaultWebRequest::DefaultWebRequest(const WebRequestSharedPtr& syncImpl)
-  : syncImpl(syncImpl)
+namespace
 {
+  std::string GetHost(const std::string& url)
+  {
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    size_t end = url.find_first_of("/?#", start);
+    std::string host = url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    size_t userInfoEnd = host.rfind('@');
+    if (userInfoEnd != std::string::npos)
+      host.erase(0, userInfoEnd + 1);
+    std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+    return host;
+  }
+
+  // A throwing callback must neither affect the other requesters nor keep
+  // the slot of the host.
+  template<typename Callback, typename... Args>
+  void Notify(const Callback& callback, const Args&... args)
+  {
+    try
+    {
+      callback(args...);
+    }
+    catch (...)
+    {
+    }
+  }
 
+  std::string GetRequestKey(const std::string& url, const HeaderList& requestHeaders)
+  {
+    std::string key = url;
+    for (const auto& header : requestHeaders)
+      key += '\n' + header.first + ": " + header.second;
+    return key;
+  }
 }
 
-DefaultWebRequest::~DefaultWebRequest()
+struct DefaultWebRequest::Request
+{
+  struct Callbacks
+  {
+    // Empty if the response text is expected in the response.
+    DataCallback dataCallback;
+    GetCallback getCallback;
+  };
+
+  std::string key;
+  std::string host;
+  std::string url;
+  HeaderList requestHeaders;
+  std::vector<Callbacks> callbacks;
+};
+
+struct DefaultWebRequest::State
+{
+  State(const WebRequestSharedPtr& syncImpl, size_t maxRequestsPerHost)
+    : syncImpl(syncImpl), maxRequestsPerHost(maxRequestsPerHost), workQueue(nullptr)
+  {
+  }
+
+  WebRequestSharedPtr syncImpl;
+  size_t maxRequestsPerHost;
+  std::mutex mutex;
+  /// Requests which didn't start yet, by key.
+  std::map<std::string, RequestPtr> joinableRequests;
+  /// Requests waiting for a request to the same host to finish.
+  std::map<std::string, std::deque<RequestPtr>> waitingRequests;
+  /// Number of posted requests by host.
+  std::map<std::string, size_t> activeRequests;
+  /// Reset on destruction of the `DefaultWebRequest`.
+  WorkQueue* workQueue;
+};
+
+DefaultWebRequest::DefaultWebRequest(const WebRequestSharedPtr& syncImpl,
+  size_t maxConcurrentRequests, size_t maxRequestsPerHost)
+  : state(std::make_shared<State>(syncImpl, std::max<size_t>(maxRequestsPerHost, 1)))
+  , workQueue(new WorkQueue(maxConcurrentRequests))
 {
+  state->workQueue = workQueue.get();
+}
 
+DefaultWebRequest::~DefaultWebRequest()
+{
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->workQueue = nullptr;
 }
 
 void DefaultWebRequest::GET(const std::string& url, const HeaderList& requestHeaders, const GetCallback& getCallback)
 {
-  auto syncImplCapture = syncImpl;
-  std::thread([syncImplCapture, url, requestHeaders, getCallback]
+  GET(url, requestHeaders, DataCallback(), getCallback);
+}
+
+void DefaultWebRequest::GET(const std::string& url, const HeaderList& requestHeaders,
+  const DataCallback& dataCallback, const GetCallback& getCallback)
+{
+  Request::Callbacks callbacks = {dataCallback, getCallback};
+  std::string key = GetRequestKey(url, requestHeaders);
+  std::lock_guard<std::mutex> lock(state->mutex);
+  auto it = state->joinableRequests.find(key);
+  if (it != state->joinableRequests.end())
   {
-    getCallback(syncImplCapture->GET(url, requestHeaders));
-  }).detach();
-}
\ No newline at end of file
+    it->second->callbacks.push_back(callbacks);
+    return;
+  }
+
+  RequestPtr request = std::make_shared<Request>();
+  request->key = key;
+  request->host = GetHost(url);
+  request->url = url;
+  request->requestHeaders = requestHeaders;
+  request->callbacks.push_back(callbacks);
+  state->joinableRequests[key] = request;
+
+  size_t& activeRequests = state->activeRequests[request->host];
+  if (activeRequests < state->maxRequestsPerHost)
+  {
+    activeRequests++;
+    Start(state, request);
+  }
+  else
+    state->waitingRequests[request->host].push_back(request);
+}
+
+void DefaultWebRequest::Start(const StatePtr& state, const RequestPtr& request)
+{
+  // Called with the state mutex locked.
+  if (!state->workQueue)
+    return;
+  state->workQueue->Post([state, request]
+  {
+    Perform(state, request);
+  });
+}
+
+void DefaultWebRequest::Perform(const StatePtr& state, const RequestPtr& request)
+{
+  std::vector<Request::Callbacks> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->joinableRequests.erase(request->key);
+    callbacks.swap(request->callbacks);
+  }
+
+  bool collectText = false;
+  for (const auto& item : callbacks)
+  {
+    if (!item.dataCallback)
+      collectText = true;
+  }
+  std::string responseText;
+  ServerResponse response;
+  try
+  {
+    response = state->syncImpl->GET(request->url, request->requestHeaders,
+      [&callbacks, collectText, &responseText](const char* data, size_t size)
+      {
+        for (const auto& item : callbacks)
+        {
+          if (item.dataCallback)
+            Notify(item.dataCallback, data, size);
+        }
+        if (collectText)
+          responseText.append(data, size);
+      });
+  }
+  catch (...)
+  {
+    response = ServerResponse();
+    response.status = NS_ERROR_FAILURE;
+    responseText.clear();
+  }
+  for (const auto& item : callbacks)
+  {
+    if (item.dataCallback)
+      Notify(item.getCallback, response);
+  }
+  if (collectText)
+  {
+    response.responseText = std::move(responseText);
+    for (const auto& item : callbacks)
+    {
+      if (!item.dataCallback)
+        Notify(item.getCallback, response);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(state->mutex);
+  auto waiting = state->waitingRequests.find(request->host);
+  if (waiting != state->waitingRequests.end())
+  {
+    RequestPtr next = waiting->second.front();
+    waiting->second.pop_front();
+    if (waiting->second.empty())
+      state->waitingRequests.erase(waiting);
+    Start(state, next);
+  }
+  else if (!--state->activeRequests[request->host])
+    state->activeRequests.erase(request->host);
+}
@@ -18,6 +18,7 @@
 #include <sstream>
 #include <cctype>
 #include <algorithm>
+#include <mutex>
 #include <curl/curl.h>
 #include <AdblockPlus/DefaultWebRequest.h>
 
@@ -36,6 +37,55 @@ namespace
     }
   };
 
+  // Cache of DNS results, TLS sessions and connections shared by all
+  // requests, so consecutive requests to the same host reuse the connection.
+  class SharedCache
+  {
+  public:
+    static CURLSH* Get()
+    {
+      static SharedCache instance;
+      return instance.share;
+    }
+
+  private:
+    SharedCache()
+    {
+      curl_global_init(CURL_GLOBAL_DEFAULT);
+      share = curl_share_init();
+      if (!share)
+        return;
+      curl_share_setopt(share, CURLSHOPT_LOCKFUNC, Lock);
+      curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, Unlock);
+      curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    }
+
+    ~SharedCache()
+    {
+      if (share)
+        curl_share_cleanup(share);
+    }
+
+    static void Lock(CURL* handle, curl_lock_data data,
+      curl_lock_access access, void* userData)
+    {
+      static_cast<SharedCache*>(userData)->mutexes[data].lock();
+    }
+
+    static void Unlock(CURL* handle, curl_lock_data data, void* userData)
+    {
+      static_cast<SharedCache*>(userData)->mutexes[data].unlock();
+    }
+
+    CURLSH* share;
+    std::mutex mutexes[CURL_LOCK_DATA_LAST];
+  };
+
   unsigned int ConvertErrorCode(CURLcode code)
   {
     switch (code)
@@ -71,10 +121,55 @@ namespace
     }
   }
 
+  int64_t GetPhaseMicroseconds(CURL* curl, CURLINFO info)
+  {
+    // The times are in seconds since the start of the transfer.
+    double seconds = 0;
+    if (curl_easy_getinfo(curl, info, &seconds) != CURLE_OK || seconds < 0)
+      return -1;
+    return static_cast<int64_t>(seconds * 1000000);
+  }
+
+  void ReadTransferInfo(CURL* curl, AdblockPlus::ServerResponse& result)
+  {
+    result.timing.dnsLookup = GetPhaseMicroseconds(curl, CURLINFO_NAMELOOKUP_TIME);
+    result.timing.connect = GetPhaseMicroseconds(curl, CURLINFO_CONNECT_TIME);
+    result.timing.tlsHandshake = GetPhaseMicroseconds(curl, CURLINFO_APPCONNECT_TIME);
+    // Zero unless a TLS handshake took place.
+    if (result.timing.tlsHandshake == 0)
+      result.timing.tlsHandshake = result.timing.connect;
+    result.timing.firstByte = GetPhaseMicroseconds(curl, CURLINFO_STARTTRANSFER_TIME);
+    result.timing.total = GetPhaseMicroseconds(curl, CURLINFO_TOTAL_TIME);
+
+    long connects = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK)
+      result.connectionReused = connects == 0 && result.status == AdblockPlus::IWebRequest::NS_OK;
+
+#if LIBCURL_VERSION_NUM >= 0x073200
+    long version = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version) == CURLE_OK)
+    {
+      switch (version)
+      {
+        case CURL_HTTP_VERSION_1_0:
+          result.protocolVersion = "HTTP/1.0";
+          break;
+        case CURL_HTTP_VERSION_1_1:
+          result.protocolVersion = "HTTP/1.1";
+          break;
+        case CURL_HTTP_VERSION_2_0:
+          result.protocolVersion = "HTTP/2";
+          break;
+      }
+    }
+#endif
+  }
+
   size_t ReceiveData(char* ptr, size_t size, size_t nmemb, void* userdata)
   {
-    std::stringstream* stream = static_cast<std::stringstream*>(userdata);
-    stream->write(ptr, size * nmemb);
+    const auto& dataCallback =
+      *static_cast<const AdblockPlus::IWebRequest::DataCallback*>(userdata);
+    dataCallback(ptr, size * nmemb);
     return nmemb;
   }
 
@@ -124,21 +219,39 @@ namespace
 
 AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
     const std::string& url, const HeaderList& requestHeaders) const
+{
+  std::string responseText;
+  AdblockPlus::ServerResponse result = GET(url, requestHeaders,
+    [&responseText](const char* data, size_t size)
+    {
+      responseText.append(data, size);
+    });
+  result.responseText = std::move(responseText);
+  return result;
+}
+
+AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
+    const std::string& url, const HeaderList& requestHeaders,
+    const IWebRequest::DataCallback& dataCallback) const
 {
   AdblockPlus::ServerResponse result;
   result.status = IWebRequest::NS_ERROR_NOT_INITIALIZED;
   result.responseStatus = 0;
 
+  CURLSH* share = SharedCache::Get();
   CURL *curl = curl_easy_init();
   if (curl)
   {
-    std::stringstream responseText;
     HeaderData headerData;
+    if (share)
+      curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ReceiveData);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseText);
-    // Request compressed data. Using any supported aglorithm
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &dataCallback);
+    // Request compressed data using any algorithm supported by libcurl,
+    // the data is decoded transparently.
     curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, ReceiveHeader);
     curl_easy_setopt(curl, CURLOPT_HEADERDATA, &headerData);
@@ -153,7 +266,17 @@ AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
 
     result.status = ConvertErrorCode(curl_easy_perform(curl));
     result.responseStatus = headerData.status;
-    result.responseText = responseText.str();
+    // The download size counts the bytes before decoding.
+#if LIBCURL_VERSION_NUM >= 0x073700
+    curl_off_t receivedBytes = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &receivedBytes) == CURLE_OK)
+      result.receivedBytes = static_cast<int64_t>(receivedBytes);
+#else
+    double receivedBytes = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &receivedBytes) == CURLE_OK)
+      result.receivedBytes = static_cast<int64_t>(receivedBytes);
+#endif
+    ReadTransferInfo(curl, result);
     for (const auto& header : headerData.headers)
     {
       // Parse header name and value out of something like "Foo: bar"
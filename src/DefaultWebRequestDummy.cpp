@@ -25,3 +25,10 @@ AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
   result.responseStatus = 0;
   return result;
 }
+
+AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
+    const std::string& url, const HeaderList& requestHeaders,
+    const IWebRequest::DataCallback& dataCallback) const
+{
+  return WebRequest::GET(url, requestHeaders, dataCallback);
+}
@@ -17,11 +17,13 @@
 
 #include "AdblockPlus/DefaultWebRequest.h"
 #include <algorithm>
+#include <chrono>
 #include <sstream>
 #include <Windows.h>
 #include <winhttp.h>
 #include <Shlwapi.h>
 
+#include "DefaultWebRequestWinInet.h"
 #include "Utils.h"
 
 class WinHttpHandle
@@ -186,6 +188,20 @@ void ParseResponseHeaders(HINTERNET hRequest, AdblockPlus::ServerResponse* resul
   std::wistringstream(statusStr) >> result->responseStatus;
   result->status = AdblockPlus::IWebRequest::NS_OK;
 
+  // Get the protocol version, e.g. "HTTP/1.1"
+  std::wstring versionStr;
+  DWORD versionLen = 0;
+  WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_VERSION, WINHTTP_HEADER_NAME_BY_INDEX, WINHTTP_NO_OUTPUT_BUFFER, &versionLen, WINHTTP_NO_HEADER_INDEX);
+  if (versionLen > 0)
+  {
+    versionStr.resize(versionLen / sizeof(std::wstring::value_type) + 1);
+    if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_VERSION, WINHTTP_HEADER_NAME_BY_INDEX, &versionStr[0], &versionLen, WINHTTP_NO_HEADER_INDEX))
+    {
+      versionStr.resize(versionLen / sizeof(std::wstring::value_type));
+      result->protocolVersion = AdblockPlus::Utils::ToUtf8String(versionStr);
+    }
+  }
+
 }
 
 AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
@@ -194,6 +210,14 @@ AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
   AdblockPlus::ServerResponse result;
   result.status = IWebRequest::NS_ERROR_FAILURE;
   result.responseStatus = 0;
+  // WinHTTP doesn't expose the connection phases, only the time until the
+  // response headers and the total time are measured.
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  auto elapsedMicroseconds = [&start]
+  {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count());
+  };
 
   HRESULT hr;
   BOOL res;
@@ -283,7 +307,14 @@ AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
     result.status = WindowsErrorToGeckoError(GetLastError());
     return result;
   }
-  // TODO: Make sure for HTTP 1.1 "Accept-Encoding: gzip, deflate" doesn't HAVE to be set here
+  // Request compressed data and let WinHTTP decode it, this option is only
+  // supported by Windows 8.1 and later.
+  bool decompressing = false;
+#ifdef WINHTTP_OPTION_DECOMPRESSION
+  DWORD decompressionFlags = WINHTTP_DECOMPRESSION_FLAG_ALL;
+  decompressing = WinHttpSetOption(hRequest, WINHTTP_OPTION_DECOMPRESSION,
+    &decompressionFlags, sizeof(decompressionFlags)) != FALSE;
+#endif
   if (headers.length() > 0)
   {
     res = ::WinHttpSendRequest(hRequest, headers.c_str(), headers.length(), WINHTTP_NO_REQUEST_DATA, 0, 0, 0);
@@ -307,6 +338,7 @@ AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
     return result;
   }
 
+  result.timing.firstByte = elapsedMicroseconds();
   ParseResponseHeaders(hRequest, &result);
 
   std::unique_ptr<char[]> outBuffer;
@@ -342,5 +374,23 @@ AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
       }
     }
   } while (downloadSize > 0);
+  result.timing.total = elapsedMicroseconds();
+
+  // WinHTTP only returns the decoded data, the number of received bytes is
+  // known from Content-Length.
+  if (!decompressing)
+    result.receivedBytes = result.responseText.size();
+  for (const auto& header : result.responseHeaders)
+  {
+    if (header.first == "content-length")
+      std::istringstream(header.second) >> result.receivedBytes;
+  }
   return result;
 }
+
+AdblockPlus::ServerResponse AdblockPlus::DefaultWebRequestSync::GET(
+    const std::string& url, const HeaderList& requestHeaders,
+    const IWebRequest::DataCallback& dataCallback) const
+{
+  return WebRequest::GET(url, requestHeaders, dataCallback);
+}
@@ -18,13 +18,16 @@
 #ifndef ADBLOCKPLUS_WEB_REQUEST_WININET_H
 #define ADBLOCKPLUS_WEB_REQUEST_WININET_H
 
-#include "AdblockPlus\WebRequest.h"
+#include <string>
+#include <Windows.h>
+#include <winhttp.h>
+
+#include "AdblockPlus/IWebRequest.h"
+
+// WinHTTP helpers shared by DefaultWebRequestSync and WinHttpWebRequest.
+
+long WindowsErrorToGeckoError(DWORD err);
+BOOL GetProxySettings(std::wstring& proxyName, std::wstring& proxyBypass);
+void ParseResponseHeaders(HINTERNET hRequest, AdblockPlus::ServerResponse* result);
 
-namespace AdblockPlus
-{
-  class DefaultWebRequest : public WebRequest
-  {
-    ServerResponse GET(const std::string& url, const HeaderList& requestHeaders) const;
-  };
-}
 #endif
@@ -0,0 +1,79 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ElemHideCache.h"
+
+using namespace AdblockPlus;
+
+ElemHideCache::ElemHideCache(size_t capacity)
+  : capacity(capacity), generation(0)
+{
+}
+
+ElemHideCache::SelectorsPtr ElemHideCache::Lookup(const std::string& domain)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entryByDomain.find(domain);
+  if (it == entryByDomain.end())
+    return SelectorsPtr();
+  entries.splice(entries.begin(), entries, it->second);
+  return it->second->second;
+}
+
+void ElemHideCache::Insert(const std::string& domain,
+  const SelectorsPtr& selectors, uint64_t generation)
+{
+  if (!capacity)
+    return;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (generation != this->generation)
+    return;
+  auto it = entryByDomain.find(domain);
+  if (it != entryByDomain.end())
+  {
+    it->second->second = selectors;
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+  if (entries.size() >= capacity)
+  {
+    entryByDomain.erase(entries.back().first);
+    entries.pop_back();
+  }
+  entries.push_front(Entry(domain, selectors));
+  entryByDomain[domain] = entries.begin();
+}
+
+uint64_t ElemHideCache::GetGeneration() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return generation;
+}
+
+size_t ElemHideCache::GetSize() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+void ElemHideCache::Invalidate()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  entryByDomain.clear();
+  ++generation;
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_ELEM_HIDE_CACHE_H
+#define ADBLOCK_PLUS_ELEM_HIDE_CACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Bounded LRU cache of the element hiding selectors per domain. The cache
+   * is dropped as a whole whenever element hiding filters change.
+   */
+  class ElemHideCache
+  {
+  public:
+    typedef std::shared_ptr<const std::vector<std::string>> SelectorsPtr;
+
+    explicit ElemHideCache(size_t capacity);
+
+    /**
+     * Looks up the selectors of a domain.
+     * @return Cached selectors or `null`.
+     */
+    SelectorsPtr Lookup(const std::string& domain);
+
+    /**
+     * Stores the selectors of a domain, unless the filters changed since
+     * `generation` was retrieved.
+     */
+    void Insert(const std::string& domain, const SelectorsPtr& selectors,
+      uint64_t generation);
+
+    /**
+     * Returns a counter which is incremented by `Invalidate()`.
+     */
+    uint64_t GetGeneration() const;
+
+    /**
+     * Returns the number of domains with cached selectors.
+     */
+    size_t GetSize() const;
+
+    /**
+     * Drops all cached selectors.
+     */
+    void Invalidate();
+
+  private:
+    typedef std::pair<std::string, SelectorsPtr> Entry;
+    typedef std::list<Entry> Entries;
+
+    const size_t capacity;
+    mutable std::mutex mutex;
+    uint64_t generation;
+    // Most recently used entries first.
+    Entries entries;
+    std::unordered_map<std::string, Entries::iterator> entryByDomain;
+  };
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/FileSystem.h>
+
+#include "StringUtils.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  class StringFileView : public FileView
+  {
+  public:
+    explicit StringFileView(std::string&& content)
+      : content(std::move(content))
+    {
+    }
+
+    const char* GetData() const
+    {
+      return content.data();
+    }
+
+    size_t GetSize() const
+    {
+      return content.size();
+    }
+
+  private:
+    std::string content;
+  };
+
+  // Makes a buffer readable as a stream without copying it.
+  class MemoryStreamBuffer : public std::streambuf
+  {
+  public:
+    MemoryStreamBuffer(const char* data, size_t size)
+    {
+      char* begin = const_cast<char*>(data);
+      setg(begin, begin, begin + size);
+    }
+  };
+}
+
+FileViewPtr FileSystem::ReadMapped(const std::string& path) const
+{
+  std::shared_ptr<std::istream> stream = Read(path);
+  return FileViewPtr(new StringFileView(Utils::Slurp(*stream)));
+}
+
+void FileSystem::Copy(const std::string& fromPath, const std::string& toPath)
+{
+  FileViewPtr file = ReadMapped(fromPath);
+  Write(toPath, file->GetData(), file->GetSize());
+}
+
+void FileSystem::Write(const std::string& path, const char* data, size_t size)
+{
+  MemoryStreamBuffer buffer(data, size);
+  std::istream stream(&buffer);
+  Write(path, stream);
+}
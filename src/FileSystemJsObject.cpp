@@ -15,231 +15,166 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <AdblockPlus/FileSystem.h>
+#include <AdblockPlus/IFileSystem.h>
 #include <stdexcept>
-#include <sstream>
 #include <vector>
 
 #include <AdblockPlus/JsValue.h>
 #include "FileSystemJsObject.h"
 #include "JsContext.h"
-#include "Thread.h"
 #include "Utils.h"
 
 using namespace AdblockPlus;
 
 namespace
 {
-  class IoThread : public Thread
+  // Size of the parts _fileSystem.readLines reads from a file and passes to
+  // JavaScript at once, bounds the memory needed for large files.
+  const size_t READ_LINES_BATCH_SIZE = 64 * 1024;
+
+  void CallErrorCallback(const JsEnginePtr& jsEngine, JsValue& callback,
+    const std::string& error)
   {
-  public:
-    IoThread(const JsEnginePtr& jsEngine, const JsValue& callback)
-      : Thread(true), jsEngine(jsEngine), fileSystem(jsEngine->GetFileSystem()),
-        callback(callback)
-    {
-    }
+    const JsContext context(*jsEngine, JsEngine::LOCK_SITE_FILE_SYSTEM);
+    auto errorValue = jsEngine->NewValue(error);
+    JsValueList params;
+    params.push_back(errorValue);
+    callback.Call(params);
+  }
 
-  protected:
-    JsEnginePtr jsEngine;
-    FileSystemPtr fileSystem;
-    JsValue callback;
-  };
+  // The JavaScript engine is only locked while a batch is processed.
+  void ProcessLinesBatch(const JsEnginePtr& jsEngine, JsValue& listener,
+    const std::string& batch)
+  {
+    const JsContext context(*jsEngine, JsEngine::LOCK_SITE_FILE_SYSTEM);
+    auto linesValue = jsEngine->NewValue(batch);
+    JsValueList params;
+    params.push_back(linesValue);
+    listener.Call(params);
+  }
 
-  class ReadThread : public IoThread
+  // Progress of _fileSystem.readLines, the file is read in parts of
+  // READ_LINES_BATCH_SIZE bytes, the next one is only requested when the
+  // lines of the previous one have been processed.
+  struct ReadLinesState
   {
-  public:
-    ReadThread(const JsEnginePtr& jsEngine, const JsValue& callback,
-               const std::string& path)
-      : IoThread(jsEngine, callback), path(path)
+    ReadLinesState(const JsEnginePtr& jsEngine, const std::string& path,
+      const JsValue& listener, const JsValue& callback)
+      : jsEngine(jsEngine), fileSystem(jsEngine->GetAsyncFileSystem()),
+        path(path), listener(listener), callback(callback), offset(0)
     {
     }
 
-    void Run()
-    {
-      std::string content;
-      std::string error;
-      try
-      {
-        std::shared_ptr<std::istream> stream = fileSystem->Read(path);
-        content = Utils::Slurp(*stream);
-      }
-      catch (std::exception& e)
-      {
-        error = e.what();
-      }
-      catch (...)
-      {
-        error =  "Unknown error while reading from " + path;
-      }
-
-      const JsContext context(*jsEngine);
-      auto result = jsEngine->NewObject();
-      result.SetProperty("content", content);
-      result.SetProperty("error", error);
-      JsValueList params;
-      params.push_back(result);
-      callback.Call(params);
-    }
-
-  private:
+    JsEnginePtr jsEngine;
+    AsyncFileSystemPtr fileSystem;
     std::string path;
+    JsValue listener;
+    JsValue callback;
+    uint64_t offset;
+    // Start of a line continued in the next part of the file.
+    std::string incompleteLine;
   };
 
-  class WriteThread : public IoThread
-  {
-  public:
-    WriteThread(const JsEnginePtr& jsEngine, const JsValue& callback,
-                const std::string& path, const std::string& content)
-      : IoThread(jsEngine, callback), path(path), content(content)
-    {
-    }
+  typedef std::shared_ptr<ReadLinesState> ReadLinesStatePtr;
 
-    void Run()
+  // Joins the lines of the text with line feeds, like split(/[\r\n]+/) empty
+  // lines are skipped.
+  std::string JoinLines(const std::string& text)
+  {
+    std::string result;
+    const char* const end = text.data() + text.size();
+    for (const char* start = text.data(); start < end;)
     {
-      std::string error;
-      try
-      {
-        std::stringstream stream;
-        stream << content;
-        fileSystem->Write(path, stream);
-      }
-      catch (std::exception& e)
-      {
-        error = e.what();
-      }
-      catch (...)
+      const char* lineEnd = start;
+      while (lineEnd < end && *lineEnd != '\r' && *lineEnd != '\n')
+        ++lineEnd;
+      if (lineEnd > start)
       {
-        error = "Unknown error while writing to " + path;
+        if (!result.empty())
+          result += '\n';
+        result.append(start, lineEnd);
       }
-
-      const JsContext context(*jsEngine);
-      auto errorValue = jsEngine->NewValue(error);
-      JsValueList params;
-      params.push_back(errorValue);
-      callback.Call(params);
+      start = lineEnd + 1;
     }
+    return result;
+  }
 
-  private:
-    std::string path;
-    std::string content;
-  };
-
-  class MoveThread : public IoThread
+  void ReadNextLines(const ReadLinesStatePtr& state)
   {
-  public:
-    MoveThread(const JsEnginePtr& jsEngine, const JsValue& callback,
-               const std::string& fromPath, const std::string& toPath)
-      : IoThread(jsEngine, callback), fromPath(fromPath), toPath(toPath)
-    {
-    }
-
-    void Run()
-    {
-      std::string error;
-      try
-      {
-        fileSystem->Move(fromPath, toPath);
-      }
-      catch (std::exception& e)
+    state->fileSystem->ReadRange(state->path, state->offset,
+      READ_LINES_BATCH_SIZE,
+      [state](IFileSystem::IoBuffer&& data, const std::string& error)
       {
-        error = e.what();
-      }
-      catch (...)
-      {
-        error = "Unknown error while moving " + fromPath + " to " + toPath;
-      }
-
-      const JsContext context(*jsEngine);
-      auto errorValue = jsEngine->NewValue(error);
-      JsValueList params;
-      params.push_back(errorValue);
-      callback.Call(params);
-    }
-
-  private:
-    std::string fromPath;
-    std::string toPath;
-  };
+        if (!error.empty())
+        {
+          CallErrorCallback(state->jsEngine, state->callback, error);
+          return;
+        }
+        state->offset += data.size();
+        bool isLastPart = data.size() < READ_LINES_BATCH_SIZE;
+        std::string text;
+        text.swap(state->incompleteLine);
+        text.append(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!isLastPart)
+        {
+          std::string::size_type lastLineEnd = text.find_last_of("\r\n");
+          if (lastLineEnd == std::string::npos)
+          {
+            state->incompleteLine.swap(text);
+            ReadNextLines(state);
+            return;
+          }
+          state->incompleteLine.assign(text, lastLineEnd + 1, std::string::npos);
+          text.resize(lastLineEnd);
+        }
+        std::string batch = JoinLines(text);
+        if (!batch.empty())
+          ProcessLinesBatch(state->jsEngine, state->listener, batch);
+        if (isLastPart)
+          CallErrorCallback(state->jsEngine, state->callback, std::string());
+        else
+          ReadNextLines(state);
+      });
+  }
 
-  class RemoveThread : public IoThread
+  // Converts the content passed to _fileSystem.write, a string or an array of
+  // lines, to UTF-8 without intermediate copies. Lines are followed by a line
+  // break each, so the scripts don't need to join them to one string.
+  IFileSystem::IoBuffer ToIoBuffer(const v8::Handle<v8::Value>& content)
   {
-  public:
-    RemoveThread(const JsEnginePtr& jsEngine, const JsValue& callback,
-                 const std::string& path)
-      : IoThread(jsEngine, callback), path(path)
-    {
-    }
-
-    void Run()
+    IFileSystem::IoBuffer result;
+    if (!content->IsArray())
     {
-      std::string error;
-      try
-      {
-        fileSystem->Remove(path);
-      }
-      catch (std::exception& e)
-      {
-        error = e.what();
-      }
-      catch (...)
-      {
-        error = "Unknown error while removing " + path;
-      }
-
-      const JsContext context(*jsEngine);
-      auto errorValue = jsEngine->NewValue(error);
-      JsValueList params;
-      params.push_back(errorValue);
-      callback.Call(params);
+      v8::Local<v8::String> str = content->ToString();
+      result.resize(str->Utf8Length());
+      if (!result.empty())
+        str->WriteUtf8(reinterpret_cast<char*>(&result[0]), result.size(),
+          0, v8::String::NO_NULL_TERMINATION);
+      return result;
     }
 
-  private:
-    std::string path;
-  };
-
-
-  class StatThread : public IoThread
-  {
-  public:
-    StatThread(const JsEnginePtr& jsEngine, const JsValue& callback,
-               const std::string& path)
-      : IoThread(jsEngine, callback), path(path)
+    v8::Local<v8::Array> lines = v8::Local<v8::Array>::Cast(content);
+    const uint32_t length = lines->Length();
+    std::vector<int> lineSizes(length);
+    size_t size = 0;
+    for (uint32_t i = 0; i < length; i++)
     {
+      lineSizes[i] = lines->Get(i)->ToString()->Utf8Length();
+      size += lineSizes[i] + 1;
     }
-
-    void Run()
+    result.resize(size);
+    size_t offset = 0;
+    for (uint32_t i = 0; i < length; i++)
     {
-      std::string error;
-      FileSystem::StatResult statResult;
-      try
-      {
-        statResult = fileSystem->Stat(path);
-      }
-      catch (std::exception& e)
-      {
-        error = e.what();
-      }
-      catch (...)
-      {
-        error = "Unknown error while calling stat on " + path;
-      }
-
-      const JsContext context(*jsEngine);
-      auto result = jsEngine->NewObject();
-      result.SetProperty("exists", statResult.exists);
-      result.SetProperty("isFile", statResult.isFile);
-      result.SetProperty("isDirectory", statResult.isDirectory);
-      result.SetProperty("lastModified", statResult.lastModified);
-      result.SetProperty("error", error);
-
-      JsValueList params;
-      params.push_back(result);
-      callback.Call(params);
+      if (lineSizes[i])
+        lines->Get(i)->ToString()->WriteUtf8(
+          reinterpret_cast<char*>(&result[offset]), lineSizes[i],
+          0, v8::String::NO_NULL_TERMINATION);
+      offset += lineSizes[i];
+      result[offset++] = '\n';
     }
-
-  private:
-    std::string path;
-  };
+    return result;
+  }
 
   v8::Handle<v8::Value> ReadCallback(const v8::Arguments& arguments)
   {
@@ -253,9 +188,42 @@ namespace
     if (!converted[1].IsFunction())
       return v8::ThrowException(Utils::ToV8String(isolate,
         "Second argument to _fileSystem.read must be a function"));
-    ReadThread* const readThread = new ReadThread(jsEngine, converted[1],
-        converted[0].AsString());
-    readThread->Start();
+
+    JsValue callback = converted[1];
+    jsEngine->GetAsyncFileSystem()->Read(converted[0].AsString(),
+      [jsEngine, callback](IFileSystem::IoBuffer&& data, const std::string& error) mutable
+      {
+        const JsContext context(*jsEngine, JsEngine::LOCK_SITE_FILE_SYSTEM);
+        auto result = jsEngine->NewObject();
+        result.SetProperty("content", context.Wrap(
+          Utils::ToV8ExternalString(jsEngine->GetIsolate(), std::move(data))));
+        result.SetProperty("error", error);
+        JsValueList params;
+        params.push_back(result);
+        callback.Call(params);
+      });
+    return v8::Undefined();
+  }
+
+  v8::Handle<v8::Value> ReadLinesCallback(const v8::Arguments& arguments)
+  {
+    AdblockPlus::JsEnginePtr jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
+    AdblockPlus::JsValueList converted = jsEngine->ConvertArguments(arguments);
+
+    v8::Isolate* isolate = arguments.GetIsolate();
+    if (converted.size() != 3)
+      return v8::ThrowException(Utils::ToV8String(isolate,
+        "_fileSystem.readLines requires 3 parameters"));
+    if (!converted[1].IsFunction())
+      return v8::ThrowException(Utils::ToV8String(isolate,
+        "Second argument to _fileSystem.readLines must be a function"));
+    if (!converted[2].IsFunction())
+      return v8::ThrowException(Utils::ToV8String(isolate,
+        "Third argument to _fileSystem.readLines must be a function"));
+
+    ReadLinesStatePtr state(new ReadLinesState(jsEngine, converted[0].AsString(),
+      converted[1], converted[2]));
+    ReadNextLines(state);
     return v8::Undefined();
   }
 
@@ -271,9 +239,14 @@ namespace
     if (!converted[2].IsFunction())
       return v8::ThrowException(Utils::ToV8String(isolate,
         "Third argument to _fileSystem.write must be a function"));
-    WriteThread* const writeThread = new WriteThread(jsEngine, converted[2],
-        converted[0].AsString(), converted[1].AsString());
-    writeThread->Start();
+
+    JsValue callback = converted[2];
+    jsEngine->GetAsyncFileSystem()->Write(converted[0].AsString(),
+      ToIoBuffer(arguments[1]),
+      [jsEngine, callback](const std::string& error) mutable
+      {
+        CallErrorCallback(jsEngine, callback, error);
+      });
     return v8::Undefined();
   }
 
@@ -289,9 +262,37 @@ namespace
     if (!converted[2].IsFunction())
       return v8::ThrowException(Utils::ToV8String(isolate,
         "Third argument to _fileSystem.move must be a function"));
-    MoveThread* const moveThread = new MoveThread(jsEngine, converted[2],
-        converted[0].AsString(), converted[1].AsString());
-    moveThread->Start();
+
+    JsValue callback = converted[2];
+    jsEngine->GetAsyncFileSystem()->Move(converted[0].AsString(),
+      converted[1].AsString(),
+      [jsEngine, callback](const std::string& error) mutable
+      {
+        CallErrorCallback(jsEngine, callback, error);
+      });
+    return v8::Undefined();
+  }
+
+  v8::Handle<v8::Value> CopyCallback(const v8::Arguments& arguments)
+  {
+    AdblockPlus::JsEnginePtr jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
+    AdblockPlus::JsValueList converted = jsEngine->ConvertArguments(arguments);
+
+    v8::Isolate* isolate = arguments.GetIsolate();
+    if (converted.size() != 3)
+      return v8::ThrowException(Utils::ToV8String(isolate,
+        "_fileSystem.copy requires 3 parameters"));
+    if (!converted[2].IsFunction())
+      return v8::ThrowException(Utils::ToV8String(isolate,
+        "Third argument to _fileSystem.copy must be a function"));
+
+    JsValue callback = converted[2];
+    jsEngine->GetAsyncFileSystem()->Copy(converted[0].AsString(),
+      converted[1].AsString(),
+      [jsEngine, callback](const std::string& error) mutable
+      {
+        CallErrorCallback(jsEngine, callback, error);
+      });
     return v8::Undefined();
   }
 
@@ -307,9 +308,13 @@ namespace
     if (!converted[1].IsFunction())
       return v8::ThrowException(Utils::ToV8String(isolate,
         "Second argument to _fileSystem.remove must be a function"));
-    RemoveThread* const removeThread = new RemoveThread(jsEngine, converted[1],
-        converted[0].AsString());
-    removeThread->Start();
+
+    JsValue callback = converted[1];
+    jsEngine->GetAsyncFileSystem()->Remove(converted[0].AsString(),
+      [jsEngine, callback](const std::string& error) mutable
+      {
+        CallErrorCallback(jsEngine, callback, error);
+      });
     return v8::Undefined();
   }
 
@@ -325,9 +330,23 @@ namespace
     if (!converted[1].IsFunction())
       return v8::ThrowException(Utils::ToV8String(isolate,
         "Second argument to _fileSystem.stat must be a function"));
-    StatThread* const statThread = new StatThread(jsEngine, converted[1],
-        converted[0].AsString());
-    statThread->Start();
+
+    JsValue callback = converted[1];
+    jsEngine->GetAsyncFileSystem()->Stat(converted[0].AsString(),
+      [jsEngine, callback](const IFileSystem::StatResult& statResult, const std::string& error) mutable
+      {
+        const JsContext context(*jsEngine, JsEngine::LOCK_SITE_FILE_SYSTEM);
+        auto result = jsEngine->NewObject();
+        result.SetProperty("exists", statResult.exists);
+        result.SetProperty("isFile", statResult.isFile);
+        result.SetProperty("isDirectory", statResult.isDirectory);
+        result.SetProperty("lastModified", statResult.lastModified);
+        result.SetProperty("error", error);
+
+        JsValueList params;
+        params.push_back(result);
+        callback.Call(params);
+      });
     return v8::Undefined();
   }
 
@@ -341,7 +360,7 @@ namespace
       return v8::ThrowException(Utils::ToV8String(isolate,
         "_fileSystem.resolve requires 1 parameter"));
 
-    std::string resolved = jsEngine->GetFileSystem()->Resolve(converted[0].AsString());
+    std::string resolved = jsEngine->GetAsyncFileSystem()->Resolve(converted[0].AsString());
 
     return Utils::ToV8String(isolate, resolved);
   }
@@ -352,8 +371,10 @@ namespace
 JsValue& FileSystemJsObject::Setup(JsEngine& jsEngine, JsValue& obj)
 {
   obj.SetProperty("read", jsEngine.NewCallback(::ReadCallback));
+  obj.SetProperty("readLines", jsEngine.NewCallback(::ReadLinesCallback));
   obj.SetProperty("write", jsEngine.NewCallback(::WriteCallback));
   obj.SetProperty("move", jsEngine.NewCallback(::MoveCallback));
+  obj.SetProperty("copy", jsEngine.NewCallback(::CopyCallback));
   obj.SetProperty("remove", jsEngine.NewCallback(::RemoveCallback));
   obj.SetProperty("stat", jsEngine.NewCallback(::StatCallback));
   obj.SetProperty("resolve", jsEngine.NewCallback(::ResolveCallback));
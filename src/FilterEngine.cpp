@@ -17,21 +17,33 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
 #include <functional>
+#include <sstream>
 #include <string>
 #include <cassert>
 #include <thread>
 
 #include <AdblockPlus.h>
+#include "BaseDomain.h"
+#include "CompiledRuleset.h"
+#include "ContentTypes.h"
+#include "ElemHideCache.h"
+#include "FilterHitStatistics.h"
 #include "JsContext.h"
+#include "JsSources.h"
+#include "LatencyHistogram.h"
+#include "MatchCache.h"
+#include "Matcher.h"
+#include "PrefsCache.h"
 #include "Thread.h"
+#include "Utils.h"
+#include "WorkQueue.h"
 #include <mutex>
 #include <condition_variable>
 
 using namespace AdblockPlus;
 
-extern std::string jsSources[];
-
 Filter::Filter(JsValue&& value)
     : JsValue(std::move(value))
 {
@@ -61,39 +73,49 @@ Filter& Filter::operator=(Filter&& src)
   return *this;
 }
 
+namespace
+{
+  // Number of filters retrieved at once by ForEachListedFilter().
+  const size_t LISTED_FILTER_PAGE_SIZE = 1000;
+
+  Filter::Type ToFilterType(const std::string& className)
+  {
+    if (className == "BlockingFilter")
+      return Filter::TYPE_BLOCKING;
+    else if (className == "WhitelistFilter")
+      return Filter::TYPE_EXCEPTION;
+    else if (className == "ElemHideFilter")
+      return Filter::TYPE_ELEMHIDE;
+    else if (className == "ElemHideException")
+      return Filter::TYPE_ELEMHIDE_EXCEPTION;
+    else if (className == "CommentFilter")
+      return Filter::TYPE_COMMENT;
+    else
+      return Filter::TYPE_INVALID;
+  }
+}
+
 Filter::Type Filter::GetType() const
 {
-  std::string className = GetClass();
-  if (className == "BlockingFilter")
-    return TYPE_BLOCKING;
-  else if (className == "WhitelistFilter")
-    return TYPE_EXCEPTION;
-  else if (className == "ElemHideFilter")
-    return TYPE_ELEMHIDE;
-  else if (className == "ElemHideException")
-    return TYPE_ELEMHIDE_EXCEPTION;
-  else if (className == "CommentFilter")
-    return TYPE_COMMENT;
-  else
-    return TYPE_INVALID;
+  return ToFilterType(GetClass());
 }
 
 bool Filter::IsListed() const
 {
-  JsValue func = jsEngine->Evaluate("API.isListedFilter");
-  return func.Call(*this).AsBool();
+  const JsContext context(*jsEngine);
+  return context.Call(context.GetApiFunction("isListedFilter"), UnwrapValue())->BooleanValue();
 }
 
 void Filter::AddToList()
 {
-  JsValue func = jsEngine->Evaluate("API.addFilterToList");
-  func.Call(*this);
+  const JsContext context(*jsEngine);
+  context.Call(context.GetApiFunction("addFilterToList"), UnwrapValue());
 }
 
 void Filter::RemoveFromList()
 {
-  JsValue func = jsEngine->Evaluate("API.removeFilterFromList");
-  func.Call(*this);
+  const JsContext context(*jsEngine);
+  context.Call(context.GetApiFunction("removeFilterFromList"), UnwrapValue());
 }
 
 bool Filter::operator==(const Filter& filter) const
@@ -132,8 +154,8 @@ Subscription& Subscription::operator=(Subscription&& src)
 
 bool Subscription::IsListed() const
 {
-  JsValue func = jsEngine->Evaluate("API.isListedSubscription");
-  return func.Call(*this).AsBool();
+  const JsContext context(*jsEngine);
+  return context.Call(context.GetApiFunction("isListedSubscription"), UnwrapValue())->BooleanValue();
 }
 
 bool Subscription::IsDisabled() const
@@ -148,31 +170,32 @@ void Subscription::SetDisabled(bool value)
 
 void Subscription::AddToList()
 {
-  JsValue func = jsEngine->Evaluate("API.addSubscriptionToList");
-  func.Call(*this);
+  const JsContext context(*jsEngine);
+  context.Call(context.GetApiFunction("addSubscriptionToList"), UnwrapValue());
 }
 
 void Subscription::RemoveFromList()
 {
-  JsValue func = jsEngine->Evaluate("API.removeSubscriptionFromList");
-  func.Call(*this);
+  const JsContext context(*jsEngine);
+  context.Call(context.GetApiFunction("removeSubscriptionFromList"), UnwrapValue());
 }
 
 void Subscription::UpdateFilters()
 {
-  JsValue func = jsEngine->Evaluate("API.updateSubscription");
-  func.Call(*this);
+  const JsContext context(*jsEngine);
+  context.Call(context.GetApiFunction("updateSubscription"), UnwrapValue());
 }
 
 bool Subscription::IsUpdating() const
 {
-  JsValue func = jsEngine->Evaluate("API.isSubscriptionUpdating");
-  return func.Call(*this).AsBool();
+  const JsContext context(*jsEngine);
+  return context.Call(context.GetApiFunction("isSubscriptionUpdating"), UnwrapValue())->BooleanValue();
 }
 
 bool Subscription::IsAA() const
 {
-  return jsEngine->Evaluate("API.isAASubscription").Call(*this).AsBool();
+  const JsContext context(*jsEngine);
+  return context.Call(context.GetApiFunction("isAASubscription"), UnwrapValue())->BooleanValue();
 }
 
 bool Subscription::operator==(const Subscription& subscription) const
@@ -182,6 +205,93 @@ bool Subscription::operator==(const Subscription& subscription) const
 
 namespace
 {
+  // Number of domains whose element hiding selectors are cached.
+  const size_t ELEM_HIDE_CACHE_CAPACITY = 100;
+
+  // Number of cached whitelisting checks of documents, see
+  // FilterEngine::GetWhitelistingFilter().
+  const size_t WHITELIST_CACHE_CAPACITY = 500;
+
+  // Rough size of a parsed filter excluding its text, i.e.\ of the filter
+  // object and its entries in the matcher and the filter maps, in bytes.
+  const size_t APPROXIMATE_FILTER_OVERHEAD = 200;
+
+  const std::string SCRIPT_CACHE_FILE = "scripts.cache";
+
+  // Maps script file names to their compilation data.
+  typedef std::map<std::string, std::string> ScriptCache;
+
+  // Compilation data is only valid for the same scripts and V8 version.
+  std::string GetScriptCacheVersion()
+  {
+    return std::string(GetJsSourcesHash()) + " " + v8::V8::GetVersion();
+  }
+
+  void LogScriptCacheError(const JsEnginePtr& jsEngine, const std::string& message)
+  {
+    LogSystemPtr logSystem = jsEngine->GetLogSystem();
+    (*logSystem)(LogSystem::LOG_LEVEL_WARN, message, SCRIPT_CACHE_FILE);
+  }
+
+  ScriptCache ReadScriptCache(const JsEnginePtr& jsEngine)
+  {
+    ScriptCache result;
+    try
+    {
+      FileSystemPtr fileSystem = jsEngine->GetFileSystem();
+      if (!fileSystem->Stat(SCRIPT_CACHE_FILE).exists)
+        return result;
+      FileViewPtr file = fileSystem->ReadMapped(SCRIPT_CACHE_FILE);
+      const char* position = file->GetData();
+      const char* end = position + file->GetSize();
+      auto readLine = [&position, end](std::string& line)->bool
+      {
+        const char* lineEnd = std::find(position, end, '\n');
+        if (lineEnd == end)
+          return false;
+        line.assign(position, lineEnd);
+        position = lineEnd + 1;
+        return true;
+      };
+
+      std::string version;
+      if (!readLine(version) || version != GetScriptCacheVersion())
+        return result;
+      std::string name;
+      std::string size;
+      while (readLine(name) && readLine(size))
+      {
+        size_t dataSize = std::strtoul(size.c_str(), nullptr, 10);
+        if (dataSize > static_cast<size_t>(end - position))
+          break;
+        result[name].assign(position, dataSize);
+        position += dataSize;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      LogScriptCacheError(jsEngine, std::string("Failed to read script cache: ") + e.what());
+      result.clear();
+    }
+    return result;
+  }
+
+  void WriteScriptCache(const JsEnginePtr& jsEngine, const ScriptCache& cache)
+  {
+    std::stringstream stream;
+    stream << GetScriptCacheVersion() << '\n';
+    for (const auto& entry : cache)
+      stream << entry.first << '\n' << entry.second.size() << '\n' << entry.second;
+    try
+    {
+      jsEngine->GetFileSystem()->Write(SCRIPT_CACHE_FILE, stream);
+    }
+    catch (const std::exception& e)
+    {
+      LogScriptCacheError(jsEngine, std::string("Failed to write script cache: ") + e.what());
+    }
+  }
+
   class Sync
   {
   public:
@@ -209,24 +319,204 @@ namespace
     std::condition_variable cv;
     bool initialized;
   };
+
+  std::chrono::microseconds ToMicroseconds(std::chrono::steady_clock::duration duration)
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+  }
+
+  // Collects the timings of FilterEngine::StartupProfile until the creation
+  // is complete, later marks are ignored.
+  class StartupRecorder
+  {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    StartupRecorder()
+      : start(Clock::now()), matcherBuildStarted(false), matcherBuilt(false),
+        complete(false)
+    {
+    }
+
+    void AddScript(const std::string& filename, Clock::duration duration)
+    {
+      FilterEngine::ScriptTiming script = {filename, ToMicroseconds(duration)};
+      profile.scripts.push_back(script);
+    }
+
+    // Phases can run several times, e.g. parsing a batch of lines, their
+    // durations add up.
+    void Mark(const std::string& phase, bool begin)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (complete)
+        return;
+      Clock::time_point now = Clock::now();
+      if (begin)
+      {
+        phaseStarts[phase] = now;
+        return;
+      }
+      auto it = phaseStarts.find(phase);
+      if (it == phaseStarts.end())
+        return;
+      phaseDurations[phase] += now - it->second;
+      phaseStarts.erase(it);
+    }
+
+    void MatcherAdd()
+    {
+      // Only the first filter added is of interest.
+      if (matcherBuildStarted)
+        return;
+      std::lock_guard<std::mutex> lock(mutex);
+      if (matcherBuildStarted)
+        return;
+      matcherBuildStart = Clock::now();
+      matcherBuildStarted = true;
+    }
+
+    void MatcherCommit()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (complete || matcherBuilt)
+        return;
+      matcherBuildEnd = Clock::now();
+      if (!matcherBuildStarted)
+        matcherBuildStart = matcherBuildEnd;
+      matcherBuilt = true;
+    }
+
+    FilterEngine::StartupProfile Complete()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Clock::time_point now = Clock::now();
+      complete = true;
+      matcherBuildStarted = true;
+      Clock::duration parse = phaseDurations["fileParse"];
+      Clock::duration read = phaseDurations["fileRead"];
+      profile.prefsLoad = ToMicroseconds(phaseDurations["prefsLoad"]);
+      profile.filterParse = ToMicroseconds(parse);
+      profile.filtersRead = ToMicroseconds(read > parse ? read - parse : Clock::duration::zero());
+      if (matcherBuilt)
+      {
+        profile.matcherBuild = ToMicroseconds(matcherBuildEnd - matcherBuildStart);
+        profile.initDelivery = ToMicroseconds(now - matcherBuildEnd);
+      }
+      profile.total = ToMicroseconds(now - start);
+      return profile;
+    }
+
+  private:
+    std::mutex mutex;
+    const Clock::time_point start;
+    FilterEngine::StartupProfile profile;
+    std::map<std::string, Clock::time_point> phaseStarts;
+    std::map<std::string, Clock::duration> phaseDurations;
+    std::atomic<bool> matcherBuildStarted;
+    Clock::time_point matcherBuildStart;
+    bool matcherBuilt;
+    Clock::time_point matcherBuildEnd;
+    bool complete;
+  };
+}
+
+FilterEngine::StartupProfile::StartupProfile()
+  : prefsLoad(0), filtersRead(0), filterParse(0), matcherBuild(0),
+    initDelivery(0), total(0)
+{
+}
+
+FilterEngine::CreationParameters::CreationParameters()
+  : matchCacheEnabled(false), matchCacheCapacity(1000),
+    coalesceAsyncMatches(true), prefilterEnabled(true),
+    prefilterFalsePositiveRate(0.01), prefilterMaxSize(1024 * 1024),
+    scriptCacheEnabled(false),
+    prefsSaveDelay(0), metricsEnabled(false), hitStatisticsEnabled(false),
+    hitStatisticsFlushInterval(60000), matcherChunkSize(1000),
+    elemHideIndexing(ELEM_HIDE_INDEXING_EAGER),
+    notificationEvaluationInterval(0), unloadDisabledSubscriptions(false)
+{
 }
 
 FilterEngine::FilterEngine(const JsEnginePtr& jsEngine)
-  : jsEngine(jsEngine), firstRun(false), updateCheckId(0)
+  : jsEngine(jsEngine), firstRun(false), updateCheckId(0),
+    matcher(std::make_shared<Matcher>()),
+    elemHideCache(std::make_shared<ElemHideCache>(ELEM_HIDE_CACHE_CAPACITY)),
+    whitelistCache(std::make_shared<MatchCache>(WHITELIST_CACHE_CAPACITY)),
+    prefsCache(std::make_shared<PrefsCache>()),
+    coalesceAsyncMatches(true), elemHideIndexing(ELEM_HIDE_INDEXING_EAGER),
+    notificationEvaluationInterval(0), notificationsEvaluated(false)
 {
 }
 
+FilterEngine::~FilterEngine()
+{
+  // The MatchesAsync() tasks capture this, their thread has to be stopped
+  // before any other member is destroyed.
+  asyncMatchesQueue.reset();
+  matcherUpdateQueue.reset();
+}
+
 void FilterEngine::CreateAsync(const JsEnginePtr& jsEngine,
   const FilterEngine::OnCreatedCallback& onCreated,
   const FilterEngine::CreationParameters& params)
 {
+  auto startupRecorder = std::make_shared<StartupRecorder>();
   FilterEnginePtr filterEngine(new FilterEngine(jsEngine));
+  if (params.matchCacheEnabled)
+    filterEngine->matchCache = std::make_shared<MatchCache>(params.matchCacheCapacity);
+  filterEngine->coalesceAsyncMatches = params.coalesceAsyncMatches;
+  filterEngine->elemHideIndexing = params.elemHideIndexing;
+  filterEngine->notificationEvaluationInterval =
+    std::chrono::milliseconds(params.notificationEvaluationInterval);
+  if (params.prefilterEnabled)
+  {
+    filterEngine->matcher->EnablePrefilter(params.prefilterFalsePositiveRate,
+      params.prefilterMaxSize);
+  }
+  if (!params.precompiledRuleset.empty())
+  {
+    filterEngine->ruleset = std::make_shared<CompiledRuleset>(
+      jsEngine->GetFileSystem()->ReadMapped(params.precompiledRuleset));
+    filterEngine->matcher->SetRuleset(filterEngine->ruleset);
+    filterEngine->matcher->Commit();
+  }
+  if (params.metricsEnabled)
+  {
+    filterEngine->metrics.reset(new LatencyHistogram[METRICS_API_COUNT],
+      std::default_delete<LatencyHistogram[]>());
+    // Reported with the download duration, see
+    // lib/filterUpdateRegistration.js.
+    std::shared_ptr<LatencyHistogram> metrics = filterEngine->metrics;
+    jsEngine->SetEventCallback("_subscriptionUpdated", [metrics](JsValueList&& params)
+    {
+      if (params.size() >= 2)
+      {
+        metrics.get()[METRICS_SUBSCRIPTION_UPDATE].Record(
+          std::chrono::milliseconds(params[1].AsInt()));
+      }
+    });
+  }
+  if (params.hitStatisticsEnabled)
+  {
+    filterEngine->hitStatistics = std::make_shared<FilterHitStatistics>();
+    // Triggered every hitStatisticsFlushInterval, see lib/api.js.
+    std::weak_ptr<FilterEngine> weakFilterEngine = filterEngine;
+    jsEngine->SetEventCallback("_flushFilterHits", [weakFilterEngine](JsValueList&&)
+    {
+      auto filterEngine = weakFilterEngine.lock();
+      if (filterEngine)
+        filterEngine->FlushFilterHits();
+    });
+  }
   {
     // TODO: replace weakFilterEngine by this when it's possible to control the
     // execution time of the asynchronous part below.
     std::weak_ptr<FilterEngine> weakFilterEngine = filterEngine;
     auto isSubscriptionDowloadAllowedCallback = params.isSubscriptionDowloadAllowedCallback;
-    jsEngine->SetEventCallback("_isSubscriptionDownloadAllowed", [weakFilterEngine, isSubscriptionDowloadAllowedCallback](JsValueList&& params){
+    auto updateCoordinator = params.updateCoordinator;
+    jsEngine->SetEventCallback("_isSubscriptionDownloadAllowed", [weakFilterEngine, isSubscriptionDowloadAllowedCallback, updateCoordinator](JsValueList&& params){
       auto filterEngine = weakFilterEngine.lock();
       if (!filterEngine)
         return;
@@ -238,7 +528,7 @@ void FilterEngine::CreateAsync(const JsEnginePtr& jsEngine,
       assert(areArgumentsValid && "Invalid argument: there should be two args and the second one should be a function");
       if (!areArgumentsValid)
         return;
-      if (!isSubscriptionDowloadAllowedCallback)
+      if (!isSubscriptionDowloadAllowedCallback && !updateCoordinator)
       {
         params[1].Call(jsEngine->NewValue(true));
         return;
@@ -253,14 +543,163 @@ void FilterEngine::CreateAsync(const JsEnginePtr& jsEngine,
         auto jsParams = jsEngine->TakeJsValues(valuesID);
         jsParams[1].Call(jsEngine->NewValue(isAllowed));
       };
-      std::string allowedConnectionType = params[0].IsString() ? params[0].AsString() : std::string();
-      isSubscriptionDowloadAllowedCallback(params[0].IsString() ? &allowedConnectionType : nullptr, callJsCallback);
+      bool hasConnectionType = params[0].IsString();
+      std::string allowedConnectionType = hasConnectionType ? params[0].AsString() : std::string();
+      auto checkConnection = [isSubscriptionDowloadAllowedCallback, callJsCallback, hasConnectionType, allowedConnectionType]
+      {
+        if (!isSubscriptionDowloadAllowedCallback)
+        {
+          callJsCallback(true);
+          return;
+        }
+        isSubscriptionDowloadAllowedCallback(hasConnectionType ? &allowedConnectionType : nullptr, callJsCallback);
+      };
+      // The connection is checked when the download starts, after the delay.
+      if (updateCoordinator)
+        updateCoordinator->Stagger(checkConnection);
+      else
+        checkConnection();
     });
+    if (updateCoordinator)
+    {
+      jsEngine->SetEventCallback("_subscriptionUpdateRequested", [updateCoordinator](JsValueList&& params)
+      {
+        if (params.size() == 1 && params[0].IsString())
+          updateCoordinator->DiscardResult(params[0].AsString());
+      });
+    }
   }
   
-  jsEngine->SetEventCallback("_init", [jsEngine, filterEngine, onCreated](JsValueList&& params)
+  // Keep the native matcher in sync with defaultMatcher, see
+  // lib/matcherRegistration.js.
+  std::shared_ptr<Matcher> matcher = filterEngine->matcher;
+  jsEngine->SetEventCallback("_matcherAdd", [matcher, startupRecorder](JsValueList&& params)
+  {
+    startupRecorder->MatcherAdd();
+    if (params.size() >= 1)
+      matcher->Add(params[0].AsString());
+  });
+  jsEngine->SetEventCallback("_matcherRemove", [matcher](JsValueList&& params)
+  {
+    if (params.size() >= 1)
+      matcher->Remove(params[0].AsString());
+  });
+  jsEngine->SetEventCallback("_matcherClear", [matcher](JsValueList&&)
+  {
+    matcher->Clear();
+  });
+  jsEngine->SetEventCallback("_matcherCommit", [matcher, startupRecorder](JsValueList&&)
+  {
+    matcher->Commit();
+    startupRecorder->MatcherCommit();
+  });
+  // Subscription updates are published once complete. Building the snapshot
+  // of a large list takes a while, it doesn't need the JavaScript engine.
+  jsEngine->SetEventCallback("_matcherBeginUpdate", [matcher](JsValueList&&)
+  {
+    matcher->BeginUpdate();
+  });
+  std::weak_ptr<FilterEngine> weakFilterEngine = filterEngine;
+  jsEngine->SetEventCallback("_matcherEndUpdate", [matcher, weakFilterEngine](JsValueList&&)
+  {
+    auto filterEngine = weakFilterEngine.lock();
+    if (filterEngine)
+      filterEngine->EndMatcherUpdate();
+    else
+      matcher->EndUpdate();
+  });
+
+  // Cached selectors are outdated once element hiding filters change, see
+  // lib/elemHideRegistration.js.
+  std::shared_ptr<ElemHideCache> elemHideCache = filterEngine->elemHideCache;
+  jsEngine->SetEventCallback("_elemHideChanged", [elemHideCache](JsValueList&&)
+  {
+    elemHideCache->Invalidate();
+  });
+
+  // Mirrors the scalar preferences, see lib/prefs.js.
+  std::shared_ptr<PrefsCache> prefsCache = filterEngine->prefsCache;
+  jsEngine->SetEventCallback("_prefChanged", [prefsCache](JsValueList&& params)
+  {
+    if (params.size() < 1)
+      return;
+    std::string pref = params[0].AsString();
+    PrefsCache::Value value;
+    if (params.size() >= 2 && params[1].IsBool())
+    {
+      value.type = PrefsCache::Value::TYPE_BOOL;
+      value.boolValue = params[1].AsBool();
+    }
+    else if (params.size() >= 2 && params[1].IsNumber())
+    {
+      value.type = PrefsCache::Value::TYPE_INT;
+      value.intValue = params[1].AsInt();
+    }
+    else if (params.size() >= 2 && params[1].IsString())
+    {
+      value.type = PrefsCache::Value::TYPE_STRING;
+      value.stringValue = params[1].AsString();
+    }
+    else
+    {
+      prefsCache->Remove(pref);
+      return;
+    }
+    prefsCache->Set(pref, value);
+  });
+
+  {
+    std::weak_ptr<FilterEngine> weakFilterEngine = filterEngine;
+    jsEngine->SetEventCallback("_notificationCandidates", [weakFilterEngine](JsValueList&& params)
+    {
+      auto filterEngine = weakFilterEngine.lock();
+      if (!filterEngine || params.size() < 3)
+        return;
+      std::shared_ptr<NotificationCandidates> candidates =
+        std::make_shared<NotificationCandidates>();
+      candidates->general = params[0].AsBool();
+      candidates->urlTargeted = params[1].AsBool();
+      candidates->hostsComplete = params[2].IsArray();
+      if (candidates->hostsComplete)
+        params[2].AsStringVector(candidates->hosts);
+      std::lock_guard<std::mutex> lock(filterEngine->notificationMutex);
+      filterEngine->notificationCandidates = candidates;
+    });
+  }
+
+  // The caches are rebuilt on demand, see JsEngine::NotifyMemoryPressure().
+  std::shared_ptr<MatchCache> matchCache = filterEngine->matchCache;
+  std::shared_ptr<MatchCache> whitelistCache = filterEngine->whitelistCache;
+  jsEngine->SetEventCallback("_memoryPressure", [matchCache, whitelistCache, elemHideCache](JsValueList&&)
+  {
+    if (matchCache)
+      matchCache->Clear();
+    whitelistCache->Clear();
+    elemHideCache->Invalidate();
+  });
+
+  auto filtersLoadedCallback = params.filtersLoadedCallback;
+  if (filtersLoadedCallback)
+  {
+    jsEngine->SetEventCallback("_filtersLoaded", [jsEngine, filterEngine, filtersLoadedCallback](JsValueList&& params)
+    {
+      filtersLoadedCallback(filterEngine);
+      jsEngine->RemoveEventCallback("_filtersLoaded");
+    });
+  }
+
+  // Phases of the scripts, see lib/prefs.js and lib/io.js.
+  jsEngine->SetEventCallback("_startupPhase", [startupRecorder](JsValueList&& params)
+  {
+    if (params.size() >= 2)
+      startupRecorder->Mark(params[0].AsString(), params[1].AsBool());
+  });
+
+  jsEngine->SetEventCallback("_init", [jsEngine, filterEngine, onCreated, startupRecorder](JsValueList&& params)
   {
     filterEngine->firstRun = params.size() && params[0].AsBool();
+    filterEngine->startupProfile = startupRecorder->Complete();
+    jsEngine->RemoveEventCallback("_startupPhase");
     onCreated(filterEngine);
     jsEngine->RemoveEventCallback("_init");
   });
@@ -275,9 +714,41 @@ void FilterEngine::CreateAsync(const JsEnginePtr& jsEngine,
     preconfiguredPrefsObject.SetProperty(pref.first, pref.second);
   }
   jsEngine->SetGlobalProperty("_preconfiguredPrefs", preconfiguredPrefsObject);
+  jsEngine->SetGlobalProperty("_prefsSaveDelay", jsEngine->NewValue(params.prefsSaveDelay));
+  jsEngine->SetGlobalProperty("_filterHitsFlushInterval", jsEngine->NewValue(
+    params.hitStatisticsEnabled ? params.hitStatisticsFlushInterval : 0));
+  jsEngine->SetGlobalProperty("_matcherChunkSize", jsEngine->NewValue(
+    params.matcherChunkSize));
+  jsEngine->SetGlobalProperty("_elemHideIndexing", jsEngine->NewValue(
+    params.elemHideIndexing == ELEM_HIDE_INDEXING_LAZY ? "lazy" :
+    params.elemHideIndexing == ELEM_HIDE_INDEXING_DISABLED ? "disabled" : "eager"));
+  jsEngine->SetGlobalProperty("_unloadDisabledSubscriptions", jsEngine->NewValue(
+    params.unloadDisabledSubscriptions));
   // Load adblockplus scripts
-  for (int i = 0; !jsSources[i].empty(); i += 2)
-    jsEngine->Evaluate(jsSources[i + 1], jsSources[i]);
+  const char* const* jsSources = GetJsSources();
+  if (!params.scriptCacheEnabled)
+  {
+    for (int i = 0; jsSources[i]; i += 2)
+    {
+      auto scriptStart = StartupRecorder::Clock::now();
+      jsEngine->EvaluateStatic(jsSources[i + 1], jsSources[i]);
+      startupRecorder->AddScript(jsSources[i], StartupRecorder::Clock::now() - scriptStart);
+    }
+    return;
+  }
+  ScriptCache scriptCache = ReadScriptCache(jsEngine);
+  bool scriptCacheChanged = false;
+  for (int i = 0; jsSources[i]; i += 2)
+  {
+    std::string& cachedData = scriptCache[jsSources[i]];
+    std::string previousData = cachedData;
+    auto scriptStart = StartupRecorder::Clock::now();
+    jsEngine->EvaluateStatic(jsSources[i + 1], jsSources[i], &cachedData);
+    startupRecorder->AddScript(jsSources[i], StartupRecorder::Clock::now() - scriptStart);
+    scriptCacheChanged = scriptCacheChanged || cachedData != previousData;
+  }
+  if (scriptCacheChanged)
+    WriteScriptCache(jsEngine, scriptCache);
 }
 
 FilterEnginePtr FilterEngine::Create(const JsEnginePtr& jsEngine,
@@ -294,51 +765,19 @@ FilterEnginePtr FilterEngine::Create(const JsEnginePtr& jsEngine,
   return retValue;
 }
 
-namespace
-{
-  typedef std::map<FilterEngine::ContentType, std::string> ContentTypeMap;
-
-  ContentTypeMap CreateContentTypeMap()
-  {
-    ContentTypeMap contentTypes;
-    contentTypes[FilterEngine::CONTENT_TYPE_OTHER] = "OTHER";
-    contentTypes[FilterEngine::CONTENT_TYPE_SCRIPT] = "SCRIPT";
-    contentTypes[FilterEngine::CONTENT_TYPE_IMAGE] = "IMAGE";
-    contentTypes[FilterEngine::CONTENT_TYPE_STYLESHEET] = "STYLESHEET";
-    contentTypes[FilterEngine::CONTENT_TYPE_OBJECT] = "OBJECT";
-    contentTypes[FilterEngine::CONTENT_TYPE_SUBDOCUMENT] = "SUBDOCUMENT";
-    contentTypes[FilterEngine::CONTENT_TYPE_DOCUMENT] = "DOCUMENT";
-    contentTypes[FilterEngine::CONTENT_TYPE_PING] = "PING";
-    contentTypes[FilterEngine::CONTENT_TYPE_XMLHTTPREQUEST] = "XMLHTTPREQUEST";
-    contentTypes[FilterEngine::CONTENT_TYPE_OBJECT_SUBREQUEST] = "OBJECT_SUBREQUEST";
-    contentTypes[FilterEngine::CONTENT_TYPE_FONT] = "FONT";
-    contentTypes[FilterEngine::CONTENT_TYPE_MEDIA] = "MEDIA";
-    contentTypes[FilterEngine::CONTENT_TYPE_ELEMHIDE] = "ELEMHIDE";
-    contentTypes[FilterEngine::CONTENT_TYPE_GENERICBLOCK] = "GENERICBLOCK";
-    contentTypes[FilterEngine::CONTENT_TYPE_GENERICHIDE] = "GENERICHIDE";
-    return contentTypes;
-  }
-}
-
-const ContentTypeMap FilterEngine::contentTypes = CreateContentTypeMap();
-
 std::string FilterEngine::ContentTypeToString(ContentType contentType)
 {
-  ContentTypeMap::const_iterator it = contentTypes.find(contentType);
-  if (it != contentTypes.end())
-    return it->second;
+  const char* name = ContentTypes::GetPublicName(static_cast<int32_t>(contentType));
+  if (name)
+    return name;
   throw std::invalid_argument("Argument is not a valid ContentType");
 }
 
 FilterEngine::ContentType FilterEngine::StringToContentType(const std::string& contentType)
 {
-  std::string contentTypeUpper = contentType;
-  std::transform(contentType.begin(), contentType.end(), contentTypeUpper.begin(), ::toupper);
-  for (const auto& contentType : contentTypes)
-  {
-    if (contentType.second == contentTypeUpper)
-      return contentType.first;
-  }
+  int32_t value;
+  if (ContentTypes::LookupPublic(contentType, value))
+    return static_cast<ContentType>(value);
   throw std::invalid_argument("Cannot convert argument to ContentType");
 }
 
@@ -349,19 +788,21 @@ bool FilterEngine::IsFirstRun() const
 
 Filter FilterEngine::GetFilter(const std::string& text) const
 {
-  JsValue func = jsEngine->Evaluate("API.getFilterFromText");
-  return Filter(func.Call(jsEngine->NewValue(text)));
+  const JsContext context(*jsEngine);
+  return Filter(context.Wrap(context.Call(context.GetApiFunction("getFilterFromText"),
+    context.NewString(text))));
 }
 
 Subscription FilterEngine::GetSubscription(const std::string& url) const
 {
-  JsValue func = jsEngine->Evaluate("API.getSubscriptionFromUrl");
-  return Subscription(func.Call(jsEngine->NewValue(url)));
+  const JsContext context(*jsEngine);
+  return Subscription(context.Wrap(context.Call(context.GetApiFunction("getSubscriptionFromUrl"),
+    context.NewString(url))));
 }
 
 std::vector<Filter> FilterEngine::GetListedFilters() const
 {
-  JsValue func = jsEngine->Evaluate("API.getListedFilters");
+  JsValue func = jsEngine->GetApiFunction("getListedFilters");
   JsValueList values = func.Call().AsList();
   std::vector<Filter> result;
   for (auto& value : values)
@@ -369,9 +810,91 @@ std::vector<Filter> FilterEngine::GetListedFilters() const
   return result;
 }
 
+std::vector<FilterEngine::FilterInfo> FilterEngine::GetListedFilterPage(
+  size_t offset, size_t limit) const
+{
+  std::vector<FilterInfo> result;
+  const JsContext context(*jsEngine);
+  v8::Local<v8::Value> value = context.Call(
+    context.GetApiFunction("getListedFilterPage"),
+    v8::Number::New(jsEngine->GetIsolate(), static_cast<double>(offset)),
+    v8::Number::New(jsEngine->GetIsolate(), static_cast<double>(limit)));
+  if (!value->IsArray())
+    throw std::runtime_error("Cannot convert a non-array to list");
+  v8::Local<v8::Array> array = v8::Local<v8::Array>::Cast(value);
+  uint32_t length = array->Length();
+  result.reserve(length);
+  v8::Local<v8::String> textProperty = context.NewString("text");
+  for (uint32_t i = 0; i < length; i++)
+  {
+    v8::Local<v8::Object> filter = array->Get(i)->ToObject();
+    FilterInfo info;
+    info.text = Utils::FromV8String(filter->Get(textProperty));
+    info.type = ToFilterType(Utils::FromV8String(filter->GetConstructorName()));
+    result.push_back(std::move(info));
+  }
+  return result;
+}
+
+namespace
+{
+  void ChangeFilters(JsEngine& jsEngine, const std::string& function,
+    const std::vector<std::string>& texts)
+  {
+    const JsContext context(jsEngine);
+    v8::Local<v8::Array> array = v8::Array::New(jsEngine.GetIsolate(),
+      static_cast<int>(texts.size()));
+    for (size_t i = 0; i < texts.size(); i++)
+      array->Set(static_cast<uint32_t>(i), context.NewString(texts[i]));
+    context.Call(context.GetApiFunction(function), array);
+  }
+}
+
+void FilterEngine::AddFilters(const std::vector<std::string>& texts)
+{
+  ChangeFilters(*jsEngine, "addFilters", texts);
+}
+
+void FilterEngine::RemoveFilters(const std::vector<std::string>& texts)
+{
+  ChangeFilters(*jsEngine, "removeFilters", texts);
+}
+
+std::string FilterEngine::ExportListedFilters() const
+{
+  const JsContext context(*jsEngine);
+  return Utils::FromV8String(context.Call(
+    context.GetApiFunction("exportListedFilters")));
+}
+
+uint64_t FilterEngine::PublishRuleset(const std::string& path) const
+{
+  std::vector<std::string> filterTexts;
+  {
+    const JsContext context(*jsEngine);
+    Utils::FromV8StringArray(context.Call(context.GetApiFunction("getActiveFilterTexts")),
+      filterTexts);
+  }
+  return CompiledRuleset::Publish(*jsEngine->GetFileSystem(), path,
+    filterTexts);
+}
+
+void FilterEngine::ForEachListedFilter(const ListedFilterCallback& callback) const
+{
+  for (size_t offset = 0; ; offset += LISTED_FILTER_PAGE_SIZE)
+  {
+    std::vector<FilterInfo> page = GetListedFilterPage(offset,
+      LISTED_FILTER_PAGE_SIZE);
+    for (const auto& filter : page)
+      callback(filter);
+    if (page.size() < LISTED_FILTER_PAGE_SIZE)
+      break;
+  }
+}
+
 std::vector<Subscription> FilterEngine::GetListedSubscriptions() const
 {
-  JsValue func = jsEngine->Evaluate("API.getListedSubscriptions");
+  JsValue func = jsEngine->GetApiFunction("getListedSubscriptions");
   JsValueList values = func.Call().AsList();
   std::vector<Subscription> result;
   for (auto& value : values)
@@ -379,9 +902,38 @@ std::vector<Subscription> FilterEngine::GetListedSubscriptions() const
   return result;
 }
 
+std::vector<FilterEngine::SubscriptionInfo> FilterEngine::GetSubscriptionsSnapshot() const
+{
+  std::vector<SubscriptionInfo> result;
+  const JsContext context(*jsEngine);
+  v8::Local<v8::Value> value = context.Call(
+    context.GetApiFunction("getSubscriptionsSnapshot"));
+  if (!value->IsArray())
+    throw std::runtime_error("Cannot convert a non-array to list");
+  v8::Local<v8::Array> array = v8::Local<v8::Array>::Cast(value);
+  uint32_t length = array->Length();
+  result.reserve(length);
+  for (uint32_t i = 0; i < length; i++)
+  {
+    v8::Local<v8::Array> fields = v8::Local<v8::Array>::Cast(array->Get(i));
+    SubscriptionInfo info;
+    info.url = Utils::FromV8String(fields->Get(0));
+    info.title = Utils::FromV8String(fields->Get(1));
+    info.homepage = Utils::FromV8String(fields->Get(2));
+    info.lastDownload = fields->Get(3)->IntegerValue();
+    info.lastSuccess = fields->Get(4)->IntegerValue();
+    info.downloadStatus = Utils::FromV8String(fields->Get(5));
+    info.disabled = fields->Get(6)->BooleanValue();
+    info.updating = fields->Get(7)->BooleanValue();
+    info.acceptableAds = fields->Get(8)->BooleanValue();
+    result.push_back(std::move(info));
+  }
+  return result;
+}
+
 std::vector<Subscription> FilterEngine::FetchAvailableSubscriptions() const
 {
-  JsValue func = jsEngine->Evaluate("API.getRecommendedSubscriptions");
+  JsValue func = jsEngine->GetApiFunction("getRecommendedSubscriptions");
   JsValueList values = func.Call().AsList();
   std::vector<Subscription> result;
   for (auto& value : values)
@@ -391,12 +943,15 @@ std::vector<Subscription> FilterEngine::FetchAvailableSubscriptions() const
 
 void FilterEngine::SetAAEnabled(bool enabled)
 {
-  jsEngine->Evaluate("API.setAASubscriptionEnabled").Call(jsEngine->NewValue(enabled));
+  const JsContext context(*jsEngine);
+  context.Call(context.GetApiFunction("setAASubscriptionEnabled"),
+    v8::Boolean::New(enabled));
 }
 
 bool FilterEngine::IsAAEnabled() const
 {
-  return jsEngine->Evaluate("API.isAASubscriptionEnabled()").AsBool();
+  const JsContext context(*jsEngine);
+  return context.Call(context.GetApiFunction("isAASubscriptionEnabled"))->BooleanValue();
 }
 
 std::string FilterEngine::GetAAUrl() const
@@ -404,9 +959,54 @@ std::string FilterEngine::GetAAUrl() const
   return GetPref("subscriptions_exceptionsurl").AsString();
 }
 
+bool FilterEngine::ShouldEvaluateNotifications(const std::string& url) const
+{
+  std::lock_guard<std::mutex> lock(notificationMutex);
+  bool hostTargeted = false;
+  if (notificationCandidates)
+  {
+    const NotificationCandidates& candidates = *notificationCandidates;
+    if (!url.empty() && candidates.urlTargeted)
+    {
+      if (!candidates.hostsComplete)
+        hostTargeted = true;
+      else
+      {
+        // "||example.com^" also targets the subdomains, the hosts are
+        // compared to the host and each of its parent domains.
+        std::string host = BaseDomain::ExtractHostFromURL(url);
+        std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+        for (size_t pos = 0; pos != std::string::npos && !hostTargeted;)
+        {
+          for (const auto& targetedHost : candidates.hosts)
+          {
+            if (host.compare(pos, std::string::npos, targetedHost) == 0)
+              hostTargeted = true;
+          }
+          pos = host.find('.', pos);
+          if (pos != std::string::npos)
+            pos++;
+        }
+      }
+    }
+    if (!candidates.general && !hostTargeted)
+      return false;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (!hostTargeted && notificationsEvaluated &&
+      now - lastNotificationEvaluation < notificationEvaluationInterval)
+    return false;
+  notificationsEvaluated = true;
+  lastNotificationEvaluation = now;
+  return true;
+}
+
 void FilterEngine::ShowNextNotification(const std::string& url) const
 {
-  JsValue func = jsEngine->Evaluate("API.showNextNotification");
+  if (!ShouldEvaluateNotifications(url))
+    return;
+  JsValue func = jsEngine->GetApiFunction("showNextNotification");
   JsValueList params;
   if (!url.empty())
   {
@@ -427,6 +1027,7 @@ void FilterEngine::SetShowNotificationCallback(const ShowNotificationCallback& c
 
     callback(Notification(std::move(params[0])));
   });
+  jsEngine->GetApiFunction("startNotifications").Call();
 }
 
 void FilterEngine::RemoveShowNotificationCallback()
@@ -447,79 +1048,530 @@ AdblockPlus::FilterPtr FilterEngine::Matches(const std::string& url,
     ContentTypeMask contentTypeMask,
     const std::vector<std::string>& documentUrls) const
 {
-  if (documentUrls.empty())
-    return CheckFilterMatch(url, contentTypeMask, "");
-
-  std::string lastDocumentUrl = documentUrls.front();
-  for (const auto& documentUrl : documentUrls) {
-    AdblockPlus::FilterPtr match = CheckFilterMatch(documentUrl,
-                                                    CONTENT_TYPE_DOCUMENT,
-                                                    lastDocumentUrl);
-    if (match && match->GetType() == AdblockPlus::Filter::TYPE_EXCEPTION)
-      return match;
-    lastDocumentUrl = documentUrl;
-  }
+  ScopedLatency latency(GetMetricsHistogram(METRICS_MATCHES));
+  return GetFilterForMatch(RecordFilterHit(
+    MatchesInternal(url, contentTypeMask, documentUrls)));
+}
 
-  return CheckFilterMatch(url, contentTypeMask, lastDocumentUrl);
+AdblockPlus::FilterPtr FilterEngine::Matches(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const SharedUrlList& documentUrls) const
+{
+  ScopedLatency latency(GetMetricsHistogram(METRICS_MATCHES));
+  return GetFilterForMatch(RecordFilterHit(
+    MatchesInternal(url, contentTypeMask, documentUrls)));
 }
 
 bool FilterEngine::IsDocumentWhitelisted(const std::string& url,
     const std::vector<std::string>& documentUrls) const
 {
-    return !!GetWhitelistingFilter(url, CONTENT_TYPE_DOCUMENT, documentUrls);
+    ScopedLatency latency(GetMetricsHistogram(METRICS_IS_DOCUMENT_WHITELISTED));
+    return !!RecordFilterHit(
+      GetWhitelistingFilter(url, CONTENT_TYPE_DOCUMENT, documentUrls));
 }
 
 bool FilterEngine::IsElemhideWhitelisted(const std::string& url,
     const std::vector<std::string>& documentUrls) const
 {
-    return !!GetWhitelistingFilter(url, CONTENT_TYPE_ELEMHIDE, documentUrls);
+    return !!RecordFilterHit(
+      GetWhitelistingFilter(url, CONTENT_TYPE_ELEMHIDE, documentUrls));
 }
 
-AdblockPlus::FilterPtr FilterEngine::CheckFilterMatch(const std::string& url,
-    ContentTypeMask contentTypeMask,
-    const std::string& documentUrl) const
+AdblockPlus::FilterPtr FilterEngine::GetFilterForMatch(const MatcherFilterPtr& match) const
 {
-  JsValue func = jsEngine->Evaluate("API.checkFilterMatch");
-  JsValueList params;
-  params.push_back(jsEngine->NewValue(url));
-  params.push_back(jsEngine->NewValue(contentTypeMask));
-  params.push_back(jsEngine->NewValue(documentUrl));
-  JsValue result = func.Call(params);
-  if (!result.IsNull())
-    return FilterPtr(new Filter(std::move(result)));
-  else
+  if (!match)
     return FilterPtr();
+  // Only a match needs the JavaScript filter object, Filter.fromText() returns
+  // the known instance for the text.
+  return FilterPtr(new Filter(GetFilter(match->GetText())));
+}
+
+DocumentContext::DocumentContext()
+  : elemhideWhitelisted(false), genericblockWhitelisted(false)
+{
+}
+
+DocumentContextPtr FilterEngine::CreateDocumentContext(
+    const std::vector<std::string>& documentUrls) const
+{
+  std::shared_ptr<DocumentContext> documentContext(new DocumentContext());
+  documentContext->documentUrls = documentUrls;
+  if (documentUrls.empty())
+    return documentContext;
+
+  documentContext->documentWhitelistingFilter = CheckDocumentChain(documentUrls);
+  const std::vector<std::string> parentUrls(documentUrls.begin() + 1,
+    documentUrls.end());
+  documentContext->elemhideWhitelisted = !!GetWhitelistingFilter(
+    documentUrls.front(), CONTENT_TYPE_ELEMHIDE, parentUrls);
+  documentContext->genericblockWhitelisted = !!GetWhitelistingFilter(
+    documentUrls.front(), CONTENT_TYPE_GENERICBLOCK, parentUrls);
+  return documentContext;
+}
+
+DocumentContextPtr FilterEngine::CreateDocumentContext(
+    const SharedUrlList& documentUrls) const
+{
+  // The context is created once per document, only the requests using it
+  // have to avoid the copies.
+  std::vector<std::string> urls;
+  urls.reserve(documentUrls.size());
+  for (const auto& documentUrl : documentUrls)
+    urls.push_back(*documentUrl);
+  return CreateDocumentContext(urls);
+}
+
+AdblockPlus::FilterPtr FilterEngine::Matches(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const DocumentContext& documentContext) const
+{
+  ScopedLatency latency(GetMetricsHistogram(METRICS_MATCHES));
+  return GetFilterForMatch(RecordFilterHit(
+    MatchesInternal(url, contentTypeMask, documentContext)));
+}
+
+MatchResult FilterEngine::GetMatchResult(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const std::vector<std::string>& documentUrls) const
+{
+  ScopedLatency latency(GetMetricsHistogram(METRICS_MATCHES));
+  return ToMatchResult(RecordFilterHit(
+    MatchesInternal(url, contentTypeMask, documentUrls)));
+}
+
+MatchResult FilterEngine::GetMatchResult(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const SharedUrlList& documentUrls) const
+{
+  ScopedLatency latency(GetMetricsHistogram(METRICS_MATCHES));
+  return ToMatchResult(RecordFilterHit(
+    MatchesInternal(url, contentTypeMask, documentUrls)));
+}
+
+MatchResult FilterEngine::GetMatchResult(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const DocumentContext& documentContext) const
+{
+  ScopedLatency latency(GetMetricsHistogram(METRICS_MATCHES));
+  return ToMatchResult(RecordFilterHit(
+    MatchesInternal(url, contentTypeMask, documentContext)));
+}
+
+std::vector<AdblockPlus::FilterPtr> FilterEngine::MatchesBatch(
+    const std::vector<MatchRequest>& requests) const
+{
+  // Requests of a page usually share their frame chain, so the document
+  // whitelisting is only checked once per distinct chain.
+  std::map<std::vector<std::string>, MatcherFilterPtr> documentChainMatches;
+  std::vector<MatcherFilterPtr> matches;
+  matches.reserve(requests.size());
+  for (const auto& request : requests)
+  {
+    // Each request counts as one lookup like with Matches(), the filter
+    // objects are created for all of them at once below.
+    ScopedLatency latency(GetMetricsHistogram(METRICS_MATCHES));
+    if (request.documentUrls.empty())
+    {
+      matches.push_back(CheckFilterMatch(request.url, request.contentTypeMask, ""));
+      continue;
+    }
+    auto documentChainMatch = documentChainMatches.find(request.documentUrls);
+    if (documentChainMatch == documentChainMatches.end())
+    {
+      documentChainMatch = documentChainMatches.insert(std::make_pair(
+        request.documentUrls, CheckDocumentChain(request.documentUrls))).first;
+    }
+    if (documentChainMatch->second)
+      matches.push_back(documentChainMatch->second);
+    else
+    {
+      matches.push_back(CheckFilterMatch(request.url, request.contentTypeMask,
+        request.documentUrls.back()));
+    }
+  }
+
+  std::vector<FilterPtr> result;
+  result.reserve(requests.size());
+  // Only enter the JavaScript engine once for all the filter objects.
+  const JsContext context(*jsEngine);
+  for (const auto& match : matches)
+    result.push_back(GetFilterForMatch(RecordFilterHit(match)));
+  return result;
+}
+
+void FilterEngine::MatchesAsync(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const std::vector<std::string>& documentUrls,
+    const MatchesCallback& callback) const
+{
+  if (!callback)
+    return;
+
+  std::string key = url;
+  key += '\0';
+  key += std::to_string(contentTypeMask);
+  for (const auto& documentUrl : documentUrls)
+  {
+    key += '\0';
+    key += documentUrl;
+  }
+
+  std::lock_guard<std::mutex> lock(asyncMatchesMutex);
+  if (!asyncMatchesQueue)
+    asyncMatchesQueue = std::make_shared<WorkQueue>();
+  if (!coalesceAsyncMatches)
+  {
+    asyncMatchesQueue->Post([this, url, contentTypeMask, documentUrls, callback]
+    {
+      RunAsyncMatch(url, contentTypeMask, documentUrls, std::string(),
+        std::vector<MatchesCallback>(1, callback));
+    });
+    return;
+  }
+
+  auto pending = pendingAsyncMatches.find(key);
+  if (pending != pendingAsyncMatches.end())
+  {
+    pending->second.push_back(callback);
+    return;
+  }
+  pendingAsyncMatches[key].push_back(callback);
+  asyncMatchesQueue->Post([this, url, contentTypeMask, documentUrls, key]
+  {
+    RunAsyncMatch(url, contentTypeMask, documentUrls, key,
+      std::vector<MatchesCallback>());
+  });
+}
+
+void FilterEngine::RunAsyncMatch(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const std::vector<std::string>& documentUrls, const std::string& key,
+    std::vector<MatchesCallback>&& callbacks) const
+{
+  std::vector<FilterPtr> filters;
+  {
+    // Recorded once per lookup like Matches(), even if it is shared.
+    ScopedLatency latency(GetMetricsHistogram(METRICS_MATCHES));
+    MatcherFilterPtr match = MatchesInternal(url, contentTypeMask, documentUrls);
+    if (!key.empty())
+    {
+      // Requests posted until now get the result of this lookup.
+      std::lock_guard<std::mutex> lock(asyncMatchesMutex);
+      auto pending = pendingAsyncMatches.find(key);
+      if (pending == pendingAsyncMatches.end())
+        return;
+      callbacks.swap(pending->second);
+      pendingAsyncMatches.erase(pending);
+    }
+    // Every caller gets its own filter object, it might be modified.
+    filters.reserve(callbacks.size());
+    for (size_t i = 0; i < callbacks.size(); i++)
+      filters.push_back(GetFilterForMatch(RecordFilterHit(match)));
+  }
+
+  // A callback might release the engine, this mustn't be used anymore.
+  for (size_t i = 0; i < callbacks.size(); i++)
+  {
+    try
+    {
+      callbacks[i](std::move(filters[i]));
+    }
+    catch (...)
+    {
+      // The other callers still have to be notified.
+    }
+  }
+}
+
+template<typename Url>
+MatcherFilterPtr FilterEngine::MatchesInternal(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const std::vector<Url>& documentUrls) const
+{
+  if (documentUrls.empty())
+    return CheckFilterMatch(url, contentTypeMask, "");
+
+  MatcherFilterPtr match = CheckDocumentChain(documentUrls);
+  if (match)
+    return match;
+  return CheckFilterMatch(url, contentTypeMask,
+    GetDocumentUrl(documentUrls.back()));
+}
+
+MatcherFilterPtr FilterEngine::MatchesInternal(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const DocumentContext& documentContext) const
+{
+  const std::vector<std::string>& documentUrls = documentContext.documentUrls;
+  if (documentUrls.empty())
+    return CheckFilterMatch(url, contentTypeMask, "");
+  if (documentContext.documentWhitelistingFilter)
+    return documentContext.documentWhitelistingFilter;
+  return CheckFilterMatch(url, contentTypeMask, documentUrls.back(),
+    documentContext.genericblockWhitelisted);
+}
+
+template<typename Url>
+MatcherFilterPtr FilterEngine::CheckDocumentChain(
+    const std::vector<Url>& documentUrls) const
+{
+  return AdblockPlus::CheckDocumentChain(documentUrls,
+    [this](const std::string& documentUrl, const std::string& parentUrl)
+    {
+      return CheckFilterMatch(documentUrl, CONTENT_TYPE_DOCUMENT, parentUrl);
+    });
+}
+
+MatcherFilterPtr FilterEngine::CheckFilterMatch(const std::string& url,
+    ContentTypeMask contentTypeMask,
+    const std::string& documentUrl,
+    bool specificOnly) const
+{
+  if (!matchCache)
+    return matcher->CheckFilterMatch(url, contentTypeMask, documentUrl, specificOnly);
+
+  uint64_t generation = matcher->GetGeneration();
+  MatcherFilterPtr match;
+  if (matchCache->Lookup(url, contentTypeMask, documentUrl, specificOnly,
+      generation, match))
+    return match;
+  match = matcher->CheckFilterMatch(url, contentTypeMask, documentUrl, specificOnly);
+  matchCache->Insert(url, contentTypeMask, documentUrl, specificOnly,
+    generation, match);
+  return match;
+}
+
+FilterEngine::MatchCacheStats FilterEngine::GetMatchCacheStats() const
+{
+  MatchCacheStats stats;
+  stats.hits = matchCache ? matchCache->GetHits() : 0;
+  stats.misses = matchCache ? matchCache->GetMisses() : 0;
+  return stats;
+}
+
+FilterEngine::Stats FilterEngine::GetStats() const
+{
+  JsValue func = jsEngine->GetApiFunction("getSubscriptionStats");
+  JsValueList values = func.Call().AsList();
+  Stats stats;
+  stats.subscriptionCount = values.size();
+  stats.filterCount = 0;
+  stats.matchCacheSize = matchCache ? matchCache->GetSize() : 0;
+  stats.elemHideCacheSize = elemHideCache->GetSize();
+  stats.whitelistCacheSize = whitelistCache->GetSize();
+  Matcher::PrefilterStats prefilterStats = matcher->GetPrefilterStats();
+  stats.prefilterSize = prefilterStats.size;
+  stats.prefilterFalsePositiveRate = prefilterStats.falsePositiveRate;
+  stats.prefilterPassedCount = prefilterStats.passedCount;
+  stats.prefilterRejectedCount = prefilterStats.rejectedCount;
+  stats.sharedFilterCount = MatcherFilter::GetSharedCount();
+  for (const auto& value : values)
+  {
+    JsValueList fields = value.AsList();
+    SubscriptionStats subscription;
+    subscription.url = fields[0].AsString();
+    subscription.filterCount = static_cast<size_t>(fields[1].AsInt());
+    subscription.disabled = fields[3].AsBool();
+    subscription.unloaded = fields[4].AsBool();
+    // Unloaded filters are only kept as text.
+    subscription.approximateSize = static_cast<size_t>(fields[2].AsInt());
+    if (!subscription.unloaded)
+      subscription.approximateSize += subscription.filterCount * APPROXIMATE_FILTER_OVERHEAD;
+    stats.filterCount += subscription.filterCount;
+    stats.subscriptions.push_back(std::move(subscription));
+  }
+  return stats;
+}
+
+void FilterEngine::EndMatcherUpdate()
+{
+  if (!matcherUpdateQueue)
+    matcherUpdateQueue = std::make_shared<WorkQueue>();
+  std::shared_ptr<Matcher> matcher = this->matcher;
+  matcherUpdateQueue->Post([matcher]()
+  {
+    matcher->EndUpdate();
+  });
+}
+
+LatencyHistogram* FilterEngine::GetMetricsHistogram(MetricsApi api) const
+{
+  return metrics ? metrics.get() + api : nullptr;
+}
+
+std::vector<LatencyMetrics> FilterEngine::GetMetrics() const
+{
+  static const char* const names[METRICS_API_COUNT] = {"Matches",
+    "IsDocumentWhitelisted", "GetElementHidingSelectors", "GetPref",
+    "SubscriptionUpdate"};
+  std::vector<LatencyMetrics> result;
+  if (!metrics)
+    return result;
+  for (int i = 0; i < METRICS_API_COUNT; i++)
+    result.push_back(metrics.get()[i].GetMetrics(names[i]));
+  return result;
+}
+
+void FilterEngine::ResetMetrics()
+{
+  if (!metrics)
+    return;
+  for (int i = 0; i < METRICS_API_COUNT; i++)
+    metrics.get()[i].Reset();
+}
+
+const MatcherFilterPtr& FilterEngine::RecordFilterHit(
+    const MatcherFilterPtr& match) const
+{
+  if (hitStatistics && match)
+    hitStatistics->Record(match);
+  return match;
+}
+
+std::vector<FilterEngine::FilterHits> FilterEngine::GetTopFilterHits(
+    size_t count) const
+{
+  std::vector<FilterHits> result;
+  if (!hitStatistics)
+    return result;
+  for (const auto& entry : hitStatistics->GetTop(count))
+  {
+    FilterHits hits;
+    hits.text = entry.text;
+    hits.hitCount = entry.hitCount;
+    hits.lastHit = entry.lastHit;
+    result.push_back(hits);
+  }
+  return result;
+}
+
+void FilterEngine::FlushFilterHits() const
+{
+  if (!hitStatistics)
+    return;
+  std::vector<FilterHitStatistics::Entry> entries = hitStatistics->Collect();
+  if (entries.empty())
+    return;
+  const JsContext context(*jsEngine);
+  JsValue addFilterHits = jsEngine->GetApiFunction("addFilterHits");
+  for (const auto& entry : entries)
+  {
+    JsValueList params;
+    params.push_back(jsEngine->NewValue(entry.text));
+    params.push_back(jsEngine->NewValue(static_cast<int64_t>(entry.hitCount)));
+    params.push_back(jsEngine->NewValue(entry.lastHit));
+    addFilterHits.Call(params);
+  }
 }
 
 std::vector<std::string> FilterEngine::GetElementHidingSelectors(const std::string& domain) const
 {
-  JsValue func = jsEngine->Evaluate("API.getElementHidingSelectors");
-  JsValueList result = func.Call(jsEngine->NewValue(domain)).AsList();
-  std::vector<std::string> selectors;
-  for (const auto& r: result)
-    selectors.push_back(r.AsString());
+  return *GetSharedElementHidingSelectors(domain);
+}
+
+void FilterEngine::GetElementHidingSelectors(const std::string& domain,
+  std::vector<std::string>& selectors) const
+{
+  ElementHidingSelectorsPtr shared = GetSharedElementHidingSelectors(domain);
+  selectors.assign(shared->begin(), shared->end());
+}
+
+FilterEngine::ElementHidingSelectorsPtr FilterEngine::GetSharedElementHidingSelectors(
+    const std::string& domain) const
+{
+  ScopedLatency latency(GetMetricsHistogram(METRICS_GET_ELEMENT_HIDING_SELECTORS));
+  ElementHidingSelectorsPtr cached = elemHideCache->Lookup(domain);
+  if (cached)
+    return cached;
+
+  uint64_t generation = elemHideCache->GetGeneration();
+  std::shared_ptr<std::vector<std::string>> selectors =
+    std::make_shared<std::vector<std::string>>();
+  if (elemHideIndexing != ELEM_HIDE_INDEXING_DISABLED)
+  {
+    const JsContext context(*jsEngine);
+    Utils::FromV8StringArray(context.Call(context.GetApiFunction("getElementHidingSelectors"),
+      context.NewString(domain)), *selectors);
+  }
+  if (ruleset)
+    ruleset->GetElementHidingSelectors(domain, *selectors);
+  elemHideCache->Insert(domain, selectors, generation);
   return selectors;
 }
 
 JsValue FilterEngine::GetPref(const std::string& pref) const
 {
-  JsValue func = jsEngine->Evaluate("API.getPref");
-  return func.Call(jsEngine->NewValue(pref));
+  ScopedLatency latency(GetMetricsHistogram(METRICS_GET_PREF));
+  PrefsCache::Value value;
+  if (prefsCache->Get(pref, value))
+  {
+    switch (value.type)
+    {
+    case PrefsCache::Value::TYPE_BOOL:
+      return jsEngine->NewValue(value.boolValue);
+    case PrefsCache::Value::TYPE_INT:
+      return jsEngine->NewValue(value.intValue);
+    default:
+      return jsEngine->NewValue(value.stringValue);
+    }
+  }
+
+  const JsContext context(*jsEngine);
+  return context.Wrap(context.Call(context.GetApiFunction("getPref"),
+    context.NewString(pref)));
+}
+
+bool FilterEngine::GetCachedPref(const std::string& pref, bool& value) const
+{
+  PrefsCache::Value cached;
+  if (!prefsCache->Get(pref, cached) || cached.type != PrefsCache::Value::TYPE_BOOL)
+    return false;
+  value = cached.boolValue;
+  return true;
+}
+
+bool FilterEngine::GetCachedPref(const std::string& pref, int64_t& value) const
+{
+  PrefsCache::Value cached;
+  if (!prefsCache->Get(pref, cached) || cached.type != PrefsCache::Value::TYPE_INT)
+    return false;
+  value = cached.intValue;
+  return true;
+}
+
+bool FilterEngine::GetCachedPref(const std::string& pref, std::string& value) const
+{
+  PrefsCache::Value cached;
+  if (!prefsCache->Get(pref, cached) || cached.type != PrefsCache::Value::TYPE_STRING)
+    return false;
+  value = cached.stringValue;
+  return true;
 }
 
 void FilterEngine::SetPref(const std::string& pref, const JsValue& value)
 {
-  JsValue func = jsEngine->Evaluate("API.setPref");
-  JsValueList params;
-  params.push_back(jsEngine->NewValue(pref));
-  params.push_back(value);
-  func.Call(params);
+  const JsContext context(*jsEngine);
+  context.Call(context.GetApiFunction("setPref"), context.NewString(pref),
+    value.UnwrapValue());
+}
+
+void FilterEngine::FlushPrefs()
+{
+  // Only one caller can wait for the event at a time.
+  std::lock_guard<std::mutex> lock(flushPrefsMutex);
+  auto sync = std::make_shared<Sync>();
+  jsEngine->SetEventCallback("_prefsFlushed", [sync](JsValueList&& params)
+  {
+    sync->Set();
+  });
+  jsEngine->GetApiFunction("flushPrefs").Call();
+  sync->Wait();
+  jsEngine->RemoveEventCallback("_prefsFlushed");
 }
 
 std::string FilterEngine::GetHostFromURL(const std::string& url) const
 {
-  JsValue func = jsEngine->Evaluate("API.getHostFromUrl");
-  return func.Call(jsEngine->NewValue(url)).AsString();
+  return BaseDomain::ExtractHostFromURL(url);
 }
 
 void FilterEngine::SetUpdateAvailableCallback(
@@ -530,6 +1582,7 @@ void FilterEngine::SetUpdateAvailableCallback(
     if (params.size() >= 1 && !params[0].IsNull())
       callback(params[0].AsString());
   });
+  jsEngine->GetApiFunction("startUpdater").Call();
 }
 
 void FilterEngine::RemoveUpdateAvailableCallback()
@@ -540,7 +1593,7 @@ void FilterEngine::RemoveUpdateAvailableCallback()
 void FilterEngine::ForceUpdateCheck(
     const FilterEngine::UpdateCheckDoneCallback& callback)
 {
-  JsValue func = jsEngine->Evaluate("API.forceUpdateCheck");
+  JsValue func = jsEngine->GetApiFunction("forceUpdateCheck");
   JsValueList params;
   if (callback)
   {
@@ -576,10 +1629,12 @@ void FilterEngine::SetAllowedConnectionType(const std::string* value)
 
 std::unique_ptr<std::string> FilterEngine::GetAllowedConnectionType() const
 {
-   auto prefValue = GetPref("allowed_connection_type");
-   if (prefValue.AsString().empty())
+   std::string value;
+   if (!GetCachedPref("allowed_connection_type", value))
+     value = GetPref("allowed_connection_type").AsString();
+   if (value.empty())
      return nullptr;
-   return std::unique_ptr<std::string>(new std::string(prefValue.AsString()));
+   return std::unique_ptr<std::string>(new std::string(value));
 }
 
 void FilterEngine::FilterChanged(const FilterEngine::FilterChangeCallback& callback, JsValueList&& params) const
@@ -591,25 +1646,25 @@ void FilterEngine::FilterChanged(const FilterEngine::FilterChangeCallback& callb
 
 int FilterEngine::CompareVersions(const std::string& v1, const std::string& v2) const
 {
-  JsValueList params;
-  params.push_back(jsEngine->NewValue(v1));
-  params.push_back(jsEngine->NewValue(v2));
-  JsValue func = jsEngine->Evaluate("API.compareVersions");
-  return func.Call(params).AsInt();
+  const JsContext context(*jsEngine);
+  return context.Call(context.GetApiFunction("compareVersions"),
+    context.NewString(v1), context.NewString(v2))->IntegerValue();
 }
 
-FilterPtr FilterEngine::GetWhitelistingFilter(const std::string& url,
+MatcherFilterPtr FilterEngine::GetWhitelistingFilter(const std::string& url,
   ContentTypeMask contentTypeMask, const std::string& documentUrl) const
 {
-  FilterPtr match = Matches(url, contentTypeMask, documentUrl);
-  if (match && match->GetType() == Filter::TYPE_EXCEPTION)
+  std::vector<std::string> documentUrls;
+  documentUrls.push_back(documentUrl);
+  MatcherFilterPtr match = MatchesInternal(url, contentTypeMask, documentUrls);
+  if (match && match->IsException())
   {
     return match;
   }
-  return FilterPtr();
+  return MatcherFilterPtr();
 }
 
-FilterPtr FilterEngine::GetWhitelistingFilter(const std::string& url,
+MatcherFilterPtr FilterEngine::GetWhitelistingFilter(const std::string& url,
   ContentTypeMask contentTypeMask,
   const std::vector<std::string>& documentUrls) const
 {
@@ -618,18 +1673,28 @@ FilterPtr FilterEngine::GetWhitelistingFilter(const std::string& url,
     return GetWhitelistingFilter(url, contentTypeMask, "");
   }
 
+  // Walking the chain matches every frame against its parent, the result
+  // is cached for the whole chain until the filters change. URLs can't
+  // contain line breaks, so joining them gives a unique key.
+  std::string chainKey;
+  for (const auto& documentUrl : documentUrls)
+    chainKey += documentUrl + '\n';
+  uint64_t generation = matcher->GetGeneration();
+  MatcherFilterPtr result;
+  if (whitelistCache->Lookup(url, contentTypeMask, chainKey, false,
+      generation, result))
+    return result;
+
   std::vector<std::string>::const_iterator urlIterator = documentUrls.begin();
   std::string currentUrl = url;
   do
   {
     std::string parentUrl = *urlIterator++;
-    FilterPtr filter = GetWhitelistingFilter(currentUrl, contentTypeMask, parentUrl);
-    if (filter)
-    {
-      return filter;
-    }
+    result = GetWhitelistingFilter(currentUrl, contentTypeMask, parentUrl);
     currentUrl = parentUrl;
   }
-  while (urlIterator != documentUrls.end());
-  return FilterPtr();
+  while (!result && urlIterator != documentUrls.end());
+  whitelistCache->Insert(url, contentTypeMask, chainKey, false, generation,
+    result);
+  return result;
 }
@@ -0,0 +1,91 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <initializer_list>
+
+#include "FilterHitStatistics.h"
+
+using namespace AdblockPlus;
+
+void FilterHitStatistics::Record(const MatcherFilterPtr& filter)
+{
+  int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  if (!filter->AddHit(now))
+    return;
+  std::lock_guard<std::mutex> lock(pendingMutex);
+  pending.push_back(filter);
+}
+
+void FilterHitStatistics::TakePending()
+{
+  std::vector<MatcherFilterPtr> filters;
+  {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    filters.swap(pending);
+  }
+
+  for (const auto& filter : filters)
+  {
+    int64_t lastHit;
+    uint32_t hitCount = filter->TakeHits(lastHit);
+    if (!hitCount)
+      continue;
+    for (EntryMap* entries : {&totals, &collected})
+    {
+      Entry& entry = (*entries)[filter->GetText()];
+      entry.text = filter->GetText();
+      entry.hitCount += hitCount;
+      entry.lastHit = std::max(entry.lastHit, lastHit);
+    }
+  }
+}
+
+std::vector<FilterHitStatistics::Entry> FilterHitStatistics::Collect()
+{
+  std::vector<Entry> result;
+  std::lock_guard<std::mutex> lock(entriesMutex);
+  TakePending();
+  result.reserve(collected.size());
+  for (const auto& entry : collected)
+    result.push_back(entry.second);
+  collected.clear();
+  return result;
+}
+
+std::vector<FilterHitStatistics::Entry> FilterHitStatistics::GetTop(size_t count)
+{
+  std::vector<Entry> result;
+  {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    TakePending();
+    result.reserve(totals.size());
+    for (const auto& total : totals)
+      result.push_back(total.second);
+  }
+  count = std::min(count, result.size());
+  std::partial_sort(result.begin(), result.begin() + count, result.end(),
+    [](const Entry& a, const Entry& b)
+    {
+      return a.hitCount > b.hitCount ||
+        (a.hitCount == b.hitCount && a.text < b.text);
+    });
+  result.resize(count);
+  return result;
+}
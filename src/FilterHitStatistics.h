@@ -0,0 +1,85 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_FILTER_HIT_STATISTICS_H
+#define ADBLOCK_PLUS_FILTER_HIT_STATISTICS_H
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Matcher.h"
+
+namespace AdblockPlus
+{
+  /**
+   * Counts the matches of native filters. The counters are atomics in the
+   * filters, only the first match of a filter since the last `Collect()`
+   * takes a lock, to remember the filter.
+   */
+  class FilterHitStatistics
+  {
+  public:
+    struct Entry
+    {
+      std::string text;
+      uint64_t hitCount;
+      /// Milliseconds since the epoch.
+      int64_t lastHit;
+    };
+
+    /**
+     * Counts a match of the filter at the current time.
+     */
+    void Record(const MatcherFilterPtr& filter);
+
+    /**
+     * Retrieves the matches counted since the last call.
+     * @return Matches since the last call, one entry per filter.
+     */
+    std::vector<Entry> Collect();
+
+    /**
+     * Returns the filters with the most matches since the creation of this
+     * instance, including the ones not collected yet.
+     * @param count Maximal number of filters to return.
+     * @return Filters sorted by descending number of matches.
+     */
+    std::vector<Entry> GetTop(size_t count);
+
+  private:
+    typedef std::unordered_map<std::string, Entry> EntryMap;
+
+    std::mutex pendingMutex;
+    /// Filters matched since the last `TakePending()`.
+    std::vector<MatcherFilterPtr> pending;
+    std::mutex entriesMutex;
+    EntryMap totals;
+    /// Matches taken from the filters but not returned by `Collect()` yet.
+    EntryMap collected;
+
+    /**
+     * Moves the counters of the pending filters to `totals` and `collected`,
+     * `entriesMutex` has to be locked.
+     */
+    void TakePending();
+  };
+}
+
+#endif
@@ -35,19 +35,30 @@ namespace
 {
   v8::Handle<v8::Value> SetTimeoutCallback(const v8::Arguments& arguments)
   {
+    v8::Isolate* isolate = arguments.GetIsolate();
+    int64_t timerId;
     try
     {
-      AdblockPlus::JsEngine::ScheduleTimer(arguments);
+      timerId = AdblockPlus::JsEngine::ScheduleTimer(arguments);
     }
     catch (const std::exception& e)
     {
-      v8::Isolate* isolate = arguments.GetIsolate();
       return v8::ThrowException(Utils::ToV8String(isolate, e.what()));
     }
+    return v8::Number::New(isolate, timerId);
+  }
 
-    // We should actually return the timer ID here, which could be
-    // used via clearTimeout(). But since we don't seem to need
-    // clearTimeout(), we can save that for later.
+  v8::Handle<v8::Value> ClearTimeoutCallback(const v8::Arguments& arguments)
+  {
+    try
+    {
+      AdblockPlus::JsEngine::CancelTimer(arguments);
+    }
+    catch (const std::exception& e)
+    {
+      v8::Isolate* isolate = arguments.GetIsolate();
+      return v8::ThrowException(Utils::ToV8String(isolate, e.what()));
+    }
     return v8::Undefined();
   }
 
@@ -72,6 +83,7 @@ JsValue& GlobalJsObject::Setup(JsEngine& jsEngine, const AppInfo& appInfo,
     JsValue& obj)
 {
   obj.SetProperty("setTimeout", jsEngine.NewCallback(::SetTimeoutCallback));
+  obj.SetProperty("clearTimeout", jsEngine.NewCallback(::ClearTimeoutCallback));
   obj.SetProperty("_triggerEvent", jsEngine.NewCallback(::TriggerEventCallback));
   auto value = jsEngine.NewObject();
   obj.SetProperty("_fileSystem", FileSystemJsObject::Setup(jsEngine, value));
@@ -16,11 +16,129 @@
  */
 
 #include "JsContext.h"
+#include "JsError.h"
+#include "LatencyHistogram.h"
+#include "Utils.h"
 
-AdblockPlus::JsContext::JsContext(JsEngine& jsEngine)
-    : locker(jsEngine.GetIsolate()), isolateScope(jsEngine.GetIsolate()),
-      handleScope(jsEngine.GetIsolate()),
+AdblockPlus::JsContext::LockTiming::LockTiming(JsEngine& jsEngine,
+  JsEngine::LockSite site)
+  : waitHistogram(nullptr), holdHistogram(nullptr)
+{
+  if (v8::Locker::IsLocked(jsEngine.GetIsolate()))
+    return;
+  ++jsEngine.contextEntries;
+  if (!jsEngine.lockMetricsEnabled)
+    return;
+  waitHistogram = &jsEngine.lockMetrics[2 * site];
+  holdHistogram = &jsEngine.lockMetrics[2 * site + 1];
+  start = std::chrono::steady_clock::now();
+}
+
+void AdblockPlus::JsContext::LockTiming::Acquired()
+{
+  if (!waitHistogram)
+    return;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  waitHistogram->Record(now - start);
+  start = now;
+}
+
+AdblockPlus::JsContext::LockTiming::~LockTiming()
+{
+  if (holdHistogram)
+    holdHistogram->Record(std::chrono::steady_clock::now() - start);
+}
+
+AdblockPlus::JsContext::PriorityGate::PriorityGate(JsEngine& jsEngine,
+  JsEngine::LockSite site)
+  : jsEngine(jsEngine), waiting(false)
+{
+  if (v8::Locker::IsLocked(jsEngine.GetIsolate()))
+    return;
+  if (site == JsEngine::LOCK_SITE_API)
+  {
+    waiting = true;
+    ++jsEngine.waitingApiEntries;
+    return;
+  }
+  if (!jsEngine.waitingApiEntries || !jsEngine.maxBackgroundDelayMillis)
+    return;
+
+  auto apiEntriesDone = [&jsEngine]()
+  {
+    return !jsEngine.waitingApiEntries || !jsEngine.maxBackgroundDelayMillis;
+  };
+  std::unique_lock<std::mutex> lock(jsEngine.priorityMutex);
+  if (apiEntriesDone())
+    return;
+  ++jsEngine.deferredBackgroundEntries;
+  jsEngine.priorityCondition.wait_for(lock,
+    std::chrono::milliseconds(jsEngine.maxBackgroundDelayMillis),
+    apiEntriesDone);
+}
+
+void AdblockPlus::JsContext::PriorityGate::Acquired()
+{
+  if (!waiting)
+    return;
+  waiting = false;
+  if (--jsEngine.waitingApiEntries)
+    return;
+  std::lock_guard<std::mutex> lock(jsEngine.priorityMutex);
+  jsEngine.priorityCondition.notify_all();
+}
+
+AdblockPlus::JsContext::PriorityGate::~PriorityGate()
+{
+  Acquired();
+}
+
+AdblockPlus::JsContext::JsContext(JsEngine& jsEngine, JsEngine::LockSite site)
+    : jsEngine(jsEngine), lockTiming(jsEngine, site),
+      priorityGate(jsEngine, site), locker(jsEngine.GetIsolate()),
+      isolateScope(jsEngine.GetIsolate()), handleScope(jsEngine.GetIsolate()),
       context(v8::Local<v8::Context>::New(jsEngine.GetIsolate(), *jsEngine.context)),
       contextScope(context)
 {
+  lockTiming.Acquired();
+  priorityGate.Acquired();
+}
+
+v8::Local<v8::Function> AdblockPlus::JsContext::GetApiFunction(const std::string& name) const
+{
+  auto& values = jsEngine.apiFunctions.values;
+  auto it = values.find(name);
+  if (it == values.end())
+  {
+    JsValue function = jsEngine.Evaluate("API." + name);
+    if (!function.IsFunction())
+      throw std::runtime_error("API." + name + " is not a function");
+    it = values.insert(std::make_pair(name,
+      std::unique_ptr<v8::Persistent<v8::Value>>(new v8::Persistent<v8::Value>(
+        jsEngine.GetIsolate(), function.UnwrapValue())))).first;
+  }
+  return v8::Local<v8::Function>::Cast(
+    v8::Local<v8::Value>::New(jsEngine.GetIsolate(), *it->second));
+}
+
+v8::Local<v8::Value> AdblockPlus::JsContext::CallWithArguments(
+  v8::Local<v8::Function> function, v8::Local<v8::Object> thisObj, int argc,
+  v8::Handle<v8::Value> argv[]) const
+{
+  const v8::TryCatch tryCatch;
+  ++jsEngine.functionCalls;
+  v8::Local<v8::Value> result = function->Call(thisObj, argc, argv);
+  if (tryCatch.HasCaught())
+    throw JsError(tryCatch.Exception(), tryCatch.Message());
+  return result;
+}
+
+v8::Local<v8::String> AdblockPlus::JsContext::NewString(const std::string& text) const
+{
+  return Utils::ToV8String(jsEngine.GetIsolate(), text);
+}
+
+AdblockPlus::JsValue AdblockPlus::JsContext::Wrap(v8::Handle<v8::Value> value) const
+{
+  return JsValue(jsEngine.shared_from_this(), value);
 }
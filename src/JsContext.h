@@ -18,22 +18,105 @@
 #ifndef ADBLOCK_PLUS_JS_CONTEXT_H
 #define ADBLOCK_PLUS_JS_CONTEXT_H
 
+#include <chrono>
+#include <string>
 #include <v8.h>
 #include <AdblockPlus/JsEngine.h>
 
 namespace AdblockPlus
 {
+  /**
+   * Locks and enters the isolate and the context of a `JsEngine`.
+   * The local handles created while it exists stay valid until it is
+   * destroyed. Unlike `JsValue` they don't require a persistent handle each,
+   * so the methods operating on them are preferable for short-lived values.
+   */
   class JsContext
   {
   public:
-    explicit JsContext(JsEngine& jsEngine);
+    /**
+     * @param site Code path locking the engine, for
+     *        `JsEngine::GetLockMetrics()`. Only matters for the outermost
+     *        context of a thread, nested ones don't wait for the lock.
+     */
+    explicit JsContext(JsEngine& jsEngine,
+      JsEngine::LockSite site = JsEngine::LOCK_SITE_API);
 
     v8::Local<v8::Context> GetV8Context() const
     {
       return context;
     }
 
+    /**
+     * Returns a function of the `API` object, see
+     * `JsEngine::GetApiFunction()`.
+     */
+    v8::Local<v8::Function> GetApiFunction(const std::string& name) const;
+
+    /**
+     * Calls a function with the global object as `this`.
+     * @throw `JsError` if the function throws.
+     */
+    template<typename... Args>
+    v8::Local<v8::Value> Call(v8::Local<v8::Function> function, Args... args) const
+    {
+      // One extra element, so that the array isn't empty without arguments.
+      v8::Handle<v8::Value> argv[] = {args..., v8::Handle<v8::Value>()};
+      return CallWithArguments(function, context->Global(),
+        static_cast<int>(sizeof...(args)), argv);
+    }
+
+    /**
+     * Calls a function with the supplied arguments.
+     * @throw `JsError` if the function throws.
+     */
+    v8::Local<v8::Value> CallWithArguments(v8::Local<v8::Function> function,
+      v8::Local<v8::Object> thisObj, int argc, v8::Handle<v8::Value> argv[]) const;
+
+    /**
+     * Creates a string from UTF-8 text.
+     */
+    v8::Local<v8::String> NewString(const std::string& text) const;
+
+    /**
+     * Wraps a local handle into a `JsValue` which outlives the context.
+     */
+    JsValue Wrap(v8::Handle<v8::Value> value) const;
+
   private:
+    /// Counts the entries of the engine and records the time spent waiting
+    /// for the lock and holding it if lock metrics are enabled, declared
+    /// before `locker` to enclose it.
+    class LockTiming
+    {
+    public:
+      LockTiming(JsEngine& jsEngine, JsEngine::LockSite site);
+      ~LockTiming();
+      void Acquired();
+
+    private:
+      LatencyHistogram* waitHistogram;
+      LatencyHistogram* holdHistogram;
+      std::chrono::steady_clock::time_point start;
+    };
+
+    /// Lets outermost API entries lock the engine before background ones,
+    /// see `JsEngine::SetApiPriority()`, declared before `locker` as well.
+    class PriorityGate
+    {
+    public:
+      PriorityGate(JsEngine& jsEngine, JsEngine::LockSite site);
+      ~PriorityGate();
+      void Acquired();
+
+    private:
+      JsEngine& jsEngine;
+      bool waiting;
+    };
+
+    JsEngine& jsEngine;
+    LockTiming lockTiming;
+    PriorityGate priorityGate;
     const v8::Locker locker;
     const v8::Isolate::Scope isolateScope;
     const v8::HandleScope handleScope;
@@ -15,20 +15,29 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <v8-profiler.h>
 #include <AdblockPlus.h>
 #include "GlobalJsObject.h"
 #include "JsContext.h"
 #include "JsError.h"
+#include "LatencyHistogram.h"
+#include "WebRequestMetrics.h"
 #include "Utils.h"
 #include "DefaultTimer.h"
+#include "WorkQueue.h"
+#ifdef _WIN32
+#include "WinHttpWebRequest.h"
+#endif
 
 namespace
 {
   v8::Handle<v8::Script> CompileScript(v8::Isolate* isolate,
-    const std::string& source, const std::string& filename)
+    const v8::Handle<v8::String>& v8Source, const std::string& filename)
   {
     using AdblockPlus::Utils::ToV8String;
-    const v8::Handle<v8::String> v8Source = ToV8String(isolate, source);
     if (filename.length())
     {
       const v8::Handle<v8::String> v8Filename = ToV8String(isolate, filename);
@@ -38,6 +47,33 @@ namespace
       return v8::Script::Compile(v8Source);
   }
 
+  v8::Handle<v8::Script> CompileScript(v8::Isolate* isolate,
+    const v8::Handle<v8::String>& v8Source, const std::string& filename,
+    std::string& cachedData)
+  {
+    using AdblockPlus::Utils::ToV8String;
+    std::unique_ptr<v8::ScriptData> scriptData;
+    if (!cachedData.empty())
+    {
+      scriptData.reset(v8::ScriptData::New(cachedData.data(),
+        static_cast<int>(cachedData.size())));
+      if (scriptData->HasError())
+        scriptData.reset();
+    }
+    if (!scriptData)
+    {
+      cachedData.clear();
+      scriptData.reset(v8::ScriptData::PreCompile(v8Source));
+      // Syntax errors are reported by the compilation below.
+      if (scriptData->HasError())
+        scriptData.reset();
+      else
+        cachedData.assign(scriptData->Data(), scriptData->Length());
+    }
+    v8::ScriptOrigin origin(ToV8String(isolate, filename));
+    return v8::Script::Compile(v8Source, &origin, scriptData.get());
+  }
+
   void CheckTryCatch(const v8::TryCatch& tryCatch)
   {
     if (tryCatch.HasCaught())
@@ -63,13 +99,286 @@ namespace
       static V8Initializer initializer;
     }
   };
+
+  int ToV8Size(size_t size)
+  {
+    return static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+  }
+
+  // Calls the near heap limit callbacks of the isolates after garbage
+  // collections, on a thread per isolate. V8 only supports process-wide GC
+  // callbacks.
+  class HeapLimitWatcher
+  {
+  public:
+    static void Add(v8::Isolate* isolate, const AdblockPlus::HeapLimits& heapLimits)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!registered)
+      {
+        v8::V8::AddGCEpilogueCallback(OnGarbageCollected);
+        registered = true;
+      }
+      auto entry = std::make_shared<Entry>();
+      entry->heapLimits = heapLimits;
+      entry->nearHeapLimit = false;
+      entry->notifications.reset(new AdblockPlus::WorkQueue());
+      entries()[isolate] = entry;
+    }
+
+    static void Remove(v8::Isolate* isolate)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries().erase(isolate);
+    }
+
+  private:
+    struct Entry
+    {
+      AdblockPlus::HeapLimits heapLimits;
+      bool nearHeapLimit;
+      /// Runs the callback once the garbage collection finished.
+      std::unique_ptr<AdblockPlus::WorkQueue> notifications;
+    };
+    typedef std::map<v8::Isolate*, std::shared_ptr<Entry>> Entries;
+
+    static Entries& entries()
+    {
+      static Entries instance;
+      return instance;
+    }
+
+    static void OnGarbageCollected(v8::GCType type, v8::GCCallbackFlags flags)
+    {
+      v8::Isolate* isolate = v8::Isolate::GetCurrent();
+      std::shared_ptr<Entry> entry;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries().find(isolate);
+        if (it == entries().end())
+          return;
+        entry = it->second;
+      }
+      // Only the thread holding the isolate lock gets here, so the entry of
+      // the isolate isn't accessed concurrently.
+      v8::HeapStatistics statistics;
+      isolate->GetHeapStatistics(&statistics);
+      bool nearHeapLimit = statistics.used_heap_size() >
+        entry->heapLimits.nearHeapLimitRatio * statistics.heap_size_limit();
+      if (nearHeapLimit && !entry->nearHeapLimit)
+      {
+        // The callback must not run inside of the garbage collection, the
+        // work queue also keeps its exceptions from propagating into V8.
+        auto callback = entry->heapLimits.nearHeapLimitCallback;
+        size_t usedHeapSize = statistics.used_heap_size();
+        size_t heapSizeLimit = statistics.heap_size_limit();
+        entry->notifications->Post([callback, usedHeapSize, heapSizeLimit]
+        {
+          callback(usedHeapSize, heapSizeLimit);
+        });
+      }
+      entry->nearHeapLimit = nearHeapLimit;
+    }
+
+    static std::mutex mutex;
+    static bool registered;
+  };
+
+  std::mutex HeapLimitWatcher::mutex;
+  bool HeapLimitWatcher::registered = false;
+
+  class DefaultIoExecutor : public AdblockPlus::IExecutor
+  {
+  public:
+    explicit DefaultIoExecutor(size_t threadCount)
+      : workQueue(threadCount)
+    {
+    }
+
+    void Dispatch(const Task& task, const std::string& key) override
+    {
+      workQueue.Post(task, key);
+    }
+
+  private:
+    AdblockPlus::WorkQueue workQueue;
+  };
+
+  // Dispatches the completion callbacks of the file system to an executor.
+  class CallbackDispatchingFileSystem : public AdblockPlus::IFileSystem
+  {
+  public:
+    CallbackDispatchingFileSystem(const AdblockPlus::AsyncFileSystemPtr& impl,
+      const std::shared_ptr<AdblockPlus::IExecutor>& executor)
+      : impl(impl), executor(executor)
+    {
+    }
+
+    void Read(const std::string& path, const ReadCallback& callback) override
+    {
+      impl->Read(path, Wrap(callback));
+    }
+
+    void ReadRange(const std::string& path, uint64_t offset, size_t size,
+      const ReadCallback& callback) override
+    {
+      impl->ReadRange(path, offset, size, Wrap(callback));
+    }
+
+    void Write(const std::string& path, IoBuffer&& data, const Callback& callback) override
+    {
+      impl->Write(path, std::move(data), Wrap(callback));
+    }
+
+    void Move(const std::string& fromPath, const std::string& toPath, const Callback& callback) override
+    {
+      impl->Move(fromPath, toPath, Wrap(callback));
+    }
+
+    void Copy(const std::string& fromPath, const std::string& toPath, const Callback& callback) override
+    {
+      impl->Copy(fromPath, toPath, Wrap(callback));
+    }
+
+    void Remove(const std::string& path, const Callback& callback) override
+    {
+      impl->Remove(path, Wrap(callback));
+    }
+
+    void Stat(const std::string& path, const StatCallback& callback) override
+    {
+      auto executor = this->executor;
+      impl->Stat(path, [executor, callback](const StatResult& result, const std::string& error)
+      {
+        executor->Dispatch([callback, result, error]
+        {
+          callback(result, error);
+        }, std::string());
+      });
+    }
+
+    std::string Resolve(const std::string& path) const override
+    {
+      return impl->Resolve(path);
+    }
+
+  private:
+    ReadCallback Wrap(const ReadCallback& callback) const
+    {
+      auto executor = this->executor;
+      return [executor, callback](IoBuffer&& data, const std::string& error)
+      {
+        auto sharedData = std::make_shared<IoBuffer>(std::move(data));
+        executor->Dispatch([callback, sharedData, error]
+        {
+          callback(std::move(*sharedData), error);
+        }, std::string());
+      };
+    }
+
+    Callback Wrap(const Callback& callback) const
+    {
+      auto executor = this->executor;
+      return [executor, callback](const std::string& error)
+      {
+        executor->Dispatch([callback, error]
+        {
+          callback(error);
+        }, std::string());
+      };
+    }
+
+    AdblockPlus::AsyncFileSystemPtr impl;
+    std::shared_ptr<AdblockPlus::IExecutor> executor;
+  };
+
+  const char CPU_PROFILE_TITLE[] = "libadblockplus";
+
+  void AppendJsonString(std::string& json, const std::string& value)
+  {
+    json += '"';
+    for (char c : value)
+    {
+      switch (c)
+      {
+      case '"':
+        json += "\\\"";
+        break;
+      case '\\':
+        json += "\\\\";
+        break;
+      case '\n':
+        json += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20)
+        {
+          const char* const hexDigits = "0123456789abcdef";
+          json += "\\u00";
+          json += hexDigits[c >> 4];
+          json += hexDigits[c & 0xF];
+        }
+        else
+          json += c;
+      }
+    }
+    json += '"';
+  }
+
+  // Writes a node of the call tree in the format of .cpuprofile files.
+  void AppendCpuProfileNode(std::string& json, const v8::CpuProfileNode* node)
+  {
+    json += "{\"id\":" + std::to_string(node->GetNodeId());
+    json += ",\"functionName\":";
+    AppendJsonString(json, AdblockPlus::Utils::FromV8String(node->GetFunctionName()));
+    json += ",\"url\":";
+    AppendJsonString(json, AdblockPlus::Utils::FromV8String(node->GetScriptResourceName()));
+    json += ",\"lineNumber\":" + std::to_string(node->GetLineNumber());
+    json += ",\"hitCount\":" + std::to_string(node->GetHitCount());
+    json += ",\"callUID\":" + std::to_string(node->GetCallUid());
+    json += ",\"children\":[";
+    for (int i = 0; i < node->GetChildrenCount(); i++)
+    {
+      if (i)
+        json += ',';
+      AppendCpuProfileNode(json, node->GetChild(i));
+    }
+    json += "]}";
+  }
+
+  class StringOutputStream : public v8::OutputStream
+  {
+  public:
+    explicit StringOutputStream(std::string& data)
+      : data(data)
+    {
+    }
+
+    void EndOfStream() override
+    {
+    }
+
+    int GetChunkSize() override
+    {
+      return 64 * 1024;
+    }
+
+    WriteResult WriteAsciiChunk(char* chunk, int size) override
+    {
+      data.append(chunk, size);
+      return kContinue;
+    }
+
+  private:
+    std::string& data;
+  };
 }
 
 using namespace AdblockPlus;
 
-TimerPtr AdblockPlus::CreateDefaultTimer()
+TimerPtr AdblockPlus::CreateDefaultTimer(const std::chrono::milliseconds& slack)
 {
-  return TimerPtr(new DefaultTimer());
+  return TimerPtr(new DefaultTimer(slack));
 }
 
 WebRequestPtr AdblockPlus::CreateDefaultWebRequest()
@@ -77,25 +386,97 @@ WebRequestPtr AdblockPlus::CreateDefaultWebRequest()
   return WebRequestPtr(new DefaultWebRequest(std::make_shared<DefaultWebRequestSync>()));
 }
 
-AdblockPlus::ScopedV8Isolate::ScopedV8Isolate()
+#ifdef _WIN32
+WebRequestPtr AdblockPlus::CreateWinHttpWebRequest()
+{
+  return WebRequestPtr(new WinHttpWebRequest());
+}
+#endif
+
+ExecutorPtr AdblockPlus::CreateDefaultIoExecutor(size_t threadCount)
+{
+  return ExecutorPtr(new DefaultIoExecutor(threadCount));
+}
+
+AdblockPlus::ScopedV8Isolate::ScopedV8Isolate(const HeapLimits& heapLimits)
 {
   V8Initializer::Init();
   isolate = v8::Isolate::New();
+  if (heapLimits.maxYoungSpaceSize || heapLimits.maxOldSpaceSize ||
+      heapLimits.maxExecutableSize)
+  {
+    // The constraints apply to the entered isolate and have to be set
+    // before its heap is set up.
+    const v8::Isolate::Scope isolateScope(isolate);
+    v8::ResourceConstraints constraints;
+    if (heapLimits.maxYoungSpaceSize)
+      constraints.set_max_young_space_size(ToV8Size(heapLimits.maxYoungSpaceSize));
+    if (heapLimits.maxOldSpaceSize)
+      constraints.set_max_old_space_size(ToV8Size(heapLimits.maxOldSpaceSize));
+    if (heapLimits.maxExecutableSize)
+      constraints.set_max_executable_size(ToV8Size(heapLimits.maxExecutableSize));
+    v8::SetResourceConstraints(&constraints);
+  }
+  if (heapLimits.nearHeapLimitCallback)
+    HeapLimitWatcher::Add(isolate, heapLimits);
 }
 
 AdblockPlus::ScopedV8Isolate::~ScopedV8Isolate()
 {
+  HeapLimitWatcher::Remove(isolate);
   isolate->Dispose();
   isolate = nullptr;
 }
 
-JsEngine::JsWeakValuesList::~JsWeakValuesList()
+struct JsEngine::CallbackRegistry
+{
+  struct Entry
+  {
+    Entry(const std::shared_ptr<CallbackRegistry>& registry, v8::Isolate* isolate,
+      const v8::Handle<v8::Function>& function)
+      : registry(registry), handle(isolate, function)
+    {
+      ++registry->count;
+    }
+
+    ~Entry()
+    {
+      --registry->count;
+      handle.Dispose();
+    }
+
+    std::shared_ptr<CallbackRegistry> registry;
+    v8::Persistent<v8::Function> handle;
+  };
+
+  explicit CallbackRegistry(const std::weak_ptr<JsEngine>& jsEngine)
+    : jsEngine(jsEngine), count(0)
+  {
+  }
+
+  static void OnCollected(v8::Isolate* isolate,
+    v8::Persistent<v8::Function>* handle, Entry* entry)
+  {
+    delete entry;
+  }
+
+  std::weak_ptr<JsEngine> jsEngine;
+  std::atomic<size_t> count;
+};
+
+JsEngine::JsWeakValuesStore::~JsWeakValuesStore()
+{
+  if (lists)
+    lists->Dispose();
+}
+
+JsEngine::JsApiFunctions::~JsApiFunctions()
 {
   for (auto& value : values)
-    value->Dispose();
+    value.second->Dispose();
 }
 
-void JsEngine::ScheduleTimer(const v8::Arguments& arguments)
+int64_t JsEngine::ScheduleTimer(const v8::Arguments& arguments)
 {
   auto jsEngine = FromArguments(arguments);
   if (arguments.Length() < 2)
@@ -106,17 +487,60 @@ void JsEngine::ScheduleTimer(const v8::Arguments& arguments)
 
   auto jsValueArguments = jsEngine->ConvertArguments(arguments);
   auto timerParamsID = jsEngine->StoreJsValues(jsValueArguments);
+  int64_t timerId;
+  {
+    std::lock_guard<std::mutex> lock(jsEngine->timerParamsMutex);
+    timerId = ++jsEngine->lastTimerId;
+    jsEngine->timerParams[timerId] = timerParamsID;
+  }
 
   std::weak_ptr<JsEngine> weakJsEngine = jsEngine;
-  jsEngine->timer->SetTimer(std::chrono::milliseconds(arguments[1]->IntegerValue()), [weakJsEngine, timerParamsID]
+  jsEngine->timer->SetTimer(std::chrono::milliseconds(arguments[1]->IntegerValue()), [weakJsEngine, timerId]
   {
     if (auto jsEngine = weakJsEngine.lock())
-      jsEngine->CallTimerTask(timerParamsID);
+    {
+      jsEngine->DispatchCallback([weakJsEngine, timerId]
+      {
+        if (auto jsEngine = weakJsEngine.lock())
+          jsEngine->CallTimerTask(timerId);
+      });
+    }
   });
+  return timerId;
 }
 
-void JsEngine::CallTimerTask(const JsWeakValuesID& timerParamsID)
+void JsEngine::CancelTimer(const v8::Arguments& arguments)
 {
+  auto jsEngine = FromArguments(arguments);
+  if (arguments.Length() < 1 || !arguments[0]->IsNumber())
+    return;
+
+  JsWeakValuesID timerParamsID;
+  {
+    std::lock_guard<std::mutex> lock(jsEngine->timerParamsMutex);
+    auto it = jsEngine->timerParams.find(arguments[0]->IntegerValue());
+    if (it == jsEngine->timerParams.end())
+      return;
+    timerParamsID = it->second;
+    jsEngine->timerParams.erase(it);
+  }
+  // Releases the callback and its arguments, the timer itself will find
+  // nothing to call.
+  jsEngine->TakeJsValues(timerParamsID);
+}
+
+void JsEngine::CallTimerTask(int64_t timerId)
+{
+  JsWeakValuesID timerParamsID;
+  {
+    std::lock_guard<std::mutex> lock(timerParamsMutex);
+    auto it = timerParams.find(timerId);
+    if (it == timerParams.end())
+      return;
+    timerParamsID = it->second;
+    timerParams.erase(it);
+  }
+  const JsContext context(*this, LOCK_SITE_TIMER);
   auto timerParams = TakeJsValues(timerParamsID);
   JsValue callback = std::move(timerParams[0]);
 
@@ -125,21 +549,53 @@ void JsEngine::CallTimerTask(const JsWeakValuesID& timerParamsID)
   callback.Call(timerParams);
 }
 
+void JsEngine::DispatchCallback(const IExecutor::Task& task)
+{
+  if (callbackExecutor)
+    callbackExecutor->Dispatch(task, std::string());
+  else
+    task();
+}
+
 AdblockPlus::JsEngine::JsEngine(const ScopedV8IsolatePtr& isolate,
-  TimerPtr timer, WebRequestPtr webRequest)
+  TimerPtr timer, WebRequestPtr webRequest, ExecutorPtr ioExecutor,
+  ExecutorPtr callbackExecutor)
   : isolate(isolate)
   , fileSystem(new DefaultFileSystem())
   , logSystem(new DefaultLogSystem())
+  , lastTimerId(0)
+  , jsValueCount(0)
+  , lockMetricsEnabled(false)
+  , contextEntries(0)
+  , scriptCompilations(0)
+  , functionCalls(0)
+  , deferredBackgroundEntries(0)
+  , waitingApiEntries(0)
+  , maxBackgroundDelayMillis(100)
+  , cpuProfileRunning(false)
+  , lockMetrics(new LatencyHistogram[2 * LOCK_SITE_COUNT])
+  , webRequestMetrics(new WebRequestMetrics())
   , timer(std::move(timer))
   , webRequest(std::move(webRequest))
+  , ioExecutor(std::move(ioExecutor))
+  , callbackExecutor(std::move(callbackExecutor))
+  , defaultAsyncFileSystem(new DefaultAsyncFileSystem(fileSystem, this->ioExecutor))
+{
+}
+
+AdblockPlus::JsEngine::~JsEngine()
 {
 }
 
 AdblockPlus::JsEnginePtr AdblockPlus::JsEngine::New(const AppInfo& appInfo,
-  TimerPtr timer, WebRequestPtr webRequest,
-  const ScopedV8IsolatePtr& isolate)
+  TimerPtr timer, WebRequestPtr webRequest, ExecutorPtr ioExecutor,
+  ExecutorPtr callbackExecutor, const ScopedV8IsolatePtr& isolate)
 {
-  JsEnginePtr result(new JsEngine(isolate, std::move(timer), std::move(webRequest)));
+  if (!ioExecutor)
+    throw std::runtime_error("I/O executor cannot be null");
+  JsEnginePtr result(new JsEngine(isolate, std::move(timer),
+    std::move(webRequest), std::move(ioExecutor), std::move(callbackExecutor)));
+  result->callbackRegistry = std::make_shared<CallbackRegistry>(result);
 
   const v8::Locker locker(result->GetIsolate());
   const v8::Isolate::Scope isolateScope(result->GetIsolate());
@@ -163,14 +619,52 @@ AdblockPlus::JsValue AdblockPlus::JsEngine::Evaluate(const std::string& source,
 {
   const JsContext context(*this);
   const v8::TryCatch tryCatch;
-  const v8::Handle<v8::Script> script = CompileScript(GetIsolate(), source,
-    filename);
+  ++scriptCompilations;
+  const v8::Handle<v8::Script> script = CompileScript(GetIsolate(),
+    Utils::ToV8String(GetIsolate(), source), filename);
+  CheckTryCatch(tryCatch);
+  v8::Local<v8::Value> result = script->Run();
+  CheckTryCatch(tryCatch);
+  return JsValue(shared_from_this(), result);
+}
+
+AdblockPlus::JsValue AdblockPlus::JsEngine::EvaluateCached(const std::string& source,
+    const std::string& filename, std::string& cachedData)
+{
+  const JsContext context(*this);
+  const v8::TryCatch tryCatch;
+  ++scriptCompilations;
+  const v8::Handle<v8::Script> script = CompileScript(GetIsolate(),
+    Utils::ToV8String(GetIsolate(), source), filename, cachedData);
+  CheckTryCatch(tryCatch);
+  v8::Local<v8::Value> result = script->Run();
+  CheckTryCatch(tryCatch);
+  return JsValue(shared_from_this(), result);
+}
+
+AdblockPlus::JsValue AdblockPlus::JsEngine::EvaluateStatic(const char* source,
+    const std::string& filename, std::string* cachedData)
+{
+  const JsContext context(*this);
+  const v8::TryCatch tryCatch;
+  ++scriptCompilations;
+  const v8::Handle<v8::String> v8Source = Utils::ToV8StaticString(GetIsolate(),
+    source, std::strlen(source));
+  const v8::Handle<v8::Script> script = cachedData ?
+    CompileScript(GetIsolate(), v8Source, filename, *cachedData) :
+    CompileScript(GetIsolate(), v8Source, filename);
   CheckTryCatch(tryCatch);
   v8::Local<v8::Value> result = script->Run();
   CheckTryCatch(tryCatch);
   return JsValue(shared_from_this(), result);
 }
 
+AdblockPlus::JsValue AdblockPlus::JsEngine::GetApiFunction(const std::string& name)
+{
+  const JsContext context(*this);
+  return JsValue(shared_from_this(), context.GetApiFunction(name));
+}
+
 void AdblockPlus::JsEngine::SetEventCallback(const std::string& eventName,
     const AdblockPlus::JsEngine::EventCallback& callback)
 {
@@ -207,6 +701,165 @@ void AdblockPlus::JsEngine::Gc()
   while (!v8::V8::IdleNotification());
 }
 
+bool AdblockPlus::JsEngine::Gc(const std::chrono::steady_clock::time_point& deadline)
+{
+  const JsContext context(*this);
+  for (;;)
+  {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now()).count();
+    if (remaining <= 0)
+      return false;
+    // The hint tells V8 how much work to do in one step, on a scale of 1 to
+    // 1000, take the remaining milliseconds as a rough measure.
+    int hint = static_cast<int>(std::min<decltype(remaining)>(remaining, 1000));
+    if (v8::V8::IdleNotification(hint))
+      return true;
+  }
+}
+
+void AdblockPlus::JsEngine::NotifyMemoryPressure(MemoryPressureLevel level)
+{
+  TriggerEvent("_memoryPressure", JsValueList{NewValue(static_cast<int>(level))});
+  if (level == MEMORY_PRESSURE_CRITICAL)
+  {
+    const JsContext context(*this);
+    v8::V8::LowMemoryNotification();
+  }
+}
+
+AdblockPlus::JsEngine::MemoryStats AdblockPlus::JsEngine::GetMemoryStats()
+{
+  MemoryStats stats;
+  {
+    const JsContext context(*this);
+    v8::HeapStatistics heapStatistics;
+    GetIsolate()->GetHeapStatistics(&heapStatistics);
+    stats.usedHeapSize = heapStatistics.used_heap_size();
+    stats.totalHeapSize = heapStatistics.total_heap_size();
+    stats.heapSizeLimit = heapStatistics.heap_size_limit();
+    stats.externalMemorySize = static_cast<size_t>(
+      std::max<intptr_t>(v8::V8::AdjustAmountOfExternalAllocatedMemory(0), 0));
+    stats.storedJsValuesCount = jsWeakValues.generations.size() -
+      jsWeakValues.freeSlots.size();
+  }
+  stats.jsValueCount = jsValueCount;
+  {
+    std::lock_guard<std::mutex> lock(timerParamsMutex);
+    stats.pendingTimerCount = timerParams.size();
+  }
+  stats.pendingWebRequestCount = GetPendingWebRequestCount();
+  stats.callbackCount = callbackRegistry->count;
+  return stats;
+}
+
+void AdblockPlus::JsEngine::StartCpuProfile()
+{
+  const JsContext context(*this);
+  if (cpuProfileRunning)
+    throw std::runtime_error("A CPU profile is already being recorded");
+  GetIsolate()->GetCpuProfiler()->StartCpuProfiling(
+    Utils::ToV8String(GetIsolate(), CPU_PROFILE_TITLE), true);
+  cpuProfileRunning = true;
+}
+
+std::string AdblockPlus::JsEngine::StopCpuProfile()
+{
+  const JsContext context(*this);
+  if (!cpuProfileRunning)
+    throw std::runtime_error("No CPU profile is being recorded");
+  cpuProfileRunning = false;
+  const v8::CpuProfile* profile = GetIsolate()->GetCpuProfiler()->StopCpuProfiling(
+    Utils::ToV8String(GetIsolate(), CPU_PROFILE_TITLE));
+  if (!profile)
+    throw std::runtime_error("Failed to record the CPU profile");
+
+  std::string json = "{\"head\":";
+  AppendCpuProfileNode(json, profile->GetTopDownRoot());
+  // Times are in seconds in this format, V8 reports microseconds.
+  json += ",\"startTime\":" + std::to_string(profile->GetStartTime() / 1e6);
+  json += ",\"endTime\":" + std::to_string(profile->GetEndTime() / 1e6);
+  json += ",\"samples\":[";
+  for (int i = 0; i < profile->GetSamplesCount(); i++)
+  {
+    if (i)
+      json += ',';
+    json += std::to_string(profile->GetSample(i)->GetNodeId());
+  }
+  json += "]}";
+  const_cast<v8::CpuProfile*>(profile)->Delete();
+  return json;
+}
+
+void AdblockPlus::JsEngine::WriteHeapSnapshot(const std::string& path)
+{
+  std::string data;
+  {
+    const JsContext context(*this);
+    const v8::HeapSnapshot* snapshot = GetIsolate()->GetHeapProfiler()->TakeHeapSnapshot(
+      Utils::ToV8String(GetIsolate(), ""));
+    if (!snapshot)
+      throw std::runtime_error("Failed to take a heap snapshot");
+    StringOutputStream stream(data);
+    snapshot->Serialize(&stream, v8::HeapSnapshot::kJSON);
+    const_cast<v8::HeapSnapshot*>(snapshot)->Delete();
+  }
+  GetFileSystem()->Write(path, data.data(), data.size());
+}
+
+void AdblockPlus::JsEngine::SetLockMetricsEnabled(bool enabled)
+{
+  lockMetricsEnabled = enabled;
+}
+
+std::vector<AdblockPlus::LatencyMetrics> AdblockPlus::JsEngine::GetLockMetrics() const
+{
+  static const char* const siteNames[LOCK_SITE_COUNT] = {"Api", "Timer",
+    "FileSystem", "WebRequest"};
+  std::vector<LatencyMetrics> result;
+  for (int i = 0; i < LOCK_SITE_COUNT; i++)
+  {
+    result.push_back(lockMetrics[2 * i].GetMetrics(std::string(siteNames[i]) + "LockWait"));
+    result.push_back(lockMetrics[2 * i + 1].GetMetrics(std::string(siteNames[i]) + "LockHold"));
+  }
+  return result;
+}
+
+void AdblockPlus::JsEngine::ResetLockMetrics()
+{
+  for (int i = 0; i < 2 * LOCK_SITE_COUNT; i++)
+    lockMetrics[i].Reset();
+}
+
+void AdblockPlus::JsEngine::SetApiPriority(
+  const std::chrono::milliseconds& maxBackgroundDelay)
+{
+  maxBackgroundDelayMillis = maxBackgroundDelay.count();
+  // Let waiting callbacks go if the prioritization was disabled.
+  std::lock_guard<std::mutex> lock(priorityMutex);
+  priorityCondition.notify_all();
+}
+
+AdblockPlus::JsEngine::OperationCounts AdblockPlus::JsEngine::GetOperationCounts() const
+{
+  OperationCounts counts;
+  counts.contextEntries = contextEntries;
+  counts.scriptCompilations = scriptCompilations;
+  counts.functionCalls = functionCalls;
+  counts.deferredBackgroundEntries = deferredBackgroundEntries;
+  return counts;
+}
+
+std::vector<AdblockPlus::WebRequestHostMetrics> AdblockPlus::JsEngine::GetWebRequestMetrics() const
+{
+  return webRequestMetrics->Get();
+}
+
+void AdblockPlus::JsEngine::ResetWebRequestMetrics()
+{
+  webRequestMetrics->Reset();
+}
+
 AdblockPlus::JsValue AdblockPlus::JsEngine::NewValue(const std::string& val)
 {
   const JsContext context(*this);
@@ -236,22 +889,23 @@ AdblockPlus::JsValue AdblockPlus::JsEngine::NewCallback(
 {
   const JsContext context(*this);
 
-  // Note: we are leaking this weak pointer, no obvious way to destroy it when
-  // it's no longer used
-  std::weak_ptr<JsEngine>* data =
-      new std::weak_ptr<JsEngine>(shared_from_this());
+  // All functions share the registry as their data, each of them only holds
+  // a weak handle which releases its reference once it is collected.
   v8::Local<v8::FunctionTemplate> templ = v8::FunctionTemplate::New(callback,
-      v8::External::New(data));
-  return JsValue(shared_from_this(), templ->GetFunction());
+      v8::External::New(callbackRegistry.get()));
+  v8::Local<v8::Function> function = templ->GetFunction();
+  CallbackRegistry::Entry* entry = new CallbackRegistry::Entry(callbackRegistry,
+    GetIsolate(), function);
+  entry->handle.MakeWeak(entry, &CallbackRegistry::OnCollected);
+  return JsValue(shared_from_this(), function);
 }
 
 AdblockPlus::JsEnginePtr AdblockPlus::JsEngine::FromArguments(const v8::Arguments& arguments)
 {
   const v8::Local<const v8::External> external =
       v8::Local<const v8::External>::Cast(arguments.Data());
-  std::weak_ptr<JsEngine>* data =
-      static_cast<std::weak_ptr<JsEngine>*>(external->Value());
-  JsEnginePtr result = data->lock();
+  CallbackRegistry* registry = static_cast<CallbackRegistry*>(external->Value());
+  JsEnginePtr result = registry->jsEngine.lock();
   if (!result)
     throw std::runtime_error("Oops, our JsEngine is gone, how did that happen?");
   return result;
@@ -259,40 +913,53 @@ AdblockPlus::JsEnginePtr AdblockPlus::JsEngine::FromArguments(const v8::Argument
 
 JsEngine::JsWeakValuesID JsEngine::StoreJsValues(const JsValueList& values)
 {
-  JsWeakValuesLists::iterator it;
+  const JsContext context(*this);
+  auto list = v8::Array::New(static_cast<int>(values.size()));
+  for (uint32_t i = 0; i < values.size(); i++)
+    list->Set(i, values[i].UnwrapValue());
+
+  if (!jsWeakValues.lists)
+    jsWeakValues.lists.reset(new v8::Persistent<v8::Array>(GetIsolate(), v8::Array::New()));
+  JsWeakValuesID id;
+  if (jsWeakValues.freeSlots.empty())
   {
-    std::lock_guard<std::mutex> lock(jsWeakValuesListsMutex);
-    it = jsWeakValuesLists.emplace(jsWeakValuesLists.end());
+    id.slot = static_cast<uint32_t>(jsWeakValues.generations.size());
+    jsWeakValues.generations.push_back(0);
   }
+  else
   {
-    JsContext context(*this);
-    for (const auto& value : values)
-    {
-      it->values.emplace_back(new v8::Persistent<v8::Value>(GetIsolate(), value.UnwrapValue()));
-    }
+    id.slot = jsWeakValues.freeSlots.back();
+    jsWeakValues.freeSlots.pop_back();
   }
-  JsWeakValuesID retValue;
-  retValue.iterator = it;
-  return retValue;
+  id.generation = jsWeakValues.generations[id.slot];
+  v8::Local<v8::Array>::New(GetIsolate(), *jsWeakValues.lists)->Set(id.slot, list);
+  return id;
 }
 
 JsValueList JsEngine::TakeJsValues(const JsWeakValuesID& id)
 {
+  const JsContext context(*this);
+  if (id.slot >= jsWeakValues.generations.size() ||
+      jsWeakValues.generations[id.slot] != id.generation)
+    throw std::runtime_error("Stored JavaScript values have already been taken");
+
+  auto lists = v8::Local<v8::Array>::New(GetIsolate(), *jsWeakValues.lists);
+  auto list = v8::Local<v8::Array>::Cast(lists->Get(id.slot));
   JsValueList retValue;
-  {
-    JsContext context(*this);
-    for (const auto& v8Value : id.iterator->values)
-    {
-      retValue.emplace_back(JsValue(shared_from_this(), v8::Local<v8::Value>::New(GetIsolate(), *v8Value)));
-    }
-  }
-  {
-    std::lock_guard<std::mutex> lock(jsWeakValuesListsMutex);
-    jsWeakValuesLists.erase(id.iterator);
-  }
+  for (uint32_t i = 0; i < list->Length(); i++)
+    retValue.emplace_back(JsValue(shared_from_this(), list->Get(i)));
+  lists->Set(id.slot, v8::Undefined());
+  jsWeakValues.generations[id.slot]++;
+  jsWeakValues.freeSlots.push_back(id.slot);
   return retValue;
 }
 
+size_t JsEngine::GetStoredJsValuesCount()
+{
+  const JsContext context(*this);
+  return jsWeakValues.generations.size() - jsWeakValues.freeSlots.size();
+}
+
 AdblockPlus::JsValueList AdblockPlus::JsEngine::ConvertArguments(const v8::Arguments& arguments)
 {
   const JsContext context(*this);
@@ -313,6 +980,23 @@ void AdblockPlus::JsEngine::SetFileSystem(const AdblockPlus::FileSystemPtr& val)
     throw std::runtime_error("FileSystem cannot be null");
 
   fileSystem = val;
+  defaultAsyncFileSystem.reset(new DefaultAsyncFileSystem(val, ioExecutor));
+}
+
+AdblockPlus::AsyncFileSystemPtr AdblockPlus::JsEngine::GetAsyncFileSystem() const
+{
+  AsyncFileSystemPtr result = asyncFileSystem ? asyncFileSystem : defaultAsyncFileSystem;
+  if (callbackExecutor)
+    result = std::make_shared<CallbackDispatchingFileSystem>(result, callbackExecutor);
+  return result;
+}
+
+void AdblockPlus::JsEngine::SetAsyncFileSystem(const AdblockPlus::AsyncFileSystemPtr& val)
+{
+  if (!val)
+    throw std::runtime_error("IFileSystem cannot be null");
+
+  asyncFileSystem = val;
 }
 
 void AdblockPlus::JsEngine::SetWebRequest(const AdblockPlus::WebRequestSharedPtr& val)
@@ -320,9 +1004,16 @@ void AdblockPlus::JsEngine::SetWebRequest(const AdblockPlus::WebRequestSharedPtr
   if (!val)
     throw std::runtime_error("WebRequest cannot be null");
 
+  if (!webRequestLegacyQueue)
+    webRequestLegacyQueue.reset(new WorkQueue(4));
   webRequestLegacy = val;
 }
 
+size_t AdblockPlus::JsEngine::GetPendingWebRequestCount() const
+{
+  return webRequestLegacyQueue ? webRequestLegacyQueue->GetPendingCount() : 0;
+}
+
 AdblockPlus::LogSystemPtr AdblockPlus::JsEngine::GetLogSystem() const
 {
   return logSystem;
@@ -0,0 +1,83 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef ADBLOCK_PLUS_COMPRESSED_JS_SOURCES
+#include <zlib.h>
+#endif
+
+#include "JsSources.h"
+
+extern const char jsSourcesHash[];
+
+#ifdef ADBLOCK_PLUS_COMPRESSED_JS_SOURCES
+extern const unsigned char jsSourcesCompressed[];
+extern const size_t jsSourcesCompressedSize;
+extern const size_t jsSourcesSize;
+extern const size_t jsSourcesOffsets[];
+extern const size_t jsSourcesCount;
+
+namespace
+{
+  std::once_flag inflateFlag;
+  // Never freed, V8 reads the sources from this buffer, see
+  // JsEngine::EvaluateStatic().
+  std::vector<char>* inflated;
+  std::vector<const char*>* sources;
+
+  void Inflate()
+  {
+    std::vector<char> buffer(jsSourcesSize);
+    uLongf size = static_cast<uLongf>(buffer.size());
+    if (uncompress(reinterpret_cast<Bytef*>(buffer.data()), &size,
+          jsSourcesCompressed, static_cast<uLong>(jsSourcesCompressedSize)) != Z_OK ||
+        size != buffer.size())
+    {
+      throw std::runtime_error("Failed to decompress the JavaScript sources");
+    }
+    std::vector<const char*> pointers;
+    pointers.reserve(jsSourcesCount + 1);
+    for (size_t i = 0; i < jsSourcesCount; i++)
+      pointers.push_back(buffer.data() + jsSourcesOffsets[i]);
+    pointers.push_back(nullptr);
+    inflated = new std::vector<char>(std::move(buffer));
+    sources = new std::vector<const char*>(std::move(pointers));
+  }
+}
+
+const char* const* AdblockPlus::GetJsSources()
+{
+  std::call_once(inflateFlag, Inflate);
+  return sources->data();
+}
+#else
+extern const char* const jsSources[];
+
+const char* const* AdblockPlus::GetJsSources()
+{
+  return jsSources;
+}
+#endif
+
+const char* AdblockPlus::GetJsSourcesHash()
+{
+  return jsSourcesHash;
+}
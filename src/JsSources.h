@@ -0,0 +1,38 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_JS_SOURCES_H
+#define ADBLOCK_PLUS_JS_SOURCES_H
+
+namespace AdblockPlus
+{
+  /**
+   * Returns the JavaScript sources compiled into the library, pairs of file
+   * name and source terminated by `NULL`. If the sources are stored
+   * compressed, see `compress_js_sources` in common.gypi, they are inflated
+   * on the first call. The returned strings stay valid until the process
+   * exits.
+   */
+  const char* const* GetJsSources();
+
+  /**
+   * Returns the hash of the sources returned by `GetJsSources()`.
+   */
+  const char* GetJsSourcesHash();
+}
+
+#endif
@@ -29,6 +29,7 @@ AdblockPlus::JsValue::JsValue(AdblockPlus::JsEnginePtr jsEngine,
     : jsEngine(jsEngine),
       value(new v8::Persistent<v8::Value>(jsEngine->GetIsolate(), value))
 {
+  ++this->jsEngine->jsValueCount;
 }
 
 AdblockPlus::JsValue::JsValue(AdblockPlus::JsValue&& src)
@@ -42,6 +43,7 @@ AdblockPlus::JsValue::JsValue(const JsValue& src)
 {
   const JsContext context(*src.jsEngine);
   value.reset(new v8::Persistent<v8::Value>(src.jsEngine->GetIsolate(), *src.value));
+  ++jsEngine->jsValueCount;
 }
 
 AdblockPlus::JsValue::~JsValue()
@@ -51,6 +53,7 @@ AdblockPlus::JsValue::~JsValue()
     const JsContext context(*jsEngine);
     value->Dispose();
     value.reset();
+    --jsEngine->jsValueCount;
   }
 }
 
@@ -58,9 +61,13 @@ JsValue& AdblockPlus::JsValue::operator=(const JsValue& src)
 {
   const JsContext context(*src.jsEngine);
   if (value)
+  {
     value->Dispose();
+    --jsEngine->jsValueCount;
+  }
   jsEngine = src.jsEngine;
   value.reset(new v8::Persistent<v8::Value>(src.jsEngine->GetIsolate(), *src.value));
+  ++jsEngine->jsValueCount;
 
   return *this;
 }
@@ -151,6 +158,19 @@ AdblockPlus::JsValueList AdblockPlus::JsValue::AsList() const
   return result;
 }
 
+std::vector<std::string> AdblockPlus::JsValue::AsStringVector() const
+{
+  std::vector<std::string> result;
+  AsStringVector(result);
+  return result;
+}
+
+void AdblockPlus::JsValue::AsStringVector(std::vector<std::string>& result) const
+{
+  const JsContext context(*jsEngine);
+  Utils::FromV8StringArray(UnwrapValue(), result);
+}
+
 std::vector<std::string> AdblockPlus::JsValue::GetOwnPropertyNames() const
 {
   if (!IsObject())
@@ -158,10 +178,8 @@ std::vector<std::string> AdblockPlus::JsValue::GetOwnPropertyNames() const
 
   const JsContext context(*jsEngine);
   v8::Local<v8::Object> object = v8::Local<v8::Object>::Cast(UnwrapValue());
-  JsValueList properties = JsValue(jsEngine, object->GetOwnPropertyNames()).AsList();
   std::vector<std::string> result;
-  for (const auto& property : properties)
-    result.push_back(property.AsString());
+  Utils::FromV8StringArray(object->GetOwnPropertyNames(), result);
   return result;
 }
 
@@ -230,10 +248,12 @@ JsValue JsValue::Call(const JsValueList& params) const
 {
   const JsContext context(*jsEngine);
   std::vector<v8::Handle<v8::Value>> argv;
+  argv.reserve(params.size());
   for (const auto& param : params)
     argv.push_back(param.UnwrapValue());
 
-  return Call(argv, context.GetV8Context()->Global());
+  return Call(static_cast<int>(argv.size()), argv.size() ? &argv[0] : nullptr,
+    context.GetV8Context()->Global());
 }
 
 JsValue JsValue::Call(const JsValueList& params, const JsValue& thisValue) const
@@ -242,23 +262,23 @@ JsValue JsValue::Call(const JsValueList& params, const JsValue& thisValue) const
   v8::Local<v8::Object> thisObj = v8::Local<v8::Object>::Cast(thisValue.UnwrapValue());
 
   std::vector<v8::Handle<v8::Value>> argv;
+  argv.reserve(params.size());
   for (const auto& param : params)
     argv.push_back(param.UnwrapValue());
 
-  return Call(argv, thisObj);
+  return Call(static_cast<int>(argv.size()), argv.size() ? &argv[0] : nullptr,
+    thisObj);
 }
 
 JsValue JsValue::Call(const JsValue& arg) const
 {
   const JsContext context(*jsEngine);
 
-  std::vector<v8::Handle<v8::Value>> argv;
-  argv.push_back(arg.UnwrapValue());
-
-  return Call(argv, context.GetV8Context()->Global());
+  v8::Handle<v8::Value> argv[] = {arg.UnwrapValue()};
+  return Call(1, argv, context.GetV8Context()->Global());
 }
 
-JsValue JsValue::Call(std::vector<v8::Handle<v8::Value>>& args, v8::Local<v8::Object> thisObj) const
+JsValue JsValue::Call(int argc, v8::Handle<v8::Value> argv[], v8::Local<v8::Object> thisObj) const
 {
   if (!IsFunction())
     throw new std::runtime_error("Attempting to call a non-function");
@@ -266,14 +286,6 @@ JsValue JsValue::Call(std::vector<v8::Handle<v8::Value>>& args, v8::Local<v8::Ob
     throw new std::runtime_error("`this` pointer has to be an object");
 
   const JsContext context(*jsEngine);
-
-  const v8::TryCatch tryCatch;
   v8::Local<v8::Function> func = v8::Local<v8::Function>::Cast(UnwrapValue());
-  v8::Local<v8::Value> result = func->Call(thisObj, args.size(),
-    args.size() ? &args[0] : nullptr);
-
-  if (tryCatch.HasCaught())
-    throw JsError(tryCatch.Exception(), tryCatch.Message());
-
-  return JsValue(jsEngine, result);
+  return JsValue(jsEngine, context.CallWithArguments(func, thisObj, argc, argv));
 }
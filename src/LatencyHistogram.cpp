@@ -0,0 +1,72 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LatencyHistogram.h"
+
+using namespace AdblockPlus;
+
+LatencyHistogram::LatencyHistogram()
+{
+  Reset();
+}
+
+int LatencyHistogram::GetBucket(uint64_t microseconds)
+{
+  int bucket = 0;
+  while (microseconds && bucket < BUCKET_COUNT - 1)
+  {
+    microseconds >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void LatencyHistogram::Record(std::chrono::steady_clock::duration duration)
+{
+  int64_t value = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  uint64_t microseconds = value > 0 ? static_cast<uint64_t>(value) : 0;
+  count.fetch_add(1, std::memory_order_relaxed);
+  totalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+  buckets[GetBucket(microseconds)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max = maxMicroseconds.load(std::memory_order_relaxed);
+  while (microseconds > max &&
+      !maxMicroseconds.compare_exchange_weak(max, microseconds, std::memory_order_relaxed))
+  {
+  }
+}
+
+LatencyMetrics LatencyHistogram::GetMetrics(const std::string& name) const
+{
+  LatencyMetrics metrics;
+  metrics.name = name;
+  metrics.count = count.load(std::memory_order_relaxed);
+  metrics.totalMicroseconds = totalMicroseconds.load(std::memory_order_relaxed);
+  metrics.maxMicroseconds = maxMicroseconds.load(std::memory_order_relaxed);
+  metrics.histogram.reserve(BUCKET_COUNT);
+  for (int i = 0; i < BUCKET_COUNT; i++)
+    metrics.histogram.push_back(buckets[i].load(std::memory_order_relaxed));
+  return metrics;
+}
+
+void LatencyHistogram::Reset()
+{
+  count = 0;
+  totalMicroseconds = 0;
+  maxMicroseconds = 0;
+  for (int i = 0; i < BUCKET_COUNT; i++)
+    buckets[i] = 0;
+}
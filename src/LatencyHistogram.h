@@ -0,0 +1,91 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_LATENCY_HISTOGRAM_H
+#define ADBLOCK_PLUS_LATENCY_HISTOGRAM_H
+
+#include <AdblockPlus/LatencyMetrics.h>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <string>
+
+namespace AdblockPlus
+{
+  /**
+   * Lock-free call counter with a logarithmic histogram of the call
+   * durations, can be updated from any thread.
+   */
+  class LatencyHistogram
+  {
+  public:
+    /**
+     * Number of buckets, the last one starts at about 18 minutes.
+     */
+    static const int BUCKET_COUNT = 32;
+
+    LatencyHistogram();
+
+    void Record(std::chrono::steady_clock::duration duration);
+
+    /**
+     * Returns the current values, calls recorded concurrently might be
+     * counted partially.
+     */
+    LatencyMetrics GetMetrics(const std::string& name) const;
+
+    void Reset();
+
+    static int GetBucket(uint64_t microseconds);
+
+  private:
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalMicroseconds;
+    std::atomic<uint64_t> maxMicroseconds;
+    std::atomic<uint64_t> buckets[BUCKET_COUNT];
+  };
+
+  /**
+   * Records the lifetime of the instance in a histogram. Nothing is
+   * measured if the histogram is `null`, not even the clock is read.
+   */
+  class ScopedLatency
+  {
+  public:
+    explicit ScopedLatency(LatencyHistogram* histogram)
+      : histogram(histogram)
+    {
+      if (histogram)
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedLatency()
+    {
+      if (histogram)
+        histogram->Record(std::chrono::steady_clock::now() - start);
+    }
+
+  private:
+    LatencyHistogram* histogram;
+    std::chrono::steady_clock::time_point start;
+
+    ScopedLatency(const ScopedLatency&);
+    void operator=(const ScopedLatency&);
+  };
+}
+
+#endif
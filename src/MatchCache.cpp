@@ -0,0 +1,120 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MatchCache.h"
+
+using namespace AdblockPlus;
+
+MatchCache::MatchCache(size_t capacity)
+  : capacity(capacity), generation(0), hits(0), misses(0)
+{
+}
+
+std::string MatchCache::MakeKey(const std::string& url, int32_t typeMask,
+  const std::string& documentUrl, bool specificOnly)
+{
+  // URLs cannot contain NUL characters, use them as separators.
+  std::string key(url);
+  key += '\0';
+  key += std::to_string(typeMask);
+  key += '\0';
+  key += documentUrl;
+  key += '\0';
+  key += specificOnly ? '1' : '0';
+  return key;
+}
+
+void MatchCache::SetGeneration(uint64_t value)
+{
+  if (generation == value)
+    return;
+  entries.clear();
+  entryByKey.clear();
+  generation = value;
+}
+
+bool MatchCache::Lookup(const std::string& url, int32_t typeMask,
+  const std::string& documentUrl, bool specificOnly, uint64_t generation,
+  MatcherFilterPtr& result)
+{
+  std::string key = MakeKey(url, typeMask, documentUrl, specificOnly);
+  std::lock_guard<std::mutex> lock(mutex);
+  SetGeneration(generation);
+  auto it = entryByKey.find(key);
+  if (it == entryByKey.end())
+  {
+    ++misses;
+    return false;
+  }
+  entries.splice(entries.begin(), entries, it->second);
+  result = it->second->second;
+  ++hits;
+  return true;
+}
+
+void MatchCache::Insert(const std::string& url, int32_t typeMask,
+  const std::string& documentUrl, bool specificOnly, uint64_t generation,
+  const MatcherFilterPtr& result)
+{
+  if (!capacity)
+    return;
+  std::string key = MakeKey(url, typeMask, documentUrl, specificOnly);
+  std::lock_guard<std::mutex> lock(mutex);
+  // The filters might have changed while the result was computed, never
+  // store it under a newer generation.
+  if (generation != this->generation)
+    return;
+  auto it = entryByKey.find(key);
+  if (it != entryByKey.end())
+  {
+    it->second->second = result;
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+  if (entries.size() >= capacity)
+  {
+    entryByKey.erase(entries.back().first);
+    entries.pop_back();
+  }
+  entries.push_front(Entry(key, result));
+  entryByKey[key] = entries.begin();
+}
+
+void MatchCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  entryByKey.clear();
+}
+
+uint64_t MatchCache::GetHits() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return hits;
+}
+
+uint64_t MatchCache::GetMisses() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return misses;
+}
+
+size_t MatchCache::GetSize() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
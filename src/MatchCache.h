@@ -0,0 +1,91 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_MATCH_CACHE_H
+#define ADBLOCK_PLUS_MATCH_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "Matcher.h"
+
+namespace AdblockPlus
+{
+  /**
+   * Bounded LRU cache of `Matcher::CheckFilterMatch()` results. Entries are
+   * tagged with the matcher generation, the cache is dropped as a whole once
+   * the generation changes.
+   */
+  class MatchCache
+  {
+  public:
+    explicit MatchCache(size_t capacity);
+
+    /**
+     * Looks up a cached result.
+     * @param result Receives the cached result, which can be `null` for
+     *        requests known not to match.
+     * @return `true` if the result was cached for the generation.
+     */
+    bool Lookup(const std::string& url, int32_t typeMask,
+      const std::string& documentUrl, bool specificOnly, uint64_t generation,
+      MatcherFilterPtr& result);
+
+    /**
+     * Stores a result obtained with the matcher at the given generation.
+     */
+    void Insert(const std::string& url, int32_t typeMask,
+      const std::string& documentUrl, bool specificOnly, uint64_t generation,
+      const MatcherFilterPtr& result);
+
+    /**
+     * Drops all cached results, the counters are kept.
+     */
+    void Clear();
+
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+
+    /**
+     * Returns the number of cached results.
+     */
+    size_t GetSize() const;
+
+  private:
+    typedef std::pair<std::string, MatcherFilterPtr> Entry;
+    typedef std::list<Entry> Entries;
+
+    static std::string MakeKey(const std::string& url, int32_t typeMask,
+      const std::string& documentUrl, bool specificOnly);
+    void SetGeneration(uint64_t value);
+
+    const size_t capacity;
+    mutable std::mutex mutex;
+    uint64_t generation;
+    uint64_t hits;
+    uint64_t misses;
+    // Most recently used entries first.
+    Entries entries;
+    std::unordered_map<std::string, Entries::iterator> entryByKey;
+  };
+}
+
+#endif
@@ -0,0 +1,1209 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <AdblockPlus/FilterEngine.h>
+
+#include "CompiledRuleset.h"
+#include "ContentTypes.h"
+#include "Matcher.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  // Values of MatcherFilter::Data::partyMask.
+  const uint8_t PARTY_MASK_FIRST = 1;
+  const uint8_t PARTY_MASK_THIRD = 2;
+  const uint8_t PARTY_MASK_ANY = PARTY_MASK_FIRST | PARTY_MASK_THIRD;
+
+  bool IsWordChar(char c)
+  {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+  }
+
+  bool IsKeywordChar(char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '%';
+  }
+
+  // Characters matched by the `^` placeholder: all ANSI characters but
+  // alphanumeric characters and _%.-
+  bool IsSeparator(char c)
+  {
+    unsigned char ch = static_cast<unsigned char>(c);
+    return ch < 0x80 && !std::isalnum(ch) &&
+        c != '_' && c != '%' && c != '.' && c != '-';
+  }
+
+  std::string ToLowerCase(const std::string& str)
+  {
+    std::string result(str);
+    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    return result;
+  }
+
+  std::string ToUpperCase(const std::string& str)
+  {
+    std::string result(str);
+    std::transform(result.begin(), result.end(), result.begin(), ::toupper);
+    return result;
+  }
+
+  std::string RemoveTrailingDots(const std::string& str)
+  {
+    std::string::size_type end = str.find_last_not_of('.');
+    return end == std::string::npos ? std::string() : str.substr(0, end + 1);
+  }
+
+  std::vector<std::string> Split(const std::string& str, char separator)
+  {
+    std::vector<std::string> result;
+    std::string::size_type start = 0;
+    while (true)
+    {
+      std::string::size_type end = str.find(separator, start);
+      result.push_back(str.substr(start, end == std::string::npos ? end : end - start));
+      if (end == std::string::npos)
+        return result;
+      start = end + 1;
+    }
+  }
+
+  // Checks the options grammar of Filter.optionsRegExp, i.e.
+  // ~?[\w-]+(?:=[^,\s]+)? separated by commas.
+  bool IsValidOptions(const std::string& options)
+  {
+    std::string::size_type pos = 0;
+    std::string::size_type length = options.length();
+    while (true)
+    {
+      if (pos < length && options[pos] == '~')
+        pos++;
+      std::string::size_type nameStart = pos;
+      while (pos < length && (IsWordChar(options[pos]) || options[pos] == '-'))
+        pos++;
+      if (pos == nameStart)
+        return false;
+      if (pos < length && options[pos] == '=')
+      {
+        std::string::size_type valueStart = ++pos;
+        while (pos < length && options[pos] != ',' &&
+               !std::isspace(static_cast<unsigned char>(options[pos])))
+          pos++;
+        if (pos == valueStart)
+          return false;
+      }
+      if (pos == length)
+        return true;
+      if (options[pos] != ',')
+        return false;
+      pos++;
+    }
+  }
+
+  // Returns the position of the `$` starting the filter options, like
+  // Filter.optionsRegExp.exec() would.
+  std::string::size_type FindOptions(const std::string& text)
+  {
+    for (std::string::size_type pos = text.find('$');
+         pos != std::string::npos;
+         pos = text.find('$', pos + 1))
+    {
+      if (IsValidOptions(text.substr(pos + 1)))
+        return pos;
+    }
+    return std::string::npos;
+  }
+
+  // Same as Filter.regexpRegExp.test()
+  bool IsRegExpFilterText(const std::string& text)
+  {
+    std::string::size_type start = text.compare(0, 2, "@@") == 0 ? 2 : 0;
+    if (text.length() < start + 2 || text[start] != '/')
+      return false;
+    if (text.back() == '/')
+      return true;
+    for (std::string::size_type pos = text.find('/', start + 1);
+         pos != std::string::npos;
+         pos = text.find('/', pos + 1))
+    {
+      if (pos + 1 < text.length() && text[pos + 1] == '$' &&
+          IsValidOptions(text.substr(pos + 2)))
+        return true;
+    }
+    return false;
+  }
+
+  std::string::size_type MatchSegmentAt(const std::string& location,
+    std::string::size_type pos, const char* segment, size_t segmentLength)
+  {
+    std::string::size_type length = location.length();
+    for (size_t i = 0; i < segmentLength; i++)
+    {
+      char c = segment[i];
+      if (c == '^')
+      {
+        // The separator placeholder also matches the end of the address.
+        if (pos == length)
+          continue;
+        if (!IsSeparator(location[pos]))
+          return std::string::npos;
+      }
+      else if (pos == length || location[pos] != c)
+        return std::string::npos;
+      pos++;
+    }
+    return pos;
+  }
+
+  // Finds the leftmost occurrence of the segment, returns the position after
+  // it.
+  std::string::size_type FindSegment(const std::string& location,
+    std::string::size_type pos, const char* segment, size_t segmentLength)
+  {
+    std::string::size_type length = location.length();
+    bool literalStart = segmentLength && segment[0] != '^';
+    while (pos <= length)
+    {
+      if (literalStart)
+      {
+        pos = location.find(segment[0], pos);
+        if (pos == std::string::npos)
+          return std::string::npos;
+      }
+      std::string::size_type end = MatchSegmentAt(location, pos, segment, segmentLength);
+      if (end != std::string::npos)
+        return end;
+      pos++;
+    }
+    return std::string::npos;
+  }
+
+  // FNV-1a, only used to find the domains of a filter quickly.
+  uint32_t HashDomain(const char* domain, size_t length)
+  {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+      hash ^= static_cast<unsigned char>(domain[i]);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+}
+
+namespace
+{
+  // Process-wide map of the parsed filters by text. Entries are removed by
+  // the deleter of the shared data once no filter uses it anymore.
+  template<typename T>
+  class SharedPool
+  {
+  public:
+    std::shared_ptr<const T> Get(const std::string& text)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = entries.find(text);
+      return it != entries.end() ? it->second.value.lock() : std::shared_ptr<const T>();
+    }
+
+    // Takes ownership of the data, returns the data already in the pool if
+    // another thread was faster.
+    std::shared_ptr<const T> Insert(T* data)
+    {
+      std::shared_ptr<const T> result(data, Deleter(this));
+      std::lock_guard<std::mutex> lock(mutex);
+      Entry& entry = entries[data->text];
+      std::shared_ptr<const T> existing = entry.value.lock();
+      if (existing)
+        return existing;
+      entry.raw = data;
+      entry.value = result;
+      return result;
+    }
+
+    size_t GetSize()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return entries.size();
+    }
+
+  private:
+    struct Entry
+    {
+      const T* raw;
+      std::weak_ptr<const T> value;
+    };
+
+    struct Deleter
+    {
+      explicit Deleter(SharedPool* pool) : pool(pool) {}
+
+      void operator()(const T* data)
+      {
+        {
+          std::lock_guard<std::mutex> lock(pool->mutex);
+          // The entry may have been replaced after the data expired.
+          auto it = pool->entries.find(data->text);
+          if (it != pool->entries.end() && it->second.raw == data)
+            pool->entries.erase(it);
+        }
+        delete data;
+      }
+
+      SharedPool* pool;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+  };
+
+  template<typename T>
+  SharedPool<T>& GetSharedPool()
+  {
+    // Never destroyed, filters may outlive static destruction.
+    static std::once_flag once;
+    static SharedPool<T>* pool;
+    std::call_once(once, []
+    {
+      pool = new SharedPool<T>();
+    });
+    return *pool;
+  }
+}
+
+MatcherFilter::Data::Data()
+  : contentType(ContentTypes::defaultMask), partyMask(PARTY_MASK_ANY),
+    matchCase(false), hasDomains(false), includeByDefault(true),
+    anchorStart(false), anchorDomain(false), anchorEnd(false),
+    isException(false), thirdParty(THIRD_PARTY_ANY), collapse(COLLAPSE_DEFAULT)
+{
+}
+
+MatcherFilter::Data::StringRef MatcherFilter::Data::AddString(const std::string& str)
+{
+  StringRef ref = {static_cast<uint32_t>(strings.length()),
+    static_cast<uint32_t>(str.length())};
+  strings.append(str);
+  return ref;
+}
+
+MatcherFilter::MatcherFilter(const std::shared_ptr<const Data>& data)
+  : data(data), pendingHits(0), lastHit(0)
+{
+}
+
+bool MatcherFilter::AddHit(int64_t time) const
+{
+  lastHit.store(time, std::memory_order_relaxed);
+  return pendingHits.fetch_add(1, std::memory_order_relaxed) == 0;
+}
+
+uint32_t MatcherFilter::TakeHits(int64_t& lastHitTime) const
+{
+  uint32_t hits = pendingHits.exchange(0, std::memory_order_relaxed);
+  lastHitTime = lastHit.load(std::memory_order_relaxed);
+  return hits;
+}
+
+MatcherFilterPtr MatcherFilter::FromText(const std::string& filterText)
+{
+  SharedPool<Data>& pool = GetSharedPool<Data>();
+  std::shared_ptr<const Data> data = pool.Get(filterText);
+  if (!data)
+  {
+    // Parsed without holding the lock, so that engines loading their
+    // filters concurrently don't wait for each other.
+    std::unique_ptr<Data> parsed = Parse(filterText);
+    if (!parsed)
+      return MatcherFilterPtr();
+    data = pool.Insert(parsed.release());
+  }
+  return MatcherFilterPtr(new MatcherFilter(data));
+}
+
+size_t MatcherFilter::GetSharedCount()
+{
+  return GetSharedPool<Data>().GetSize();
+}
+
+std::unique_ptr<MatcherFilter::Data> MatcherFilter::Parse(const std::string& filterText)
+{
+  // Mirrors RegExpFilter.fromText() and the RegExpFilter constructor.
+  std::unique_ptr<Data> data(new Data());
+  data->text = filterText;
+  // The segments, domains and sitekeys are shorter than the text together.
+  data->strings.reserve(filterText.length());
+
+  std::string text = filterText;
+  if (text.compare(0, 2, "@@") == 0)
+  {
+    data->isException = true;
+    text = text.substr(2);
+  }
+
+  bool hasContentType = false;
+  std::string domainSource;
+  std::string sitekeySource;
+  std::string::size_type optionsStart = text.find('$') != std::string::npos ?
+      FindOptions(text) : std::string::npos;
+  if (optionsStart != std::string::npos)
+  {
+    std::vector<std::string> options = Split(ToUpperCase(text.substr(optionsStart + 1)), ',');
+    text = text.substr(0, optionsStart);
+    for (auto& option : options)
+    {
+      std::string value;
+      bool hasValue = false;
+      std::string::size_type separatorIndex = option.find('=');
+      if (separatorIndex != std::string::npos)
+      {
+        value = option.substr(separatorIndex + 1);
+        option = option.substr(0, separatorIndex);
+        hasValue = true;
+      }
+      std::string::size_type dashIndex = option.find('-');
+      if (dashIndex != std::string::npos)
+        option[dashIndex] = '_';
+
+      int32_t type;
+      if (ContentTypes::Lookup(option, type))
+      {
+        if (!hasContentType)
+          data->contentType = 0;
+        hasContentType = true;
+        data->contentType |= type;
+      }
+      else if (option[0] == '~' && ContentTypes::Lookup(option.substr(1), type))
+      {
+        if (!hasContentType)
+          data->contentType = ContentTypes::defaultMask;
+        hasContentType = true;
+        data->contentType &= ~type;
+      }
+      else if (option == "MATCH_CASE")
+        data->matchCase = true;
+      else if (option == "~MATCH_CASE")
+        data->matchCase = false;
+      else if (option == "DOMAIN")
+      {
+        if (hasValue)
+          domainSource = ToLowerCase(value);
+      }
+      else if (option == "THIRD_PARTY")
+      {
+        data->thirdParty = THIRD_PARTY_ONLY;
+        data->partyMask = PARTY_MASK_THIRD;
+      }
+      else if (option == "~THIRD_PARTY")
+      {
+        data->thirdParty = FIRST_PARTY_ONLY;
+        data->partyMask = PARTY_MASK_FIRST;
+      }
+      else if (option == "COLLAPSE")
+        data->collapse = COLLAPSE_ALWAYS;
+      else if (option == "~COLLAPSE")
+        data->collapse = COLLAPSE_NEVER;
+      else if (option == "SITEKEY")
+      {
+        if (hasValue)
+          sitekeySource = value;
+      }
+      else
+        return std::unique_ptr<Data>();
+    }
+  }
+
+  if (!domainSource.empty())
+  {
+    // Mirrors the ActiveFilter.domains getter, domains are kept lower-case.
+    std::vector<std::string> list = Split(domainSource, '|');
+    std::vector<std::pair<std::string, bool>> domains;
+    data->hasDomains = true;
+    if (list.size() == 1 && list[0][0] != '~')
+    {
+      data->includeByDefault = false;
+      domains.push_back(std::make_pair(RemoveTrailingDots(list[0]), true));
+    }
+    else
+    {
+      bool hasIncludes = false;
+      for (const auto& entry : list)
+      {
+        std::string domain = RemoveTrailingDots(entry);
+        if (domain.empty())
+          continue;
+        bool include = true;
+        if (domain[0] == '~')
+        {
+          include = false;
+          domain = domain.substr(1);
+        }
+        else
+          hasIncludes = true;
+        domains.push_back(std::make_pair(domain, include));
+      }
+      data->includeByDefault = !hasIncludes;
+    }
+
+    // Sorted by hash and name, the last entry listing a domain applies.
+    std::vector<Data::Domain> entries;
+    entries.reserve(domains.size());
+    for (const auto& domain : domains)
+    {
+      Data::Domain entry = {HashDomain(domain.first.data(), domain.first.length()),
+        data->AddString(domain.first), domain.second};
+      entries.push_back(entry);
+    }
+    const std::string& strings = data->strings;
+    auto less = [&strings](const Data::Domain& a, const Data::Domain& b)
+    {
+      if (a.hash != b.hash)
+        return a.hash < b.hash;
+      return strings.compare(a.name.offset, a.name.length,
+        strings, b.name.offset, b.name.length) < 0;
+    };
+    std::stable_sort(entries.begin(), entries.end(), less);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+      if (i + 1 < entries.size() && !less(entries[i], entries[i + 1]))
+        continue;
+      data->domains.push_back(entries[i]);
+    }
+  }
+  if (!sitekeySource.empty())
+  {
+    for (const auto& sitekey : Split(sitekeySource, '|'))
+      data->sitekeys.push_back(data->AddString(sitekey));
+  }
+
+  if (text.length() >= 2 && text[0] == '/' && text.back() == '/')
+  {
+    std::regex::flag_type flags = std::regex::ECMAScript;
+    if (!data->matchCase)
+      flags |= std::regex::icase;
+    try
+    {
+      data->regexp = std::make_shared<std::regex>(text.substr(1, text.length() - 2), flags);
+    }
+    catch (const std::regex_error&)
+    {
+      return std::unique_ptr<Data>();
+    }
+    return data;
+  }
+
+  // Same transformations as the RegExpFilter.regexp getter, the pattern is
+  // kept as segments between wildcards.
+  std::string pattern;
+  for (char c : text)
+    if (c != '*' || pattern.empty() || pattern.back() != '*')
+      pattern += c;
+  if (pattern.length() >= 2 && pattern.compare(pattern.length() - 2, 2, "^|") == 0)
+    pattern.erase(pattern.length() - 1);
+  if (pattern.compare(0, 2, "||") == 0)
+  {
+    data->anchorDomain = true;
+    pattern.erase(0, 2);
+  }
+  else if (pattern.compare(0, 1, "|") == 0)
+  {
+    data->anchorStart = true;
+    pattern.erase(0, 1);
+  }
+  if (!pattern.empty() && pattern.back() == '|')
+  {
+    data->anchorEnd = true;
+    pattern.erase(pattern.length() - 1);
+  }
+  if (!data->matchCase)
+    pattern = ToLowerCase(pattern);
+  for (const auto& segment : Split(pattern, '*'))
+    data->segments.push_back(data->AddString(segment));
+  return data;
+}
+
+bool MatcherFilter::Matches(const std::string& location,
+  const std::string& lowerLocation, int32_t typeMask,
+  const std::string& docDomain, bool isThirdParty,
+  const std::string& sitekey) const
+{
+  if (!(data->contentType & typeMask) || !(data->partyMask & (1 << isThirdParty)))
+    return false;
+  if (!IsActiveOnDomain(docDomain, sitekey))
+    return false;
+  return MatchesLocation(data->matchCase ? location : lowerLocation);
+}
+
+bool MatcherFilter::IsGeneric() const
+{
+  return data->sitekeys.empty() && (!data->hasDomains || data->includeByDefault);
+}
+
+bool MatcherFilter::IsActiveOnDomain(const std::string& docDomain,
+  const std::string& sitekey) const
+{
+  if (!data->sitekeys.empty())
+  {
+    if (sitekey.empty())
+      return false;
+    std::string upperSitekey = ToUpperCase(sitekey);
+    bool found = false;
+    for (const auto& ref : data->sitekeys)
+    {
+      if (!data->strings.compare(ref.offset, ref.length, upperSitekey))
+      {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      return false;
+  }
+
+  // If no domains are set the rule matches everywhere
+  if (!data->hasDomains)
+    return true;
+
+  // If the document has no host name, match only if the filter isn't
+  // restricted to specific domains
+  if (docDomain.empty())
+    return data->includeByDefault;
+
+  std::string domain = ToLowerCase(RemoveTrailingDots(docDomain));
+  std::string::size_type start = 0;
+  while (true)
+  {
+    const char* suffix = domain.data() + start;
+    size_t suffixLength = domain.length() - start;
+    uint32_t hash = HashDomain(suffix, suffixLength);
+    auto it = std::lower_bound(data->domains.begin(), data->domains.end(), hash,
+      [](const Data::Domain& entry, uint32_t hash)
+      {
+        return entry.hash < hash;
+      });
+    for (; it != data->domains.end() && it->hash == hash; ++it)
+    {
+      if (it->name.length == suffixLength &&
+          !data->strings.compare(it->name.offset, it->name.length, suffix, suffixLength))
+        return it->include;
+    }
+    std::string::size_type nextDot = domain.find('.', start);
+    if (nextDot == std::string::npos)
+      break;
+    start = nextDot + 1;
+  }
+  return data->includeByDefault;
+}
+
+std::vector<std::string> MatcherFilter::GetKeywordCandidates() const
+{
+  std::vector<std::string> result;
+  if (IsRegExpFilterText(data->text))
+    return result;
+
+  std::string pattern = data->text;
+  std::string::size_type optionsStart = FindOptions(pattern);
+  if (optionsStart != std::string::npos)
+    pattern.erase(optionsStart);
+  if (pattern.compare(0, 2, "@@") == 0)
+    pattern.erase(0, 2);
+  pattern = ToLowerCase(pattern);
+
+  // Same as matching /[^a-z0-9%*][a-z0-9%]{3,}(?=[^a-z0-9%*])/g
+  std::string::size_type length = pattern.length();
+  std::string::size_type pos = 0;
+  while (pos < length)
+  {
+    if (IsKeywordChar(pattern[pos]) || pattern[pos] == '*')
+    {
+      pos++;
+      continue;
+    }
+    std::string::size_type end = pos + 1;
+    while (end < length && IsKeywordChar(pattern[end]))
+      end++;
+    if (end - pos - 1 >= 3 && end < length && pattern[end] != '*')
+    {
+      result.push_back(pattern.substr(pos + 1, end - pos - 1));
+      pos = end;
+    }
+    else
+      pos++;
+  }
+  return result;
+}
+
+std::string MatcherFilter::GetRequiredSubstring() const
+{
+  std::string result;
+  if (data->regexp)
+    return result;
+  for (const auto& segment : data->segments)
+  {
+    for (const auto& part : Split(data->GetString(segment), '^'))
+    {
+      if (part.length() > result.length())
+        result = part;
+    }
+  }
+  return data->matchCase ? ToLowerCase(result) : result;
+}
+
+bool MatcherFilter::MatchesLocation(const std::string& location) const
+{
+  if (data->regexp)
+    return std::regex_search(location, *data->regexp);
+
+  if (data->anchorDomain)
+  {
+    // The equivalent of ^[\w\-]+:\/+(?!\/)(?:[^\/]+\.)?
+    std::string::size_type pos = 0;
+    while (pos < location.length() && (IsWordChar(location[pos]) || location[pos] == '-'))
+      pos++;
+    if (pos == 0 || pos >= location.length() || location[pos] != ':')
+      return false;
+    pos++;
+    if (pos >= location.length() || location[pos] != '/')
+      return false;
+    while (pos < location.length() && location[pos] == '/')
+      pos++;
+    if (MatchesPatternFrom(location, pos, true))
+      return true;
+    for (std::string::size_type dot = pos + 1;
+         dot < location.length() && location[dot] != '/';
+         dot++)
+    {
+      if (location[dot] == '.' && MatchesPatternFrom(location, dot + 1, true))
+        return true;
+    }
+    return false;
+  }
+  return MatchesPatternFrom(location, 0, data->anchorStart);
+}
+
+bool MatcherFilter::MatchesPatternFrom(const std::string& location,
+  std::string::size_type pos, bool anchored) const
+{
+  std::string::size_type length = location.length();
+  size_t last = data->segments.size() - 1;
+  for (size_t i = 0; i <= last; i++)
+  {
+    const char* segment = data->strings.data() + data->segments[i].offset;
+    size_t segmentLength = data->segments[i].length;
+    bool anchoredHere = i == 0 && anchored;
+    if (i == last && data->anchorEnd)
+    {
+      if (anchoredHere)
+        return MatchSegmentAt(location, pos, segment, segmentLength) == length;
+      for (; pos <= length; pos++)
+        if (MatchSegmentAt(location, pos, segment, segmentLength) == length)
+          return true;
+      return false;
+    }
+    pos = anchoredHere ? MatchSegmentAt(location, pos, segment, segmentLength) :
+        FindSegment(location, pos, segment, segmentLength);
+    if (pos == std::string::npos)
+      return false;
+  }
+  return true;
+}
+
+void Matcher::KeywordIndex::Add(const MatcherFilterPtr& filter)
+{
+  if (keywordByFilter.find(filter->GetText()) != keywordByFilter.end())
+    return;
+
+  std::string keyword = FindKeyword(*filter);
+  filterByKeyword[keyword].push_back(filter);
+  keywordByFilter[filter->GetText()] = keyword;
+  keywordlessIndex.reset();
+}
+
+bool Matcher::KeywordIndex::Remove(const std::string& filterText)
+{
+  auto keyword = keywordByFilter.find(filterText);
+  if (keyword == keywordByFilter.end())
+    return false;
+
+  auto list = filterByKeyword.find(keyword->second);
+  if (list != filterByKeyword.end())
+  {
+    auto& filters = list->second;
+    for (auto it = filters.begin(); it != filters.end(); ++it)
+    {
+      if ((*it)->GetText() == filterText)
+      {
+        filters.erase(it);
+        break;
+      }
+    }
+    if (filters.empty())
+      filterByKeyword.erase(list);
+  }
+  keywordByFilter.erase(keyword);
+  keywordlessIndex.reset();
+  return true;
+}
+
+void Matcher::KeywordIndex::Clear()
+{
+  filterByKeyword.clear();
+  keywordByFilter.clear();
+  keywordlessIndex.reset();
+}
+
+void Matcher::KeywordIndex::BuildKeywordlessIndex()
+{
+  keywordlessIndex.reset();
+  auto list = filterByKeyword.find(std::string());
+  if (list == filterByKeyword.end())
+    return;
+
+  std::shared_ptr<KeywordlessIndex> index = std::make_shared<KeywordlessIndex>();
+  for (size_t i = 0; i < list->second.size(); i++)
+  {
+    std::string substring = list->second[i]->GetRequiredSubstring();
+    if (substring.empty())
+      index->unindexed.push_back(i);
+    else
+      index->substrings.Add(substring, i);
+  }
+  index->substrings.Build();
+  keywordlessIndex = index;
+}
+
+bool Matcher::KeywordIndex::HasKeyword(const std::string& keyword) const
+{
+  return filterByKeyword.find(keyword) != filterByKeyword.end();
+}
+
+std::string Matcher::KeywordIndex::FindKeyword(const MatcherFilter& filter) const
+{
+  // Pick the least used keyword, prefer longer ones on ties.
+  std::string result;
+  std::vector<std::string>::size_type resultCount = 0xFFFFFF;
+  std::string::size_type resultLength = 0;
+  for (const auto& candidate : filter.GetKeywordCandidates())
+  {
+    auto list = filterByKeyword.find(candidate);
+    std::vector<std::string>::size_type count =
+        list != filterByKeyword.end() ? list->second.size() : 0;
+    if (count < resultCount ||
+        (count == resultCount && candidate.length() > resultLength))
+    {
+      result = candidate;
+      resultCount = count;
+      resultLength = candidate.length();
+    }
+  }
+  return result;
+}
+
+MatcherFilterPtr Matcher::KeywordIndex::CheckEntryMatch(const std::string& keyword,
+  const std::string& location, const std::string& lowerLocation,
+  int32_t typeMask, const std::string& docDomain, bool thirdParty,
+  const std::string& sitekey, bool specificOnly) const
+{
+  auto list = filterByKeyword.find(keyword);
+  if (list == filterByKeyword.end())
+    return MatcherFilterPtr();
+  if (keyword.empty() && keywordlessIndex)
+  {
+    // Only test the filters whose required substring occurs, still in list
+    // order so that the same filter is returned.
+    std::vector<size_t> positions(keywordlessIndex->unindexed);
+    keywordlessIndex->substrings.FindAll(lowerLocation, positions);
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()),
+      positions.end());
+    for (size_t position : positions)
+    {
+      const MatcherFilterPtr& filter = list->second[position];
+      if (specificOnly && filter->IsGeneric() && !filter->IsException())
+        continue;
+      if (filter->Matches(location, lowerLocation, typeMask, docDomain, thirdParty, sitekey))
+        return filter;
+    }
+    return MatcherFilterPtr();
+  }
+  for (const auto& filter : list->second)
+  {
+    if (specificOnly && filter->IsGeneric() && !filter->IsException())
+      continue;
+    if (filter->Matches(location, lowerLocation, typeMask, docDomain, thirdParty, sitekey))
+      return filter;
+  }
+  return MatcherFilterPtr();
+}
+
+void Matcher::KeywordIndex::GetKeywords(std::vector<std::string>& keywords) const
+{
+  for (const auto& entry : filterByKeyword)
+  {
+    if (!entry.first.empty())
+      keywords.push_back(entry.first);
+  }
+}
+
+int32_t Matcher::KeywordIndex::GetKeywordlessContentTypes() const
+{
+  int32_t contentTypes = 0;
+  auto list = filterByKeyword.find(std::string());
+  if (list == filterByKeyword.end())
+    return contentTypes;
+  for (const auto& filter : list->second)
+    contentTypes |= filter->GetContentType();
+  return contentTypes;
+}
+
+Matcher::Prefilter::Prefilter(size_t keywordCount, double falsePositiveRate,
+  size_t maxSize)
+  : keywords(keywordCount, falsePositiveRate, maxSize),
+    keywordlessContentTypes(0)
+{
+}
+
+Matcher::Matcher()
+  : generation(0), hasUncommittedChanges(false), updateDepth(0),
+    snapshot(std::make_shared<Filters>()),
+    publicSuffixes(BaseDomain::GetPublicSuffixList()),
+    prefilterEnabled(false), prefilterFalsePositiveRate(0),
+    prefilterMaxSize(0), prefilterPassedCount(0), prefilterRejectedCount(0)
+{
+}
+
+void Matcher::Add(const std::string& filterText)
+{
+  MatcherFilterPtr filter = MatcherFilter::FromText(filterText);
+  if (!filter)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (filter->IsException())
+    filters.whitelist.Add(filter);
+  else
+    filters.blacklist.Add(filter);
+  hasUncommittedChanges = true;
+  ++generation;
+}
+
+void Matcher::Remove(const std::string& filterText)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!filters.whitelist.Remove(filterText))
+    filters.blacklist.Remove(filterText);
+  hasUncommittedChanges = true;
+  ++generation;
+}
+
+void Matcher::Clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  filters.whitelist.Clear();
+  filters.blacklist.Clear();
+  hasUncommittedChanges = true;
+  ++generation;
+}
+
+void Matcher::Commit()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  // The outermost EndUpdate() publishes the changes made during an update.
+  if (!updateDepth)
+    CommitLocked();
+}
+
+void Matcher::BeginUpdate()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  // The changes made so far have to be visible during the update.
+  if (!updateDepth)
+    CommitLocked();
+  ++updateDepth;
+}
+
+void Matcher::EndUpdate()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!updateDepth)
+    return;
+  if (updateDepth == 1)
+    CommitLocked();
+  --updateDepth;
+  // Results obtained from the previous snapshot during the update are
+  // outdated now.
+  ++generation;
+}
+
+bool Matcher::IsUpdating() const
+{
+  return updateDepth > 0;
+}
+
+bool Matcher::UseSnapshot() const
+{
+  return !hasUncommittedChanges || updateDepth;
+}
+
+void Matcher::CommitLocked()
+{
+  if (!hasUncommittedChanges)
+    return;
+  std::shared_ptr<Filters> newSnapshot = std::make_shared<Filters>(filters);
+  newSnapshot->blacklist.BuildKeywordlessIndex();
+  newSnapshot->whitelist.BuildKeywordlessIndex();
+  if (prefilterEnabled)
+  {
+    std::vector<std::string> keywords;
+    filters.blacklist.GetKeywords(keywords);
+    filters.whitelist.GetKeywords(keywords);
+    std::vector<uint64_t> rulesetKeywords;
+    if (filters.ruleset)
+      filters.ruleset->GetKeywordHashes(rulesetKeywords);
+    std::shared_ptr<Prefilter> prefilter = std::make_shared<Prefilter>(
+      keywords.size() + rulesetKeywords.size(), prefilterFalsePositiveRate,
+      prefilterMaxSize);
+    for (const auto& keyword : keywords)
+      prefilter->keywords.Add(keyword);
+    for (uint64_t hash : rulesetKeywords)
+      prefilter->keywords.AddHash(hash);
+    prefilter->keywordlessContentTypes =
+      filters.blacklist.GetKeywordlessContentTypes() |
+      filters.whitelist.GetKeywordlessContentTypes();
+    if (filters.ruleset)
+      prefilter->keywordlessContentTypes |= filters.ruleset->GetKeywordlessContentTypes();
+    newSnapshot->prefilter = prefilter;
+  }
+  std::atomic_store(&snapshot, std::shared_ptr<const Filters>(newSnapshot));
+  hasUncommittedChanges = false;
+}
+
+void Matcher::EnablePrefilter(double falsePositiveRate, size_t maxSize)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  prefilterEnabled = true;
+  prefilterFalsePositiveRate = falsePositiveRate;
+  prefilterMaxSize = maxSize;
+  hasUncommittedChanges = true;
+}
+
+bool Matcher::MayMatch(const std::string& location, int32_t typeMask) const
+{
+  UrlTokenizer::Tokens tokens;
+  UrlTokenizer::Tokenize(location, tokens);
+  return MayMatch(tokens, typeMask);
+}
+
+bool Matcher::MayMatch(const UrlTokenizer::Tokens& tokens,
+  int32_t typeMask) const
+{
+  if (!UseSnapshot())
+    return true;
+  std::shared_ptr<const Filters> currentSnapshot = std::atomic_load(&snapshot);
+  const Prefilter* prefilter = currentSnapshot->prefilter.get();
+  if (!prefilter || (typeMask & prefilter->keywordlessContentTypes))
+    return true;
+
+  for (const auto& token : tokens.tokens)
+  {
+    if (prefilter->keywords.MayContainHash(token.hash))
+    {
+      prefilterPassedCount.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  prefilterRejectedCount.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+Matcher::PrefilterStats Matcher::GetPrefilterStats() const
+{
+  PrefilterStats stats;
+  std::shared_ptr<const Filters> currentSnapshot = std::atomic_load(&snapshot);
+  const Prefilter* prefilter = currentSnapshot->prefilter.get();
+  stats.size = prefilter ? prefilter->keywords.GetSize() : 0;
+  stats.falsePositiveRate = prefilter ?
+    prefilter->keywords.GetFalsePositiveRate() : 0;
+  stats.passedCount = prefilterPassedCount.load(std::memory_order_relaxed);
+  stats.rejectedCount = prefilterRejectedCount.load(std::memory_order_relaxed);
+  return stats;
+}
+
+uint64_t Matcher::GetGeneration() const
+{
+  return generation;
+}
+
+void Matcher::SetPublicSuffixes(BaseDomain::PublicSuffixes&& value)
+{
+  std::atomic_store(&publicSuffixes, std::shared_ptr<const BaseDomain::PublicSuffixes>(
+    std::make_shared<BaseDomain::PublicSuffixes>(std::move(value))));
+  ++generation;
+}
+
+void Matcher::SetRuleset(const std::shared_ptr<const CompiledRuleset>& ruleset)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  filters.ruleset = ruleset;
+  hasUncommittedChanges = true;
+  ++generation;
+}
+
+MatcherFilterPtr Matcher::MatchesAny(const std::string& location,
+  int32_t typeMask, const std::string& docDomain, bool thirdParty,
+  const std::string& sitekey, bool specificOnly) const
+{
+  UrlTokenizer::Tokens tokens;
+  UrlTokenizer::Tokenize(location, tokens);
+  return MatchesAny(location, tokens, typeMask, docDomain, thirdParty,
+    sitekey, specificOnly);
+}
+
+MatcherFilterPtr Matcher::MatchesAny(const std::string& location,
+  const UrlTokenizer::Tokens& tokens, int32_t typeMask,
+  const std::string& docDomain, bool thirdParty, const std::string& sitekey,
+  bool specificOnly) const
+{
+  const std::string& lowerLocation = tokens.lowerUrl;
+
+  // The tokens are the keyword candidates, followed by the empty keyword of
+  // filters without one.
+  std::vector<std::string> candidates;
+  candidates.reserve(tokens.tokens.size() + 1);
+  for (const auto& token : tokens.tokens)
+    candidates.push_back(tokens.GetToken(token));
+  candidates.push_back(std::string());
+
+  if (UseSnapshot())
+  {
+    std::shared_ptr<const Filters> currentSnapshot = std::atomic_load(&snapshot);
+    return MatchesAny(*currentSnapshot, candidates, location, lowerLocation,
+      typeMask, docDomain, thirdParty, sitekey, specificOnly);
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  return MatchesAny(filters, candidates, location, lowerLocation, typeMask,
+    docDomain, thirdParty, sitekey, specificOnly);
+}
+
+MatcherFilterPtr Matcher::MatchesAny(const Filters& filters,
+  const std::vector<std::string>& candidates, const std::string& location,
+  const std::string& lowerLocation, int32_t typeMask,
+  const std::string& docDomain, bool thirdParty, const std::string& sitekey,
+  bool specificOnly)
+{
+  MatcherFilterPtr blacklistHit;
+  for (const auto& candidate : candidates)
+  {
+    if (filters.whitelist.HasKeyword(candidate))
+    {
+      MatcherFilterPtr result = filters.whitelist.CheckEntryMatch(candidate,
+          location, lowerLocation, typeMask, docDomain, thirdParty, sitekey,
+          specificOnly);
+      if (result)
+        return result;
+    }
+    if (filters.ruleset)
+    {
+      MatcherFilterPtr result = filters.ruleset->CheckEntryMatch(true,
+          candidate, location, lowerLocation, typeMask, docDomain, thirdParty,
+          sitekey, specificOnly);
+      if (result)
+        return result;
+    }
+    if (!blacklistHit && filters.blacklist.HasKeyword(candidate))
+    {
+      blacklistHit = filters.blacklist.CheckEntryMatch(candidate, location,
+          lowerLocation, typeMask, docDomain, thirdParty, sitekey,
+          specificOnly);
+    }
+    if (!blacklistHit && filters.ruleset)
+    {
+      blacklistHit = filters.ruleset->CheckEntryMatch(false, candidate,
+          location, lowerLocation, typeMask, docDomain, thirdParty, sitekey,
+          specificOnly);
+    }
+  }
+  return blacklistHit;
+}
+
+MatcherFilterPtr Matcher::CheckFilterMatch(const std::string& url,
+  int32_t typeMask, const std::string& documentUrl, bool specificOnly) const
+{
+  UrlTokenizer::Tokens tokens;
+  UrlTokenizer::Tokenize(url, tokens);
+  if (!MayMatch(tokens, typeMask))
+    return MatcherFilterPtr();
+
+  std::string requestHost = BaseDomain::ExtractHostFromURL(url);
+  std::string documentHost = BaseDomain::ExtractHostFromURL(documentUrl);
+  std::shared_ptr<const BaseDomain::PublicSuffixes> currentPublicSuffixes =
+    std::atomic_load(&publicSuffixes);
+  bool thirdParty = BaseDomain::IsThirdParty(requestHost, documentHost,
+    *currentPublicSuffixes);
+  return MatchesAny(url, tokens, typeMask, documentHost, thirdParty,
+    std::string(), specificOnly);
+}
+
+MatchResult::MatchResult()
+  : type(Filter::TYPE_INVALID), thirdParty(THIRD_PARTY_ANY),
+    collapse(COLLAPSE_DEFAULT)
+{
+}
+
+namespace
+{
+  MatchResult::ThirdParty ToMatchResultThirdParty(MatcherFilter::ThirdParty value)
+  {
+    switch (value)
+    {
+    case MatcherFilter::THIRD_PARTY_ONLY:
+      return MatchResult::THIRD_PARTY_ONLY;
+    case MatcherFilter::FIRST_PARTY_ONLY:
+      return MatchResult::FIRST_PARTY_ONLY;
+    default:
+      return MatchResult::THIRD_PARTY_ANY;
+    }
+  }
+
+  MatchResult::Collapse ToMatchResultCollapse(MatcherFilter::Collapse value)
+  {
+    switch (value)
+    {
+    case MatcherFilter::COLLAPSE_ALWAYS:
+      return MatchResult::COLLAPSE_ALWAYS;
+    case MatcherFilter::COLLAPSE_NEVER:
+      return MatchResult::COLLAPSE_NEVER;
+    default:
+      return MatchResult::COLLAPSE_DEFAULT;
+    }
+  }
+}
+
+MatchResult AdblockPlus::ToMatchResult(const MatcherFilterPtr& match)
+{
+  MatchResult result;
+  if (!match)
+    return result;
+  result.type = match->IsException() ? Filter::TYPE_EXCEPTION : Filter::TYPE_BLOCKING;
+  result.text = match->GetText();
+  result.thirdParty = ToMatchResultThirdParty(match->GetThirdParty());
+  result.collapse = ToMatchResultCollapse(match->GetCollapse());
+  return result;
+}
@@ -0,0 +1,460 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_MATCHER_H
+#define ADBLOCK_PLUS_MATCHER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BaseDomain.h"
+#include "BloomFilter.h"
+#include "MultiPatternMatcher.h"
+#include "UrlTokenizer.h"
+
+namespace AdblockPlus
+{
+  class CompiledRuleset;
+  class MatcherFilter;
+  struct MatchResult;
+
+  /**
+   * Shared smart pointer to an immutable `MatcherFilter`.
+   */
+  typedef std::shared_ptr<const MatcherFilter> MatcherFilterPtr;
+
+  /**
+   * Native counterpart of a blocking or whitelist filter (`RegExpFilter` in
+   * filterClasses.js), containing everything needed to match requests.
+   */
+  class MatcherFilter
+  {
+  public:
+    enum ThirdParty {THIRD_PARTY_ANY, THIRD_PARTY_ONLY, FIRST_PARTY_ONLY};
+    enum Collapse {COLLAPSE_DEFAULT, COLLAPSE_ALWAYS, COLLAPSE_NEVER};
+
+    /**
+     * Parses the text of a blocking or whitelist filter.
+     * @param text Normalized filter text.
+     * @return Parsed filter, or `null` if the text is not a valid blocking or
+     *         whitelist filter.
+     */
+    static MatcherFilterPtr FromText(const std::string& text);
+
+    /**
+     * Tests whether the URL matches this filter, same as
+     * `RegExpFilter.matches()`.
+     * @param location URL to check.
+     * @param lowerLocation Lower-cased `location`.
+     * @param typeMask Content type mask of the request.
+     * @param docDomain Host name of the document which loads the URL.
+     * @param thirdParty Whether the request is third party.
+     * @param sitekey Public key provided by the document, may be empty.
+     */
+    bool Matches(const std::string& location, const std::string& lowerLocation,
+      int32_t typeMask, const std::string& docDomain, bool thirdParty,
+      const std::string& sitekey) const;
+
+    /**
+     * Checks whether this filter is active on all domains.
+     */
+    bool IsGeneric() const;
+
+    bool IsActiveOnDomain(const std::string& docDomain,
+      const std::string& sitekey) const;
+
+    /**
+     * Returns the keyword candidates of this filter, see
+     * `Matcher.findKeyword()`. Regular expression filters have none.
+     */
+    std::vector<std::string> GetKeywordCandidates() const;
+
+    /**
+     * Returns the longest string which the lower-cased URL has to contain
+     * for this filter to match, the longest part of the pattern without
+     * wildcards and separator placeholders. Empty for regular expression
+     * filters.
+     */
+    std::string GetRequiredSubstring() const;
+
+    const std::string& GetText() const
+    {
+      return data->text;
+    }
+
+    bool IsException() const
+    {
+      return data->isException;
+    }
+
+    int32_t GetContentType() const
+    {
+      return data->contentType;
+    }
+
+    ThirdParty GetThirdParty() const
+    {
+      return data->thirdParty;
+    }
+
+    Collapse GetCollapse() const
+    {
+      return data->collapse;
+    }
+
+    /**
+     * Counts a match of this filter, see `FilterHitStatistics`.
+     * @param time Time of the match in milliseconds since the epoch.
+     * @return `true` if this is the first match since the last
+     *         `TakeHits()`.
+     */
+    bool AddHit(int64_t time) const;
+
+    /**
+     * Resets the number of matches counted by `AddHit()`.
+     * @param lastHitTime Receives the time of the last match.
+     * @return Number of matches since the last call.
+     */
+    uint32_t TakeHits(int64_t& lastHitTime) const;
+
+    /**
+     * Returns the number of distinct filters parsed by `FromText()` which are
+     * still in use. The parsed data is shared by all instances created for
+     * the same text, e.g. by several `FilterEngine` instances with the same
+     * subscriptions, only the counters of `AddHit()` are per instance.
+     */
+    static size_t GetSharedCount();
+
+  private:
+    struct Data
+    {
+      Data();
+
+      /// Range of `strings`.
+      struct StringRef
+      {
+        uint32_t offset;
+        uint32_t length;
+      };
+
+      struct Domain
+      {
+        uint32_t hash;
+        StringRef name;
+        bool include;
+      };
+
+      // Checked for every candidate request first.
+      int32_t contentType;
+      // `thirdParty` as bits of the accepted requests, bit 0 for first
+      // party and bit 1 for third party ones.
+      uint8_t partyMask;
+      bool matchCase;
+      // Domain restrictions, `includeByDefault` is the value for `""` in
+      // ActiveFilter.domains.
+      bool hasDomains;
+      bool includeByDefault;
+      bool anchorStart;
+      bool anchorDomain;
+      bool anchorEnd;
+      bool isException;
+
+      // The pattern split at wildcards, where `^` stands for a separator
+      // placeholder, the domains and the sitekeys are ranges of a single
+      // buffer allocated once per filter. Domains are sorted by hash.
+      std::string strings;
+      std::vector<StringRef> segments;
+      std::vector<Domain> domains;
+      std::vector<StringRef> sitekeys;
+      // Set instead of `segments` for regular expression filters.
+      std::shared_ptr<std::regex> regexp;
+
+      // Only needed to report a match.
+      ThirdParty thirdParty;
+      Collapse collapse;
+      std::string text;
+
+      StringRef AddString(const std::string& str);
+      std::string GetString(const StringRef& ref) const
+      {
+        return strings.substr(ref.offset, ref.length);
+      }
+    };
+
+    explicit MatcherFilter(const std::shared_ptr<const Data>& data);
+
+    static std::unique_ptr<Data> Parse(const std::string& text);
+    bool MatchesLocation(const std::string& location) const;
+    bool MatchesPatternFrom(const std::string& location,
+      std::string::size_type start, bool anchored) const;
+
+    std::shared_ptr<const Data> data;
+    mutable std::atomic<uint32_t> pendingHits;
+    mutable std::atomic<int64_t> lastHit;
+  };
+
+  /**
+   * Native equivalent of `CombinedMatcher` from matcher.js. It is kept in
+   * sync with `defaultMatcher` via lib/matcherRegistration.js and allows
+   * matching requests without entering the JavaScript engine.
+   * All methods are thread-safe.
+   */
+  class Matcher
+  {
+  public:
+    Matcher();
+
+    void Add(const std::string& filterText);
+    void Remove(const std::string& filterText);
+    void Clear();
+
+    /**
+     * Publishes the changes made since the last call as an immutable
+     * snapshot. Until then matching has to lock the changed filters, which
+     * serializes concurrent lookups, afterwards lookups from any number of
+     * threads run in parallel. During an update started by `BeginUpdate()`
+     * nothing is published, the outermost `EndUpdate()` does it.
+     */
+    void Commit();
+
+    /**
+     * Starts an update replacing many filters, e.g.\ of a subscription.
+     * Until the matching `EndUpdate()` lookups only see the snapshot
+     * published before, never a partially applied update. Updates can be
+     * nested.
+     */
+    void BeginUpdate();
+
+    /**
+     * Ends an update started by `BeginUpdate()`, the outermost one
+     * publishes all changes at once like `Commit()`.
+     */
+    void EndUpdate();
+
+    /**
+     * Checks whether an update started by `BeginUpdate()` is in progress.
+     */
+    bool IsUpdating() const;
+
+    /**
+     * Returns a counter which is incremented whenever the filters or the
+     * public suffix list change, results obtained with a different generation
+     * might be outdated.
+     */
+    uint64_t GetGeneration() const;
+
+    /**
+     * Sets the public suffix list used to determine third-party requests,
+     * `BaseDomain::GetPublicSuffixList()` by default.
+     */
+    void SetPublicSuffixes(BaseDomain::PublicSuffixes&& publicSuffixes);
+
+    /**
+     * Sets precompiled filters which are checked in addition to the added
+     * ones, like `Add()` the change is published by `Commit()`.
+     * @param ruleset Ruleset to use, `null` to remove it.
+     */
+    void SetRuleset(const std::shared_ptr<const CompiledRuleset>& ruleset);
+
+    /**
+     * Looks up the filter which applies to the request, same as
+     * `CombinedMatcher.matchesAny()`.
+     * @param specificOnly Whether generic blocking filters should be ignored,
+     *        e.g. on documents whitelisted with `$genericblock`.
+     * @return Matching filter, whitelist filters take precedence over
+     *         blocking ones, or `null` if there is no match.
+     */
+    MatcherFilterPtr MatchesAny(const std::string& location, int32_t typeMask,
+      const std::string& docDomain, bool thirdParty,
+      const std::string& sitekey = std::string(),
+      bool specificOnly = false) const;
+
+    /**
+     * Statistics of the prefilter, see `EnablePrefilter()`.
+     */
+    struct PrefilterStats
+    {
+      size_t size;
+      double falsePositiveRate;
+      uint64_t passedCount;
+      uint64_t rejectedCount;
+    };
+
+    /**
+     * Enables a Bloom filter of the keywords of all filters, which is built
+     * by `Commit()` and allows `CheckFilterMatch()` to reject most requests
+     * that can't match before doing any other work.
+     * @param falsePositiveRate Targeted probability of a request without
+     *        any matching keyword passing the prefilter.
+     * @param maxSize Upper bound of the memory used by the prefilter, in
+     *        bytes.
+     */
+    void EnablePrefilter(double falsePositiveRate, size_t maxSize);
+
+    /**
+     * Checks whether any filter could match the request, using the
+     * prefilter of the current snapshot.
+     * @return `false` if no filter matches, `true` if one might or if the
+     *         prefilter is disabled or outdated.
+     */
+    bool MayMatch(const std::string& location, int32_t typeMask) const;
+
+    PrefilterStats GetPrefilterStats() const;
+
+    /**
+     * Checks a request made by a document: extracts the hosts and determines
+     * whether the request is third party before calling `MatchesAny()`.
+     */
+    MatcherFilterPtr CheckFilterMatch(const std::string& url, int32_t typeMask,
+      const std::string& documentUrl, bool specificOnly = false) const;
+
+  private:
+    class KeywordIndex
+    {
+    public:
+      void Add(const MatcherFilterPtr& filter);
+      bool Remove(const std::string& filterText);
+      void Clear();
+      bool HasKeyword(const std::string& keyword) const;
+      void GetKeywords(std::vector<std::string>& keywords) const;
+      /// Content types of the filters without a keyword.
+      int32_t GetKeywordlessContentTypes() const;
+      /**
+       * Indexes the filters without a keyword by their required substrings,
+       * so that `CheckEntryMatch()` only tests the ones which can match.
+       * The index has to be rebuilt when the filters change.
+       */
+      void BuildKeywordlessIndex();
+      MatcherFilterPtr CheckEntryMatch(const std::string& keyword,
+        const std::string& location, const std::string& lowerLocation,
+        int32_t typeMask, const std::string& docDomain, bool thirdParty,
+        const std::string& sitekey, bool specificOnly) const;
+    private:
+      std::string FindKeyword(const MatcherFilter& filter) const;
+
+      std::unordered_map<std::string, std::vector<MatcherFilterPtr>> filterByKeyword;
+      std::unordered_map<std::string, std::string> keywordByFilter;
+
+      struct KeywordlessIndex
+      {
+        // IDs are positions in the filter list of the empty keyword.
+        MultiPatternMatcher substrings;
+        std::vector<size_t> unindexed;
+      };
+      std::shared_ptr<const KeywordlessIndex> keywordlessIndex;
+    };
+
+    struct Prefilter
+    {
+      Prefilter(size_t keywordCount, double falsePositiveRate, size_t maxSize);
+
+      BloomFilter keywords;
+      int32_t keywordlessContentTypes;
+    };
+
+    struct Filters
+    {
+      KeywordIndex blacklist;
+      KeywordIndex whitelist;
+      std::shared_ptr<const CompiledRuleset> ruleset;
+      /// Only set for snapshots.
+      std::shared_ptr<const Prefilter> prefilter;
+    };
+
+    void CommitLocked();
+    /// Whether lookups can use the snapshot without locking the filters.
+    bool UseSnapshot() const;
+    bool MayMatch(const UrlTokenizer::Tokens& tokens, int32_t typeMask) const;
+    MatcherFilterPtr MatchesAny(const std::string& location,
+      const UrlTokenizer::Tokens& tokens, int32_t typeMask,
+      const std::string& docDomain, bool thirdParty,
+      const std::string& sitekey, bool specificOnly) const;
+    static MatcherFilterPtr MatchesAny(const Filters& filters,
+      const std::vector<std::string>& candidates, const std::string& location,
+      const std::string& lowerLocation, int32_t typeMask,
+      const std::string& docDomain, bool thirdParty,
+      const std::string& sitekey, bool specificOnly);
+
+    std::atomic<uint64_t> generation;
+    // Changed filters are only accessed with the mutex locked, the snapshot
+    // is replaced atomically and is never modified.
+    mutable std::mutex mutex;
+    Filters filters;
+    std::atomic<bool> hasUncommittedChanges;
+    /// Only changed with the mutex locked.
+    std::atomic<int> updateDepth;
+    std::shared_ptr<const Filters> snapshot;
+    std::shared_ptr<const BaseDomain::PublicSuffixes> publicSuffixes;
+    bool prefilterEnabled;
+    double prefilterFalsePositiveRate;
+    size_t prefilterMaxSize;
+    mutable std::atomic<uint64_t> prefilterPassedCount;
+    mutable std::atomic<uint64_t> prefilterRejectedCount;
+  };
+
+  /**
+   * Converts a match to the result returned by
+   * `FilterEngine::GetMatchResult()`.
+   * @param match Matching filter, `null` if there was no match.
+   */
+  MatchResult ToMatchResult(const MatcherFilterPtr& match);
+
+  inline const std::string& GetDocumentUrl(const std::string& documentUrl)
+  {
+    return documentUrl;
+  }
+
+  template<typename T>
+  const std::string& GetDocumentUrl(const std::shared_ptr<T>& documentUrl)
+  {
+    return *documentUrl;
+  }
+
+  /**
+   * Checks whether one of the documents in a chain is whitelisted by a
+   * document exception, shared by `FilterEngine` and `SharedMatcher`.
+   * @param documentUrls Chain of documents, starting with the parent frame
+   *        and ending with the top-level frame, must not be empty.
+   * @param checkFilterMatch Called for each document with its URL and the
+   *        URL of the document containing it, returns the matching filter
+   *        for the `CONTENT_TYPE_DOCUMENT` request.
+   * @return The first matching exception, `null` if there is none.
+   */
+  template<typename Url, typename CheckFilterMatch>
+  MatcherFilterPtr CheckDocumentChain(const std::vector<Url>& documentUrls,
+    const CheckFilterMatch& checkFilterMatch)
+  {
+    const std::string* lastDocumentUrl = &GetDocumentUrl(documentUrls.front());
+    for (const auto& entry : documentUrls)
+    {
+      const std::string& documentUrl = GetDocumentUrl(entry);
+      MatcherFilterPtr match = checkFilterMatch(documentUrl, *lastDocumentUrl);
+      if (match && match->IsException())
+        return match;
+      lastDocumentUrl = &documentUrl;
+    }
+    return MatcherFilterPtr();
+  }
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <queue>
+
+#include "MultiPatternMatcher.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const int32_t ROOT = 0;
+  const int32_t NONE = -1;
+
+  bool CompareChild(const std::pair<char, int32_t>& child, char c)
+  {
+    return child.first < c;
+  }
+}
+
+MultiPatternMatcher::Node::Node()
+  : failure(ROOT), outputLink(NONE)
+{
+}
+
+MultiPatternMatcher::MultiPatternMatcher()
+  : nodes(1), patternCount(0)
+{
+}
+
+int32_t MultiPatternMatcher::FindChild(int32_t node, char c) const
+{
+  const std::vector<std::pair<char, int32_t>>& children = nodes[node].children;
+  auto it = std::lower_bound(children.begin(), children.end(), c, CompareChild);
+  return it != children.end() && it->first == c ? it->second : NONE;
+}
+
+void MultiPatternMatcher::Add(const std::string& pattern, size_t id)
+{
+  if (pattern.empty())
+    return;
+
+  int32_t node = ROOT;
+  for (char c : pattern)
+  {
+    int32_t child = FindChild(node, c);
+    if (child == NONE)
+    {
+      child = static_cast<int32_t>(nodes.size());
+      // Inserting may reallocate the nodes, don't keep references.
+      nodes.push_back(Node());
+      std::vector<std::pair<char, int32_t>>& children = nodes[node].children;
+      children.insert(std::lower_bound(children.begin(), children.end(), c,
+        CompareChild), std::make_pair(c, child));
+    }
+    node = child;
+  }
+  nodes[node].ids.push_back(id);
+  patternCount++;
+}
+
+void MultiPatternMatcher::Build()
+{
+  // Breadth-first, so that the failure transitions of shorter prefixes are
+  // known already.
+  std::queue<int32_t> queue;
+  for (const auto& child : nodes[ROOT].children)
+  {
+    nodes[child.second].failure = ROOT;
+    nodes[child.second].outputLink = NONE;
+    queue.push(child.second);
+  }
+  while (!queue.empty())
+  {
+    int32_t node = queue.front();
+    queue.pop();
+    for (const auto& child : nodes[node].children)
+    {
+      int32_t failure = nodes[node].failure;
+      int32_t next = FindChild(failure, child.first);
+      while (next == NONE && failure != ROOT)
+      {
+        failure = nodes[failure].failure;
+        next = FindChild(failure, child.first);
+      }
+      Node& childNode = nodes[child.second];
+      childNode.failure = next == NONE ? ROOT : next;
+      childNode.outputLink = nodes[childNode.failure].ids.empty() ?
+        nodes[childNode.failure].outputLink : childNode.failure;
+      queue.push(child.second);
+    }
+  }
+}
+
+void MultiPatternMatcher::FindAll(const std::string& text,
+  std::vector<size_t>& ids) const
+{
+  if (!patternCount)
+    return;
+
+  int32_t node = ROOT;
+  for (char c : text)
+  {
+    int32_t next = FindChild(node, c);
+    while (next == NONE && node != ROOT)
+    {
+      node = nodes[node].failure;
+      next = FindChild(node, c);
+    }
+    node = next == NONE ? ROOT : next;
+
+    for (int32_t output = nodes[node].ids.empty() ? nodes[node].outputLink : node;
+         output != NONE; output = nodes[output].outputLink)
+    {
+      ids.insert(ids.end(), nodes[output].ids.begin(), nodes[output].ids.end());
+    }
+  }
+}
+
+size_t MultiPatternMatcher::GetPatternCount() const
+{
+  return patternCount;
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_MULTI_PATTERN_MATCHER_H
+#define ADBLOCK_PLUS_MULTI_PATTERN_MATCHER_H
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Finds all occurrences of a set of strings in a text in a single pass,
+   * using an Aho-Corasick automaton. The time needed doesn't depend on the
+   * number of strings.
+   */
+  class MultiPatternMatcher
+  {
+  public:
+    MultiPatternMatcher();
+
+    /**
+     * Adds a string to look for, `Build()` has to be called before
+     * `FindAll()` is used again.
+     * @param pattern Non-empty string, empty ones are ignored.
+     * @param id Value reported by `FindAll()` for this string.
+     */
+    void Add(const std::string& pattern, size_t id);
+
+    /**
+     * Computes the failure transitions of the automaton.
+     */
+    void Build();
+
+    /**
+     * Appends the IDs of the strings occurring in the text to `ids`. IDs
+     * are reported once for every occurrence, in no particular order.
+     */
+    void FindAll(const std::string& text, std::vector<size_t>& ids) const;
+
+    size_t GetPatternCount() const;
+
+  private:
+    struct Node
+    {
+      Node();
+
+      // Sorted by character.
+      std::vector<std::pair<char, int32_t>> children;
+      int32_t failure;
+      // Next node along the failure transitions which ends a string.
+      int32_t outputLink;
+      std::vector<size_t> ids;
+    };
+
+    int32_t FindChild(int32_t node, char c) const;
+
+    std::vector<Node> nodes;
+    size_t patternCount;
+  };
+}
+
+#endif
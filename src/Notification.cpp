@@ -91,7 +91,7 @@ NotificationType Notification::GetType() const
 
 NotificationTexts Notification::GetTexts() const
 {
-  JsValue jsTexts = jsEngine->Evaluate("API.getNotificationTexts").Call(*this);
+  JsValue jsTexts = jsEngine->GetApiFunction("getNotificationTexts").Call(*this);
   NotificationTexts notificationTexts;
   JsValue jsTitle = jsTexts.GetProperty("title");
   if (jsTitle.IsString())
@@ -124,5 +124,5 @@ std::vector<std::string> Notification::GetLinks() const
 
 void Notification::MarkAsShown()
 {
-  jsEngine->Evaluate("API.markNotificationAsShown").Call(GetProperty("id"));
+  jsEngine->GetApiFunction("markNotificationAsShown").Call(GetProperty("id"));
 }
@@ -0,0 +1,53 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrefsCache.h"
+
+using namespace AdblockPlus;
+
+PrefsCache::PrefsCache()
+  : values(std::make_shared<Values>())
+{
+}
+
+bool PrefsCache::Get(const std::string& pref, Value& value) const
+{
+  std::shared_ptr<const Values> currentValues = std::atomic_load(&values);
+  Values::const_iterator it = currentValues->find(pref);
+  if (it == currentValues->end())
+    return false;
+  value = it->second;
+  return true;
+}
+
+void PrefsCache::Set(const std::string& pref, const Value& value)
+{
+  std::lock_guard<std::mutex> lock(writeMutex);
+  std::shared_ptr<Values> newValues = std::make_shared<Values>(*values);
+  (*newValues)[pref] = value;
+  std::atomic_store(&values, std::shared_ptr<const Values>(newValues));
+}
+
+void PrefsCache::Remove(const std::string& pref)
+{
+  std::lock_guard<std::mutex> lock(writeMutex);
+  if (!values->count(pref))
+    return;
+  std::shared_ptr<Values> newValues = std::make_shared<Values>(*values);
+  newValues->erase(pref);
+  std::atomic_store(&values, std::shared_ptr<const Values>(newValues));
+}
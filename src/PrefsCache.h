@@ -0,0 +1,73 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_PREFS_CACHE_H
+#define ADBLOCK_PLUS_PREFS_CACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+namespace AdblockPlus
+{
+  /**
+   * Native copy of the scalar preferences, kept up to date by
+   * lib/prefs.js. Lookups don't lock, they read an immutable snapshot that
+   * is replaced on every change.
+   */
+  class PrefsCache
+  {
+  public:
+    struct Value
+    {
+      enum Type {TYPE_BOOL, TYPE_INT, TYPE_STRING};
+
+      Type type;
+      bool boolValue;
+      int64_t intValue;
+      std::string stringValue;
+    };
+
+    PrefsCache();
+
+    /**
+     * Looks up a preference.
+     * @return `true` if the preference is cached.
+     */
+    bool Get(const std::string& pref, Value& value) const;
+
+    /**
+     * Stores the current value of a preference.
+     */
+    void Set(const std::string& pref, const Value& value);
+
+    /**
+     * Drops a preference, e.g.\ if its current value can't be cached.
+     */
+    void Remove(const std::string& pref);
+
+  private:
+    typedef std::map<std::string, Value> Values;
+
+    std::mutex writeMutex;
+    std::shared_ptr<const Values> values;
+  };
+}
+
+#endif
@@ -15,6 +15,7 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <AdblockPlus/ReferrerMapping.h>
 
 using namespace AdblockPlus;
@@ -24,22 +25,55 @@ ReferrerMapping::ReferrerMapping(const int maxCachedUrls)
 {
 }
 
+ReferrerMapping::Mapping::const_iterator ReferrerMapping::Find(
+  const std::string& url) const
+{
+  // Doesn't own the string, only used for the lookup.
+  return mapping.find(SharedUrl(SharedUrl(), &url));
+}
+
+SharedUrl ReferrerMapping::Intern(const std::string& url) const
+{
+  Mapping::const_iterator entry = Find(url);
+  if (entry != mapping.end())
+    return entry->first;
+  return std::make_shared<const std::string>(url);
+}
+
 void ReferrerMapping::Add(const std::string& url, const std::string& referrer)
 {
-  if (mapping.find(url) != mapping.end())
-    cachedUrls.remove(url);
-  cachedUrls.push_back(url);
-  mapping[url] = referrer;
+  Mapping::iterator existing = mapping.find(SharedUrl(SharedUrl(), &url));
+  if (existing != mapping.end())
+  {
+    Entry& entry = existing->second;
+    entry.referrer = Intern(referrer);
+    cachedUrls.splice(cachedUrls.end(), cachedUrls, entry.cachedUrl);
+    return;
+  }
+
+  SharedUrl sharedUrl = std::make_shared<const std::string>(url);
+  Entry entry;
+  entry.referrer = url == referrer ? sharedUrl : Intern(referrer);
+  entry.cachedUrl = cachedUrls.insert(cachedUrls.end(), sharedUrl);
+  mapping.insert(std::make_pair(sharedUrl, entry));
 
-  const int urlsToPop = cachedUrls.size() - maxCachedUrls;
-  for (int i = 0; i < urlsToPop; i++)
+  while (static_cast<int>(mapping.size()) > maxCachedUrls)
   {
-    const std::string poppedUrl = cachedUrls.front();
+    mapping.erase(cachedUrls.front());
     cachedUrls.pop_front();
-    mapping.erase(poppedUrl);
   }
 }
 
+bool ReferrerMapping::GetReferrer(const std::string& url,
+  std::string& referrer) const
+{
+  Mapping::const_iterator entry = Find(url);
+  if (entry == mapping.end())
+    return false;
+  referrer = *entry->second.referrer;
+  return true;
+}
+
 std::vector<std::string> ReferrerMapping::BuildReferrerChain(
   const std::string& url) const
 {
@@ -48,13 +82,30 @@ std::vector<std::string> ReferrerMapping::BuildReferrerChain(
   // We need to limit the chain length to ensure we don't block indefinitely
   // if there's a referrer loop.
   const int maxChainLength = 10;
-  std::map<std::string, std::string>::const_iterator currentEntry =
-    mapping.find(url);
+  Mapping::const_iterator currentEntry = Find(url);
   for (int i = 0; i < maxChainLength && currentEntry != mapping.end(); i++)
   {
-    const std::string& currentUrl = currentEntry->second;
-    referrerChain.insert(referrerChain.begin(), currentUrl);
-    currentEntry = mapping.find(currentUrl);
+    const std::string& currentUrl = *currentEntry->second.referrer;
+    referrerChain.push_back(currentUrl);
+    currentEntry = Find(currentUrl);
   }
+  std::reverse(referrerChain.begin(), referrerChain.end());
   return referrerChain;
 }
+
+void ReferrerMapping::BuildReferrerChain(const std::string& url,
+  SharedUrlList& referrerChain) const
+{
+  referrerChain.clear();
+  Mapping::const_iterator currentEntry = Find(url);
+  referrerChain.push_back(currentEntry != mapping.end() ?
+    currentEntry->first : std::make_shared<const std::string>(url));
+  const int maxChainLength = 10;
+  for (int i = 0; i < maxChainLength && currentEntry != mapping.end(); i++)
+  {
+    const SharedUrl& currentUrl = currentEntry->second.referrer;
+    referrerChain.push_back(currentUrl);
+    currentEntry = Find(*currentUrl);
+  }
+  std::reverse(referrerChain.begin(), referrerChain.end());
+}
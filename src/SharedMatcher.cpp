@@ -0,0 +1,104 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/SharedMatcher.h>
+
+#include "CompiledRuleset.h"
+#include "Matcher.h"
+
+using namespace AdblockPlus;
+
+SharedMatcher::SharedMatcher(const FileSystemPtr& fileSystem,
+  const std::string& path)
+  : fileSystem(fileSystem), path(path)
+{
+  std::shared_ptr<State> initialState = std::make_shared<State>();
+  initialState->generation = 0;
+  initialState->matcher = std::make_shared<Matcher>();
+  state = initialState;
+  Refresh();
+}
+
+SharedMatcher::~SharedMatcher()
+{
+}
+
+SharedMatcher::StatePtr SharedMatcher::GetState() const
+{
+  return std::atomic_load(&state);
+}
+
+bool SharedMatcher::Refresh()
+{
+  std::lock_guard<std::mutex> lock(refreshMutex);
+  uint64_t generation = CompiledRuleset::GetPublishedGeneration(*fileSystem,
+    path);
+  if (generation == GetState()->generation)
+    return false;
+
+  std::shared_ptr<State> newState = std::make_shared<State>();
+  newState->generation = generation;
+  newState->ruleset = std::make_shared<CompiledRuleset>(fileSystem->ReadMapped(
+    CompiledRuleset::GetPublishedPath(path, generation)));
+  newState->matcher = std::make_shared<Matcher>();
+  newState->matcher->SetRuleset(newState->ruleset);
+  newState->matcher->Commit();
+  std::atomic_store(&state, StatePtr(newState));
+  return true;
+}
+
+uint64_t SharedMatcher::GetGeneration() const
+{
+  return GetState()->generation;
+}
+
+MatchResult SharedMatcher::GetMatchResult(const std::string& url,
+  FilterEngine::ContentTypeMask contentTypeMask,
+  const std::vector<std::string>& documentUrls) const
+{
+  StatePtr current = GetState();
+  if (documentUrls.empty())
+    return ToMatchResult(current->matcher->CheckFilterMatch(url,
+      contentTypeMask, ""));
+
+  MatcherFilterPtr match = CheckDocumentChain(documentUrls,
+    [&current](const std::string& documentUrl, const std::string& parentUrl)
+    {
+      return current->matcher->CheckFilterMatch(documentUrl,
+        FilterEngine::CONTENT_TYPE_DOCUMENT, parentUrl);
+    });
+  if (match)
+    return ToMatchResult(match);
+  return ToMatchResult(current->matcher->CheckFilterMatch(url,
+    contentTypeMask, documentUrls.back()));
+}
+
+MatchResult SharedMatcher::GetMatchResult(const std::string& url,
+  FilterEngine::ContentTypeMask contentTypeMask) const
+{
+  return GetMatchResult(url, contentTypeMask, std::vector<std::string>());
+}
+
+std::vector<std::string> SharedMatcher::GetElementHidingSelectors(
+  const std::string& domain) const
+{
+  std::vector<std::string> selectors;
+  StatePtr current = GetState();
+  if (current->ruleset)
+    current->ruleset->GetElementHidingSelectors(domain, selectors);
+  return selectors;
+}
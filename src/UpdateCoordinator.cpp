@@ -0,0 +1,268 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/JsEngine.h>
+#include <AdblockPlus/UpdateCoordinator.h>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  // Query parameters added by the downloader of adblockpluscore, they differ
+  // between the engines but don't change the response.
+  const char* const DOWNLOAD_STATISTICS_PARAMETERS[] = {"addonName",
+    "addonVersion", "application", "applicationVersion", "platform",
+    "platformVersion", "lastVersion", "downloadCount"};
+
+  bool IsDownloadStatisticsParameter(const std::string& parameter)
+  {
+    std::string name = parameter.substr(0, parameter.find('='));
+    for (const char* statisticsParameter : DOWNLOAD_STATISTICS_PARAMETERS)
+    {
+      if (name == statisticsParameter)
+        return true;
+    }
+    return false;
+  }
+
+  std::string GetDownloadKey(const std::string& url)
+  {
+    std::string::size_type queryStart = url.find('?');
+    std::string::size_type fragmentStart = url.find('#');
+    if (queryStart == std::string::npos || queryStart > fragmentStart)
+      return url.substr(0, fragmentStart);
+
+    std::string key = url.substr(0, queryStart);
+    std::string query = url.substr(queryStart + 1,
+      fragmentStart == std::string::npos ? std::string::npos :
+      fragmentStart - queryStart - 1);
+    char separator = '?';
+    std::string::size_type start = 0;
+    while (start <= query.size())
+    {
+      std::string::size_type end = query.find('&', start);
+      if (end == std::string::npos)
+        end = query.size();
+      std::string parameter = query.substr(start, end - start);
+      if (!parameter.empty() && !IsDownloadStatisticsParameter(parameter))
+      {
+        key += separator;
+        key += parameter;
+        separator = '&';
+      }
+      start = end + 1;
+    }
+    return key;
+  }
+
+  unsigned GetSeed()
+  {
+    // Hosts started from the same image must not end up with the same
+    // sequence of delays.
+    std::random_device device;
+    return device() ^ static_cast<unsigned>(
+      Clock::now().time_since_epoch().count());
+  }
+}
+
+struct UpdateCoordinator::Download
+{
+  std::string key;
+  std::string url;
+  HeaderList requestHeaders;
+  std::vector<IWebRequest::GetCallback> callbacks;
+};
+
+class UpdateCoordinator::CoordinatedWebRequest : public IWebRequest
+{
+public:
+  explicit CoordinatedWebRequest(const UpdateCoordinatorPtr& coordinator)
+    : coordinator(coordinator)
+  {
+  }
+
+  void GET(const std::string& url, const HeaderList& requestHeaders,
+    const GetCallback& getCallback) override
+  {
+    coordinator->GET(url, requestHeaders, getCallback);
+  }
+
+private:
+  UpdateCoordinatorPtr coordinator;
+};
+
+UpdateCoordinator::Settings::Settings()
+  : maxJitter(std::chrono::minutes(1)), maxConcurrentDownloads(2),
+    resultLifetime(std::chrono::minutes(10))
+{
+}
+
+UpdateCoordinator::UpdateCoordinator(const Settings& settings,
+  WebRequestPtr webRequest, TimerPtr timer)
+  : settings(settings), webRequest(std::move(webRequest)),
+    timer(std::move(timer)), random(GetSeed())
+{
+}
+
+UpdateCoordinatorPtr UpdateCoordinator::New(const Settings& settings,
+  WebRequestPtr webRequest, TimerPtr timer)
+{
+  if (!webRequest)
+    webRequest = CreateDefaultWebRequest();
+  if (!timer)
+    timer = CreateDefaultTimer();
+  return UpdateCoordinatorPtr(new UpdateCoordinator(settings,
+    std::move(webRequest), std::move(timer)));
+}
+
+WebRequestPtr UpdateCoordinator::CreateWebRequest()
+{
+  return WebRequestPtr(new CoordinatedWebRequest(shared_from_this()));
+}
+
+void UpdateCoordinator::Stagger(const std::function<void()>& task)
+{
+  int64_t maxJitter = settings.maxJitter.count();
+  if (maxJitter <= 0)
+  {
+    task();
+    return;
+  }
+  std::chrono::milliseconds delay;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    delay = std::chrono::milliseconds(
+      std::uniform_int_distribution<int64_t>(0, maxJitter)(random));
+  }
+  timer->SetTimer(delay, task);
+}
+
+void UpdateCoordinator::DiscardResult(const std::string& url)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  results.erase(GetDownloadKey(url));
+}
+
+UpdateCoordinator::Stats UpdateCoordinator::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  Stats result = stats;
+  result.queuedDownloads = queuedDownloads.size();
+  return result;
+}
+
+void UpdateCoordinator::GET(const std::string& url,
+  const HeaderList& requestHeaders, const IWebRequest::GetCallback& getCallback)
+{
+  std::string key = GetDownloadKey(url);
+  DownloadPtr download;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.requests++;
+
+    auto result = results.find(key);
+    if (result != results.end() && result->second.expires <= Clock::now())
+    {
+      results.erase(result);
+      result = results.end();
+    }
+    if (result != results.end())
+    {
+      stats.sharedResponses++;
+      ServerResponse response = result->second.response;
+      // The callback isn't called synchronously, like for any other
+      // request.
+      timer->SetTimer(std::chrono::milliseconds(0), [getCallback, response]
+      {
+        getCallback(response);
+      });
+      return;
+    }
+
+    auto it = downloads.find(key);
+    if (it != downloads.end())
+    {
+      stats.sharedResponses++;
+      it->second->callbacks.push_back(getCallback);
+      return;
+    }
+
+    download = std::make_shared<Download>();
+    download->key = key;
+    download->url = url;
+    download->requestHeaders = requestHeaders;
+    download->callbacks.push_back(getCallback);
+    downloads[key] = download;
+    if (stats.activeDownloads >= std::max<size_t>(settings.maxConcurrentDownloads, 1))
+    {
+      queuedDownloads.push_back(download);
+      return;
+    }
+    stats.activeDownloads++;
+    stats.downloads++;
+  }
+  Start(download);
+}
+
+void UpdateCoordinator::Start(const DownloadPtr& download)
+{
+  std::weak_ptr<UpdateCoordinator> weakCoordinator = shared_from_this();
+  webRequest->GET(download->url, download->requestHeaders,
+    [weakCoordinator, download](const ServerResponse& response)
+    {
+      auto coordinator = weakCoordinator.lock();
+      if (coordinator)
+      {
+        coordinator->Finish(download, response);
+        return;
+      }
+      for (const auto& callback : download->callbacks)
+        callback(response);
+    });
+}
+
+void UpdateCoordinator::Finish(const DownloadPtr& download,
+  const ServerResponse& response)
+{
+  std::vector<IWebRequest::GetCallback> callbacks;
+  DownloadPtr next;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    downloads.erase(download->key);
+    callbacks.swap(download->callbacks);
+    if (response.status == IWebRequest::NS_OK && response.responseStatus == 200 &&
+      settings.resultLifetime.count() > 0)
+    {
+      CachedResult result = {Clock::now() + settings.resultLifetime, response};
+      results[download->key] = result;
+    }
+    if (queuedDownloads.empty())
+      stats.activeDownloads--;
+    else
+    {
+      next = queuedDownloads.front();
+      queuedDownloads.pop_front();
+      stats.downloads++;
+    }
+  }
+  if (next)
+    Start(next);
+  for (const auto& callback : callbacks)
+    callback(response);
+}
@@ -0,0 +1,227 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "UrlTokenizer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define URL_TOKENIZER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define URL_TOKENIZER_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const size_t MIN_TOKEN_LENGTH = 3;
+
+  void AddToken(UrlTokenizer::Tokens& result, size_t start, size_t end)
+  {
+    if (end - start < MIN_TOKEN_LENGTH)
+      return;
+    UrlTokenizer::Token token;
+    token.start = start;
+    token.length = end - start;
+    token.hash = UrlTokenizer::HashToken(result.lowerUrl.data() + start,
+      token.length);
+    result.tokens.push_back(token);
+  }
+
+#if defined(URL_TOKENIZER_SSE2) || defined(URL_TOKENIZER_NEON)
+  const size_t BLOCK_SIZE = 16;
+
+  int CountTrailingZeros(uint32_t value)
+  {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(value);
+#endif
+  }
+
+  // Writes the lower-cased block to `out` and returns a mask with a bit set
+  // for every keyword character.
+  uint32_t ClassifyBlock(const char* in, char* out)
+  {
+#ifdef URL_TOKENIZER_SSE2
+    // The comparisons are signed, non-ASCII characters are negative and
+    // never fall into any of the ranges.
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i upper = _mm_and_si128(
+      _mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)),
+      _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+    __m128i lower = _mm_or_si128(chars,
+      _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), lower);
+    __m128i letter = _mm_and_si128(
+      _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+      _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(
+      _mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+      _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    __m128i percent = _mm_cmpeq_epi8(chars, _mm_set1_epi8('%'));
+    return static_cast<uint32_t>(_mm_movemask_epi8(
+      _mm_or_si128(letter, _mm_or_si128(digit, percent))));
+#else
+    uint8x16_t chars = vld1q_u8(reinterpret_cast<const uint8_t*>(in));
+    uint8x16_t upper = vandq_u8(vcgeq_u8(chars, vdupq_n_u8('A')),
+      vcleq_u8(chars, vdupq_n_u8('Z')));
+    uint8x16_t lower = vorrq_u8(chars, vandq_u8(upper, vdupq_n_u8(0x20)));
+    vst1q_u8(reinterpret_cast<uint8_t*>(out), lower);
+    uint8x16_t letter = vandq_u8(vcgeq_u8(lower, vdupq_n_u8('a')),
+      vcleq_u8(lower, vdupq_n_u8('z')));
+    uint8x16_t digit = vandq_u8(vcgeq_u8(chars, vdupq_n_u8('0')),
+      vcleq_u8(chars, vdupq_n_u8('9')));
+    uint8x16_t percent = vceqq_u8(chars, vdupq_n_u8('%'));
+    uint8x16_t keyword = vorrq_u8(letter, vorrq_u8(digit, percent));
+
+    // There is no movemask, weight the lanes and add them up pairwise.
+    static const uint8_t weights[16] = {
+      1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+    };
+    uint8x16_t bits = vandq_u8(keyword, vld1q_u8(weights));
+    uint8x8_t low = vget_low_u8(bits);
+    uint8x8_t high = vget_high_u8(bits);
+    for (int i = 0; i < 3; i++)
+    {
+      low = vpadd_u8(low, low);
+      high = vpadd_u8(high, high);
+    }
+    return vget_lane_u8(low, 0) | (static_cast<uint32_t>(vget_lane_u8(high, 0)) << 8);
+#endif
+  }
+#endif
+}
+
+uint64_t UrlTokenizer::HashToken(const char* data, size_t length)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++)
+  {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void UrlTokenizer::TokenizeScalar(const std::string& url, Tokens& result)
+{
+  size_t length = url.length();
+  result.lowerUrl.resize(length);
+  result.tokens.clear();
+
+  bool inToken = false;
+  size_t tokenStart = 0;
+  for (size_t pos = 0; pos < length; pos++)
+  {
+    char c = url[pos];
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+    result.lowerUrl[pos] = c;
+    bool keywordChar = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+        c == '%';
+    if (keywordChar && !inToken)
+    {
+      tokenStart = pos;
+      inToken = true;
+    }
+    else if (!keywordChar && inToken)
+    {
+      AddToken(result, tokenStart, pos);
+      inToken = false;
+    }
+  }
+  if (inToken)
+    AddToken(result, tokenStart, length);
+}
+
+#if defined(URL_TOKENIZER_SSE2) || defined(URL_TOKENIZER_NEON)
+void UrlTokenizer::Tokenize(const std::string& url, Tokens& result)
+{
+  size_t length = url.length();
+  result.lowerUrl.resize(length);
+  result.tokens.clear();
+  if (!length)
+    return;
+
+  bool inToken = false;
+  size_t tokenStart = 0;
+  for (size_t offset = 0; offset < length; offset += BLOCK_SIZE)
+  {
+    uint32_t mask;
+    if (length - offset >= BLOCK_SIZE)
+      mask = ClassifyBlock(url.data() + offset, &result.lowerUrl[offset]);
+    else
+    {
+      // Zero padding isn't a keyword character, so a token at the end of the
+      // URL always ends within the last block.
+      char in[BLOCK_SIZE] = {0};
+      char out[BLOCK_SIZE];
+      std::memcpy(in, url.data() + offset, length - offset);
+      mask = ClassifyBlock(in, out);
+      std::memcpy(&result.lowerUrl[offset], out, length - offset);
+    }
+
+    // Alternately look for the next keyword character and the next
+    // character ending the token.
+    int pos = 0;
+    for (;;)
+    {
+      uint32_t candidates = (inToken ? ~mask : mask) & (0xFFFFu << pos) & 0xFFFFu;
+      if (!candidates)
+        break;
+      pos = CountTrailingZeros(candidates);
+      if (inToken)
+        AddToken(result, tokenStart, offset + pos);
+      else
+        tokenStart = offset + pos;
+      inToken = !inToken;
+    }
+  }
+  if (inToken)
+    AddToken(result, tokenStart, length);
+}
+
+const char* UrlTokenizer::GetImplementation()
+{
+#ifdef URL_TOKENIZER_SSE2
+  return "SSE2";
+#else
+  return "NEON";
+#endif
+}
+#else
+void UrlTokenizer::Tokenize(const std::string& url, Tokens& result)
+{
+  TokenizeScalar(url, result);
+}
+
+const char* UrlTokenizer::GetImplementation()
+{
+  return "scalar";
+}
+#endif
@@ -0,0 +1,77 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_URL_TOKENIZER_H
+#define ADBLOCK_PLUS_URL_TOKENIZER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Splits URLs into the keyword candidates of `Matcher`, the runs of at
+   * least three [a-z0-9%] characters after lower-casing, same as
+   * `/[a-z0-9%]{3,}/g` in lib/matcher.js.
+   */
+  namespace UrlTokenizer
+  {
+    struct Token
+    {
+      size_t start;
+      size_t length;
+      /// Hash of the lower-cased token, see `HashToken()`.
+      uint64_t hash;
+    };
+
+    struct Tokens
+    {
+      std::string lowerUrl;
+      std::vector<Token> tokens;
+
+      std::string GetToken(const Token& token) const
+      {
+        return lowerUrl.substr(token.start, token.length);
+      }
+    };
+
+    /**
+     * 64-bit FNV-1a hash, also used by `BloomFilter`.
+     */
+    uint64_t HashToken(const char* data, size_t length);
+
+    /**
+     * Lower-cases the URL and extracts its tokens in one pass, classifying
+     * 16 characters at a time with SSE2 or NEON where available.
+     */
+    void Tokenize(const std::string& url, Tokens& result);
+
+    /**
+     * Same as `Tokenize()`, processing one character at a time.
+     */
+    void TokenizeScalar(const std::string& url, Tokens& result);
+
+    /**
+     * Returns the name of the instruction set used by `Tokenize()`:
+     * "SSE2", "NEON" or "scalar".
+     */
+    const char* GetImplementation();
+  }
+}
+
+#endif
@@ -16,22 +16,88 @@
  */
 
 #include <sstream>
+#include <type_traits>
 #include <stdexcept>
 
-#ifdef _WIN32
-#include <Windows.h>
-#include <Shlwapi.h>
-#endif
-
 #include "Utils.h"
 
 using namespace AdblockPlus;
 
-std::string Utils::Slurp(std::istream& stream)
+namespace
 {
-  std::stringstream content;
-  content << stream.rdbuf();
-  return content.str();
+  // Texts below this length are copied, an external string only pays off for
+  // large texts.
+  const size_t EXTERNAL_STRING_MIN_LENGTH = 4096;
+
+  bool IsAscii(const char* data, size_t length)
+  {
+    for (size_t i = 0; i < length; i++)
+      if (static_cast<unsigned char>(data[i]) >= 0x80)
+        return false;
+    return true;
+  }
+
+  class StaticStringResource : public v8::String::ExternalAsciiStringResource
+  {
+  public:
+    StaticStringResource(const char* data, size_t length)
+      : text(data), textLength(length)
+    {
+    }
+
+    const char* data() const override
+    {
+      return text;
+    }
+
+    size_t length() const override
+    {
+      return textLength;
+    }
+
+  private:
+    const char* text;
+    size_t textLength;
+  };
+
+  // V8 deletes the resource, and thereby the buffer, once the string is
+  // garbage collected.
+  template<typename Buffer>
+  class OwnedStringResource : public v8::String::ExternalAsciiStringResource
+  {
+  public:
+    explicit OwnedStringResource(Buffer&& buffer)
+      : buffer(std::move(buffer))
+    {
+    }
+
+    const char* data() const override
+    {
+      return reinterpret_cast<const char*>(buffer.data());
+    }
+
+    size_t length() const override
+    {
+      return buffer.size();
+    }
+
+  private:
+    Buffer buffer;
+  };
+
+  template<typename Buffer>
+  v8::Local<v8::String> ToExternalString(v8::Isolate* isolate, Buffer&& buffer)
+  {
+    const char* data = reinterpret_cast<const char*>(buffer.data());
+    if (buffer.size() < EXTERNAL_STRING_MIN_LENGTH ||
+        !IsAscii(data, buffer.size()))
+    {
+      return v8::String::NewFromUtf8(isolate, data,
+        v8::String::NewStringType::kNormalString, static_cast<int>(buffer.size()));
+    }
+    return v8::String::NewExternal(
+      new OwnedStringResource<typename std::decay<Buffer>::type>(std::move(buffer)));
+  }
 }
 
 std::string Utils::FromV8String(const v8::Handle<v8::Value>& value)
@@ -43,64 +109,44 @@ std::string Utils::FromV8String(const v8::Handle<v8::Value>& value)
     return std::string();
 }
 
+void Utils::FromV8StringArray(const v8::Handle<v8::Value>& value,
+  std::vector<std::string>& result)
+{
+  if (!value->IsArray())
+    throw std::runtime_error("Cannot convert a non-array to list");
+  v8::Local<v8::Array> array = v8::Local<v8::Array>::Cast(value);
+  uint32_t length = array->Length();
+  result.clear();
+  result.reserve(length);
+  for (uint32_t i = 0; i < length; i++)
+    result.push_back(FromV8String(array->Get(i)));
+}
+
 v8::Local<v8::String> Utils::ToV8String(v8::Isolate* isolate, const std::string& str)
 {
   return v8::String::NewFromUtf8(isolate, str.c_str(),
     v8::String::NewStringType::kNormalString, str.length());
 }
 
-
-#ifdef _WIN32
-std::wstring Utils::ToUtf16String(const std::string& str)
+v8::Local<v8::String> Utils::ToV8StaticString(v8::Isolate* isolate,
+  const char* data, size_t length)
 {
-  size_t length = str.size();
-  if (length == 0)
-    return std::wstring();
-
-  DWORD utf16StringLength = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), length, NULL, 0);
-  if (utf16StringLength == 0)
-    throw std::runtime_error("ToUTF16String failed. Can't determine the length of the buffer needed.");
-
-  std::wstring utf16String(utf16StringLength, L'\0');
-  MultiByteToWideChar(CP_UTF8, 0, str.c_str(), length, &utf16String[0], utf16StringLength);
-  return utf16String;
+  if (!IsAscii(data, length))
+  {
+    return v8::String::NewFromUtf8(isolate, data,
+      v8::String::NewStringType::kNormalString, static_cast<int>(length));
+  }
+  return v8::String::NewExternal(new StaticStringResource(data, length));
 }
 
-std::string Utils::ToUtf8String(const std::wstring& str)
+v8::Local<v8::String> Utils::ToV8ExternalString(v8::Isolate* isolate,
+  std::string&& str)
 {
-  size_t length = str.size();
-  if (length == 0)
-    return std::string();
-
-  DWORD utf8StringLength = WideCharToMultiByte(CP_UTF8, 0, str.c_str(), length, NULL, 0, 0, 0);
-  if (utf8StringLength == 0)
-    throw std::runtime_error("ToUTF8String failed. Can't determine the length of the buffer needed.");
-
-  std::string utf8String(utf8StringLength, '\0');
-  WideCharToMultiByte(CP_UTF8, 0, str.c_str(), length, &utf8String[0], utf8StringLength, 0, 0);
-  return utf8String;
+  return ToExternalString(isolate, std::move(str));
 }
 
-std::wstring Utils::CanonizeUrl(const std::wstring& url)
+v8::Local<v8::String> Utils::ToV8ExternalString(v8::Isolate* isolate,
+  std::vector<uint8_t>&& data)
 {
-  HRESULT hr;
-
-  std::wstring canonizedUrl;
-  DWORD canonizedUrlLength = 2049; // de-facto limit of url length
-
-  canonizedUrl.resize(canonizedUrlLength);
-  hr = UrlCanonicalize(url.c_str(), &canonizedUrl[0], &canonizedUrlLength, 0);
-  canonizedUrl.resize(canonizedUrlLength);
-  if (FAILED(hr))
-  {
-    hr = UrlCanonicalize(url.c_str(), &canonizedUrl[0], &canonizedUrlLength, 0);
-    if (FAILED(hr))
-    {
-      throw std::runtime_error("CanonizeUrl failed\n");
-    }
-  }
-  return canonizedUrl;
-
+  return ToExternalString(isolate, std::move(data));
 }
-#endif
-
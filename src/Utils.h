@@ -18,36 +18,36 @@
 #ifndef ADBLOCK_PLUS_UTILS_H
 #define ADBLOCK_PLUS_UTILS_H
 
-#include <algorithm>
-#include <cctype>
-#include <functional>
-#include <istream>
 #include <string>
+#include <vector>
 #include <v8.h>
 
+#include "StringUtils.h"
+
 namespace AdblockPlus
 {
   namespace Utils
   {
-    std::string Slurp(std::istream& stream);
     std::string FromV8String(const v8::Handle<v8::Value>& value);
+
+    // Converts the elements of an array into the supplied vector, reusing
+    // its capacity. Throws unless the value is an array.
+    void FromV8StringArray(const v8::Handle<v8::Value>& value,
+      std::vector<std::string>& result);
     v8::Local<v8::String> ToV8String(v8::Isolate* isolate, const std::string& str);
 
-    // Code for templated function has to be in a header file, can't be in .cpp
-    template<class T>
-    T TrimString(const T& text)
-    {
-      // Via http://stackoverflow.com/questions/216823/whats-the-best-way-to-trim-stdstring
-      T trimmed(text);
-      trimmed.erase(trimmed.begin(), std::find_if(trimmed.begin(), trimmed.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
-      trimmed.erase(std::find_if(trimmed.rbegin(), trimmed.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), trimmed.end());
-      return trimmed;
-    }
-#ifdef _WIN32
-    std::wstring ToUtf16String(const std::string& str);
-    std::string ToUtf8String(const std::wstring& str);
-    std::wstring CanonizeUrl(const std::wstring& url);
-#endif
+    // Creates a string V8 reads from the supplied buffer instead of copying
+    // it, the buffer has to stay valid and unchanged for the lifetime of the
+    // isolate. Falls back to copying unless the text is ASCII only.
+    v8::Local<v8::String> ToV8StaticString(v8::Isolate* isolate,
+      const char* data, size_t length);
+
+    // Creates a string taking over the UTF-8 text, large ASCII texts are then
+    // read by V8 from the moved buffer instead of being copied.
+    v8::Local<v8::String> ToV8ExternalString(v8::Isolate* isolate,
+      std::string&& str);
+    v8::Local<v8::String> ToV8ExternalString(v8::Isolate* isolate,
+      std::vector<uint8_t>&& data);
   }
 }
 
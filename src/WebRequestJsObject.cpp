@@ -21,10 +21,40 @@
 #include "JsContext.h"
 #include "Utils.h"
 #include "WebRequestJsObject.h"
-#include <thread> // TODO: remove with removing of JsEngine::webRequestLegacy
+#include "WebRequestMetrics.h"
+#include "WorkQueue.h"
 
 using namespace AdblockPlus;
 
+namespace
+{
+  // Returns the length of the longest prefix of the data which doesn't end
+  // in the middle of a UTF-8 sequence.
+  size_t CompleteUtf8Length(const std::string& data)
+  {
+    size_t length = data.length();
+    for (size_t i = 1; i <= 3 && i <= length; i++)
+    {
+      unsigned char byte = static_cast<unsigned char>(data[length - i]);
+      if ((byte & 0xC0) != 0x80)
+      {
+        size_t sequenceLength = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+        return sequenceLength > i ? length - i : length;
+      }
+    }
+    return length;
+  }
+
+  struct WebRequestState
+  {
+    // Stores the parameters of GET followed by the response text received
+    // so far.
+    JsEngine::JsWeakValuesID paramsID;
+    // Trailing bytes of an incomplete UTF-8 sequence.
+    std::string pendingData;
+  };
+}
+
 void JsEngine::ScheduleWebRequest(const v8::Arguments& arguments)
 {
   AdblockPlus::JsEnginePtr jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
@@ -54,21 +84,66 @@ void JsEngine::ScheduleWebRequest(const v8::Arguments& arguments)
   if (!converted[2].IsFunction())
     throw std::runtime_error("Third argument to GET must be a function");
 
-  auto paramsID = jsEngine->StoreJsValues(converted);
+  converted.push_back(jsEngine->NewValue(""));
+  std::shared_ptr<WebRequestState> state = std::make_shared<WebRequestState>();
+  state->paramsID = jsEngine->StoreJsValues(converted);
   std::weak_ptr<JsEngine> weakJsEngine = jsEngine;
-  auto getCallback = [weakJsEngine, paramsID](const ServerResponse& response)
+  // Appends the complete UTF-8 sequences of the pending data to the stored
+  // response text. The text is kept as a JavaScript string only, so the
+  // response body is never held as a whole in native memory.
+  auto appendResponseText = [](const JsEnginePtr& jsEngine, WebRequestState& state, bool flush)
+  {
+    size_t length = flush ? state.pendingData.length() : CompleteUtf8Length(state.pendingData);
+    if (!length)
+      return;
+    AdblockPlus::JsContext context(*jsEngine, JsEngine::LOCK_SITE_WEB_REQUEST);
+    auto params = jsEngine->TakeJsValues(state.paramsID);
+    v8::Local<v8::String> chunk;
+    if (length == state.pendingData.length())
+    {
+      // Large ASCII chunks are handed over to V8 without a copy.
+      chunk = AdblockPlus::Utils::ToV8ExternalString(jsEngine->GetIsolate(),
+        std::move(state.pendingData));
+      state.pendingData.clear();
+    }
+    else
+    {
+      chunk = v8::String::NewFromUtf8(jsEngine->GetIsolate(), state.pendingData.data(),
+        v8::String::kNormalString, static_cast<int>(length));
+      state.pendingData.erase(0, length);
+    }
+    params[3] = JsValue(jsEngine, v8::String::Concat(params[3].UnwrapValue()->ToString(), chunk));
+    state.paramsID = jsEngine->StoreJsValues(params);
+  };
+  auto dataCallback = [weakJsEngine, state, appendResponseText](const char* data, size_t size)
   {
     auto jsEngine = weakJsEngine.lock();
     if (!jsEngine)
       return;
-    auto webRequestParams = jsEngine->TakeJsValues(paramsID);
-
-    AdblockPlus::JsContext context(*jsEngine);
+    auto chunk = std::make_shared<std::string>(data, size);
+    jsEngine->DispatchCallback([weakJsEngine, state, appendResponseText, chunk]
+    {
+      auto jsEngine = weakJsEngine.lock();
+      if (!jsEngine)
+        return;
+      state->pendingData.append(*chunk);
+      appendResponseText(jsEngine, *state, false);
+    });
+  };
+  auto completeRequest = [weakJsEngine, state, appendResponseText](const ServerResponse& response)
+  {
+    auto jsEngine = weakJsEngine.lock();
+    if (!jsEngine)
+      return;
+    AdblockPlus::JsContext context(*jsEngine, JsEngine::LOCK_SITE_WEB_REQUEST);
+    appendResponseText(jsEngine, *state, true);
+    auto webRequestParams = jsEngine->TakeJsValues(state->paramsID);
 
     auto resultObject = jsEngine->NewObject();
     resultObject.SetProperty("status", response.status);
     resultObject.SetProperty("responseStatus", response.responseStatus);
-    resultObject.SetProperty("responseText", response.responseText);
+    resultObject.SetProperty("responseText", webRequestParams[3]);
+    resultObject.SetProperty("receivedBytes", response.receivedBytes);
 
     auto headersObject = jsEngine->NewObject();
     for (const auto& header : response.responseHeaders)
@@ -79,18 +154,29 @@ void JsEngine::ScheduleWebRequest(const v8::Arguments& arguments)
 
     webRequestParams[2].Call(resultObject);
   };
-
+  auto getCallback = [weakJsEngine, url, completeRequest](const ServerResponse& response)
+  {
+    if (auto jsEngine = weakJsEngine.lock())
+    {
+      jsEngine->webRequestMetrics->Record(url, response);
+      jsEngine->DispatchCallback([completeRequest, response]
+      {
+        completeRequest(response);
+      });
+    }
+  };
 
   if (jsEngine->webRequestLegacy)
   {
-    std::thread([jsEngine, url, headers, getCallback]
+    auto webRequestLegacy = jsEngine->webRequestLegacy;
+    jsEngine->webRequestLegacyQueue->Post([webRequestLegacy, url, headers, dataCallback, getCallback]
     {
-      getCallback(jsEngine->webRequestLegacy->GET(url, headers));
-    }).detach();
+      getCallback(webRequestLegacy->GET(url, headers, dataCallback));
+    });
     return;
   }
 
-  jsEngine->webRequest->GET(url, headers, getCallback);
+  jsEngine->webRequest->GET(url, headers, dataCallback, getCallback);
 }
 
 namespace
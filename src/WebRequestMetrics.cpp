@@ -0,0 +1,95 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+
+#include "BaseDomain.h"
+#include "LatencyHistogram.h"
+#include "WebRequestMetrics.h"
+
+using namespace AdblockPlus;
+
+WebRequestMetrics::Host::Host()
+  : requestCount(0), failedCount(0), reusedConnectionCount(0),
+    receivedBytes(0),
+    timings(new LatencyHistogram[PHASE_COUNT],
+      std::default_delete<LatencyHistogram[]>())
+{
+}
+
+WebRequestMetrics::WebRequestMetrics()
+{
+}
+
+WebRequestMetrics::~WebRequestMetrics()
+{
+}
+
+void WebRequestMetrics::Record(const std::string& url,
+  const ServerResponse& response)
+{
+  const int64_t phases[PHASE_COUNT] = {response.timing.dnsLookup,
+    response.timing.connect, response.timing.tlsHandshake,
+    response.timing.firstByte, response.timing.total};
+  std::string hostName = BaseDomain::ExtractHostFromURL(url);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  Host& host = hosts[hostName];
+  host.requestCount++;
+  if (response.status != IWebRequest::NS_OK)
+    host.failedCount++;
+  if (response.connectionReused)
+    host.reusedConnectionCount++;
+  if (response.receivedBytes > 0)
+    host.receivedBytes += response.receivedBytes;
+  if (!response.protocolVersion.empty())
+    host.protocolVersion = response.protocolVersion;
+  for (int i = 0; i < PHASE_COUNT; i++)
+  {
+    if (phases[i] >= 0)
+      host.timings.get()[i].Record(std::chrono::microseconds(phases[i]));
+  }
+}
+
+std::vector<WebRequestHostMetrics> WebRequestMetrics::Get() const
+{
+  static const char* const phaseNames[PHASE_COUNT] = {"DnsLookup", "Connect",
+    "TlsHandshake", "FirstByte", "Total"};
+  std::vector<WebRequestHostMetrics> result;
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& entry : hosts)
+  {
+    const Host& host = entry.second;
+    WebRequestHostMetrics metrics;
+    metrics.host = entry.first;
+    metrics.requestCount = host.requestCount;
+    metrics.failedCount = host.failedCount;
+    metrics.reusedConnectionCount = host.reusedConnectionCount;
+    metrics.receivedBytes = host.receivedBytes;
+    metrics.protocolVersion = host.protocolVersion;
+    for (int i = 0; i < PHASE_COUNT; i++)
+      metrics.timings.push_back(host.timings.get()[i].GetMetrics(phaseNames[i]));
+    result.push_back(metrics);
+  }
+  return result;
+}
+
+void WebRequestMetrics::Reset()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  hosts.clear();
+}
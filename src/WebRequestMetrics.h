@@ -0,0 +1,80 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_WEB_REQUEST_METRICS_H
+#define ADBLOCK_PLUS_WEB_REQUEST_METRICS_H
+
+#include <AdblockPlus/IWebRequest.h>
+#include <AdblockPlus/LatencyMetrics.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace AdblockPlus
+{
+  class LatencyHistogram;
+
+  /**
+   * Aggregates the transfers of completed web requests by host, see
+   * `JsEngine::GetWebRequestMetrics()`.
+   */
+  class WebRequestMetrics
+  {
+  public:
+    WebRequestMetrics();
+    ~WebRequestMetrics();
+
+    void Record(const std::string& url, const ServerResponse& response);
+
+    /**
+     * @return One entry per host, sorted by host name.
+     */
+    std::vector<WebRequestHostMetrics> Get() const;
+
+    void Reset();
+
+  private:
+    /// Indexes of the histograms in `Host::timings`.
+    enum Phase
+    {
+      PHASE_DNS_LOOKUP, PHASE_CONNECT, PHASE_TLS_HANDSHAKE, PHASE_FIRST_BYTE,
+      PHASE_TOTAL, PHASE_COUNT
+    };
+
+    struct Host
+    {
+      Host();
+
+      uint64_t requestCount;
+      uint64_t failedCount;
+      uint64_t reusedConnectionCount;
+      uint64_t receivedBytes;
+      std::string protocolVersion;
+      std::shared_ptr<LatencyHistogram> timings;
+    };
+
+    mutable std::mutex mutex;
+    std::map<std::string, Host> hosts;
+
+    WebRequestMetrics(const WebRequestMetrics&);
+    void operator=(const WebRequestMetrics&);
+  };
+}
+
+#endif
@@ -0,0 +1,334 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "DefaultWebRequestWinInet.h"
+#include "Utils.h"
+#include "WinHttpWebRequest.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  int64_t MicrosecondsSince(const Clock::time_point& start)
+  {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start).count());
+  }
+}
+
+struct WinHttpWebRequest::State
+{
+  State()
+    : session(0), closed(false)
+  {
+  }
+
+  ~State()
+  {
+    for (const auto& connection : connections)
+      WinHttpCloseHandle(connection.second);
+    if (session)
+      WinHttpCloseHandle(session);
+  }
+
+  HINTERNET session;
+  std::mutex mutex;
+  /// Connection handles by host and port, kept for the lifetime of the
+  /// session.
+  std::map<std::pair<std::wstring, INTERNET_PORT>, HINTERNET> connections;
+  /// Request handles which weren't closed yet.
+  std::set<HINTERNET> activeRequests;
+  /// Set on destruction of the `WinHttpWebRequest`.
+  bool closed;
+};
+
+/// Context of the status callbacks of a request handle, deleted when the
+/// handle is closed.
+struct WinHttpWebRequest::Request
+{
+  StatePtr state;
+  HINTERNET handle;
+  DataCallback dataCallback;
+  GetCallback getCallback;
+  ServerResponse response;
+  Clock::time_point start;
+  bool decompressing;
+  std::vector<char> buffer;
+
+  static void CALLBACK OnStatus(HINTERNET handle, DWORD_PTR context,
+    DWORD status, LPVOID info, DWORD infoLength);
+  void Fail(DWORD error);
+  void Finish();
+  void ReadNext();
+};
+
+void CALLBACK WinHttpWebRequest::Request::OnStatus(HINTERNET handle,
+  DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLength)
+{
+  Request* request = reinterpret_cast<Request*>(context);
+  if (!request)
+    return;
+  switch (status)
+  {
+  case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+    if (!WinHttpReceiveResponse(handle, 0))
+      request->Fail(GetLastError());
+    break;
+  case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
+    request->response.timing.firstByte = MicrosecondsSince(request->start);
+    try
+    {
+      ParseResponseHeaders(handle, &request->response);
+    }
+    catch (const std::exception&)
+    {
+      request->Fail(ERROR_WINHTTP_INVALID_SERVER_RESPONSE);
+      break;
+    }
+    request->ReadNext();
+    break;
+  case WINHTTP_CALLBACK_STATUS_DATA_AVAILABLE:
+  {
+    DWORD size = *static_cast<DWORD*>(info);
+    if (size == 0)
+    {
+      request->Finish();
+      break;
+    }
+    request->buffer.resize(size);
+    if (!WinHttpReadData(handle, &request->buffer[0], size, 0))
+      request->Fail(GetLastError());
+    break;
+  }
+  case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+    if (infoLength == 0)
+    {
+      request->Finish();
+      break;
+    }
+    if (request->dataCallback)
+      request->dataCallback(static_cast<const char*>(info), infoLength);
+    else
+      request->response.responseText.append(static_cast<const char*>(info), infoLength);
+    if (!request->decompressing)
+      request->response.receivedBytes += infoLength;
+    request->ReadNext();
+    break;
+  case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR:
+    request->Fail(static_cast<WINHTTP_ASYNC_RESULT*>(info)->dwError);
+    break;
+  case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING:
+    delete request;
+    break;
+  }
+}
+
+void WinHttpWebRequest::Request::ReadNext()
+{
+  if (!WinHttpQueryDataAvailable(handle, 0))
+    Fail(GetLastError());
+}
+
+void WinHttpWebRequest::Request::Fail(DWORD error)
+{
+  ServerResponse failed;
+  failed.status = WindowsErrorToGeckoError(error);
+  failed.timing = response.timing;
+  response = failed;
+  Finish();
+}
+
+void WinHttpWebRequest::Request::Finish()
+{
+  response.timing.total = MicrosecondsSince(start);
+  // With decompression WinHTTP only returns the decoded data, the number of
+  // received bytes is known from Content-Length then.
+  if (decompressing)
+  {
+    for (const auto& header : response.responseHeaders)
+    {
+      if (header.first == "content-length")
+        std::istringstream(header.second) >> response.receivedBytes;
+    }
+  }
+
+  bool closed;
+  bool ownsHandle;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    closed = state->closed;
+    // The destructor of WinHttpWebRequest takes over and closes the handles
+    // of the requests still active.
+    ownsHandle = state->activeRequests.erase(handle) != 0;
+  }
+  // The request is deleted once the handle is closed, see OnStatus().
+  GetCallback callback = getCallback;
+  ServerResponse result = response;
+  if (ownsHandle)
+    WinHttpCloseHandle(handle);
+  if (!closed)
+    callback(result);
+}
+
+WinHttpWebRequest::WinHttpWebRequest()
+  : state(std::make_shared<State>())
+{
+  std::wstring proxyName, proxyBypass;
+  GetProxySettings(proxyName, proxyBypass);
+  if (proxyName.empty())
+  {
+    state->session = WinHttpOpen(L"Adblock Plus", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+      WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, WINHTTP_FLAG_ASYNC);
+  }
+  else
+  {
+    state->session = WinHttpOpen(L"Adblock Plus", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+      proxyName.c_str(), proxyBypass.c_str(), WINHTTP_FLAG_ASYNC);
+    if (state->session)
+    {
+      WINHTTP_PROXY_INFO proxyInfo;
+      proxyInfo.dwAccessType = WINHTTP_ACCESS_TYPE_NAMED_PROXY;
+      proxyInfo.lpszProxy = const_cast<LPWSTR>(proxyName.c_str());
+      proxyInfo.lpszProxyBypass = const_cast<LPWSTR>(proxyBypass.c_str());
+      WinHttpSetOption(state->session, WINHTTP_OPTION_PROXY, &proxyInfo, sizeof(proxyInfo));
+    }
+  }
+  if (!state->session)
+    return;
+
+  WinHttpSetStatusCallback(state->session, &Request::OnStatus,
+    WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES, 0);
+#ifdef WINHTTP_PROTOCOL_FLAG_HTTP2
+  // Windows 10 1607 and later, requests to the same host share a single
+  // connection then.
+  DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+  WinHttpSetOption(state->session, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL,
+    &protocols, sizeof(protocols));
+#endif
+}
+
+WinHttpWebRequest::~WinHttpWebRequest()
+{
+  std::set<HINTERNET> requests;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->closed = true;
+    requests.swap(state->activeRequests);
+  }
+  // The handles of the connections and of the session are closed by the
+  // state, once the last request released it.
+  for (HINTERNET handle : requests)
+    WinHttpCloseHandle(handle);
+}
+
+void WinHttpWebRequest::GET(const std::string& url, const HeaderList& requestHeaders,
+  const GetCallback& getCallback)
+{
+  GET(url, requestHeaders, DataCallback(), getCallback);
+}
+
+void WinHttpWebRequest::GET(const std::string& url, const HeaderList& requestHeaders,
+  const DataCallback& dataCallback, const GetCallback& getCallback)
+{
+  ServerResponse failed;
+  failed.status = IWebRequest::NS_ERROR_NOT_INITIALIZED;
+  if (!state->session)
+  {
+    getCallback(failed);
+    return;
+  }
+
+  std::wstring canonizedUrl = Utils::CanonizeUrl(Utils::ToUtf16String(url));
+  URL_COMPONENTS urlComponents;
+  ZeroMemory(&urlComponents, sizeof(urlComponents));
+  urlComponents.dwStructSize = sizeof(urlComponents);
+  urlComponents.dwSchemeLength = static_cast<DWORD>(-1);
+  urlComponents.dwHostNameLength = static_cast<DWORD>(-1);
+  urlComponents.dwUrlPathLength = static_cast<DWORD>(-1);
+  urlComponents.dwExtraInfoLength = static_cast<DWORD>(-1);
+  if (!WinHttpCrackUrl(canonizedUrl.c_str(), static_cast<DWORD>(canonizedUrl.length()),
+      0, &urlComponents))
+  {
+    failed.status = WindowsErrorToGeckoError(GetLastError());
+    getCallback(failed);
+    return;
+  }
+  std::wstring hostName(urlComponents.lpszHostName, urlComponents.dwHostNameLength);
+
+  std::unique_ptr<Request> request(new Request());
+  request->state = state;
+  request->dataCallback = dataCallback;
+  request->getCallback = getCallback;
+  request->start = Clock::now();
+  request->decompressing = false;
+  request->response.receivedBytes = 0;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    HINTERNET& connection = state->connections[std::make_pair(hostName, urlComponents.nPort)];
+    if (!connection)
+      connection = WinHttpConnect(state->session, hostName.c_str(), urlComponents.nPort, 0);
+    if (connection)
+    {
+      DWORD flags = urlComponents.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0;
+      request->handle = WinHttpOpenRequest(connection, L"GET", urlComponents.lpszUrlPath,
+        0, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
+    }
+    else
+      request->handle = 0;
+    if (request->handle)
+      state->activeRequests.insert(request->handle);
+  }
+  if (!request->handle)
+  {
+    failed.status = WindowsErrorToGeckoError(GetLastError());
+    getCallback(failed);
+    return;
+  }
+
+#ifdef WINHTTP_OPTION_DECOMPRESSION
+  DWORD decompressionFlags = WINHTTP_DECOMPRESSION_FLAG_ALL;
+  request->decompressing = WinHttpSetOption(request->handle, WINHTTP_OPTION_DECOMPRESSION,
+    &decompressionFlags, sizeof(decompressionFlags)) != FALSE;
+#endif
+
+  std::string headersString;
+  for (const auto& header : requestHeaders)
+    headersString += header.first + ": " + header.second + "\r\n";
+  std::wstring headers = Utils::ToUtf16String(headersString);
+
+  // From now on the request is owned by its handle, see Request::OnStatus().
+  Request* context = request.release();
+  if (!WinHttpSendRequest(context->handle,
+      headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
+      static_cast<DWORD>(headers.length()), WINHTTP_NO_REQUEST_DATA, 0, 0,
+      reinterpret_cast<DWORD_PTR>(context)))
+  {
+    // No callbacks are made for the request, the context is only passed to
+    // the one for the closing handle.
+    WinHttpSetOption(context->handle, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context));
+    context->Fail(GetLastError());
+  }
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_WIN_HTTP_WEB_REQUEST_H
+#define ADBLOCK_PLUS_WIN_HTTP_WEB_REQUEST_H
+
+#include <memory>
+#include <AdblockPlus/IWebRequest.h>
+
+namespace AdblockPlus
+{
+  /**
+   * Asynchronous `IWebRequest` implementation based on WinHTTP, returned by
+   * `CreateWinHttpWebRequest()`. All requests share one session,
+   * so that WinHTTP reuses the connections to a host, and are driven by the
+   * WinHTTP status callbacks instead of a thread per request. Compressed
+   * responses are requested and decoded where WinHTTP supports it, i.e.\
+   * on Windows 8.1 and later.
+   *
+   * Callbacks are called on the WinHTTP worker threads. Requests still in
+   * progress on destruction are aborted without calling their callbacks.
+   */
+  class WinHttpWebRequest : public IWebRequest
+  {
+  public:
+    WinHttpWebRequest();
+    ~WinHttpWebRequest();
+
+    void GET(const std::string& url, const HeaderList& requestHeaders,
+      const GetCallback& getCallback) override;
+    void GET(const std::string& url, const HeaderList& requestHeaders,
+      const DataCallback& dataCallback, const GetCallback& getCallback) override;
+
+  private:
+    struct Request;
+    struct State;
+    typedef std::shared_ptr<State> StatePtr;
+
+    WinHttpWebRequest(const WinHttpWebRequest&);
+    WinHttpWebRequest& operator=(const WinHttpWebRequest&);
+
+    StatePtr state;
+  };
+}
+
+#endif
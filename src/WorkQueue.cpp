@@ -0,0 +1,128 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WorkQueue.h"
+
+using AdblockPlus::WorkQueue;
+
+WorkQueue::State::State()
+  : shouldThreadStop(false)
+{
+}
+
+WorkQueue::Entries::iterator WorkQueue::State::FindRunnable()
+{
+  // A task which isn't the first one of its key is never found here, the
+  // first one is either running or found before.
+  for (auto it = tasks.begin(); it != tasks.end(); ++it)
+  {
+    if (it->key.empty() || !activeKeys.count(it->key))
+      return it;
+  }
+  return tasks.end();
+}
+
+WorkQueue::WorkQueue(size_t threadCount)
+  : state(std::make_shared<State>())
+{
+  if (!threadCount)
+    threadCount = 1;
+  StatePtr threadState = state;
+  for (size_t i = 0; i < threadCount; i++)
+  {
+    threads.push_back(std::thread([threadState]
+    {
+      ThreadFunc(threadState);
+    }));
+  }
+}
+
+WorkQueue::~WorkQueue()
+{
+  Entries discardedTasks;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->shouldThreadStop = true;
+    discardedTasks.swap(state->tasks);
+  }
+  state->conditionVariable.notify_all();
+  // A task might release the last reference to the owner of the queue, the
+  // worker thread cannot join itself then.
+  for (auto& thread : threads)
+  {
+    if (thread.get_id() == std::this_thread::get_id())
+      thread.detach();
+    else if (thread.joinable())
+      thread.join();
+  }
+}
+
+void WorkQueue::Post(const Task& task, const std::string& key)
+{
+  if (!task)
+    return;
+  Entry entry = {task, key};
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->tasks.push_back(entry);
+  state->conditionVariable.notify_one();
+}
+
+size_t WorkQueue::GetPendingCount() const
+{
+  std::lock_guard<std::mutex> lock(state->mutex);
+  return state->tasks.size();
+}
+
+void WorkQueue::ThreadFunc(const StatePtr& state)
+{
+  while (true)
+  {
+    Entry entry;
+    {
+      std::unique_lock<std::mutex> lock(state->mutex);
+      Entries::iterator runnable;
+      state->conditionVariable.wait(lock, [&state, &runnable]()->bool
+      {
+        if (state->shouldThreadStop)
+          return true;
+        runnable = state->FindRunnable();
+        return runnable != state->tasks.end();
+      });
+      if (state->shouldThreadStop)
+        return;
+      entry = std::move(*runnable);
+      state->tasks.erase(runnable);
+      if (!entry.key.empty())
+        state->activeKeys.insert(entry.key);
+    }
+    try
+    {
+      entry.task();
+    }
+    catch (...)
+    {
+      // do nothing, but the thread will be alive.
+    }
+    if (!entry.key.empty())
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->activeKeys.erase(entry.key);
+      // Tasks waiting for this key can run now.
+      state->conditionVariable.notify_all();
+    }
+  }
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADBLOCK_PLUS_WORK_QUEUE_H
+#define ADBLOCK_PLUS_WORK_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Runs tasks on a fixed number of dedicated threads. Tasks which did not
+   * start yet are discarded on destruction.
+   */
+  class WorkQueue
+  {
+  public:
+    typedef std::function<void()> Task;
+
+    /**
+     * @param threadCount Number of worker threads, with a single thread all
+     *        tasks run one after another in the order they were posted.
+     */
+    explicit WorkQueue(size_t threadCount = 1);
+    ~WorkQueue();
+
+    /**
+     * Enqueues a task, it will run on one of the worker threads.
+     * @param task Task to run.
+     * @param key Tasks with the same non-empty key run one after another in
+     *        the order they were posted.
+     */
+    void Post(const Task& task, const std::string& key = std::string());
+
+    /**
+     * @return Number of posted tasks which did not start yet.
+     */
+    size_t GetPendingCount() const;
+
+  private:
+    WorkQueue(const WorkQueue&);
+    WorkQueue& operator=(const WorkQueue&);
+
+    struct Entry
+    {
+      Task task;
+      std::string key;
+    };
+    typedef std::deque<Entry> Entries;
+
+    /// Shared with the worker threads, it outlives the queue if a thread had
+    /// to be detached.
+    struct State
+    {
+      State();
+      Entries::iterator FindRunnable();
+
+      std::mutex mutex;
+      std::condition_variable conditionVariable;
+      Entries tasks;
+      /// Keys of the running tasks.
+      std::set<std::string> activeKeys;
+      bool shouldThreadStop;
+    };
+    typedef std::shared_ptr<State> StatePtr;
+
+    static void ThreadFunc(const StatePtr& state);
+
+    StatePtr state;
+    std::vector<std::thread> threads;
+  };
+}
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <condition_variable>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <AdblockPlus/AsyncLogSystem.h>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  class CollectingLogSystem : public LogSystem
+  {
+  public:
+    struct Message
+    {
+      LogLevel level;
+      std::string text;
+      std::string source;
+    };
+
+    CollectingLogSystem()
+      : blocked(false)
+    {
+    }
+
+    void operator()(LogLevel logLevel, const std::string& message,
+          const std::string& source) override
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      unblocked.wait(lock, [this] { return !blocked; });
+      Message entry = {logLevel, message, source};
+      messages.push_back(entry);
+    }
+
+    void SetBlocked(bool value)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocked = value;
+      }
+      unblocked.notify_all();
+    }
+
+    std::vector<Message> GetMessages()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return messages;
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable unblocked;
+    bool blocked;
+    std::vector<Message> messages;
+  };
+
+  class DisabledInfoLogSystem : public CollectingLogSystem
+  {
+  public:
+    bool IsEnabled(LogLevel logLevel) const override
+    {
+      return logLevel != LOG_LEVEL_INFO;
+    }
+  };
+}
+
+TEST(AsyncLogSystemTest, WritesMessagesInOrder)
+{
+  auto target = std::make_shared<CollectingLogSystem>();
+  AsyncLogSystem logSystem(target);
+  for (int i = 0; i < 100; i++)
+    logSystem(LogSystem::LOG_LEVEL_LOG, std::to_string(i), "source");
+  logSystem.Flush();
+
+  std::vector<CollectingLogSystem::Message> messages = target->GetMessages();
+  ASSERT_EQ(100u, messages.size());
+  for (int i = 0; i < 100; i++)
+  {
+    ASSERT_EQ(LogSystem::LOG_LEVEL_LOG, messages[i].level);
+    ASSERT_EQ(std::to_string(i), messages[i].text);
+    ASSERT_EQ("source", messages[i].source);
+  }
+  ASSERT_EQ(0u, logSystem.GetDroppedCount());
+}
+
+TEST(AsyncLogSystemTest, ConcurrentProducers)
+{
+  auto target = std::make_shared<CollectingLogSystem>();
+  AsyncLogSystem logSystem(target, LogSystem::LOG_LEVEL_TRACE, 8192);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++)
+  {
+    threads.push_back(std::thread([&logSystem]
+    {
+      for (int j = 0; j < 1000; j++)
+        logSystem(LogSystem::LOG_LEVEL_WARN, "message", "");
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+  logSystem.Flush();
+  ASSERT_EQ(4000u, target->GetMessages().size());
+}
+
+TEST(AsyncLogSystemTest, FiltersLevels)
+{
+  auto target = std::make_shared<DisabledInfoLogSystem>();
+  AsyncLogSystem logSystem(target, LogSystem::LOG_LEVEL_LOG);
+  ASSERT_FALSE(logSystem.IsEnabled(LogSystem::LOG_LEVEL_TRACE));
+  ASSERT_TRUE(logSystem.IsEnabled(LogSystem::LOG_LEVEL_LOG));
+  ASSERT_FALSE(logSystem.IsEnabled(LogSystem::LOG_LEVEL_INFO));
+  ASSERT_TRUE(logSystem.IsEnabled(LogSystem::LOG_LEVEL_ERROR));
+  logSystem(LogSystem::LOG_LEVEL_TRACE, "trace", "");
+  logSystem(LogSystem::LOG_LEVEL_INFO, "info", "");
+  logSystem(LogSystem::LOG_LEVEL_ERROR, "error", "");
+  logSystem.Flush();
+
+  std::vector<CollectingLogSystem::Message> messages = target->GetMessages();
+  ASSERT_EQ(1u, messages.size());
+  ASSERT_EQ("error", messages[0].text);
+}
+
+TEST(AsyncLogSystemTest, DropsMessagesIfFull)
+{
+  auto target = std::make_shared<CollectingLogSystem>();
+  AsyncLogSystem logSystem(target, LogSystem::LOG_LEVEL_TRACE, 4);
+  target->SetBlocked(true);
+  for (int i = 0; i < 10; i++)
+    logSystem(LogSystem::LOG_LEVEL_LOG, std::to_string(i), "");
+  // The background thread might have taken the first message already.
+  uint64_t dropped = logSystem.GetDroppedCount();
+  ASSERT_LE(5u, dropped);
+  ASSERT_GE(6u, dropped);
+  target->SetBlocked(false);
+  logSystem.Flush();
+
+  std::vector<CollectingLogSystem::Message> messages = target->GetMessages();
+  ASSERT_EQ(10 - dropped + 1, messages.size());
+  bool reported = false;
+  for (const auto& message : messages)
+  {
+    if (message.level == LogSystem::LOG_LEVEL_WARN)
+    {
+      ASSERT_EQ(std::to_string(dropped) + " log messages dropped, the buffer was full", message.text);
+      reported = true;
+    }
+  }
+  ASSERT_TRUE(reported);
+}
+
+TEST(AsyncLogSystemTest, WritesPendingMessagesOnDestruction)
+{
+  auto target = std::make_shared<CollectingLogSystem>();
+  {
+    AsyncLogSystem logSystem(target);
+    for (int i = 0; i < 10; i++)
+      logSystem(LogSystem::LOG_LEVEL_LOG, "message", "");
+  }
+  ASSERT_EQ(10u, target->GetMessages().size());
+}
@@ -36,6 +36,7 @@ JsEngineCreationParameters::JsEngineCreationParameters()
   : logSystem(std::make_shared<ThrowingLogSystem>())
   , timer(new ThrowingTimer())
   , webRequest(new ThrowingWebRequest())
+  , ioExecutor(AdblockPlus::CreateDefaultIoExecutor())
   , fileSystem(std::make_shared<ThrowingFileSystem>())
 {
 }
@@ -46,6 +47,8 @@ AdblockPlus::JsEnginePtr CreateJsEngine(JsEngineCreationParameters&& jsEngineCre
   auto jsEngine = AdblockPlus::JsEngine::New(jsEngineCreationParameters.appInfo,
     std::move(jsEngineCreationParameters.timer),
     std::move(jsEngineCreationParameters.webRequest),
+    std::move(jsEngineCreationParameters.ioExecutor),
+    std::move(jsEngineCreationParameters.callbackExecutor),
     isolate);
   jsEngine->SetLogSystem(std::move(jsEngineCreationParameters.logSystem));
   jsEngine->SetFileSystem(std::move(jsEngineCreationParameters.fileSystem));
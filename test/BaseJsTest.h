@@ -234,6 +234,8 @@ struct JsEngineCreationParameters
   AdblockPlus::LogSystemPtr logSystem;
   AdblockPlus::TimerPtr timer;
   AdblockPlus::WebRequestPtr webRequest;
+  AdblockPlus::ExecutorPtr ioExecutor;
+  AdblockPlus::ExecutorPtr callbackExecutor;
   AdblockPlus::FileSystemPtr fileSystem;
 };
 
@@ -0,0 +1,58 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+#include <string>
+
+#include "../src/BloomFilter.h"
+
+using namespace AdblockPlus;
+
+TEST(BloomFilterTest, ContainsAddedStrings)
+{
+  BloomFilter filter(100, 0.01, 1024 * 1024);
+  for (int i = 0; i < 100; i++)
+    filter.Add("keyword" + std::to_string(i));
+  for (int i = 0; i < 100; i++)
+    ASSERT_TRUE(filter.MayContain("keyword" + std::to_string(i)));
+  std::string keyword("xkeyword1x");
+  ASSERT_TRUE(filter.MayContain(keyword.data() + 1, keyword.length() - 2));
+}
+
+TEST(BloomFilterTest, FalsePositiveRate)
+{
+  BloomFilter filter(1000, 0.01, 1024 * 1024);
+  for (int i = 0; i < 1000; i++)
+    filter.Add("keyword" + std::to_string(i));
+  EXPECT_LT(filter.GetFalsePositiveRate(), 0.015);
+  int falsePositives = 0;
+  for (int i = 0; i < 10000; i++)
+  {
+    if (filter.MayContain("other" + std::to_string(i)))
+      falsePositives++;
+  }
+  EXPECT_LT(falsePositives, 300);
+}
+
+TEST(BloomFilterTest, MaxSize)
+{
+  BloomFilter filter(100000, 0.0001, 1024);
+  EXPECT_EQ(1024u, filter.GetSize());
+  for (int i = 0; i < 100000; i++)
+    filter.Add("keyword" + std::to_string(i));
+  EXPECT_TRUE(filter.MayContain("keyword1"));
+  EXPECT_GT(filter.GetFalsePositiveRate(), 0.5);
+}
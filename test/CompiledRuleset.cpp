@@ -0,0 +1,203 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <gtest/gtest.h>
+
+#include "../src/CompiledRuleset.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const int32_t CONTENT_TYPE_SCRIPT = 2;
+  const int32_t CONTENT_TYPE_IMAGE = 4;
+
+  class StringFileView : public FileView
+  {
+  public:
+    explicit StringFileView(const std::string& data)
+      : data(data)
+    {
+    }
+
+    const char* GetData() const
+    {
+      return data.data();
+    }
+
+    size_t GetSize() const
+    {
+      return data.size();
+    }
+
+  private:
+    std::string data;
+  };
+
+  std::string Compile(const std::vector<std::string>& filters,
+    CompiledRuleset::CompileStats* stats = 0)
+  {
+    std::ostringstream output;
+    CompiledRuleset::CompileStats result = CompiledRuleset::Compile(filters, output);
+    if (stats)
+      *stats = result;
+    return output.str();
+  }
+
+  std::shared_ptr<CompiledRuleset> Open(const std::string& data)
+  {
+    return std::make_shared<CompiledRuleset>(
+      FileViewPtr(new StringFileView(data)));
+  }
+
+  class CompiledRulesetTest : public ::testing::Test
+  {
+  protected:
+    Matcher matcher;
+
+    void SetUp()
+    {
+      BaseDomain::PublicSuffixes publicSuffixes;
+      publicSuffixes["com"] = 1;
+      matcher.SetPublicSuffixes(std::move(publicSuffixes));
+    }
+
+    std::string Match(const std::string& url, int32_t contentTypeMask,
+      const std::string& documentUrl = "")
+    {
+      MatcherFilterPtr filter = matcher.CheckFilterMatch(url, contentTypeMask,
+        documentUrl);
+      return filter ? filter->GetText() : "";
+    }
+  };
+}
+
+TEST(CompiledRulesetFormatTest, CompileStats)
+{
+  std::vector<std::string> filters;
+  filters.push_back("[Adblock Plus 2.0]");
+  filters.push_back("! Comment");
+  filters.push_back("/banner/*");
+  filters.push_back("/banner/*");
+  filters.push_back("@@||example.com^$image");
+  filters.push_back("##.ad");
+  filters.push_back("example.com#@#.ad");
+  filters.push_back("example.com#?#div:-abp-has(.ad)");
+  filters.push_back("/invalid[/");
+  CompiledRuleset::CompileStats stats;
+  std::shared_ptr<CompiledRuleset> ruleset = Open(Compile(filters, &stats));
+  EXPECT_EQ(1u, stats.blockingFilters);
+  EXPECT_EQ(1u, stats.whitelistFilters);
+  EXPECT_EQ(1u, stats.elemHideFilters);
+  EXPECT_EQ(1u, stats.elemHideExceptions);
+  EXPECT_EQ(5u, stats.skippedFilters);
+  EXPECT_EQ(2u, ruleset->GetFilterCount());
+}
+
+TEST(CompiledRulesetFormatTest, RejectsInvalidData)
+{
+  std::vector<std::string> filters;
+  filters.push_back("/banner/*");
+  std::string data = Compile(filters);
+  EXPECT_NO_THROW(Open(data));
+  EXPECT_THROW(Open(""), std::runtime_error);
+  EXPECT_THROW(Open(data.substr(0, data.size() - 1)), std::runtime_error);
+  std::string wrongMagic(data);
+  wrongMagic[0] = 'X';
+  EXPECT_THROW(Open(wrongMagic), std::runtime_error);
+  std::string wrongVersion(data);
+  wrongVersion[4]++;
+  EXPECT_THROW(Open(wrongVersion), std::runtime_error);
+}
+
+TEST_F(CompiledRulesetTest, Matching)
+{
+  std::vector<std::string> filters;
+  filters.push_back("/banner/*");
+  filters.push_back("||ads.com^$script");
+  filters.push_back("&ad=");
+  filters.push_back("@@||good.com/banner/$image");
+  matcher.SetRuleset(Open(Compile(filters)));
+
+  for (int i = 0; i < 2; i++)
+  {
+    EXPECT_EQ("/banner/*", Match("http://example.com/banner/1.png", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("||ads.com^$script", Match("http://ads.com/x.js", CONTENT_TYPE_SCRIPT));
+    EXPECT_EQ("", Match("http://ads.com/x.png", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("&ad=", Match("http://example.com/?x&ad=1", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("@@||good.com/banner/$image", Match("http://good.com/banner/1.png", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("", Match("http://example.com/", CONTENT_TYPE_IMAGE));
+    matcher.Commit();
+  }
+}
+
+TEST_F(CompiledRulesetTest, CombinedWithAddedFilters)
+{
+  std::vector<std::string> filters;
+  filters.push_back("/banner/*");
+  matcher.SetRuleset(Open(Compile(filters)));
+  matcher.Add("@@||example.com^$image");
+  matcher.Add("/ads/*");
+  matcher.EnablePrefilter(0.01, 1024 * 1024);
+  matcher.Commit();
+
+  EXPECT_EQ("@@||example.com^$image", Match("http://example.com/banner/1.png", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("/banner/*", Match("http://test.com/banner/1.png", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("/ads/*", Match("http://test.com/ads/1.png", CONTENT_TYPE_IMAGE));
+
+  // Clearing the added filters keeps the ruleset
+  matcher.Clear();
+  matcher.Commit();
+  EXPECT_EQ("/banner/*", Match("http://example.com/banner/1.png", CONTENT_TYPE_IMAGE));
+  matcher.SetRuleset(std::shared_ptr<const CompiledRuleset>());
+  matcher.Commit();
+  EXPECT_EQ("", Match("http://example.com/banner/1.png", CONTENT_TYPE_IMAGE));
+}
+
+TEST(CompiledRulesetFormatTest, ElementHidingSelectors)
+{
+  std::vector<std::string> filters;
+  filters.push_back("##.generic");
+  filters.push_back("~example.com##.notonexample");
+  filters.push_back("example.com,test.com##.specific");
+  filters.push_back("foo.example.com##.sub");
+  filters.push_back("##.excepted");
+  filters.push_back("Example.com#@#.excepted");
+  std::shared_ptr<CompiledRuleset> ruleset = Open(Compile(filters));
+
+  std::vector<std::string> selectors;
+  ruleset->GetElementHidingSelectors("www.foo.example.com.", selectors);
+  std::sort(selectors.begin(), selectors.end());
+  std::vector<std::string> expected;
+  expected.push_back(".generic");
+  expected.push_back(".specific");
+  expected.push_back(".sub");
+  EXPECT_EQ(expected, selectors);
+
+  selectors.clear();
+  ruleset->GetElementHidingSelectors("other.com", selectors);
+  std::sort(selectors.begin(), selectors.end());
+  expected.clear();
+  expected.push_back(".excepted");
+  expected.push_back(".generic");
+  expected.push_back(".notonexample");
+  EXPECT_EQ(expected, selectors);
+}
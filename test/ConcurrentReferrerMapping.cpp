@@ -0,0 +1,106 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/ConcurrentReferrerMapping.h>
+#include <gtest/gtest.h>
+#include <thread>
+
+using AdblockPlus::ConcurrentReferrerMapping;
+
+TEST(ConcurrentReferrerMappingTest, ChainAcrossShards)
+{
+  ConcurrentReferrerMapping referrerMapping;
+  referrerMapping.Add("second", "first");
+  referrerMapping.Add("third", "second");
+  referrerMapping.Add("fourth", "third");
+  std::vector<std::string> referrerChain =
+    referrerMapping.BuildReferrerChain("fourth");
+  ASSERT_EQ(4u, referrerChain.size());
+  ASSERT_EQ("first", referrerChain[0]);
+  ASSERT_EQ("second", referrerChain[1]);
+  ASSERT_EQ("third", referrerChain[2]);
+  ASSERT_EQ("fourth", referrerChain[3]);
+  ASSERT_EQ(1u, referrerMapping.BuildReferrerChain("first").size());
+}
+
+TEST(ConcurrentReferrerMappingTest, ReferrerLoop)
+{
+  ConcurrentReferrerMapping referrerMapping;
+  referrerMapping.Add("first", "second");
+  referrerMapping.Add("second", "first");
+  ASSERT_EQ(11u, referrerMapping.BuildReferrerChain("first").size());
+}
+
+TEST(ConcurrentReferrerMappingTest, ScopesAreSeparate)
+{
+  ConcurrentReferrerMapping referrerMapping(5000, 16, 2);
+  referrerMapping.Add(1, "frame", "tab1");
+  referrerMapping.Add(2, "frame", "tab2");
+  referrerMapping.Add(2, "a", "frame");
+  referrerMapping.Add(2, "b", "frame");
+  referrerMapping.Add(2, "c", "frame");
+
+  // Scope 2 evicted its oldest mappings, scope 1 is unaffected.
+  std::vector<std::string> referrerChain =
+    referrerMapping.BuildReferrerChain(1, "frame");
+  ASSERT_EQ(2u, referrerChain.size());
+  ASSERT_EQ("tab1", referrerChain[0]);
+  ASSERT_EQ(2u, referrerMapping.BuildReferrerChain(2, "c").size());
+  ASSERT_EQ(1u, referrerMapping.BuildReferrerChain(2, "frame").size());
+  ASSERT_EQ(1u, referrerMapping.BuildReferrerChain("frame").size());
+
+  referrerMapping.RemoveScope(1);
+  ASSERT_EQ(1u, referrerMapping.BuildReferrerChain(1, "frame").size());
+  ASSERT_EQ(1u, referrerMapping.BuildReferrerChain(3, "frame").size());
+}
+
+TEST(ConcurrentReferrerMappingTest, ConcurrentAccess)
+{
+  ConcurrentReferrerMapping referrerMapping;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++)
+  {
+    threads.push_back(std::thread([&referrerMapping, i]
+    {
+      std::string document = "document" + std::to_string(i);
+      for (int j = 0; j < 1000; j++)
+      {
+        std::string url = document + "/" + std::to_string(j);
+        referrerMapping.Add(url, document);
+        referrerMapping.Add(i, url, document);
+        ASSERT_EQ(2u, referrerMapping.BuildReferrerChain(url).size());
+        ASSERT_EQ(2u, referrerMapping.BuildReferrerChain(i, url).size());
+      }
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+}
+
+TEST(ConcurrentReferrerMappingTest, SharedScopedReferrerChain)
+{
+  AdblockPlus::ConcurrentReferrerMapping referrerMapping;
+  referrerMapping.Add(1, "second", "first");
+  AdblockPlus::SharedUrlList referrerChain;
+  referrerMapping.BuildReferrerChain(1, "second", referrerChain);
+  ASSERT_EQ(2u, referrerChain.size());
+  ASSERT_EQ("first", *referrerChain[0]);
+  ASSERT_EQ("second", *referrerChain[1]);
+  referrerMapping.BuildReferrerChain(2, "second", referrerChain);
+  ASSERT_EQ(1u, referrerChain.size());
+  ASSERT_EQ("second", *referrerChain[0]);
+}
@@ -35,6 +35,15 @@ namespace
     }
   };
 
+  class WarningsOnlyLogSystem : public MockLogSystem
+  {
+  public:
+    bool IsEnabled(AdblockPlus::LogSystem::LogLevel logLevel) const override
+    {
+      return logLevel >= AdblockPlus::LogSystem::LOG_LEVEL_WARN;
+    }
+  };
+
   typedef std::shared_ptr<MockLogSystem> MockLogSystemPtr;
 
   class ConsoleJsObjectTest : public BaseJsTest
@@ -108,3 +117,13 @@ TEST_F(ConsoleJsObjectTest, ConsoleTraceCall)
 3: /* anonymous */() at eval:8\n", mockLogSystem->lastMessage);
   ASSERT_EQ("", mockLogSystem->lastSource);
 }
+
+TEST_F(ConsoleJsObjectTest, DisabledLevelsAreSkipped)
+{
+  auto logSystem = std::make_shared<WarningsOnlyLogSystem>();
+  jsEngine->SetLogSystem(logSystem);
+  // The arguments are not even converted.
+  jsEngine->Evaluate("console.warn('foo'); console.log({toString: function() { throw 'bar'; }}); console.trace()");
+  ASSERT_EQ(AdblockPlus::LogSystem::LOG_LEVEL_WARN, logSystem->lastLogLevel);
+  ASSERT_EQ("foo", logSystem->lastMessage);
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <AdblockPlus/FilterEngine.h>
+
+#include "../src/ContentTypes.h"
+
+using namespace AdblockPlus;
+
+TEST(ContentTypesTest, LookupFilterOptions)
+{
+  int32_t value = 0;
+  ASSERT_TRUE(ContentTypes::Lookup("IMAGE", value));
+  EXPECT_EQ(FilterEngine::CONTENT_TYPE_IMAGE, value);
+  ASSERT_TRUE(ContentTypes::Lookup("BACKGROUND", value));
+  EXPECT_EQ(FilterEngine::CONTENT_TYPE_IMAGE, value);
+  ASSERT_TRUE(ContentTypes::Lookup("WEBSOCKET", value));
+  EXPECT_EQ(128, value);
+  EXPECT_FALSE(ContentTypes::Lookup("image", value));
+  EXPECT_FALSE(ContentTypes::Lookup("THIRD_PARTY", value));
+
+  EXPECT_FALSE(ContentTypes::defaultMask & FilterEngine::CONTENT_TYPE_DOCUMENT);
+  EXPECT_FALSE(ContentTypes::defaultMask & FilterEngine::CONTENT_TYPE_ELEMHIDE);
+  EXPECT_TRUE(ContentTypes::defaultMask & FilterEngine::CONTENT_TYPE_SCRIPT);
+}
+
+TEST(ContentTypesTest, PublicNames)
+{
+  for (size_t i = 0; i < ContentTypes::tableSize; i++)
+  {
+    const ContentTypes::Entry& entry = ContentTypes::table[i];
+    if (!entry.isPublic)
+      continue;
+    FilterEngine::ContentType contentType =
+      static_cast<FilterEngine::ContentType>(entry.value);
+    EXPECT_EQ(entry.name, FilterEngine::ContentTypeToString(contentType));
+    EXPECT_EQ(contentType, FilterEngine::StringToContentType(entry.name));
+  }
+  EXPECT_EQ(FilterEngine::CONTENT_TYPE_OBJECT_SUBREQUEST,
+    FilterEngine::StringToContentType("object_subrequest"));
+  EXPECT_EQ("OTHER", FilterEngine::ContentTypeToString(FilterEngine::CONTENT_TYPE_OTHER));
+  EXPECT_EQ("GENERICHIDE",
+    FilterEngine::ContentTypeToString(FilterEngine::CONTENT_TYPE_GENERICHIDE));
+  EXPECT_THROW(FilterEngine::StringToContentType("websocket"), std::invalid_argument);
+  EXPECT_THROW(FilterEngine::StringToContentType("background"), std::invalid_argument);
+  EXPECT_THROW(FilterEngine::ContentTypeToString(static_cast<FilterEngine::ContentType>(128)),
+    std::invalid_argument);
+}
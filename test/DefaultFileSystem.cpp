@@ -15,6 +15,7 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <future>
 #include <sstream>
 #include <AdblockPlus.h>
 #include <gtest/gtest.h>
@@ -42,6 +43,49 @@ TEST(DefaultFileSystemTest, WriteReadRemove)
   ASSERT_EQ("foo", output.str());
 }
 
+TEST(DefaultFileSystemTest, WriteBufferReadRemove)
+{
+  AdblockPlus::DefaultFileSystem fileSystem;
+  const std::string content("foo\0bar", 7);
+  fileSystem.Write(testPath, content.data(), content.size());
+  std::stringstream output;
+  output << fileSystem.Read(testPath)->rdbuf();
+  fileSystem.Remove(testPath);
+  ASSERT_EQ(content, output.str());
+}
+
+TEST(DefaultFileSystemTest, WriteReadMappedRemove)
+{
+  AdblockPlus::DefaultFileSystem fileSystem;
+  WriteString(fileSystem, "foo\nbar");
+  AdblockPlus::FileViewPtr file = fileSystem.ReadMapped(testPath);
+  ASSERT_EQ("foo\nbar", std::string(file->GetData(), file->GetSize()));
+  file.reset();
+
+  WriteString(fileSystem, "");
+  file = fileSystem.ReadMapped(testPath);
+  ASSERT_EQ(0u, file->GetSize());
+  file.reset();
+  fileSystem.Remove(testPath);
+  ASSERT_ANY_THROW(fileSystem.ReadMapped(testPath));
+}
+
+TEST(DefaultFileSystemTest, WriteCopyReadRemove)
+{
+  AdblockPlus::DefaultFileSystem fileSystem;
+  WriteString(fileSystem, "foo\nbar");
+  const std::string copyPath = testPath + "-copy";
+  fileSystem.Copy(testPath, copyPath);
+  WriteString(fileSystem, "baz");
+  std::stringstream output;
+  output << fileSystem.Read(copyPath)->rdbuf();
+  fileSystem.Remove(copyPath);
+  fileSystem.Remove(testPath);
+  ASSERT_EQ("foo\nbar", output.str());
+  ASSERT_ANY_THROW(fileSystem.Copy(testPath, copyPath));
+  ASSERT_FALSE(fileSystem.Stat(copyPath).exists);
+}
+
 TEST(DefaultFileSystemTest, StatWorkingDirectory)
 {
   AdblockPlus::DefaultFileSystem fileSystem;
@@ -71,3 +115,103 @@ TEST(DefaultFileSystemTest, WriteMoveStatRemove)
   result = fileSystem.Stat(newTestPath);
   ASSERT_FALSE(result.exists);
 }
+
+TEST(DefaultAsyncFileSystemTest, WriteReadStatRemove)
+{
+  AdblockPlus::DefaultAsyncFileSystem fileSystem(
+    std::make_shared<AdblockPlus::DefaultFileSystem>(),
+    AdblockPlus::CreateDefaultIoExecutor());
+  typedef AdblockPlus::IFileSystem::IoBuffer IoBuffer;
+  typedef AdblockPlus::IFileSystem::StatResult StatResult;
+
+  // Operations on the same path complete in the order they were requested.
+  std::promise<std::string> writeError;
+  std::promise<std::string> content;
+  std::promise<StatResult> statResult;
+  std::promise<std::string> removeError;
+  std::promise<bool> existsAfterRemove;
+  fileSystem.Write(testPath, IoBuffer{'f', 'o', 'o'},
+    [&writeError](const std::string& error)
+    {
+      writeError.set_value(error);
+    });
+  fileSystem.Read(testPath,
+    [&content](IoBuffer&& data, const std::string& error)
+    {
+      content.set_value(error.empty() ? std::string(data.begin(), data.end()) : error);
+    });
+  fileSystem.Stat(testPath,
+    [&statResult](const StatResult& result, const std::string& error)
+    {
+      statResult.set_value(result);
+    });
+  fileSystem.Remove(testPath,
+    [&removeError](const std::string& error)
+    {
+      removeError.set_value(error);
+    });
+  fileSystem.Stat(testPath,
+    [&existsAfterRemove](const StatResult& result, const std::string& error)
+    {
+      existsAfterRemove.set_value(result.exists);
+    });
+
+  ASSERT_EQ("", writeError.get_future().get());
+  ASSERT_EQ("foo", content.get_future().get());
+  ASSERT_TRUE(statResult.get_future().get().isFile);
+  ASSERT_EQ("", removeError.get_future().get());
+  ASSERT_FALSE(existsAfterRemove.get_future().get());
+}
+
+TEST(DefaultAsyncFileSystemTest, ReadError)
+{
+  AdblockPlus::DefaultAsyncFileSystem fileSystem(
+    std::make_shared<AdblockPlus::DefaultFileSystem>(),
+    AdblockPlus::CreateDefaultIoExecutor());
+  std::promise<std::string> readError;
+  fileSystem.Read(testPath + "-missing",
+    [&readError](AdblockPlus::IFileSystem::IoBuffer&& data, const std::string& error)
+    {
+      readError.set_value(error);
+    });
+  ASSERT_NE("", readError.get_future().get());
+}
+
+TEST(DefaultAsyncFileSystemTest, ReadRange)
+{
+  AdblockPlus::DefaultAsyncFileSystem fileSystem(
+    std::make_shared<AdblockPlus::DefaultFileSystem>(),
+    AdblockPlus::CreateDefaultIoExecutor());
+  typedef AdblockPlus::IFileSystem::IoBuffer IoBuffer;
+
+  std::promise<std::string> writeError;
+  std::promise<std::string> middle;
+  std::promise<std::string> end;
+  std::promise<std::string> beyondEnd;
+  fileSystem.Write(testPath, IoBuffer{'f', 'o', 'o', 'b', 'a', 'r'},
+    [&writeError](const std::string& error)
+    {
+      writeError.set_value(error);
+    });
+  fileSystem.ReadRange(testPath, 2, 3,
+    [&middle](IoBuffer&& data, const std::string& error)
+    {
+      middle.set_value(error.empty() ? std::string(data.begin(), data.end()) : error);
+    });
+  fileSystem.ReadRange(testPath, 4, 3,
+    [&end](IoBuffer&& data, const std::string& error)
+    {
+      end.set_value(error.empty() ? std::string(data.begin(), data.end()) : error);
+    });
+  fileSystem.ReadRange(testPath, 10, 3,
+    [&beyondEnd](IoBuffer&& data, const std::string& error)
+    {
+      beyondEnd.set_value(error.empty() ? std::string(data.begin(), data.end()) : error);
+    });
+
+  ASSERT_EQ("", writeError.get_future().get());
+  EXPECT_EQ("oba", middle.get_future().get());
+  EXPECT_EQ("ar", end.get_future().get());
+  EXPECT_EQ("", beyondEnd.get_future().get());
+  AdblockPlus::DefaultFileSystem().Remove(testPath);
+}
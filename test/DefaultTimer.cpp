@@ -0,0 +1,121 @@
+/*
+* This file is part of Adblock Plus <https://adblockplus.org/>,
+* Copyright (C) 2006-2017 eyeo GmbH
+*
+* Adblock Plus is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 3 as
+* published by the Free Software Foundation.
+*
+* Adblock Plus is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../src/DefaultTimer.h"
+
+using AdblockPlus::DefaultTimer;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  struct FiredTimers
+  {
+    std::mutex mutex;
+    std::condition_variable conditionVariable;
+    std::vector<std::pair<int, Clock::time_point>> timers;
+    std::vector<std::thread::id> threadIds;
+
+    AdblockPlus::ITimer::TimerCallback Callback(int id)
+    {
+      return [this, id]
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        timers.push_back(std::make_pair(id, Clock::now()));
+        threadIds.push_back(std::this_thread::get_id());
+        conditionVariable.notify_all();
+      };
+    }
+
+    bool WaitFor(size_t count)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      return conditionVariable.wait_for(lock, std::chrono::seconds(5), [this, count]()->bool
+      {
+        return timers.size() >= count;
+      });
+    }
+  };
+}
+
+TEST(DefaultTimerTest, InstancesShareThread)
+{
+  FiredTimers fired;
+  DefaultTimer timer1;
+  DefaultTimer timer2;
+  timer1.SetTimer(std::chrono::milliseconds(20), fired.Callback(1));
+  timer2.SetTimer(std::chrono::milliseconds(10), fired.Callback(2));
+  ASSERT_TRUE(fired.WaitFor(2));
+  EXPECT_EQ(2, fired.timers[0].first);
+  EXPECT_EQ(1, fired.timers[1].first);
+  EXPECT_EQ(fired.threadIds[0], fired.threadIds[1]);
+  EXPECT_NE(std::this_thread::get_id(), fired.threadIds[0]);
+}
+
+TEST(DefaultTimerTest, TimersWithinSlackFireTogether)
+{
+  FiredTimers fired;
+  DefaultTimer lazyTimer(std::chrono::milliseconds(200));
+  DefaultTimer timer;
+  auto start = Clock::now();
+  lazyTimer.SetTimer(std::chrono::milliseconds(50), fired.Callback(1));
+  timer.SetTimer(std::chrono::milliseconds(150), fired.Callback(2));
+  ASSERT_TRUE(fired.WaitFor(2));
+  // The lazy timer waits for the other one instead of waking up on its own.
+  EXPECT_EQ(1, fired.timers[0].first);
+  EXPECT_GE(fired.timers[0].second - start, std::chrono::milliseconds(150));
+  EXPECT_LT(fired.timers[1].second - fired.timers[0].second, std::chrono::milliseconds(20));
+}
+
+TEST(DefaultTimerTest, DestroyedInstanceDoesNotFire)
+{
+  FiredTimers fired;
+  DefaultTimer timer;
+  {
+    DefaultTimer destroyedTimer;
+    destroyedTimer.SetTimer(std::chrono::milliseconds(10), fired.Callback(1));
+  }
+  timer.SetTimer(std::chrono::milliseconds(50), fired.Callback(2));
+  ASSERT_TRUE(fired.WaitFor(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_EQ(1u, fired.timers.size());
+  EXPECT_EQ(2, fired.timers[0].first);
+}
+
+TEST(DefaultTimerTest, DestroyedFromCallback)
+{
+  std::atomic<bool> done(false);
+  std::unique_ptr<DefaultTimer> timer(new DefaultTimer());
+  DefaultTimer* timerPtr = timer.get();
+  timerPtr->SetTimer(std::chrono::milliseconds(10), [&timer, &done]
+  {
+    timer.reset();
+    done = true;
+  });
+  auto start = Clock::now();
+  while (!done && Clock::now() - start < std::chrono::seconds(5))
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_TRUE(done);
+}
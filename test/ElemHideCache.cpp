@@ -0,0 +1,67 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../src/ElemHideCache.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  ElemHideCache::SelectorsPtr Selectors(const std::string& selector)
+  {
+    return ElemHideCache::SelectorsPtr(new std::vector<std::string>(1, selector));
+  }
+}
+
+TEST(ElemHideCacheTest, LookupAndInsert)
+{
+  ElemHideCache cache(10);
+  ASSERT_FALSE(cache.Lookup("example.com"));
+  ElemHideCache::SelectorsPtr selectors = Selectors("#ad");
+  cache.Insert("example.com", selectors, cache.GetGeneration());
+  ASSERT_EQ(selectors, cache.Lookup("example.com"));
+  ASSERT_FALSE(cache.Lookup("example.org"));
+}
+
+TEST(ElemHideCacheTest, EvictsLeastRecentlyUsed)
+{
+  ElemHideCache cache(2);
+  cache.Insert("a.com", Selectors("#a"), 0);
+  cache.Insert("b.com", Selectors("#b"), 0);
+  ASSERT_TRUE(cache.Lookup("a.com"));
+  cache.Insert("c.com", Selectors("#c"), 0);
+  ASSERT_TRUE(cache.Lookup("a.com"));
+  ASSERT_FALSE(cache.Lookup("b.com"));
+  ASSERT_EQ("#c", cache.Lookup("c.com")->at(0));
+}
+
+TEST(ElemHideCacheTest, Invalidate)
+{
+  ElemHideCache cache(10);
+  uint64_t generation = cache.GetGeneration();
+  cache.Insert("example.com", Selectors("#ad"), generation);
+  cache.Invalidate();
+  ASSERT_FALSE(cache.Lookup("example.com"));
+
+  // Selectors computed before the change are dropped
+  cache.Insert("example.com", Selectors("#ad"), generation);
+  ASSERT_FALSE(cache.Lookup("example.com"));
+  cache.Insert("example.com", Selectors("#ad"), cache.GetGeneration());
+  ASSERT_TRUE(cache.Lookup("example.com"));
+}
@@ -109,6 +109,77 @@ namespace
 
   typedef std::shared_ptr<MockFileSystem> MockFileSystemPtr;
 
+  class ImmediateAsyncFileSystem : public AdblockPlus::IFileSystem
+  {
+  public:
+    std::string readPath;
+
+    void Read(const std::string& path, const ReadCallback& callback) override
+    {
+      readPath = path;
+      callback(IoBuffer{'b', 'a', 'r'}, "");
+    }
+
+    void ReadRange(const std::string& path, uint64_t offset, size_t size,
+      const ReadCallback& callback) override
+    {
+      readPath = path;
+      callback(offset ? IoBuffer() : IoBuffer{'b', 'a', 'r'}, "");
+    }
+
+    void Write(const std::string& path, IoBuffer&& data,
+      const Callback& callback) override
+    {
+      callback("Unable to write to " + path);
+    }
+
+    void Move(const std::string& fromPath, const std::string& toPath,
+      const Callback& callback) override
+    {
+      callback("");
+    }
+
+    void Copy(const std::string& fromPath, const std::string& toPath,
+      const Callback& callback) override
+    {
+      callback("");
+    }
+
+    void Remove(const std::string& path, const Callback& callback) override
+    {
+      callback("");
+    }
+
+    void Stat(const std::string& path, const StatCallback& callback) override
+    {
+      callback(StatResult(), "");
+    }
+
+    std::string Resolve(const std::string& path) const override
+    {
+      return "/" + path;
+    }
+  };
+
+  typedef std::vector<std::pair<std::string, AdblockPlus::IExecutor::Task>> DispatchedTasks;
+
+  class DeferredExecutor : public AdblockPlus::IExecutor
+  {
+  public:
+    explicit DeferredExecutor(const std::shared_ptr<DispatchedTasks>& tasks)
+      : tasks(tasks)
+    {
+    }
+
+    void Dispatch(const Task& task, const std::string& key) override
+    {
+      tasks->push_back(std::make_pair(key, task));
+    }
+
+  private:
+    std::shared_ptr<DispatchedTasks> tasks;
+  };
+
   class FileSystemJsObjectTest : public BaseJsTest
   {
   protected:
@@ -133,6 +204,19 @@ TEST_F(FileSystemJsObjectTest, Read)
   ASSERT_EQ("", error);
 }
 
+TEST_F(FileSystemJsObjectTest, ReadLargeFile)
+{
+  std::string expected;
+  for (int i = 0; i < 10000; i++)
+    expected += "line " + std::to_string(i) + "\n";
+  mockFileSystem->contentToRead = expected;
+  std::string content;
+  std::string error;
+  ReadFile(jsEngine, content, error);
+  ASSERT_EQ(expected, content);
+  ASSERT_EQ("", error);
+}
+
 TEST_F(FileSystemJsObjectTest, ReadIllegalArguments)
 {
   ASSERT_ANY_THROW(jsEngine->Evaluate("_fileSystem.read()"));
@@ -149,6 +233,63 @@ TEST_F(FileSystemJsObjectTest, ReadError)
   ASSERT_EQ("", content);
 }
 
+TEST_F(FileSystemJsObjectTest, ReadLines)
+{
+  mockFileSystem->contentToRead = "foo\r\nbar\n\n\rbaz\n";
+  jsEngine->Evaluate("var lines = []; var error = null;"
+    "_fileSystem.readLines('', function(batch) {lines = lines.concat(batch.split('\\n'))},"
+    "  function(e) {error = e})");
+  AdblockPlus::Sleep(50);
+  ASSERT_EQ("", jsEngine->Evaluate("error").AsString());
+  ASSERT_EQ("foo,bar,baz", jsEngine->Evaluate("lines.join(',')").AsString());
+}
+
+TEST_F(FileSystemJsObjectTest, ReadLinesInBatches)
+{
+  std::string line(1000, 'a');
+  for (int i = 0; i < 200; i++)
+    mockFileSystem->contentToRead += line + "\n";
+  jsEngine->Evaluate("var lines = 0; var batches = 0; var error = null;"
+    "_fileSystem.readLines('', function(batch) {lines += batch.split('\\n').length; batches++},"
+    "  function(e) {error = e})");
+  AdblockPlus::Sleep(200);
+  ASSERT_EQ("", jsEngine->Evaluate("error").AsString());
+  ASSERT_EQ(200, jsEngine->Evaluate("lines").AsInt());
+  ASSERT_LT(1, jsEngine->Evaluate("batches").AsInt());
+}
+
+TEST_F(FileSystemJsObjectTest, ReadLinesSpanningBatches)
+{
+  // The line breaks don't coincide with the ends of the parts read.
+  std::string line(999, 'a');
+  for (int i = 0; i < 200; i++)
+    mockFileSystem->contentToRead += line + "\r\n";
+  mockFileSystem->contentToRead += "b";
+  jsEngine->Evaluate("var lengths = {}; var count = 0; var error = null;"
+    "_fileSystem.readLines('', function(batch) {"
+    "  batch.split('\\n').forEach(function(l) {lengths[l.length] = true; count++})},"
+    "  function(e) {error = e})");
+  AdblockPlus::Sleep(200);
+  ASSERT_EQ("", jsEngine->Evaluate("error").AsString());
+  ASSERT_EQ(201, jsEngine->Evaluate("count").AsInt());
+  ASSERT_EQ("1,999", jsEngine->Evaluate("Object.keys(lengths).join(',')").AsString());
+}
+
+TEST_F(FileSystemJsObjectTest, ReadLinesIllegalArguments)
+{
+  ASSERT_ANY_THROW(jsEngine->Evaluate("_fileSystem.readLines()"));
+  ASSERT_ANY_THROW(jsEngine->Evaluate("_fileSystem.readLines('', function() {}, '')"));
+}
+
+TEST_F(FileSystemJsObjectTest, ReadLinesError)
+{
+  mockFileSystem->success = false;
+  jsEngine->Evaluate("var error = null;"
+    "_fileSystem.readLines('', function() {}, function(e) {error = e})");
+  AdblockPlus::Sleep(50);
+  ASSERT_NE("", jsEngine->Evaluate("error").AsString());
+}
+
 TEST_F(FileSystemJsObjectTest, Write)
 {
   jsEngine->Evaluate("_fileSystem.write('foo', 'bar', function(e) {error = e})");
@@ -158,6 +299,15 @@ TEST_F(FileSystemJsObjectTest, Write)
   ASSERT_EQ("", jsEngine->Evaluate("error").AsString());
 }
 
+TEST_F(FileSystemJsObjectTest, WriteLines)
+{
+  jsEngine->Evaluate("_fileSystem.write('foo', ['bar', '', '\u00e4'], function(e) {error = e})");
+  AdblockPlus::Sleep(50);
+  ASSERT_EQ("foo", mockFileSystem->lastWrittenPath);
+  ASSERT_EQ("bar\n\n\xc3\xa4\n", mockFileSystem->lastWrittenContent);
+  ASSERT_EQ("", jsEngine->Evaluate("error").AsString());
+}
+
 TEST_F(FileSystemJsObjectTest, WriteIllegalArguments)
 {
   ASSERT_ANY_THROW(jsEngine->Evaluate("_fileSystem.write()"));
@@ -195,6 +345,30 @@ TEST_F(FileSystemJsObjectTest, MoveError)
   ASSERT_NE("", jsEngine->Evaluate("error").AsString());
 }
 
+TEST_F(FileSystemJsObjectTest, Copy)
+{
+  mockFileSystem->contentToRead = "foo\nbar";
+  jsEngine->Evaluate("_fileSystem.copy('foo', 'bar', function(e) {error = e})");
+  AdblockPlus::Sleep(50);
+  ASSERT_EQ("bar", mockFileSystem->lastWrittenPath);
+  ASSERT_EQ("foo\nbar", mockFileSystem->lastWrittenContent);
+  ASSERT_EQ("", jsEngine->Evaluate("error").AsString());
+}
+
+TEST_F(FileSystemJsObjectTest, CopyIllegalArguments)
+{
+  ASSERT_ANY_THROW(jsEngine->Evaluate("_fileSystem.copy()"));
+  ASSERT_ANY_THROW(jsEngine->Evaluate("_fileSystem.copy('', '', '')"));
+}
+
+TEST_F(FileSystemJsObjectTest, CopyError)
+{
+  mockFileSystem->success = false;
+  jsEngine->Evaluate("_fileSystem.copy('foo', 'bar', function(e) {error = e})");
+  AdblockPlus::Sleep(50);
+  ASSERT_NE("", jsEngine->Evaluate("error").AsString());
+}
+
 TEST_F(FileSystemJsObjectTest, Remove)
 {
   jsEngine->Evaluate("_fileSystem.remove('foo', function(e) {error = e})");
@@ -246,3 +420,74 @@ TEST_F(FileSystemJsObjectTest, StatError)
   AdblockPlus::Sleep(50);
   ASSERT_NE("", jsEngine->Evaluate("result.error").AsString());
 }
+
+TEST_F(FileSystemJsObjectTest, UsesAsyncFileSystem)
+{
+  auto asyncFileSystem = std::make_shared<ImmediateAsyncFileSystem>();
+  jsEngine->SetAsyncFileSystem(asyncFileSystem);
+  jsEngine->Evaluate("_fileSystem.read('foo', function(r) {result = r})");
+  ASSERT_EQ("foo", asyncFileSystem->readPath);
+  ASSERT_EQ("bar", jsEngine->Evaluate("result.content").AsString());
+  jsEngine->Evaluate("_fileSystem.readLines('foo', function(batch) {lines = batch},"
+    "  function(e) {linesError = e})");
+  ASSERT_EQ("bar", jsEngine->Evaluate("lines").AsString());
+  ASSERT_EQ("", jsEngine->Evaluate("linesError").AsString());
+  jsEngine->Evaluate("_fileSystem.write('foo', 'bar', function(e) {error = e})");
+  ASSERT_EQ("Unable to write to foo", jsEngine->Evaluate("error").AsString());
+  ASSERT_EQ("/foo", jsEngine->Evaluate("_fileSystem.resolve('foo')").AsString());
+  ASSERT_EQ("", mockFileSystem->lastWrittenPath);
+}
+
+TEST(FileSystemJsObjectExecutorTest, OperationsAreDispatchedByPath)
+{
+  auto tasks = std::make_shared<DispatchedTasks>();
+  auto mockFileSystem = std::make_shared<MockFileSystem>();
+  JsEngineCreationParameters jsEngineParams;
+  jsEngineParams.ioExecutor.reset(new DeferredExecutor(tasks));
+  jsEngineParams.fileSystem = mockFileSystem;
+  auto jsEngine = CreateJsEngine(std::move(jsEngineParams));
+
+  jsEngine->Evaluate("_fileSystem.write('foo', 'bar', function(e) {writeError = e})");
+  jsEngine->Evaluate("_fileSystem.move('foo', 'baz', function(e) {moveError = e})");
+  ASSERT_EQ(2u, tasks->size());
+  EXPECT_EQ("foo", (*tasks)[0].first);
+  EXPECT_EQ("foo", (*tasks)[1].first);
+  EXPECT_TRUE(jsEngine->Evaluate("typeof writeError").AsString() == "undefined");
+  EXPECT_EQ("", mockFileSystem->lastWrittenPath);
+
+  for (const auto& task : *tasks)
+    task.second();
+  // The tasks keep the engine alive.
+  tasks->clear();
+  EXPECT_EQ("foo", mockFileSystem->lastWrittenPath);
+  EXPECT_EQ("bar", mockFileSystem->lastWrittenContent);
+  EXPECT_EQ("foo", mockFileSystem->movedFrom);
+  EXPECT_EQ("baz", mockFileSystem->movedTo);
+  EXPECT_EQ("", jsEngine->Evaluate("writeError").AsString());
+  EXPECT_EQ("", jsEngine->Evaluate("moveError").AsString());
+}
+
+TEST(FileSystemJsObjectExecutorTest, CallbacksAreDispatchedToCallbackExecutor)
+{
+  auto ioTasks = std::make_shared<DispatchedTasks>();
+  auto callbackTasks = std::make_shared<DispatchedTasks>();
+  auto mockFileSystem = std::make_shared<MockFileSystem>();
+  JsEngineCreationParameters jsEngineParams;
+  jsEngineParams.ioExecutor.reset(new DeferredExecutor(ioTasks));
+  jsEngineParams.callbackExecutor.reset(new DeferredExecutor(callbackTasks));
+  jsEngineParams.fileSystem = mockFileSystem;
+  auto jsEngine = CreateJsEngine(std::move(jsEngineParams));
+
+  jsEngine->Evaluate("_fileSystem.write('foo', 'bar', function(e) {writeError = e})");
+  ASSERT_EQ(1u, ioTasks->size());
+  (*ioTasks)[0].second();
+  ioTasks->clear();
+  EXPECT_EQ("foo", mockFileSystem->lastWrittenPath);
+  EXPECT_TRUE(jsEngine->Evaluate("typeof writeError").AsString() == "undefined");
+
+  ASSERT_EQ(1u, callbackTasks->size());
+  (*callbackTasks)[0].second();
+  // The tasks keep the engine alive.
+  callbackTasks->clear();
+  EXPECT_EQ("", jsEngine->Evaluate("writeError").AsString());
+}
@@ -15,10 +15,15 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include "BaseJsTest.h"
 #include <thread>
+#include <atomic>
 #include <condition_variable>
 
+#include "../src/CompiledRuleset.h"
+#include "../src/ContentTypes.h"
+
 using namespace AdblockPlus;
 
 namespace AdblockPlus
@@ -69,6 +74,115 @@ namespace
   typedef FilterEngineTestGeneric<LazyFileSystem, AdblockPlus::DefaultLogSystem> FilterEngineTest;
   typedef FilterEngineTestGeneric<VeryLazyFileSystem, LazyLogSystem> FilterEngineTestNoData;
 
+  // Subclasses set createParams before calling SetUp().
+  class FilterEngineWithParamsTest : public ::testing::Test
+  {
+  protected:
+    FilterEnginePtr filterEngine;
+    FilterEngine::CreationParameters createParams;
+    LogSystemPtr logSystem;
+
+    void SetUp() override
+    {
+      JsEngineCreationParameters jsEngineParams;
+      if (logSystem)
+        jsEngineParams.logSystem = logSystem;
+      jsEngineParams.fileSystem.reset(new LazyFileSystem());
+      jsEngineParams.timer.reset(new NoopTimer());
+      jsEngineParams.webRequest.reset(new NoopWebRequest());
+      auto jsEngine = CreateJsEngine(std::move(jsEngineParams));
+      filterEngine = AdblockPlus::FilterEngine::Create(jsEngine, createParams);
+    }
+    void TearDown() override
+    {
+      // Workaround for issue 5198
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  };
+
+  class FilterEngineWithMatchCacheTest : public FilterEngineWithParamsTest
+  {
+  protected:
+    void SetUp() override
+    {
+      createParams.matchCacheEnabled = true;
+      createParams.matchCacheCapacity = 2;
+      FilterEngineWithParamsTest::SetUp();
+    }
+  };
+
+  class FilterEngineWithMetricsTest : public FilterEngineWithParamsTest
+  {
+  protected:
+    void SetUp() override
+    {
+      createParams.metricsEnabled = true;
+      FilterEngineWithParamsTest::SetUp();
+    }
+  };
+
+  class FilterEngineWithHitStatisticsTest : public FilterEngineWithParamsTest
+  {
+  protected:
+    void SetUp() override
+    {
+      createParams.hitStatisticsEnabled = true;
+      FilterEngineWithParamsTest::SetUp();
+    }
+  };
+
+  class FilterEngineWithLazyElemHideIndexingTest : public FilterEngineWithParamsTest
+  {
+  protected:
+    void SetUp() override
+    {
+      logSystem.reset(new LazyLogSystem());
+      createParams.elemHideIndexing = FilterEngine::ELEM_HIDE_INDEXING_LAZY;
+      FilterEngineWithParamsTest::SetUp();
+    }
+  };
+
+  class FilterEngineWithoutElemHideIndexingTest : public FilterEngineWithParamsTest
+  {
+  protected:
+    void SetUp() override
+    {
+      logSystem.reset(new LazyLogSystem());
+      createParams.elemHideIndexing = FilterEngine::ELEM_HIDE_INDEXING_DISABLED;
+      FilterEngineWithParamsTest::SetUp();
+    }
+  };
+
+  class FilterEngineWithUnloadingTest : public FilterEngineWithParamsTest
+  {
+  protected:
+    void SetUp() override
+    {
+      logSystem.reset(new LazyLogSystem());
+      createParams.unloadDisabledSubscriptions = true;
+      FilterEngineWithParamsTest::SetUp();
+    }
+  };
+
+  class FilterEngineWithFiltersLoadedCallbackTest : public FilterEngineWithParamsTest
+  {
+  protected:
+    std::vector<std::string> calls;
+
+    void SetUp() override
+    {
+      logSystem.reset(new LazyLogSystem());
+      createParams.filtersLoadedCallback = [this](const FilterEnginePtr& filterEngine)
+      {
+        calls.push_back("filtersLoaded");
+        EXPECT_FALSE(filterEngine->Matches("http://example.org/adbanner.gif",
+          AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+      };
+      FilterEngineWithParamsTest::SetUp();
+      calls.push_back("created");
+    }
+  };
+
   class UpdaterTest : public ::testing::Test
   {
   protected:
@@ -254,6 +368,20 @@ TEST_F(FilterEngineTest, FilterCreation)
   ASSERT_EQ(filter1, filter5);
 }
 
+TEST_F(FilterEngineTest, ContentTypesMatchTypeMap)
+{
+  AdblockPlus::JsValue typeMap = filterEngine->GetJsEngine()->Evaluate(
+    "require('filterClasses').RegExpFilter.typeMap");
+  std::vector<std::string> names = typeMap.GetOwnPropertyNames();
+  EXPECT_EQ(AdblockPlus::ContentTypes::tableSize, names.size());
+  for (const auto& name : names)
+  {
+    int32_t value = 0;
+    ASSERT_TRUE(AdblockPlus::ContentTypes::Lookup(name, value)) << name;
+    EXPECT_EQ(static_cast<int32_t>(typeMap.GetProperty(name).AsInt()), value) << name;
+  }
+}
+
 TEST_F(FilterEngineTest, FilterProperties)
 {
   AdblockPlus::Filter filter = filterEngine->GetFilter("foo");
@@ -292,6 +420,89 @@ TEST_F(FilterEngineTest, AddRemoveFilters)
   ASSERT_FALSE(filter.IsListed());
 }
 
+TEST_F(FilterEngineTest, AddRemoveFiltersInBulk)
+{
+  std::vector<std::string> actions;
+  std::vector<size_t> itemCounts;
+  filterEngine->SetFilterChangeCallback(
+    [&actions, &itemCounts](const std::string& action, AdblockPlus::JsValue&& item)
+    {
+      actions.push_back(action);
+      itemCounts.push_back(item.IsArray() ? item.AsList().size() : 0);
+    });
+  filterEngine->GetFilter("foo").AddToList();
+  actions.clear();
+  itemCounts.clear();
+
+  std::vector<std::string> texts;
+  texts.push_back("foo");
+  texts.push_back("bar");
+  texts.push_back("");
+  texts.push_back("@@baz");
+  filterEngine->AddFilters(texts);
+  ASSERT_EQ(1u, actions.size());
+  EXPECT_EQ("filters.added", actions[0]);
+  EXPECT_EQ(2u, itemCounts[0]);
+  ASSERT_EQ(3u, filterEngine->GetListedFilters().size());
+  EXPECT_TRUE(filterEngine->GetFilter("bar").IsListed());
+  EXPECT_TRUE(filterEngine->GetFilter("@@baz").IsListed());
+
+  std::string exported = filterEngine->ExportListedFilters();
+  EXPECT_NE(std::string::npos, exported.find("foo\n"));
+  EXPECT_NE(std::string::npos, exported.find("bar\n"));
+  EXPECT_NE(std::string::npos, exported.find("@@baz\n"));
+  EXPECT_EQ(3, std::count(exported.begin(), exported.end(), '\n'));
+
+  texts.clear();
+  texts.push_back("foo");
+  texts.push_back("@@baz");
+  texts.push_back("unknown");
+  filterEngine->RemoveFilters(texts);
+  ASSERT_EQ(2u, actions.size());
+  EXPECT_EQ("filters.removed", actions[1]);
+  EXPECT_EQ(2u, itemCounts[1]);
+  ASSERT_EQ(1u, filterEngine->GetListedFilters().size());
+  EXPECT_EQ("bar\n", filterEngine->ExportListedFilters());
+
+  // Nothing changed, nothing is reported.
+  filterEngine->RemoveFilters(texts);
+  EXPECT_EQ(2u, actions.size());
+}
+
+TEST_F(FilterEngineTest, ListedFilterPages)
+{
+  ASSERT_EQ(0u, filterEngine->GetListedFilterPage(0, 10).size());
+  filterEngine->GetFilter("foo").AddToList();
+  filterEngine->GetFilter("@@bar").AddToList();
+  filterEngine->GetFilter("##.baz").AddToList();
+  std::vector<AdblockPlus::Filter> filters = filterEngine->GetListedFilters();
+  ASSERT_EQ(3u, filters.size());
+
+  std::vector<AdblockPlus::FilterEngine::FilterInfo> page =
+    filterEngine->GetListedFilterPage(0, 2);
+  ASSERT_EQ(2u, page.size());
+  std::vector<AdblockPlus::FilterEngine::FilterInfo> lastPage =
+    filterEngine->GetListedFilterPage(2, 2);
+  ASSERT_EQ(1u, lastPage.size());
+  page.push_back(lastPage[0]);
+  EXPECT_EQ(0u, filterEngine->GetListedFilterPage(3, 2).size());
+  for (size_t i = 0; i < filters.size(); i++)
+  {
+    EXPECT_EQ(filters[i].GetProperty("text").AsString(), page[i].text);
+    EXPECT_EQ(filters[i].GetType(), page[i].type);
+  }
+
+  std::vector<std::string> texts;
+  filterEngine->ForEachListedFilter(
+    [&texts](const AdblockPlus::FilterEngine::FilterInfo& filter)
+    {
+      texts.push_back(filter.text);
+    });
+  ASSERT_EQ(3u, texts.size());
+  for (size_t i = 0; i < filters.size(); i++)
+    EXPECT_EQ(page[i].text, texts[i]);
+}
+
 TEST_F(FilterEngineTest, SubscriptionProperties)
 {
   AdblockPlus::Subscription subscription = filterEngine->GetSubscription("foo");
@@ -349,6 +560,68 @@ TEST_F(FilterEngineTest, EnablingSubscriptionEnablesItAndFiresEvent)
   EXPECT_FALSE(subscription.IsDisabled());
 }
 
+TEST_F(FilterEngineTest, ApiCallsOnlyWrapTheirResults)
+{
+  auto jsEngine = filterEngine->GetJsEngine();
+  size_t jsValueCount = jsEngine->GetMemoryStats().jsValueCount;
+  {
+    AdblockPlus::Filter filter = filterEngine->GetFilter("foo");
+    ASSERT_EQ(jsValueCount + 1, jsEngine->GetMemoryStats().jsValueCount);
+    filter.AddToList();
+    ASSERT_TRUE(filter.IsListed());
+    filterEngine->GetElementHidingSelectors("example.org");
+    ASSERT_EQ(jsValueCount + 1, jsEngine->GetMemoryStats().jsValueCount);
+  }
+  ASSERT_EQ(jsValueCount, jsEngine->GetMemoryStats().jsValueCount);
+}
+
+TEST_F(FilterEngineTest, Stats)
+{
+  AdblockPlus::FilterEngine::Stats stats = filterEngine->GetStats();
+  ASSERT_EQ(0u, stats.filterCount);
+
+  filterEngine->GetFilter("foo").AddToList();
+  filterEngine->GetFilter("barbaz").AddToList();
+  stats = filterEngine->GetStats();
+  ASSERT_EQ(2u, stats.filterCount);
+  ASSERT_EQ(stats.subscriptions.size(), stats.subscriptionCount);
+  size_t approximateSize = 0;
+  for (const auto& subscription : stats.subscriptions)
+  {
+    if (subscription.filterCount)
+    {
+      ASSERT_EQ(2u, subscription.filterCount);
+      ASSERT_EQ('~', subscription.url[0]);
+      approximateSize = subscription.approximateSize;
+    }
+  }
+  ASSERT_GE(approximateSize, 9u);
+}
+
+TEST_F(FilterEngineTest, StartupProfile)
+{
+  const AdblockPlus::FilterEngine::StartupProfile& profile = filterEngine->GetStartupProfile();
+  ASSERT_FALSE(profile.scripts.empty());
+  std::chrono::microseconds scriptsDuration(0);
+  for (const auto& script : profile.scripts)
+  {
+    ASSERT_FALSE(script.filename.empty());
+    scriptsDuration += script.duration;
+  }
+  ASSERT_GT(profile.total.count(), 0);
+  ASSERT_GE(profile.total, scriptsDuration);
+  ASSERT_GE(profile.total, profile.prefsLoad);
+  ASSERT_GE(profile.total, profile.filtersRead + profile.filterParse);
+  ASSERT_GE(profile.total, profile.matcherBuild + profile.initDelivery);
+}
+
+TEST_F(FilterEngineTest, MetricsDisabledByDefault)
+{
+  filterEngine->Matches("http://example.org/", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  ASSERT_TRUE(filterEngine->GetMetrics().empty());
+  filterEngine->ResetMetrics();
+}
+
 TEST_F(FilterEngineTest, AddRemoveSubscriptions)
 {
   ASSERT_EQ(0u, filterEngine->GetListedSubscriptions().size());
@@ -371,6 +644,33 @@ TEST_F(FilterEngineTest, AddRemoveSubscriptions)
   ASSERT_FALSE(subscription.IsListed());
 }
 
+TEST_F(FilterEngineTest, SubscriptionsSnapshot)
+{
+  ASSERT_EQ(0u, filterEngine->GetSubscriptionsSnapshot().size());
+  AdblockPlus::Subscription subscription = filterEngine->GetSubscription("foo");
+  subscription.SetProperty("title", "Foo list");
+  subscription.SetProperty("lastDownload", 1234);
+  subscription.SetProperty("downloadStatus", "synchronize_ok");
+  subscription.AddToList();
+  subscription.SetDisabled(true);
+
+  std::vector<AdblockPlus::FilterEngine::SubscriptionInfo> snapshot =
+    filterEngine->GetSubscriptionsSnapshot();
+  ASSERT_EQ(1u, snapshot.size());
+  EXPECT_EQ("foo", snapshot[0].url);
+  EXPECT_EQ("Foo list", snapshot[0].title);
+  EXPECT_EQ("", snapshot[0].homepage);
+  EXPECT_EQ(1234, snapshot[0].lastDownload);
+  EXPECT_EQ(0, snapshot[0].lastSuccess);
+  EXPECT_EQ("synchronize_ok", snapshot[0].downloadStatus);
+  EXPECT_TRUE(snapshot[0].disabled);
+  EXPECT_EQ(subscription.IsUpdating(), snapshot[0].updating);
+  EXPECT_FALSE(snapshot[0].acceptableAds);
+
+  subscription.RemoveFromList();
+  ASSERT_EQ(0u, filterEngine->GetSubscriptionsSnapshot().size());
+}
+
 TEST_F(FilterEngineTest, SubscriptionUpdates)
 {
   AdblockPlus::Subscription subscription = filterEngine->GetSubscription("foo");
@@ -544,6 +844,40 @@ TEST_F(FilterEngineTest, MatchesNestedFrameRequest)
   ASSERT_EQ(AdblockPlus::Filter::TYPE_BLOCKING, match3->GetType());
 }
 
+TEST_F(FilterEngineTest, MatchesSharedReferrerChain)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  filterEngine->GetFilter("@@adbanner.gif$domain=example.org").AddToList();
+
+  AdblockPlus::ReferrerMapping referrerMapping;
+  referrerMapping.Add("http://ads.com/frame/", "http://example.com/");
+  referrerMapping.Add("http://example.org/", "http://ads.com/frame/");
+  AdblockPlus::SharedUrlList documentUrls;
+  referrerMapping.BuildReferrerChain("http://ads.com/frame/", documentUrls);
+  ASSERT_EQ(2u, documentUrls.size());
+
+  AdblockPlus::FilterPtr match1 =
+    filterEngine->Matches("http://ads.com/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE,
+                          documentUrls);
+  ASSERT_TRUE(match1);
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_BLOCKING, match1->GetType());
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_BLOCKING,
+    filterEngine->GetMatchResult("http://ads.com/adbanner.gif",
+      AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, documentUrls).type);
+
+  referrerMapping.BuildReferrerChain("http://example.org/", documentUrls);
+  AdblockPlus::FilterPtr match2 =
+    filterEngine->Matches("http://ads.com/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE,
+                          documentUrls);
+  ASSERT_TRUE(match2);
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_EXCEPTION, match2->GetType());
+
+  AdblockPlus::DocumentContextPtr documentContext =
+    filterEngine->CreateDocumentContext(documentUrls);
+  ASSERT_EQ(3u, documentContext->GetDocumentUrls().size());
+  ASSERT_EQ("http://example.org/", documentContext->GetDocumentUrls().back());
+}
+
 TEST_F(FilterEngineTest, MatchesNestedFrameOnWhitelistedDomain)
 {
   filterEngine->GetFilter("adbanner.gif").AddToList();
@@ -595,6 +929,923 @@ TEST_F(FilterEngineTest, MatchesNestedFrameOnWhitelistedDomain)
   ASSERT_EQ(AdblockPlus::Filter::TYPE_EXCEPTION, match5->GetType());
 }
 
+TEST_F(FilterEngineTest, MatchesWithDocumentContext)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  filterEngine->GetFilter("@@||example.org^$document,domain=ads.com").AddToList();
+
+  std::vector<std::string> documentUrls1;
+  documentUrls1.push_back("http://ads.com/frame/");
+  documentUrls1.push_back("http://example.com/");
+  AdblockPlus::DocumentContextPtr context1 = filterEngine->CreateDocumentContext(documentUrls1);
+  ASSERT_EQ(documentUrls1, context1->GetDocumentUrls());
+  ASSERT_FALSE(context1->IsDocumentWhitelisted());
+  AdblockPlus::FilterPtr match1 =
+    filterEngine->Matches("http://ads.com/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, *context1);
+  ASSERT_TRUE(match1);
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_BLOCKING, match1->GetType());
+  ASSERT_FALSE(filterEngine->Matches("http://ads.com/image.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, *context1));
+
+  std::vector<std::string> documentUrls2;
+  documentUrls2.push_back("http://ads.com/frame/");
+  documentUrls2.push_back("http://example.org/");
+  AdblockPlus::DocumentContextPtr context2 = filterEngine->CreateDocumentContext(documentUrls2);
+  ASSERT_TRUE(context2->IsDocumentWhitelisted());
+  for (const auto& url : {"http://ads.com/adbanner.gif", "http://ads.com/image.gif"})
+  {
+    AdblockPlus::FilterPtr match2 =
+      filterEngine->Matches(url, AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, *context2);
+    ASSERT_TRUE(match2);
+    ASSERT_EQ(AdblockPlus::Filter::TYPE_EXCEPTION, match2->GetType());
+  }
+
+  AdblockPlus::DocumentContextPtr emptyContext =
+    filterEngine->CreateDocumentContext(std::vector<std::string>());
+  ASSERT_FALSE(emptyContext->IsDocumentWhitelisted());
+  ASSERT_TRUE(filterEngine->Matches("http://ads.com/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, *emptyContext));
+}
+
+TEST_F(FilterEngineTest, DocumentContextWhitelisting)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  filterEngine->GetFilter("specific.gif$domain=example.com").AddToList();
+  filterEngine->GetFilter("@@||example.com^$genericblock").AddToList();
+  filterEngine->GetFilter("@@||example.org^$elemhide").AddToList();
+
+  AdblockPlus::DocumentContextPtr context1 =
+    filterEngine->CreateDocumentContext(std::vector<std::string>(1, "http://example.com/"));
+  ASSERT_TRUE(context1->IsGenericblockWhitelisted());
+  ASSERT_FALSE(context1->IsElemhideWhitelisted());
+  ASSERT_FALSE(filterEngine->Matches("http://ads.com/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, *context1));
+  ASSERT_TRUE(filterEngine->Matches("http://ads.com/specific.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, *context1));
+
+  AdblockPlus::DocumentContextPtr context2 =
+    filterEngine->CreateDocumentContext(std::vector<std::string>(1, "http://example.org/"));
+  ASSERT_FALSE(context2->IsGenericblockWhitelisted());
+  ASSERT_TRUE(context2->IsElemhideWhitelisted());
+  ASSERT_TRUE(filterEngine->IsElemhideWhitelisted("http://example.org/", std::vector<std::string>()));
+  ASSERT_TRUE(filterEngine->Matches("http://ads.com/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, *context2));
+}
+
+TEST_F(FilterEngineTest, GetMatchResult)
+{
+  filterEngine->GetFilter("adbanner.gif$third-party,collapse").AddToList();
+  filterEngine->GetFilter("@@adbanner.gif$domain=example.org").AddToList();
+
+  std::vector<std::string> documentUrls(1, "http://example.com/");
+  AdblockPlus::MatchResult result = filterEngine->GetMatchResult("http://ads.com/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, documentUrls);
+  ASSERT_TRUE(result.IsMatch());
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_BLOCKING, result.type);
+  ASSERT_EQ("adbanner.gif$third-party,collapse", result.text);
+  ASSERT_EQ(AdblockPlus::MatchResult::THIRD_PARTY_ONLY, result.thirdParty);
+  ASSERT_EQ(AdblockPlus::MatchResult::COLLAPSE_ALWAYS, result.collapse);
+  ASSERT_EQ(result.text, filterEngine->Matches("http://ads.com/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, documentUrls)->GetProperty("text").AsString());
+
+  result = filterEngine->GetMatchResult("http://ads.com/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE,
+    *filterEngine->CreateDocumentContext(std::vector<std::string>(1, "http://example.org/")));
+  ASSERT_TRUE(result.IsMatch());
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_EXCEPTION, result.type);
+  ASSERT_EQ("@@adbanner.gif$domain=example.org", result.text);
+  ASSERT_EQ(AdblockPlus::MatchResult::THIRD_PARTY_ANY, result.thirdParty);
+  ASSERT_EQ(AdblockPlus::MatchResult::COLLAPSE_DEFAULT, result.collapse);
+
+  result = filterEngine->GetMatchResult("http://example.com/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, documentUrls);
+  ASSERT_FALSE(result.IsMatch());
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_INVALID, result.type);
+  ASSERT_TRUE(result.text.empty());
+}
+
+TEST_F(FilterEngineTest, MatchesBatch)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  filterEngine->GetFilter("@@||example.org^$document,domain=ads.com").AddToList();
+
+  std::vector<std::string> documentUrls1;
+  documentUrls1.push_back("http://ads.com/frame/");
+  documentUrls1.push_back("http://example.com/");
+  std::vector<std::string> documentUrls2;
+  documentUrls2.push_back("http://ads.com/frame/");
+  documentUrls2.push_back("http://example.org/");
+
+  std::vector<AdblockPlus::FilterEngine::MatchRequest> requests;
+  AdblockPlus::FilterEngine::MatchRequest request;
+  request.url = "http://ads.com/adbanner.gif";
+  request.contentTypeMask = AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE;
+  request.documentUrls = documentUrls1;
+  requests.push_back(request);
+  request.url = "http://ads.com/image.gif";
+  requests.push_back(request);
+  request.url = "http://ads.com/adbanner.gif";
+  request.documentUrls = documentUrls2;
+  requests.push_back(request);
+  request.documentUrls.clear();
+  requests.push_back(request);
+
+  std::vector<AdblockPlus::FilterPtr> matches = filterEngine->MatchesBatch(requests);
+  ASSERT_EQ(requests.size(), matches.size());
+  for (size_t i = 0; i < requests.size(); i++)
+  {
+    AdblockPlus::FilterPtr expected = filterEngine->Matches(requests[i].url,
+      requests[i].contentTypeMask, requests[i].documentUrls);
+    ASSERT_EQ(static_cast<bool>(expected), static_cast<bool>(matches[i]));
+    if (expected)
+    {
+      ASSERT_EQ(*expected, *matches[i]);
+    }
+  }
+  ASSERT_TRUE(matches[0]);
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_BLOCKING, matches[0]->GetType());
+  ASSERT_FALSE(matches[1]);
+  ASSERT_TRUE(matches[2]);
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_EXCEPTION, matches[2]->GetType());
+  ASSERT_TRUE(matches[3]);
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_BLOCKING, matches[3]->GetType());
+
+  ASSERT_TRUE(filterEngine->MatchesBatch(
+    std::vector<AdblockPlus::FilterEngine::MatchRequest>()).empty());
+}
+
+TEST_F(FilterEngineTest, MatchCacheIsDisabledByDefault)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+  AdblockPlus::FilterEngine::MatchCacheStats stats = filterEngine->GetMatchCacheStats();
+  ASSERT_EQ(0u, stats.hits);
+  ASSERT_EQ(0u, stats.misses);
+}
+
+TEST_F(FilterEngineWithMatchCacheTest, CachesResults)
+{
+  const std::vector<std::string> noDocuments;
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  ASSERT_FALSE(filterEngine->Matches("http://example.org/image.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  ASSERT_FALSE(filterEngine->Matches("http://example.org/image.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  AdblockPlus::FilterEngine::MatchCacheStats stats = filterEngine->GetMatchCacheStats();
+  ASSERT_EQ(2u, stats.hits);
+  ASSERT_EQ(2u, stats.misses);
+
+  // A different content type is a different request, with a capacity of two
+  // it evicts the least recently used result
+  ASSERT_FALSE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_SUBDOCUMENT, noDocuments));
+  ASSERT_FALSE(filterEngine->Matches("http://example.org/image.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  stats = filterEngine->GetMatchCacheStats();
+  ASSERT_EQ(3u, stats.hits);
+  ASSERT_EQ(4u, stats.misses);
+}
+
+TEST_F(FilterEngineWithMatchCacheTest, FilterChangesInvalidateCache)
+{
+  const std::vector<std::string> noDocuments;
+  auto filter = filterEngine->GetFilter("adbanner.gif");
+  ASSERT_FALSE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  filter.AddToList();
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  filterEngine->GetFilter("@@adbanner.gif").AddToList();
+  AdblockPlus::FilterPtr match = filterEngine->Matches("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments);
+  ASSERT_TRUE(match);
+  ASSERT_EQ(AdblockPlus::Filter::TYPE_EXCEPTION, match->GetType());
+  filterEngine->GetFilter("@@adbanner.gif").RemoveFromList();
+  filter.RemoveFromList();
+  ASSERT_FALSE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  ASSERT_EQ(0u, filterEngine->GetMatchCacheStats().hits);
+  ASSERT_EQ(4u, filterEngine->GetMatchCacheStats().misses);
+}
+
+TEST_F(FilterEngineWithMatchCacheTest, MemoryPressureDropsCaches)
+{
+  const std::vector<std::string> noDocuments;
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  filterEngine->GetFilter("example.org##.ad").AddToList();
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  ASSERT_EQ(1u, filterEngine->GetElementHidingSelectors("example.org").size());
+  AdblockPlus::FilterEngine::Stats stats = filterEngine->GetStats();
+  ASSERT_EQ(1u, stats.matchCacheSize);
+  ASSERT_EQ(1u, stats.elemHideCacheSize);
+
+  filterEngine->GetJsEngine()->NotifyMemoryPressure(AdblockPlus::JsEngine::MEMORY_PRESSURE_MODERATE);
+  stats = filterEngine->GetStats();
+  ASSERT_EQ(0u, stats.matchCacheSize);
+  ASSERT_EQ(0u, stats.elemHideCacheSize);
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments));
+  ASSERT_EQ(0u, filterEngine->GetMatchCacheStats().hits);
+  ASSERT_EQ(2u, filterEngine->GetMatchCacheStats().misses);
+}
+
+TEST_F(FilterEngineWithMetricsTest, CountsCalls)
+{
+  const std::vector<std::string> noDocuments;
+  filterEngine->Matches("http://example.org/", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  filterEngine->GetMatchResult("http://example.org/", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments);
+  filterEngine->IsDocumentWhitelisted("http://example.org/", noDocuments);
+  filterEngine->GetElementHidingSelectors("example.org");
+  filterEngine->GetElementHidingSelectors("example.org");
+  filterEngine->GetPref("foobar");
+
+  std::vector<AdblockPlus::LatencyMetrics> metrics = filterEngine->GetMetrics();
+  ASSERT_EQ(5u, metrics.size());
+  std::map<std::string, uint64_t> counts;
+  for (const auto& entry : metrics)
+  {
+    counts[entry.name] = entry.count;
+    uint64_t histogramCount = 0;
+    for (uint64_t bucket : entry.histogram)
+      histogramCount += bucket;
+    ASSERT_EQ(entry.count, histogramCount);
+    ASSERT_LE(entry.maxMicroseconds, entry.totalMicroseconds);
+  }
+  ASSERT_EQ(2u, counts["Matches"]);
+  ASSERT_EQ(1u, counts["IsDocumentWhitelisted"]);
+  ASSERT_EQ(2u, counts["GetElementHidingSelectors"]);
+  ASSERT_EQ(1u, counts["GetPref"]);
+  ASSERT_EQ(0u, counts["SubscriptionUpdate"]);
+
+  filterEngine->ResetMetrics();
+  for (const auto& entry : filterEngine->GetMetrics())
+    ASSERT_EQ(0u, entry.count);
+}
+
+TEST_F(FilterEngineTest, HitStatisticsDisabledByDefault)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+  ASSERT_TRUE(filterEngine->GetTopFilterHits(10).empty());
+}
+
+TEST_F(FilterEngineWithHitStatisticsTest, CountsMatches)
+{
+  const std::vector<std::string> noDocuments;
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  filterEngine->GetFilter("@@notbanner.gif").AddToList();
+  filterEngine->GetFilter("@@||example.com^$document").AddToList();
+  filterEngine->Matches("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  filterEngine->GetMatchResult("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments);
+  filterEngine->Matches("http://example.org/notbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  filterEngine->Matches("http://example.org/image.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  ASSERT_TRUE(filterEngine->IsDocumentWhitelisted("http://example.com/",
+    noDocuments));
+
+  std::vector<FilterEngine::FilterHits> top = filterEngine->GetTopFilterHits(10);
+  ASSERT_EQ(3u, top.size());
+  ASSERT_EQ("adbanner.gif", top[0].text);
+  ASSERT_EQ(2u, top[0].hitCount);
+  ASSERT_LT(0, top[0].lastHit);
+  ASSERT_EQ(1u, top[1].hitCount);
+  ASSERT_EQ(1u, top[2].hitCount);
+  ASSERT_EQ(1u, filterEngine->GetTopFilterHits(1).size());
+}
+
+TEST_F(FilterEngineWithHitStatisticsTest, FlushesToFiltersWithSavestats)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  filterEngine->Matches("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  filterEngine->FlushFilterHits();
+  ASSERT_EQ(0, filterEngine->GetFilter("adbanner.gif").GetProperty("hitCount").AsInt());
+
+  filterEngine->SetPref("savestats", filterEngine->GetJsEngine()->NewValue(true));
+  filterEngine->Matches("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  filterEngine->Matches("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  filterEngine->FlushFilterHits();
+  AdblockPlus::Filter filter = filterEngine->GetFilter("adbanner.gif");
+  ASSERT_EQ(2, filter.GetProperty("hitCount").AsInt());
+  ASSERT_LT(0, filter.GetProperty("lastHit").AsInt());
+  ASSERT_EQ(3u, filterEngine->GetTopFilterHits(1)[0].hitCount);
+}
+
+namespace
+{
+  class ScriptCacheFileSystem : public LazyFileSystem
+  {
+  public:
+    std::string scriptCache;
+    int scriptCacheWrites;
+
+    ScriptCacheFileSystem() : scriptCacheWrites(0)
+    {
+    }
+
+    std::shared_ptr<std::istream> Read(const std::string& path) const
+    {
+      if (path == "scripts.cache")
+        return std::shared_ptr<std::istream>(new std::istringstream(scriptCache));
+      return LazyFileSystem::Read(path);
+    }
+
+    void Write(const std::string& path, std::istream& content)
+    {
+      if (path == "scripts.cache")
+      {
+        std::stringstream ss;
+        ss << content.rdbuf();
+        scriptCache = ss.str();
+        ++scriptCacheWrites;
+      }
+      else
+        LazyFileSystem::Write(path, content);
+    }
+
+    StatResult Stat(const std::string& path) const
+    {
+      if (path == "scripts.cache")
+      {
+        StatResult result;
+        result.exists = result.isFile = !scriptCache.empty();
+        return result;
+      }
+      return LazyFileSystem::Stat(path);
+    }
+  };
+
+  FilterEnginePtr CreateFilterEngineWithScriptCache(
+    const std::shared_ptr<ScriptCacheFileSystem>& fileSystem)
+  {
+    JsEngineCreationParameters jsEngineParams;
+    jsEngineParams.fileSystem = fileSystem;
+    jsEngineParams.logSystem.reset(new LazyLogSystem());
+    jsEngineParams.timer.reset(new NoopTimer());
+    jsEngineParams.webRequest.reset(new NoopWebRequest());
+    AdblockPlus::FilterEngine::CreationParameters createParams;
+    createParams.scriptCacheEnabled = true;
+    return AdblockPlus::FilterEngine::Create(CreateJsEngine(std::move(jsEngineParams)), createParams);
+  }
+}
+
+TEST(FilterEngineScriptCacheTest, CacheIsWrittenOnceAndReused)
+{
+  auto fileSystem = std::make_shared<ScriptCacheFileSystem>();
+  CreateFilterEngineWithScriptCache(fileSystem);
+  ASSERT_EQ(1, fileSystem->scriptCacheWrites);
+  ASSERT_FALSE(fileSystem->scriptCache.empty());
+
+  {
+    FilterEnginePtr filterEngine = CreateFilterEngineWithScriptCache(fileSystem);
+    filterEngine->GetFilter("adbanner.gif").AddToList();
+    ASSERT_TRUE(filterEngine->Matches("http://example.org/adbanner.gif", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+  }
+  ASSERT_EQ(1, fileSystem->scriptCacheWrites);
+
+  // Outdated data is replaced
+  fileSystem->scriptCache = "outdated\n";
+  CreateFilterEngineWithScriptCache(fileSystem);
+  ASSERT_EQ(2, fileSystem->scriptCacheWrites);
+  ASSERT_NE("outdated\n", fileSystem->scriptCache);
+}
+
+namespace
+{
+  class RulesetFileSystem : public LazyFileSystem
+  {
+  public:
+    std::string ruleset;
+
+    std::shared_ptr<std::istream> Read(const std::string& path) const
+    {
+      if (path == "ruleset.dat")
+        return std::shared_ptr<std::istream>(new std::istringstream(ruleset));
+      return LazyFileSystem::Read(path);
+    }
+  };
+}
+
+TEST(FilterEngineRulesetTest, PrecompiledFiltersApply)
+{
+  std::vector<std::string> filters;
+  filters.push_back("/compiled/*");
+  filters.push_back("@@||example.com/compiled/$image");
+  filters.push_back("##.compiled");
+  filters.push_back("example.com#@#.compiled");
+  std::ostringstream ruleset;
+  CompiledRuleset::Compile(filters, ruleset);
+  auto fileSystem = std::make_shared<RulesetFileSystem>();
+  fileSystem->ruleset = ruleset.str();
+
+  JsEngineCreationParameters jsEngineParams;
+  jsEngineParams.fileSystem = fileSystem;
+  jsEngineParams.logSystem.reset(new LazyLogSystem());
+  jsEngineParams.timer.reset(new NoopTimer());
+  jsEngineParams.webRequest.reset(new NoopWebRequest());
+  AdblockPlus::FilterEngine::CreationParameters createParams;
+  createParams.precompiledRuleset = "ruleset.dat";
+  FilterEnginePtr filterEngine = AdblockPlus::FilterEngine::Create(
+    CreateJsEngine(std::move(jsEngineParams)), createParams);
+
+  AdblockPlus::FilterPtr match = filterEngine->Matches(
+    "http://test.org/compiled/ad.png", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  ASSERT_TRUE(match);
+  EXPECT_EQ("/compiled/*", match->GetProperty("text").AsString());
+  match = filterEngine->Matches("http://example.com/compiled/ad.png",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "");
+  ASSERT_TRUE(match);
+  EXPECT_EQ(AdblockPlus::Filter::TYPE_EXCEPTION, match->GetType());
+  EXPECT_TRUE(filterEngine->GetListedFilters().empty());
+
+  std::vector<std::string> selectors = filterEngine->GetElementHidingSelectors("test.org");
+  EXPECT_NE(selectors.end(), std::find(selectors.begin(), selectors.end(), ".compiled"));
+  selectors = filterEngine->GetElementHidingSelectors("example.com");
+  EXPECT_EQ(selectors.end(), std::find(selectors.begin(), selectors.end(), ".compiled"));
+
+  fileSystem->ruleset = "invalid";
+  JsEngineCreationParameters invalidParams;
+  invalidParams.fileSystem = fileSystem;
+  invalidParams.logSystem.reset(new LazyLogSystem());
+  invalidParams.timer.reset(new NoopTimer());
+  invalidParams.webRequest.reset(new NoopWebRequest());
+  EXPECT_THROW(AdblockPlus::FilterEngine::Create(
+    CreateJsEngine(std::move(invalidParams)), createParams), std::runtime_error);
+}
+
+namespace
+{
+  class PublishingFileSystem : public LazyFileSystem
+  {
+  public:
+    std::map<std::string, std::string> published;
+
+    std::shared_ptr<std::istream> Read(const std::string& path) const
+    {
+      std::map<std::string, std::string>::const_iterator it = published.find(path);
+      if (it != published.end())
+        return std::shared_ptr<std::istream>(new std::istringstream(it->second));
+      return LazyFileSystem::Read(path);
+    }
+
+    void Write(const std::string& path, std::istream& content)
+    {
+      if (path.compare(0, 9, "published") != 0)
+        return;
+      std::stringstream data;
+      data << content.rdbuf();
+      published[path] = data.str();
+    }
+
+    void Move(const std::string& fromPath, const std::string& toPath)
+    {
+      if (published.count(fromPath))
+      {
+        published[toPath] = published[fromPath];
+        published.erase(fromPath);
+      }
+    }
+
+    void Remove(const std::string& path)
+    {
+      published.erase(path);
+    }
+
+    StatResult Stat(const std::string& path) const
+    {
+      if (!published.count(path))
+        return LazyFileSystem::Stat(path);
+      StatResult result;
+      result.exists = true;
+      result.isFile = true;
+      return result;
+    }
+  };
+}
+
+TEST(FilterEngineRulesetTest, PublishedFiltersMatchWithoutEngine)
+{
+  auto fileSystem = std::make_shared<PublishingFileSystem>();
+  JsEngineCreationParameters jsEngineParams;
+  jsEngineParams.fileSystem = fileSystem;
+  jsEngineParams.logSystem.reset(new LazyLogSystem());
+  jsEngineParams.timer.reset(new NoopTimer());
+  jsEngineParams.webRequest.reset(new NoopWebRequest());
+  FilterEnginePtr filterEngine = AdblockPlus::FilterEngine::Create(
+    CreateJsEngine(std::move(jsEngineParams)));
+
+  std::vector<std::string> filters;
+  filters.push_back("/published/*");
+  filters.push_back("##.published");
+  filterEngine->AddFilters(filters);
+  ASSERT_EQ(1u, filterEngine->PublishRuleset("published"));
+
+  AdblockPlus::SharedMatcher matcher(fileSystem, "published");
+  AdblockPlus::MatchResult result = matcher.GetMatchResult(
+    "http://test.org/published/ad.png", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE);
+  EXPECT_EQ(AdblockPlus::Filter::TYPE_BLOCKING, result.type);
+  EXPECT_EQ("/published/*", result.text);
+  std::vector<std::string> selectors = matcher.GetElementHidingSelectors("test.org");
+  EXPECT_NE(selectors.end(), std::find(selectors.begin(), selectors.end(), ".published"));
+
+  filterEngine->RemoveFilters(std::vector<std::string>(1, "/published/*"));
+  ASSERT_EQ(2u, filterEngine->PublishRuleset("published"));
+  EXPECT_TRUE(matcher.Refresh());
+  EXPECT_FALSE(matcher.GetMatchResult("http://test.org/published/ad.png",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE).IsMatch());
+}
+
+TEST(FilterEngineMatcherChunkTest, LargeChangesAreAppliedInChunks)
+{
+  DelayedTimer::SharedTasks timerTasks;
+  JsEngineCreationParameters jsEngineParams;
+  jsEngineParams.fileSystem.reset(new LazyFileSystem());
+  jsEngineParams.logSystem.reset(new LazyLogSystem());
+  jsEngineParams.timer = DelayedTimer::New(timerTasks);
+  jsEngineParams.webRequest.reset(new NoopWebRequest());
+  JsEnginePtr jsEngine = CreateJsEngine(std::move(jsEngineParams));
+  AdblockPlus::FilterEngine::CreationParameters createParams;
+  createParams.preconfiguredPrefs.emplace("first_run_subscription_auto_select",
+    jsEngine->NewValue(false));
+  createParams.matcherChunkSize = 2;
+  FilterEnginePtr filterEngine = AdblockPlus::FilterEngine::Create(jsEngine,
+    createParams);
+  DelayedTimer::ProcessImmediateTimers(timerTasks);
+
+  std::vector<std::string> filters;
+  filters.push_back("/chunk1/*");
+  filters.push_back("/chunk2/*");
+  filters.push_back("/chunk3/*");
+  filters.push_back("/chunk4/*");
+  filters.push_back("/chunk5/*");
+  filterEngine->AddFilters(filters);
+  EXPECT_EQ(5u, filterEngine->GetListedFilters().size());
+  EXPECT_TRUE(filterEngine->Matches("http://test.org/chunk1/ad.png",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+  EXPECT_FALSE(filterEngine->Matches("http://test.org/chunk5/ad.png",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+
+  DelayedTimer::ProcessImmediateTimers(timerTasks);
+  for (const auto& filter : filters)
+  {
+    EXPECT_TRUE(filterEngine->Matches("http://test.org" + filter.substr(0, 8) + "ad.png",
+      AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, "")) << filter;
+  }
+}
+
+namespace
+{
+  class AsyncMatchesHelper
+  {
+  public:
+    AsyncMatchesHelper() : calls(0)
+    {
+    }
+
+    AdblockPlus::FilterEngine::MatchesCallback Callback()
+    {
+      return [this](AdblockPlus::FilterPtr&& filter)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(filter ? filter->GetProperty("text").AsString() : "");
+        ++calls;
+        cv.notify_one();
+      };
+    }
+
+    std::vector<std::string> Wait(size_t expectedCalls)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait_for(lock, std::chrono::seconds(5), [this, expectedCalls]()->bool
+      {
+        return calls >= expectedCalls;
+      });
+      return results;
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::string> results;
+    size_t calls;
+  };
+}
+
+TEST_F(FilterEngineTest, MatchesAsync)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  filterEngine->GetFilter("@@||example.com^$document").AddToList();
+  std::vector<std::string> noDocuments;
+  std::vector<std::string> whitelistedDocument;
+  whitelistedDocument.push_back("http://example.com/");
+
+  AsyncMatchesHelper helper;
+  filterEngine->MatchesAsync("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments, helper.Callback());
+  filterEngine->MatchesAsync("http://example.org/image.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments, helper.Callback());
+  filterEngine->MatchesAsync("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, whitelistedDocument, helper.Callback());
+  std::vector<std::string> results = helper.Wait(3);
+  ASSERT_EQ(3u, results.size());
+  ASSERT_EQ("adbanner.gif", results[0]);
+  ASSERT_EQ("", results[1]);
+  ASSERT_EQ("@@||example.com^$document", results[2]);
+}
+
+TEST_F(FilterEngineTest, MatchesAsyncCoalescesIdenticalRequests)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  std::vector<std::string> noDocuments;
+
+  AsyncMatchesHelper helper;
+  for (int i = 0; i < 10; i++)
+  {
+    filterEngine->MatchesAsync("http://example.org/adbanner.gif",
+      AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments, helper.Callback());
+  }
+  std::vector<std::string> results = helper.Wait(10);
+  ASSERT_EQ(10u, results.size());
+  for (const auto& result : results)
+    ASSERT_EQ("adbanner.gif", result);
+}
+
+TEST_F(FilterEngineTest, GetMatchResultWhileFiltersChange)
+{
+  // Same as the stress command of the shell: the filters changed while
+  // matching never match the URL, so every result has to stay the same.
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  const std::vector<std::string> documentUrls(1, "http://example.org/");
+
+  std::atomic<bool> done(false);
+  std::atomic<int> inconsistent(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++)
+  {
+    threads.push_back(std::thread([this, &done, &inconsistent, &documentUrls]
+    {
+      while (!done)
+      {
+        MatchResult result = filterEngine->GetMatchResult(
+          "http://example.org/adbanner.gif",
+          AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, documentUrls);
+        if (result.type != Filter::TYPE_BLOCKING || result.text != "adbanner.gif")
+          inconsistent++;
+      }
+    }));
+  }
+  for (int i = 0; i < 100; i++)
+  {
+    Filter filter = filterEngine->GetFilter("||stress" + std::to_string(i) + ".invalid^");
+    filter.AddToList();
+    filter.RemoveFromList();
+  }
+  done = true;
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(0, inconsistent);
+}
+
+TEST_F(FilterEngineTest, MatchesAsyncCallbacksAreIsolated)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  std::vector<std::string> noDocuments;
+
+  // Block the worker, so that the requests below are coalesced.
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool released = false;
+  filterEngine->MatchesAsync("http://example.org/first.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments,
+    [&](AdblockPlus::FilterPtr&& filter)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return released; });
+    });
+  AsyncMatchesHelper helper;
+  for (int i = 0; i < 3; i++)
+  {
+    filterEngine->MatchesAsync("http://example.org/adbanner.gif",
+      AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments,
+      [](AdblockPlus::FilterPtr&& filter)
+      {
+        throw std::runtime_error("Callback failed");
+      });
+    filterEngine->MatchesAsync("http://example.org/adbanner.gif",
+      AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments, helper.Callback());
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+  }
+  cv.notify_all();
+  std::vector<std::string> results = helper.Wait(3);
+  ASSERT_EQ(3u, results.size());
+  for (const auto& result : results)
+    ASSERT_EQ("adbanner.gif", result);
+}
+
+TEST_F(FilterEngineWithMetricsTest, MatchesAsyncIsCounted)
+{
+  std::vector<std::string> noDocuments;
+  AsyncMatchesHelper helper;
+  filterEngine->MatchesAsync("http://example.org/", AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE,
+    noDocuments, helper.Callback());
+  ASSERT_EQ(1u, helper.Wait(1).size());
+
+  std::map<std::string, uint64_t> counts;
+  for (const auto& entry : filterEngine->GetMetrics())
+    counts[entry.name] = entry.count;
+  ASSERT_EQ(1u, counts["Matches"]);
+}
+
+TEST_F(FilterEngineWithMetricsTest, MatchesBatchCountsEachRequest)
+{
+  std::vector<AdblockPlus::FilterEngine::MatchRequest> requests(3);
+  for (auto& request : requests)
+  {
+    request.url = "http://example.org/";
+    request.contentTypeMask = AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE;
+  }
+  ASSERT_EQ(3u, filterEngine->MatchesBatch(requests).size());
+
+  std::map<std::string, uint64_t> counts;
+  for (const auto& entry : filterEngine->GetMetrics())
+    counts[entry.name] = entry.count;
+  ASSERT_EQ(3u, counts["Matches"]);
+}
+
+TEST_F(FilterEngineTest, DestructionWaitsForMatchesAsyncCallback)
+{
+  filterEngine->GetFilter("adbanner.gif").AddToList();
+  std::vector<std::string> noDocuments;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool entered = false;
+  bool released = false;
+  bool finished = false;
+  filterEngine->MatchesAsync("http://example.org/adbanner.gif",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, noDocuments,
+    [&](FilterPtr&& filter)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      entered = true;
+      cv.notify_all();
+      cv.wait(lock, [&]() { return released; });
+      finished = true;
+    });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return entered; });
+  }
+
+  std::atomic<bool> destroyed(false);
+  std::thread destroyer([&]()
+  {
+    filterEngine.reset();
+    destroyed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(destroyed);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+  }
+  cv.notify_all();
+  destroyer.join();
+  ASSERT_TRUE(destroyed);
+  ASSERT_TRUE(finished);
+}
+
+TEST_F(FilterEngineTest, ElementHidingSelectors)
+{
+  filterEngine->GetFilter("##.generic").AddToList();
+  filterEngine->GetFilter("example.com##.specific").AddToList();
+
+  std::vector<std::string> selectors = filterEngine->GetElementHidingSelectors("example.com");
+  ASSERT_EQ(2u, selectors.size());
+  ASSERT_NE(selectors.end(), std::find(selectors.begin(), selectors.end(), ".generic"));
+  ASSERT_NE(selectors.end(), std::find(selectors.begin(), selectors.end(), ".specific"));
+  selectors = filterEngine->GetElementHidingSelectors("example.org");
+  ASSERT_EQ(1u, selectors.size());
+  ASSERT_EQ(".generic", selectors[0]);
+}
+
+TEST_F(FilterEngineTest, SharedElementHidingSelectorsAreCached)
+{
+  filterEngine->GetFilter("example.com##.specific").AddToList();
+  AdblockPlus::FilterEngine::ElementHidingSelectorsPtr selectors1 =
+    filterEngine->GetSharedElementHidingSelectors("example.com");
+  ASSERT_EQ(1u, selectors1->size());
+  ASSERT_EQ(selectors1, filterEngine->GetSharedElementHidingSelectors("example.com"));
+
+  // Element hiding filter changes invalidate the cache
+  filterEngine->GetFilter("example.com##.another").AddToList();
+  AdblockPlus::FilterEngine::ElementHidingSelectorsPtr selectors2 =
+    filterEngine->GetSharedElementHidingSelectors("example.com");
+  ASSERT_NE(selectors1, selectors2);
+  ASSERT_EQ(2u, selectors2->size());
+  ASSERT_EQ(1u, selectors1->size());
+
+  filterEngine->GetFilter("example.com##.specific").RemoveFromList();
+  ASSERT_EQ(1u, filterEngine->GetSharedElementHidingSelectors("example.com")->size());
+  ASSERT_EQ(*filterEngine->GetSharedElementHidingSelectors("example.com"),
+    filterEngine->GetElementHidingSelectors("example.com"));
+}
+
+TEST_F(FilterEngineWithLazyElemHideIndexingTest, IndexIsBuiltOnFirstUse)
+{
+  filterEngine->GetFilter("##.generic").AddToList();
+  filterEngine->GetFilter("example.com##.specific").AddToList();
+  filterEngine->GetFilter("##.removed").AddToList();
+  filterEngine->GetFilter("##.removed").RemoveFromList();
+  EXPECT_EQ(2u, filterEngine->GetListedFilters().size());
+
+  std::vector<std::string> selectors = filterEngine->GetElementHidingSelectors("example.com");
+  ASSERT_EQ(2u, selectors.size());
+  EXPECT_NE(selectors.end(), std::find(selectors.begin(), selectors.end(), ".generic"));
+  EXPECT_NE(selectors.end(), std::find(selectors.begin(), selectors.end(), ".specific"));
+
+  // Later changes are indexed right away.
+  filterEngine->GetFilter("example.com##.specific").RemoveFromList();
+  selectors = filterEngine->GetElementHidingSelectors("example.com");
+  ASSERT_EQ(1u, selectors.size());
+  EXPECT_EQ(".generic", selectors[0]);
+}
+
+TEST_F(FilterEngineWithoutElemHideIndexingTest, FiltersAreKeptListed)
+{
+  filterEngine->GetFilter("##.generic").AddToList();
+  filterEngine->GetFilter("/ad.png").AddToList();
+  EXPECT_EQ(2u, filterEngine->GetListedFilters().size());
+  EXPECT_TRUE(filterEngine->GetElementHidingSelectors("example.com").empty());
+  EXPECT_TRUE(filterEngine->Matches("http://example.com/ad.png",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+}
+
+TEST_F(FilterEngineWithUnloadingTest, DisabledSubscriptionsAreUnloaded)
+{
+  JsEnginePtr jsEngine = filterEngine->GetJsEngine();
+  const std::string url = "https://example.com/list.txt";
+  Subscription subscription = filterEngine->GetSubscription(url);
+  subscription.AddToList();
+  jsEngine->Evaluate("var subscription = require('subscriptionClasses').Subscription.fromURL('" + url + "');"
+    "var Filter = require('filterClasses').Filter;"
+    "require('filterStorage').FilterStorage.updateSubscriptionFilters(subscription,"
+    "  [Filter.fromText('/ad.png'), Filter.fromText('##.ad')]);");
+  ASSERT_TRUE(filterEngine->Matches("http://example.com/ad.png",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+
+  auto findStats = [this, &url]() -> AdblockPlus::FilterEngine::SubscriptionStats
+  {
+    for (const auto& stats : filterEngine->GetStats().subscriptions)
+    {
+      if (stats.url == url)
+        return stats;
+    }
+    throw std::runtime_error("Subscription not found");
+  };
+  AdblockPlus::FilterEngine::SubscriptionStats loadedStats = findStats();
+  EXPECT_FALSE(loadedStats.unloaded);
+  EXPECT_EQ(2u, loadedStats.filterCount);
+
+  subscription.SetDisabled(true);
+  AdblockPlus::FilterEngine::SubscriptionStats unloadedStats = findStats();
+  EXPECT_TRUE(unloadedStats.disabled);
+  EXPECT_TRUE(unloadedStats.unloaded);
+  EXPECT_EQ(2u, unloadedStats.filterCount);
+  EXPECT_LT(unloadedStats.approximateSize, loadedStats.approximateSize);
+  EXPECT_EQ(0u, subscription.GetProperty("filters").AsList().size());
+  EXPECT_FALSE(filterEngine->Matches("http://example.com/ad.png",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+
+  subscription.SetDisabled(false);
+  EXPECT_FALSE(findStats().unloaded);
+  EXPECT_EQ(2u, subscription.GetProperty("filters").AsList().size());
+  EXPECT_TRUE(filterEngine->Matches("http://example.com/ad.png",
+    AdblockPlus::FilterEngine::CONTENT_TYPE_IMAGE, ""));
+}
+
+TEST_F(FilterEngineTest, LazyModulesAreEvaluatedOnFirstUse)
+{
+  AdblockPlus::JsEnginePtr jsEngine = filterEngine->GetJsEngine();
+  ASSERT_FALSE(jsEngine->Evaluate("'notification' in require.scopes").AsBool());
+  ASSERT_FALSE(jsEngine->Evaluate("'updater' in require.scopes").AsBool());
+
+  filterEngine->SetShowNotificationCallback([](AdblockPlus::Notification&&) {});
+  ASSERT_TRUE(jsEngine->Evaluate("'notification' in require.scopes").AsBool());
+  ASSERT_FALSE(jsEngine->Evaluate("'updater' in require.scopes").AsBool());
+
+  filterEngine->SetUpdateAvailableCallback([](const std::string&) {});
+  ASSERT_TRUE(jsEngine->Evaluate("'updater' in require.scopes").AsBool());
+  ASSERT_TRUE(jsEngine->Evaluate("typeof require('updater').checkForUpdates == 'function'").AsBool());
+}
+
+TEST_F(FilterEngineWithFiltersLoadedCallbackTest, CallbackIsCalledBeforeCreationCompletes)
+{
+  ASSERT_EQ(2u, calls.size());
+  ASSERT_EQ("filtersLoaded", calls[0]);
+  ASSERT_EQ("created", calls[1]);
+}
+
 TEST_F(FilterEngineTest, FirstRunFlag)
 {
   ASSERT_FALSE(filterEngine->IsFirstRun());
@@ -698,6 +1949,29 @@ TEST_F(FilterEngineTest, DocumentWhitelisting)
       documentUrls1));
 }
 
+TEST_F(FilterEngineTest, CachedWhitelistingFollowsFilterChanges)
+{
+  std::vector<std::string> documentUrls;
+  documentUrls.push_back("http://example.com/frame.html");
+  documentUrls.push_back("http://example.de");
+  ASSERT_FALSE(filterEngine->IsDocumentWhitelisted(
+      "http://example.org/ad.html", documentUrls));
+  ASSERT_EQ(1u, filterEngine->GetStats().whitelistCacheSize);
+
+  filterEngine->GetFilter("@@||example.com^$document").AddToList();
+  ASSERT_TRUE(filterEngine->IsDocumentWhitelisted(
+      "http://example.org/ad.html", documentUrls));
+  ASSERT_TRUE(filterEngine->IsDocumentWhitelisted(
+      "http://example.org/ad.html", documentUrls));
+  ASSERT_FALSE(filterEngine->IsElemhideWhitelisted(
+      "http://example.org/ad.html", documentUrls));
+  ASSERT_EQ(2u, filterEngine->GetStats().whitelistCacheSize);
+
+  filterEngine->RemoveFilters(std::vector<std::string>(1, "@@||example.com^$document"));
+  ASSERT_FALSE(filterEngine->IsDocumentWhitelisted(
+      "http://example.org/ad.html", documentUrls));
+}
+
 TEST_F(FilterEngineTest, ElemhideWhitelisting)
 {
   filterEngine->GetFilter("@@||example.org^$elemhide").AddToList();
@@ -0,0 +1,121 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "../src/FilterHitStatistics.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  typedef std::vector<FilterHitStatistics::Entry> EntryList;
+
+  void SortByText(EntryList& entries)
+  {
+    std::sort(entries.begin(), entries.end(),
+      [](const FilterHitStatistics::Entry& a, const FilterHitStatistics::Entry& b)
+      {
+        return a.text < b.text;
+      });
+  }
+}
+
+TEST(FilterHitStatisticsTest, CollectReturnsNewMatches)
+{
+  FilterHitStatistics statistics;
+  MatcherFilterPtr ads = MatcherFilter::FromText("ads");
+  MatcherFilterPtr tracker = MatcherFilter::FromText("@@tracker");
+  ASSERT_TRUE(statistics.Collect().empty());
+
+  statistics.Record(ads);
+  statistics.Record(tracker);
+  statistics.Record(ads);
+  EntryList entries = statistics.Collect();
+  SortByText(entries);
+  ASSERT_EQ(2u, entries.size());
+  ASSERT_EQ("@@tracker", entries[0].text);
+  ASSERT_EQ(1u, entries[0].hitCount);
+  ASSERT_EQ("ads", entries[1].text);
+  ASSERT_EQ(2u, entries[1].hitCount);
+  ASSERT_LT(0, entries[1].lastHit);
+  ASSERT_TRUE(statistics.Collect().empty());
+
+  statistics.Record(ads);
+  entries = statistics.Collect();
+  ASSERT_EQ(1u, entries.size());
+  ASSERT_EQ("ads", entries[0].text);
+  ASSERT_EQ(1u, entries[0].hitCount);
+}
+
+TEST(FilterHitStatisticsTest, GetTopSortsByHitCount)
+{
+  FilterHitStatistics statistics;
+  MatcherFilterPtr a = MatcherFilter::FromText("a");
+  MatcherFilterPtr b = MatcherFilter::FromText("b");
+  MatcherFilterPtr c = MatcherFilter::FromText("c");
+  statistics.Record(b);
+  statistics.Record(c);
+  statistics.Record(c);
+  statistics.Record(a);
+  statistics.Collect();
+  statistics.Record(c);
+
+  EntryList top = statistics.GetTop(2);
+  ASSERT_EQ(2u, top.size());
+  ASSERT_EQ("c", top[0].text);
+  ASSERT_EQ(3u, top[0].hitCount);
+  ASSERT_EQ("a", top[1].text);
+  ASSERT_EQ(1u, top[1].hitCount);
+  ASSERT_EQ(3u, statistics.GetTop(10).size());
+
+  // Taken by GetTop(), but not collected yet.
+  EntryList entries = statistics.Collect();
+  ASSERT_EQ(1u, entries.size());
+  ASSERT_EQ("c", entries[0].text);
+  ASSERT_EQ(1u, entries[0].hitCount);
+}
+
+TEST(FilterHitStatisticsTest, CountsConcurrentMatches)
+{
+  FilterHitStatistics statistics;
+  MatcherFilterPtr filter = MatcherFilter::FromText("ads");
+  const int threadCount = 4;
+  const int matchCount = 1000;
+  uint64_t collected = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.push_back(std::thread([&statistics, &filter]
+    {
+      for (int j = 0; j < matchCount; j++)
+        statistics.Record(filter);
+    }));
+  }
+  for (int i = 0; i < 10; i++)
+  {
+    for (const auto& entry : statistics.Collect())
+      collected += entry.hitCount;
+  }
+  for (auto& thread : threads)
+    thread.join();
+  for (const auto& entry : statistics.Collect())
+    collected += entry.hitCount;
+  ASSERT_EQ(static_cast<uint64_t>(threadCount * matchCount), collected);
+}
@@ -74,3 +74,16 @@ TEST_F(GlobalJsObjectTest, TimeoutDoesNotKeepJsEngine)
   jsEngine.reset();
   EXPECT_FALSE(weakJsEngine.lock());
 }
+
+TEST_F(GlobalJsObjectTest, ClearTimeout)
+{
+  jsEngine->Evaluate("foo = []");
+  jsEngine->Evaluate("var id1 = setTimeout(function() {foo.push('1');}, 100)");
+  jsEngine->Evaluate("var id2 = setTimeout(function() {foo.push('2');}, 100)");
+  ASSERT_TRUE(jsEngine->Evaluate("typeof id1 == 'number' && id1 != id2").AsBool());
+  jsEngine->Evaluate("clearTimeout(id1)");
+  // Unknown IDs are ignored.
+  jsEngine->Evaluate("clearTimeout(id1); clearTimeout(undefined)");
+  AdblockPlus::Sleep(200);
+  ASSERT_EQ("2", jsEngine->Evaluate("this.foo").AsString());
+}
@@ -15,8 +15,12 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include "BaseJsTest.h"
+#include "../src/JsContext.h"
 
 using namespace AdblockPlus;
 
@@ -162,6 +166,264 @@ TEST_F(JsEngineTest, EventCallbacks)
   ASSERT_FALSE(callbackCalled);
 }
 
+TEST_F(JsEngineTest, EvaluateCached)
+{
+  const std::string source = "(function(x) { return x * 2; })(21)";
+  std::string cachedData;
+  ASSERT_EQ(42, jsEngine->EvaluateCached(source, "test.js", cachedData).AsInt());
+  ASSERT_FALSE(cachedData.empty());
+
+  // Valid compilation data is reused as is
+  std::string previousData = cachedData;
+  ASSERT_EQ(42, jsEngine->EvaluateCached(source, "test.js", cachedData).AsInt());
+  ASSERT_EQ(previousData, cachedData);
+
+  std::string unusedData;
+  ASSERT_ANY_THROW(jsEngine->EvaluateCached("doesnotexist", "test.js", unusedData));
+  ASSERT_ANY_THROW(jsEngine->EvaluateCached("(", "test.js", unusedData));
+}
+
+TEST_F(JsEngineTest, EvaluateStatic)
+{
+  ASSERT_EQ(42, jsEngine->EvaluateStatic("(function(x) { return x * 2; })(21)", "test.js").AsInt());
+  // Non-ASCII sources are copied
+  ASSERT_EQ("\xC3\xA9", jsEngine->EvaluateStatic("'\xC3\xA9'", "test.js").AsString());
+
+  std::string cachedData;
+  ASSERT_EQ(3, jsEngine->EvaluateStatic("1 + 2", "test.js", &cachedData).AsInt());
+  ASSERT_FALSE(cachedData.empty());
+  ASSERT_ANY_THROW(jsEngine->EvaluateStatic("(", "test.js"));
+}
+
+TEST_F(JsEngineTest, ApiFunctions)
+{
+  jsEngine->Evaluate("var API = {answer: function(x) { return x * 2; }, value: 1};");
+  auto function = jsEngine->GetApiFunction("answer");
+  ASSERT_TRUE(function.IsFunction());
+  ASSERT_EQ(42, function.Call(jsEngine->NewValue(21)).AsInt());
+
+  // The resolved function is cached
+  jsEngine->Evaluate("API.answer = function(x) { return x; };");
+  ASSERT_EQ(42, jsEngine->GetApiFunction("answer").Call(jsEngine->NewValue(21)).AsInt());
+
+  ASSERT_THROW(jsEngine->GetApiFunction("value"), std::runtime_error);
+  ASSERT_THROW(jsEngine->GetApiFunction("doesnotexist"), std::runtime_error);
+}
+
+TEST_F(JsEngineTest, StoredValues)
+{
+  ASSERT_EQ(0u, jsEngine->GetStoredJsValuesCount());
+  JsValueList values;
+  values.push_back(jsEngine->NewValue("foo"));
+  values.push_back(jsEngine->NewValue(12));
+  auto id1 = jsEngine->StoreJsValues(values);
+  auto id2 = jsEngine->StoreJsValues(JsValueList());
+  ASSERT_EQ(2u, jsEngine->GetStoredJsValuesCount());
+
+  auto taken = jsEngine->TakeJsValues(id1);
+  ASSERT_EQ(2u, taken.size());
+  ASSERT_EQ("foo", taken[0].AsString());
+  ASSERT_EQ(12, taken[1].AsInt());
+  ASSERT_EQ(1u, jsEngine->GetStoredJsValuesCount());
+  ASSERT_ANY_THROW(jsEngine->TakeJsValues(id1));
+
+  // The slot is reused, the old ID stays invalid.
+  auto id3 = jsEngine->StoreJsValues(values);
+  ASSERT_ANY_THROW(jsEngine->TakeJsValues(id1));
+  ASSERT_EQ(0u, jsEngine->TakeJsValues(id2).size());
+  ASSERT_EQ("foo", jsEngine->TakeJsValues(id3)[0].AsString());
+  ASSERT_EQ(0u, jsEngine->GetStoredJsValuesCount());
+}
+
+TEST_F(JsEngineTest, MemoryStats)
+{
+  AdblockPlus::JsEngine::MemoryStats stats = jsEngine->GetMemoryStats();
+  ASSERT_GT(stats.usedHeapSize, 0u);
+  ASSERT_LE(stats.usedHeapSize, stats.totalHeapSize);
+  ASSERT_EQ(0u, stats.storedJsValuesCount);
+  ASSERT_EQ(0u, stats.pendingTimerCount);
+  size_t jsValueCount = stats.jsValueCount;
+
+  {
+    AdblockPlus::JsValue value = jsEngine->NewValue("foo");
+    AdblockPlus::JsValue copy = value;
+    AdblockPlus::JsValue moved = std::move(value);
+    ASSERT_EQ(jsValueCount + 2, jsEngine->GetMemoryStats().jsValueCount);
+    jsEngine->StoreJsValues(JsValueList());
+    ASSERT_EQ(1u, jsEngine->GetMemoryStats().storedJsValuesCount);
+  }
+  ASSERT_EQ(jsValueCount, jsEngine->GetMemoryStats().jsValueCount);
+}
+
+namespace
+{
+  v8::Handle<v8::Value> ReturnArgumentCount(const v8::Arguments& arguments)
+  {
+    return v8::Integer::New(arguments.Length());
+  }
+}
+
+TEST_F(JsEngineTest, CollectedCallbacksAreReleased)
+{
+  size_t callbackCount = jsEngine->GetMemoryStats().callbackCount;
+  {
+    AdblockPlus::JsValue callback = jsEngine->NewCallback(::ReturnArgumentCount);
+    ASSERT_EQ(callbackCount + 1, jsEngine->GetMemoryStats().callbackCount);
+    ASSERT_EQ(2, callback.Call(JsValueList{jsEngine->NewValue(1),
+      jsEngine->NewValue(2)}).AsInt());
+  }
+  for (int i = 0; i < 100; i++)
+    jsEngine->NewCallback(::ReturnArgumentCount);
+  ASSERT_EQ(callbackCount + 101, jsEngine->GetMemoryStats().callbackCount);
+  jsEngine->NotifyMemoryPressure(AdblockPlus::JsEngine::MEMORY_PRESSURE_CRITICAL);
+  ASSERT_EQ(callbackCount, jsEngine->GetMemoryStats().callbackCount);
+}
+
+TEST_F(JsEngineTest, MemoryPressure)
+{
+  std::vector<int64_t> levels;
+  jsEngine->SetEventCallback("_memoryPressure", [&levels](JsValueList&& params)
+  {
+    levels.push_back(params.at(0).AsInt());
+  });
+  jsEngine->NotifyMemoryPressure(AdblockPlus::JsEngine::MEMORY_PRESSURE_MODERATE);
+  jsEngine->NotifyMemoryPressure(AdblockPlus::JsEngine::MEMORY_PRESSURE_CRITICAL);
+  ASSERT_EQ(2u, levels.size());
+  ASSERT_EQ(AdblockPlus::JsEngine::MEMORY_PRESSURE_MODERATE, levels[0]);
+  ASSERT_EQ(AdblockPlus::JsEngine::MEMORY_PRESSURE_CRITICAL, levels[1]);
+  jsEngine->RemoveEventCallback("_memoryPressure");
+}
+
+TEST_F(JsEngineTest, CpuProfile)
+{
+  ASSERT_THROW(jsEngine->StopCpuProfile(), std::runtime_error);
+  jsEngine->StartCpuProfile();
+  ASSERT_THROW(jsEngine->StartCpuProfile(), std::runtime_error);
+  jsEngine->Evaluate("function busy() { var x = 0; for (var i = 0; i < 100000; i++) x += i; return x; } busy();");
+  std::string profile = jsEngine->StopCpuProfile();
+  ASSERT_EQ(0u, profile.find("{\"head\":{\"id\":"));
+  ASSERT_NE(std::string::npos, profile.find("\"samples\":["));
+  ASSERT_EQ('}', profile[profile.size() - 1]);
+  ASSERT_THROW(jsEngine->StopCpuProfile(), std::runtime_error);
+}
+
+TEST_F(JsEngineTest, WriteHeapSnapshot)
+{
+  class SnapshotFileSystem : public LazyFileSystem
+  {
+  public:
+    std::string path;
+    std::string content;
+
+    void Write(const std::string& path, std::istream& data)
+    {
+      this->path = path;
+      std::stringstream content;
+      content << data.rdbuf();
+      this->content = content.str();
+    }
+  };
+  auto fileSystem = std::make_shared<SnapshotFileSystem>();
+  jsEngine->SetFileSystem(fileSystem);
+  jsEngine->WriteHeapSnapshot("test.heapsnapshot");
+  ASSERT_EQ("test.heapsnapshot", fileSystem->path);
+  ASSERT_EQ(0u, fileSystem->content.find("{\"snapshot\":"));
+}
+
+TEST_F(JsEngineTest, LockMetrics)
+{
+  jsEngine->Evaluate("1");
+  std::vector<LatencyMetrics> metrics = jsEngine->GetLockMetrics();
+  ASSERT_EQ(2u * AdblockPlus::JsEngine::LOCK_SITE_COUNT, metrics.size());
+  ASSERT_EQ("ApiLockWait", metrics[0].name);
+  ASSERT_EQ("ApiLockHold", metrics[1].name);
+  ASSERT_EQ("TimerLockWait", metrics[2].name);
+  ASSERT_EQ(0u, metrics[0].count);
+
+  jsEngine->SetLockMetricsEnabled(true);
+  {
+    // Only the outermost context is measured.
+    const JsContext context(*jsEngine);
+    jsEngine->Evaluate("1");
+    jsEngine->Evaluate("2");
+  }
+  metrics = jsEngine->GetLockMetrics();
+  ASSERT_EQ(1u, metrics[0].count);
+  ASSERT_EQ(1u, metrics[1].count);
+  ASSERT_EQ(0u, metrics[2].count);
+
+  jsEngine->SetLockMetricsEnabled(false);
+  jsEngine->ResetLockMetrics();
+  jsEngine->Evaluate("1");
+  ASSERT_EQ(0u, jsEngine->GetLockMetrics()[0].count);
+}
+
+TEST_F(JsEngineTest, OperationCounts)
+{
+  auto function = jsEngine->Evaluate("(function() {})");
+  AdblockPlus::JsEngine::OperationCounts start = jsEngine->GetOperationCounts();
+  ASSERT_LE(1u, start.contextEntries);
+  ASSERT_LE(1u, start.scriptCompilations);
+  {
+    // Only the outermost context enters the engine.
+    const JsContext context(*jsEngine);
+    jsEngine->Evaluate("1");
+    jsEngine->Evaluate("2");
+    function.Call();
+  }
+  AdblockPlus::JsEngine::OperationCounts counts = jsEngine->GetOperationCounts();
+  ASSERT_EQ(start.contextEntries + 1, counts.contextEntries);
+  ASSERT_EQ(start.scriptCompilations + 2, counts.scriptCompilations);
+  ASSERT_EQ(start.functionCalls + 1, counts.functionCalls);
+}
+
+TEST_F(JsEngineTest, ApiCallsEnterBeforeBackgroundCallbacks)
+{
+  jsEngine->SetApiPriority(std::chrono::seconds(10));
+  uint64_t deferred = jsEngine->GetOperationCounts().deferredBackgroundEntries;
+  std::mutex orderMutex;
+  std::vector<std::string> order;
+  std::thread apiThread;
+  std::thread timerThread;
+  {
+    const JsContext context(*jsEngine);
+    apiThread = std::thread([this, &orderMutex, &order]()
+    {
+      const JsContext apiContext(*jsEngine);
+      std::lock_guard<std::mutex> lock(orderMutex);
+      order.push_back("api");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    timerThread = std::thread([this, &orderMutex, &order]()
+    {
+      const JsContext timerContext(*jsEngine, AdblockPlus::JsEngine::LOCK_SITE_TIMER);
+      std::lock_guard<std::mutex> lock(orderMutex);
+      order.push_back("timer");
+    });
+    auto start = std::chrono::steady_clock::now();
+    while (jsEngine->GetOperationCounts().deferredBackgroundEntries == deferred &&
+        std::chrono::steady_clock::now() - start < std::chrono::seconds(10))
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  apiThread.join();
+  timerThread.join();
+  ASSERT_EQ(2u, order.size());
+  EXPECT_EQ("api", order[0]);
+  EXPECT_EQ("timer", order[1]);
+  EXPECT_EQ(deferred + 1, jsEngine->GetOperationCounts().deferredBackgroundEntries);
+}
+
+TEST_F(JsEngineTest, GcWithDeadline)
+{
+  jsEngine->Evaluate("var garbage = []; for (var i = 0; i < 10000; i++) garbage.push({i: i}); garbage = null;");
+  ASSERT_FALSE(jsEngine->Gc(std::chrono::steady_clock::now() - std::chrono::seconds(1)));
+  auto start = std::chrono::steady_clock::now();
+  while (!jsEngine->Gc(std::chrono::steady_clock::now() + std::chrono::milliseconds(50)))
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+}
+
 TEST(NewJsEngineTest, CallbackGetSet)
 {
   AdblockPlus::JsEnginePtr jsEngine(AdblockPlus::JsEngine::New());
@@ -188,3 +450,29 @@ TEST(NewJsEngineTest, GlobalPropertyTest)
   ASSERT_EQ(foo.AsString(), "bar");
 }
 
+TEST(NewJsEngineTest, NearHeapLimitCallback)
+{
+  std::atomic<bool> called(false);
+  std::atomic<bool> calledDuringEvaluate(false);
+  std::thread::id evaluatingThread = std::this_thread::get_id();
+  AdblockPlus::HeapLimits heapLimits;
+  heapLimits.maxOldSpaceSize = 128 * 1024 * 1024;
+  heapLimits.nearHeapLimitRatio = 0.05;
+  heapLimits.nearHeapLimitCallback = [&](size_t usedHeapSize, size_t heapSizeLimit)
+  {
+    // Not called from within the garbage collection.
+    if (std::this_thread::get_id() == evaluatingThread)
+      calledDuringEvaluate = true;
+    if (usedHeapSize > heapSizeLimit / 20 && usedHeapSize <= heapSizeLimit)
+      called = true;
+  };
+  auto isolate = std::make_shared<AdblockPlus::ScopedV8Isolate>(heapLimits);
+  AdblockPlus::JsEnginePtr jsEngine(AdblockPlus::JsEngine::New(AdblockPlus::AppInfo(),
+    AdblockPlus::CreateDefaultTimer(), AdblockPlus::CreateDefaultWebRequest(),
+    AdblockPlus::CreateDefaultIoExecutor(), AdblockPlus::ExecutorPtr(), isolate));
+  jsEngine->Evaluate("var items = []; for (var i = 0; i < 300000; i++) items.push({text: 'item ' + i});");
+  for (int i = 0; i < 100 && !called; i++)
+    AdblockPlus::Sleep(10);
+  EXPECT_TRUE(called);
+  EXPECT_FALSE(calledDuringEvaluate);
+}
@@ -16,6 +16,9 @@
  */
 
 #include "BaseJsTest.h"
+#include "../src/JsContext.h"
+#include "../src/JsError.h"
+#include "../src/Utils.h"
 
 namespace
 {
@@ -183,6 +186,20 @@ TEST_F(JsValueTest, ArrayValue)
   ASSERT_ANY_THROW(value.Call());
 }
 
+TEST_F(JsValueTest, StringVector)
+{
+  auto value = jsEngine->Evaluate("['foo', 8, 'b\\u00e4r']");
+  std::vector<std::string> expected{"foo", "8", "b\xC3\xA4r"};
+  ASSERT_EQ(expected, value.AsStringVector());
+
+  std::vector<std::string> result{"x", "y", "z", "w"};
+  value.AsStringVector(result);
+  ASSERT_EQ(expected, result);
+  ASSERT_GE(result.capacity(), 4u);
+
+  ASSERT_ANY_THROW(jsEngine->NewValue("foo").AsStringVector());
+}
+
 TEST_F(JsValueTest, FunctionValue)
 {
   auto value = jsEngine->Evaluate("(function(foo, bar) {return this.x + '/' + foo + '/' + bar;})");
@@ -211,6 +228,26 @@ TEST_F(JsValueTest, JsValueCallSingleArg)
   EXPECT_EQ(10, func.Call(jsEngine->NewValue(5)).AsInt());
 }
 
+TEST_F(JsValueTest, LocalCall)
+{
+  jsEngine->Evaluate("var API = {join: function(a, b) {return a + '/' + b;},"
+    " fail: function() {throw new Error('failed');}};");
+  size_t jsValueCount = jsEngine->GetMemoryStats().jsValueCount;
+  {
+    const AdblockPlus::JsContext context(*jsEngine);
+    v8::Local<v8::Value> result = context.Call(context.GetApiFunction("join"),
+      context.NewString("foo"), context.NewString("bar"));
+    ASSERT_EQ("foo/bar", AdblockPlus::Utils::FromV8String(result));
+    ASSERT_EQ(jsValueCount, jsEngine->GetMemoryStats().jsValueCount);
+
+    AdblockPlus::JsValue value = context.Wrap(result);
+    ASSERT_EQ(jsValueCount + 1, jsEngine->GetMemoryStats().jsValueCount);
+    ASSERT_EQ("foo/bar", value.AsString());
+    ASSERT_THROW(context.Call(context.GetApiFunction("fail")), AdblockPlus::JsError);
+  }
+  ASSERT_EQ(jsValueCount, jsEngine->GetMemoryStats().jsValueCount);
+}
+
 TEST_F(JsValueTest, ThrowingCoversion)
 {
   const std::string source("\
@@ -0,0 +1,69 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../src/LatencyHistogram.h"
+
+using namespace AdblockPlus;
+
+TEST(LatencyHistogramTest, Buckets)
+{
+  ASSERT_EQ(0, LatencyHistogram::GetBucket(0));
+  ASSERT_EQ(1, LatencyHistogram::GetBucket(1));
+  ASSERT_EQ(2, LatencyHistogram::GetBucket(2));
+  ASSERT_EQ(2, LatencyHistogram::GetBucket(3));
+  ASSERT_EQ(11, LatencyHistogram::GetBucket(1024));
+  ASSERT_EQ(LatencyHistogram::BUCKET_COUNT - 1,
+    LatencyHistogram::GetBucket(UINT64_MAX));
+}
+
+TEST(LatencyHistogramTest, RecordAndReset)
+{
+  LatencyHistogram histogram;
+  histogram.Record(std::chrono::microseconds(3));
+  histogram.Record(std::chrono::microseconds(100));
+  histogram.Record(std::chrono::nanoseconds(10));
+
+  LatencyMetrics metrics = histogram.GetMetrics("test");
+  ASSERT_EQ("test", metrics.name);
+  ASSERT_EQ(3u, metrics.count);
+  ASSERT_EQ(103u, metrics.totalMicroseconds);
+  ASSERT_EQ(100u, metrics.maxMicroseconds);
+  ASSERT_EQ(static_cast<size_t>(LatencyHistogram::BUCKET_COUNT), metrics.histogram.size());
+  ASSERT_EQ(1u, metrics.histogram[0]);
+  ASSERT_EQ(1u, metrics.histogram[2]);
+  ASSERT_EQ(1u, metrics.histogram[7]);
+
+  histogram.Reset();
+  metrics = histogram.GetMetrics("test");
+  ASSERT_EQ(0u, metrics.count);
+  ASSERT_EQ(0u, metrics.maxMicroseconds);
+  ASSERT_EQ(0u, metrics.histogram[7]);
+}
+
+TEST(LatencyHistogramTest, ScopedLatency)
+{
+  LatencyHistogram histogram;
+  {
+    ScopedLatency latency(&histogram);
+  }
+  {
+    ScopedLatency latency(nullptr);
+  }
+  ASSERT_EQ(1u, histogram.GetMetrics("test").count);
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../src/MatchCache.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const int32_t CONTENT_TYPE_IMAGE = 4;
+
+  MatcherFilterPtr MakeFilter(const std::string& text)
+  {
+    return MatcherFilter::FromText(text);
+  }
+}
+
+TEST(MatchCacheTest, LookupAndInsert)
+{
+  MatchCache cache(10);
+  MatcherFilterPtr match = MakeFilter("ads");
+  MatcherFilterPtr result;
+  ASSERT_FALSE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+  cache.Insert("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 0, match);
+  cache.Insert("http://example.com/", CONTENT_TYPE_IMAGE, "", false, 0, MatcherFilterPtr());
+
+  ASSERT_TRUE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+  ASSERT_EQ(match, result);
+  ASSERT_TRUE(cache.Lookup("http://example.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+  ASSERT_FALSE(result);
+  ASSERT_FALSE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE, "http://example.com/", false, 0, result));
+  ASSERT_FALSE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE + 1, "", false, 0, result));
+  ASSERT_EQ(2u, cache.GetHits());
+  ASSERT_EQ(3u, cache.GetMisses());
+}
+
+TEST(MatchCacheTest, EvictsLeastRecentlyUsed)
+{
+  MatchCache cache(2);
+  MatcherFilterPtr result;
+  cache.Insert("http://a.com/", CONTENT_TYPE_IMAGE, "", false, 0, MakeFilter("a"));
+  cache.Insert("http://b.com/", CONTENT_TYPE_IMAGE, "", false, 0, MakeFilter("b"));
+  ASSERT_TRUE(cache.Lookup("http://a.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+  cache.Insert("http://c.com/", CONTENT_TYPE_IMAGE, "", false, 0, MakeFilter("c"));
+  ASSERT_TRUE(cache.Lookup("http://a.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+  ASSERT_FALSE(cache.Lookup("http://b.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+  ASSERT_TRUE(cache.Lookup("http://c.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+  ASSERT_EQ("c", result->GetText());
+}
+
+TEST(MatchCacheTest, GenerationChangeInvalidates)
+{
+  MatchCache cache(10);
+  MatcherFilterPtr result;
+  cache.Insert("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 0, MakeFilter("ads"));
+  ASSERT_TRUE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+  ASSERT_FALSE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 1, result));
+
+  // Results computed with an outdated generation are dropped
+  cache.Insert("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 0, MakeFilter("ads"));
+  ASSERT_FALSE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 1, result));
+  cache.Insert("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 1, MakeFilter("ads"));
+  ASSERT_TRUE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 1, result));
+}
+
+TEST(MatchCacheTest, ZeroCapacity)
+{
+  MatchCache cache(0);
+  MatcherFilterPtr result;
+  cache.Insert("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 0, MakeFilter("ads"));
+  ASSERT_FALSE(cache.Lookup("http://ads.com/", CONTENT_TYPE_IMAGE, "", false, 0, result));
+}
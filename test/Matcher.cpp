@@ -0,0 +1,397 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../src/Matcher.h"
+
+namespace
+{
+  const int32_t CONTENT_TYPE_SCRIPT = 2;
+  const int32_t CONTENT_TYPE_IMAGE = 4;
+  const int32_t CONTENT_TYPE_DOCUMENT = 64;
+
+  class MatcherTest : public ::testing::Test
+  {
+  protected:
+    AdblockPlus::Matcher matcher;
+
+    void SetUp()
+    {
+      AdblockPlus::BaseDomain::PublicSuffixes publicSuffixes;
+      publicSuffixes["com"] = 1;
+      publicSuffixes["org"] = 1;
+      publicSuffixes["co.uk"] = 1;
+      matcher.SetPublicSuffixes(std::move(publicSuffixes));
+    }
+
+    std::string Match(const std::string& url, int32_t contentTypeMask,
+      const std::string& documentUrl = "", bool specificOnly = false)
+    {
+      AdblockPlus::MatcherFilterPtr filter =
+        matcher.CheckFilterMatch(url, contentTypeMask, documentUrl, specificOnly);
+      return filter ? filter->GetText() : "";
+    }
+  };
+}
+
+TEST(MatcherFilterTest, ParsesOptions)
+{
+  auto filter = AdblockPlus::MatcherFilter::FromText("@@foo$script,image,third-party,collapse");
+  ASSERT_TRUE(filter != nullptr);
+  EXPECT_TRUE(filter->IsException());
+  EXPECT_EQ(CONTENT_TYPE_SCRIPT | CONTENT_TYPE_IMAGE, filter->GetContentType());
+  EXPECT_EQ(AdblockPlus::MatcherFilter::THIRD_PARTY_ONLY, filter->GetThirdParty());
+  EXPECT_EQ(AdblockPlus::MatcherFilter::COLLAPSE_ALWAYS, filter->GetCollapse());
+
+  filter = AdblockPlus::MatcherFilter::FromText("foo$~image");
+  ASSERT_TRUE(filter != nullptr);
+  EXPECT_FALSE(filter->IsException());
+  EXPECT_EQ(0, filter->GetContentType() & CONTENT_TYPE_IMAGE);
+  EXPECT_NE(0, filter->GetContentType() & CONTENT_TYPE_SCRIPT);
+  EXPECT_EQ(0, filter->GetContentType() & CONTENT_TYPE_DOCUMENT);
+}
+
+TEST(MatcherFilterTest, RejectsInvalidFilters)
+{
+  EXPECT_TRUE(AdblockPlus::MatcherFilter::FromText("foo$nosuchoption") == nullptr);
+  EXPECT_TRUE(AdblockPlus::MatcherFilter::FromText("/foo(/") == nullptr);
+}
+
+TEST(MatcherFilterTest, KeywordCandidates)
+{
+  auto filter = AdblockPlus::MatcherFilter::FromText("||example.com/ads/*banner^$image");
+  ASSERT_TRUE(filter != nullptr);
+  std::vector<std::string> candidates = filter->GetKeywordCandidates();
+  ASSERT_EQ(3u, candidates.size());
+  EXPECT_EQ("example", candidates[0]);
+  EXPECT_EQ("com", candidates[1]);
+  EXPECT_EQ("ads", candidates[2]);
+
+  filter = AdblockPlus::MatcherFilter::FromText("/banner[0-9]+/");
+  ASSERT_TRUE(filter != nullptr);
+  EXPECT_TRUE(filter->GetKeywordCandidates().empty());
+}
+
+TEST(MatcherFilterTest, RequiredSubstring)
+{
+  auto filter = AdblockPlus::MatcherFilter::FromText("||ad.com^banners*X$image");
+  ASSERT_TRUE(filter != nullptr);
+  EXPECT_EQ("banners", filter->GetRequiredSubstring());
+
+  filter = AdblockPlus::MatcherFilter::FromText("AdX$match-case");
+  ASSERT_TRUE(filter != nullptr);
+  EXPECT_EQ("adx", filter->GetRequiredSubstring());
+
+  filter = AdblockPlus::MatcherFilter::FromText("/banner[0-9]+/");
+  ASSERT_TRUE(filter != nullptr);
+  EXPECT_EQ("", filter->GetRequiredSubstring());
+}
+
+TEST(MatcherFilterTest, SharedData)
+{
+  size_t sharedCount = AdblockPlus::MatcherFilter::GetSharedCount();
+  {
+    auto filter = AdblockPlus::MatcherFilter::FromText("/shared-data/*$image");
+    auto sameFilter = AdblockPlus::MatcherFilter::FromText("/shared-data/*$image");
+    ASSERT_TRUE(filter != nullptr);
+    ASSERT_TRUE(sameFilter != nullptr);
+    EXPECT_EQ(sharedCount + 1, AdblockPlus::MatcherFilter::GetSharedCount());
+    EXPECT_EQ(&filter->GetText(), &sameFilter->GetText());
+    EXPECT_EQ(CONTENT_TYPE_IMAGE, sameFilter->GetContentType());
+
+    // Hits are still counted per instance
+    int64_t lastHit;
+    filter->AddHit(1000);
+    EXPECT_EQ(1u, filter->TakeHits(lastHit));
+    EXPECT_EQ(0u, sameFilter->TakeHits(lastHit));
+
+    EXPECT_FALSE(AdblockPlus::MatcherFilter::FromText("|invalid$foo"));
+    EXPECT_EQ(sharedCount + 1, AdblockPlus::MatcherFilter::GetSharedCount());
+  }
+  EXPECT_EQ(sharedCount, AdblockPlus::MatcherFilter::GetSharedCount());
+}
+
+TEST_F(MatcherTest, Patterns)
+{
+  matcher.Add("|http://start");
+  matcher.Add("end.png|");
+  matcher.Add("foo*bar^baz");
+  matcher.Add("trail^");
+  matcher.Add("||ads.co.uk^");
+  matcher.Add("/ban[0-9]+er/");
+  matcher.Add("CaseSensitive$match-case");
+
+  EXPECT_EQ("|http://start", Match("http://start.com/", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("https://www.example.com/http://start", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("end.png|", Match("http://example.com/end.png", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("http://example.com/end.png?query", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("foo*bar^baz", Match("http://example.com/foo/x/bar/baz", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("http://example.com/foo/x/barxbaz", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("trail^", Match("http://example.com/trail", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("http://example.com/trailer", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("||ads.co.uk^", Match("https://www.ads.co.uk/", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("||ads.co.uk^", Match("https://ads.co.uk:8080/", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("https://badads.co.uk/", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("/ban[0-9]+er/", Match("http://example.com/BAN123ER", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("CaseSensitive$match-case", Match("http://example.com/CaseSensitive", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("http://example.com/casesensitive", CONTENT_TYPE_IMAGE));
+}
+
+TEST_F(MatcherTest, Options)
+{
+  matcher.Add("tpbanner.gif$third-party");
+  matcher.Add("fpbanner.gif$~third-party");
+  matcher.Add("combanner.gif$domain=example.com");
+  matcher.Add("orgbanner.gif$domain=~example.com");
+  matcher.Add("script.js$script");
+
+  EXPECT_EQ("", Match("http://example.org/tpbanner.gif", CONTENT_TYPE_IMAGE, "http://example.org/"));
+  EXPECT_EQ("tpbanner.gif$third-party", Match("http://example.org/tpbanner.gif", CONTENT_TYPE_IMAGE, "http://example.com/"));
+  EXPECT_EQ("fpbanner.gif$~third-party", Match("http://cdn.example.org/fpbanner.gif", CONTENT_TYPE_IMAGE, "http://www.example.org/"));
+  EXPECT_EQ("", Match("http://example.org/fpbanner.gif", CONTENT_TYPE_IMAGE, "http://example.com/"));
+  EXPECT_EQ("combanner.gif$domain=example.com", Match("http://example.org/combanner.gif", CONTENT_TYPE_IMAGE, "http://sub.example.com/"));
+  EXPECT_EQ("", Match("http://example.org/combanner.gif", CONTENT_TYPE_IMAGE, "http://example.org/"));
+  EXPECT_EQ("", Match("http://example.org/orgbanner.gif", CONTENT_TYPE_IMAGE, "http://example.com/"));
+  EXPECT_EQ("orgbanner.gif$domain=~example.com", Match("http://example.org/orgbanner.gif", CONTENT_TYPE_IMAGE, "http://example.org/"));
+  EXPECT_EQ("script.js$script", Match("http://example.org/script.js", CONTENT_TYPE_SCRIPT));
+  EXPECT_EQ("", Match("http://example.org/script.js", CONTENT_TYPE_IMAGE));
+}
+
+TEST(MatcherFilterTest, DomainLists)
+{
+  auto filter = AdblockPlus::MatcherFilter::FromText(
+    "banner.gif$domain=example.com|~sub.example.com|example.org.|~example.com|other.example.com");
+  ASSERT_TRUE(filter != nullptr);
+  EXPECT_FALSE(filter->IsGeneric());
+  // The last entry for a domain applies, trailing dots are ignored.
+  EXPECT_FALSE(filter->IsActiveOnDomain("example.com", ""));
+  EXPECT_FALSE(filter->IsActiveOnDomain("sub.example.com", ""));
+  EXPECT_TRUE(filter->IsActiveOnDomain("other.example.com", ""));
+  EXPECT_TRUE(filter->IsActiveOnDomain("www.Other.Example.com.", ""));
+  EXPECT_TRUE(filter->IsActiveOnDomain("example.org", ""));
+  EXPECT_FALSE(filter->IsActiveOnDomain("example.net", ""));
+  EXPECT_FALSE(filter->IsActiveOnDomain("", ""));
+
+  auto sitekeyFilter = AdblockPlus::MatcherFilter::FromText("@@$document,sitekey=abc|def");
+  ASSERT_TRUE(sitekeyFilter != nullptr);
+  EXPECT_FALSE(sitekeyFilter->IsGeneric());
+  EXPECT_TRUE(sitekeyFilter->IsActiveOnDomain("example.com", "def"));
+  EXPECT_TRUE(sitekeyFilter->IsActiveOnDomain("example.com", "ABC"));
+  EXPECT_FALSE(sitekeyFilter->IsActiveOnDomain("example.com", "ab"));
+  EXPECT_FALSE(sitekeyFilter->IsActiveOnDomain("example.com", ""));
+}
+
+TEST_F(MatcherTest, WhitelistTakesPrecedence)
+{
+  matcher.Add("adbanner.gif");
+  matcher.Add("@@||example.org/adbanner.gif");
+  matcher.Add("@@||example.org^$document");
+
+  EXPECT_EQ("adbanner.gif", Match("http://example.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("@@||example.org/adbanner.gif", Match("http://example.org/adbanner.gif", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("@@||example.org^$document", Match("http://example.org/", CONTENT_TYPE_DOCUMENT));
+  EXPECT_EQ("", Match("http://example.com/", CONTENT_TYPE_DOCUMENT));
+}
+
+TEST_F(MatcherTest, RemoveAndClear)
+{
+  matcher.Add("adbanner.gif");
+  matcher.Add("adbanner.gif");
+  matcher.Add("@@notbanner.gif");
+  matcher.Remove("adbanner.gif");
+  EXPECT_EQ("", Match("http://example.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("@@notbanner.gif", Match("http://example.com/notbanner.gif", CONTENT_TYPE_IMAGE));
+  matcher.Clear();
+  EXPECT_EQ("", Match("http://example.com/notbanner.gif", CONTENT_TYPE_IMAGE));
+}
+
+TEST_F(MatcherTest, SpecificOnly)
+{
+  matcher.Add("adbanner.gif");
+  matcher.Add("ads.png$domain=example.com");
+  EXPECT_EQ("adbanner.gif", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE, "http://example.com/"));
+  EXPECT_EQ("", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE, "http://example.com/", true));
+  EXPECT_EQ("ads.png$domain=example.com", Match("http://ads.com/ads.png", CONTENT_TYPE_IMAGE, "http://example.com/", true));
+
+  // Generic whitelist filters still apply
+  matcher.Add("@@adbanner.gif");
+  matcher.Add("specific.gif$domain=example.com");
+  matcher.Add("@@specific.gif");
+  EXPECT_EQ("@@specific.gif", Match("http://ads.com/specific.gif", CONTENT_TYPE_IMAGE, "http://example.com/", true));
+}
+
+TEST_F(MatcherTest, Commit)
+{
+  matcher.Add("adbanner.gif");
+  EXPECT_EQ("adbanner.gif", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+  matcher.Commit();
+  EXPECT_EQ("adbanner.gif", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+
+  // Changes are visible before they are committed
+  matcher.Add("@@adbanner.gif");
+  EXPECT_EQ("@@adbanner.gif", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+  matcher.Commit();
+  EXPECT_EQ("@@adbanner.gif", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+  matcher.Clear();
+  matcher.Commit();
+  EXPECT_EQ("", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+}
+
+TEST_F(MatcherTest, Updates)
+{
+  matcher.Add("adbanner.gif");
+  matcher.Add("old.gif");
+  uint64_t generation = matcher.GetGeneration();
+
+  matcher.BeginUpdate();
+  EXPECT_TRUE(matcher.IsUpdating());
+  // Lookups use the filters from before the update until it ends
+  matcher.Clear();
+  matcher.Add("adbanner.gif");
+  matcher.Add("new.gif");
+  EXPECT_EQ("adbanner.gif", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("old.gif", Match("http://ads.com/old.gif", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("http://ads.com/new.gif", CONTENT_TYPE_IMAGE));
+
+  // Nested updates are published by the outermost one
+  matcher.BeginUpdate();
+  matcher.EndUpdate();
+  EXPECT_TRUE(matcher.IsUpdating());
+  EXPECT_EQ("", Match("http://ads.com/new.gif", CONTENT_TYPE_IMAGE));
+
+  // Commits during the update don't publish anything either
+  matcher.Commit();
+  EXPECT_EQ("old.gif", Match("http://ads.com/old.gif", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("http://ads.com/new.gif", CONTENT_TYPE_IMAGE));
+
+  matcher.EndUpdate();
+  EXPECT_FALSE(matcher.IsUpdating());
+  EXPECT_LT(generation, matcher.GetGeneration());
+  EXPECT_EQ("adbanner.gif", Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("http://ads.com/old.gif", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("new.gif", Match("http://ads.com/new.gif", CONTENT_TYPE_IMAGE));
+
+  // Unbalanced calls are ignored
+  matcher.EndUpdate();
+  EXPECT_FALSE(matcher.IsUpdating());
+}
+
+TEST_F(MatcherTest, KeywordlessFilters)
+{
+  matcher.Add("&ad=");
+  matcher.Add("ad=");
+  matcher.Add("/ad_");
+  matcher.Add("|ab^$image");
+  matcher.Add("/b[0-9]c/");
+  matcher.Add("@@/ad_$script");
+  matcher.Add("Qz$match-case");
+
+  for (int i = 0; i < 2; i++)
+  {
+    // Results are the same with the index built by Commit()
+    EXPECT_EQ("&ad=", Match("http://example.com/?x&ad=1", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("ad=", Match("http://example.com/?ad=1", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("/ad_", Match("http://example.com/ad_1.png", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("@@/ad_$script", Match("http://example.com/ad_1.js", CONTENT_TYPE_SCRIPT));
+    EXPECT_EQ("|ab^$image", Match("ab://example.com/", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("/b[0-9]c/", Match("http://example.com/b1c", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("Qz$match-case", Match("http://example.com/Qz", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("", Match("http://example.com/qz", CONTENT_TYPE_IMAGE));
+    EXPECT_EQ("", Match("http://example.com/", CONTENT_TYPE_IMAGE));
+    matcher.Commit();
+  }
+
+  matcher.Remove("&ad=");
+  matcher.Commit();
+  EXPECT_EQ("ad=", Match("http://example.com/?x&ad=1", CONTENT_TYPE_IMAGE));
+}
+
+TEST_F(MatcherTest, Prefilter)
+{
+  matcher.EnablePrefilter(0.01, 1024);
+  matcher.Add("||ads.example.com^");
+  matcher.Add("@@||example.com/allowed$image");
+  matcher.Add("/ban[0-9]+er/$script");
+  matcher.Commit();
+
+  EXPECT_EQ("||ads.example.com^", Match("http://ads.example.com/", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("@@||example.com/allowed$image",
+    Match("http://ads.example.com/allowed", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ("", Match("http://www.test.org/", CONTENT_TYPE_IMAGE));
+  // Keywordless filters apply to scripts, those can't be rejected.
+  EXPECT_FALSE(matcher.MayMatch("http://www.test.org/", CONTENT_TYPE_IMAGE));
+  EXPECT_TRUE(matcher.MayMatch("http://www.test.org/", CONTENT_TYPE_SCRIPT));
+  EXPECT_EQ("/ban[0-9]+er/$script", Match("http://www.test.org/ban1er", CONTENT_TYPE_SCRIPT));
+
+  AdblockPlus::Matcher::PrefilterStats stats = matcher.GetPrefilterStats();
+  EXPECT_GT(stats.size, 0u);
+  EXPECT_LE(stats.size, 1024u);
+  EXPECT_GT(stats.falsePositiveRate, 0);
+  EXPECT_LT(stats.falsePositiveRate, 0.01);
+  EXPECT_GE(stats.passedCount, 2u);
+  EXPECT_GE(stats.rejectedCount, 2u);
+
+  // Uncommitted changes bypass the prefilter.
+  matcher.Add("||test.org^");
+  EXPECT_EQ("||test.org^", Match("http://www.test.org/", CONTENT_TYPE_IMAGE));
+  matcher.Commit();
+  EXPECT_EQ("||test.org^", Match("http://www.test.org/", CONTENT_TYPE_IMAGE));
+}
+
+TEST_F(MatcherTest, PrefilterDisabledByDefault)
+{
+  matcher.Add("||ads.example.com^");
+  matcher.Commit();
+  EXPECT_TRUE(matcher.MayMatch("http://www.example.org/", CONTENT_TYPE_IMAGE));
+  EXPECT_EQ(0u, matcher.GetPrefilterStats().size);
+}
+
+TEST_F(MatcherTest, ConcurrentMatching)
+{
+  matcher.Add("adbanner.gif");
+  matcher.Commit();
+
+  std::atomic<bool> done(false);
+  std::atomic<int> mismatches(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++)
+  {
+    threads.push_back(std::thread([this, &done, &mismatches]
+    {
+      while (!done)
+      {
+        if (Match("http://ads.com/adbanner.gif", CONTENT_TYPE_IMAGE) != "adbanner.gif")
+          mismatches++;
+      }
+    }));
+  }
+  for (int i = 0; i < 1000; i++)
+  {
+    matcher.Add("ads" + std::to_string(i) + ".png");
+    if (i % 10 == 0)
+      matcher.Commit();
+  }
+  done = true;
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(0, mismatches);
+  EXPECT_EQ("ads999.png", Match("http://ads.com/ads999.png", CONTENT_TYPE_IMAGE));
+}
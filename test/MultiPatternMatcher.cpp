@@ -0,0 +1,85 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <gtest/gtest.h>
+
+#include "../src/MultiPatternMatcher.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  std::vector<size_t> FindAll(const MultiPatternMatcher& matcher,
+    const std::string& text)
+  {
+    std::vector<size_t> ids;
+    matcher.FindAll(text, ids);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+  }
+}
+
+TEST(MultiPatternMatcherTest, FindsAllOccurrences)
+{
+  MultiPatternMatcher matcher;
+  matcher.Add("he", 0);
+  matcher.Add("she", 1);
+  matcher.Add("his", 2);
+  matcher.Add("hers", 3);
+  matcher.Build();
+  EXPECT_EQ(4u, matcher.GetPatternCount());
+
+  std::vector<size_t> expected;
+  expected.push_back(0);
+  expected.push_back(0);
+  expected.push_back(1);
+  expected.push_back(3);
+  EXPECT_EQ(expected, FindAll(matcher, "ushers he"));
+  EXPECT_TRUE(FindAll(matcher, "xyz").empty());
+  EXPECT_TRUE(FindAll(matcher, "").empty());
+}
+
+TEST(MultiPatternMatcherTest, SharedPatternsAndPrefixes)
+{
+  MultiPatternMatcher matcher;
+  matcher.Add("aaa", 0);
+  matcher.Add("a", 1);
+  matcher.Add("a", 2);
+  matcher.Add("", 3);
+  matcher.Build();
+  EXPECT_EQ(3u, matcher.GetPatternCount());
+
+  std::vector<size_t> expected;
+  expected.push_back(0);
+  expected.push_back(0);
+  for (int i = 0; i < 4; i++)
+  {
+    expected.push_back(1);
+    expected.push_back(2);
+  }
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, FindAll(matcher, "aaaa"));
+}
+
+TEST(MultiPatternMatcherTest, Empty)
+{
+  MultiPatternMatcher matcher;
+  matcher.Build();
+  EXPECT_TRUE(FindAll(matcher, "text").empty());
+}
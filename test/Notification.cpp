@@ -31,6 +31,7 @@ namespace
   {
   protected:
     FilterEnginePtr filterEngine;
+    FilterEngine::CreationParameters createParams;
     void SetUp()
     {
       JsEngineCreationParameters jsEngineParams;
@@ -39,7 +40,7 @@ namespace
       jsEngineParams.timer.reset(new NoopTimer());
       jsEngineParams.webRequest.reset(new NoopWebRequest());
       auto jsEngine = CreateJsEngine(std::move(jsEngineParams));
-      filterEngine = FilterEngine::Create(jsEngine);
+      filterEngine = FilterEngine::Create(jsEngine, createParams);
     }
 
     void AddNotification(const std::string& notification)
@@ -86,6 +87,16 @@ namespace
     }
   };
 
+  class NotificationEvaluationIntervalTest : public NotificationTest
+  {
+  protected:
+    void SetUp()
+    {
+      createParams.notificationEvaluationInterval = 60 * 60 * 1000;
+      NotificationTest::SetUp();
+    }
+  };
+
 #ifdef NotificationMockWebRequestTest_ENABLED
   class NotificationMockWebRequestTest : public BaseJsTest
   {
@@ -203,3 +214,48 @@ TEST_F(NotificationTest, Links)
   EXPECT_EQ("link1", notificationLinks[0]);
   EXPECT_EQ("link2", notificationLinks[1]);
 }
+
+TEST_F(NotificationTest, UrlTargetedNotificationsAreLookedUpByHost)
+{
+  AddNotification("{ id: 'www.de', type: 'question',"
+    "urlFilters:['||www.de^$document']"
+  "}");
+  EXPECT_FALSE(PeekNotification());
+  EXPECT_FALSE(PeekNotification("http://www.com/page.html"));
+
+  auto notification = PeekNotification("http://sub.www.de/page.html");
+  ASSERT_TRUE(notification);
+  EXPECT_EQ(NotificationType::NOTIFICATION_TYPE_QUESTION, notification->GetType());
+}
+
+TEST_F(NotificationEvaluationIntervalTest, CallsWithinIntervalAreSkipped)
+{
+  AddNotification("{ id: 'no-filter', type: 'critical' }");
+  AddNotification("{ id: 'www.de', type: 'question',"
+    "urlFilters:['||www.de$document']"
+  "}");
+  EXPECT_TRUE(PeekNotification());
+  EXPECT_FALSE(PeekNotification());
+
+  // Targeted hosts are evaluated regardless of the interval.
+  auto notification = PeekNotification("http://www.de");
+  ASSERT_TRUE(notification);
+  EXPECT_EQ(NotificationType::NOTIFICATION_TYPE_QUESTION, notification->GetType());
+}
+
+TEST_F(NotificationEvaluationIntervalTest, TargetedHostsMatchWholeLabels)
+{
+  AddNotification("{ id: 'no-filter', type: 'critical' }");
+  AddNotification("{ id: 'example.com', type: 'question',"
+    "urlFilters:['||example.com^$document']"
+  "}");
+  EXPECT_TRUE(PeekNotification());
+
+  // Not a subdomain of a targeted host, so the interval applies.
+  EXPECT_FALSE(PeekNotification("http://example.community.org/"));
+  EXPECT_FALSE(PeekNotification("http://myexample.com/"));
+
+  auto notification = PeekNotification("http://www.example.com/");
+  ASSERT_TRUE(notification);
+  EXPECT_EQ(NotificationType::NOTIFICATION_TYPE_QUESTION, notification->GetType());
+}
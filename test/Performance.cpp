@@ -0,0 +1,213 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "BaseJsTest.h"
+
+using namespace AdblockPlus;
+
+// Counts the allocations of the whole test binary while enabled, only the
+// thread under test is supposed to allocate then.
+namespace
+{
+  std::atomic<bool> countAllocations(false);
+  std::atomic<uint64_t> allocationCount(0);
+}
+
+void* operator new(size_t size)
+{
+  if (countAllocations)
+    ++allocationCount;
+  void* result = std::malloc(size ? size : 1);
+  if (!result)
+    throw std::bad_alloc();
+  return result;
+}
+
+void operator delete(void* pointer) throw()
+{
+  std::free(pointer);
+}
+
+namespace
+{
+  const std::string BLOCKED_URL = "http://example.org/adbanner.gif";
+  const std::string UNMATCHED_URL = "http://example.org/image.gif";
+
+  /**
+   * Asserts upper bounds of operation counts of the hot paths. Timings are
+   * too noisy for that, see `JsEngine::GetOperationCounts()`. Only runs if
+   * the `ABP_PERFORMANCE_TESTS` environment variable is set, e.g.
+   * `ABP_PERFORMANCE_TESTS=1 make test FILTER=PerformanceTest.*`.
+   */
+  class PerformanceTest : public ::testing::Test
+  {
+  protected:
+    bool enabled;
+    JsEnginePtr jsEngine;
+    FilterEnginePtr filterEngine;
+    std::vector<std::string> documentUrls;
+
+    void SetUp() override
+    {
+      const char* variable = std::getenv("ABP_PERFORMANCE_TESTS");
+      enabled = variable && *variable && std::string(variable) != "0";
+      if (!enabled)
+        return;
+      JsEngineCreationParameters jsEngineParams;
+      jsEngineParams.fileSystem.reset(new LazyFileSystem());
+      jsEngineParams.timer.reset(new NoopTimer());
+      jsEngineParams.webRequest.reset(new NoopWebRequest());
+      jsEngine = CreateJsEngine(std::move(jsEngineParams));
+      filterEngine = FilterEngine::Create(jsEngine);
+      filterEngine->GetFilter("adbanner.gif").AddToList();
+      filterEngine->GetFilter("@@notbanner.gif").AddToList();
+      filterEngine->GetFilter("||ads.example.com^").AddToList();
+      filterEngine->GetFilter("example.org##.ad").AddToList();
+      documentUrls.push_back("http://example.org/");
+    }
+
+    void TearDown() override
+    {
+      if (!enabled)
+        return;
+      // Workaround for issue 5198
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    JsEngine::OperationCounts CountsSince(const JsEngine::OperationCounts& start) const
+    {
+      JsEngine::OperationCounts counts = jsEngine->GetOperationCounts();
+      counts.contextEntries -= start.contextEntries;
+      counts.scriptCompilations -= start.scriptCompilations;
+      counts.functionCalls -= start.functionCalls;
+      return counts;
+    }
+  };
+}
+
+TEST_F(PerformanceTest, MatchesWithoutMatchStaysNative)
+{
+  if (!enabled)
+    return;
+  JsEngine::OperationCounts start = jsEngine->GetOperationCounts();
+  for (int i = 0; i < 100; i++)
+    ASSERT_FALSE(filterEngine->Matches(UNMATCHED_URL, FilterEngine::CONTENT_TYPE_IMAGE, documentUrls));
+  JsEngine::OperationCounts counts = CountsSince(start);
+  ASSERT_EQ(0u, counts.contextEntries);
+  ASSERT_EQ(0u, counts.scriptCompilations);
+  ASSERT_EQ(0u, counts.functionCalls);
+}
+
+TEST_F(PerformanceTest, MatchesWithMatchCreatesOnlyTheFilter)
+{
+  if (!enabled)
+    return;
+  filterEngine->Matches(BLOCKED_URL, FilterEngine::CONTENT_TYPE_IMAGE, documentUrls);
+  JsEngine::OperationCounts start = jsEngine->GetOperationCounts();
+  for (int i = 0; i < 100; i++)
+    ASSERT_TRUE(filterEngine->Matches(BLOCKED_URL, FilterEngine::CONTENT_TYPE_IMAGE, documentUrls));
+  JsEngine::OperationCounts counts = CountsSince(start);
+  // Creating and releasing the filter object.
+  ASSERT_GE(2u * 100, counts.contextEntries);
+  ASSERT_EQ(0u, counts.scriptCompilations);
+  ASSERT_GE(1u * 100, counts.functionCalls);
+}
+
+TEST_F(PerformanceTest, GetMatchResultStaysNative)
+{
+  if (!enabled)
+    return;
+  JsEngine::OperationCounts start = jsEngine->GetOperationCounts();
+  for (int i = 0; i < 100; i++)
+  {
+    ASSERT_EQ(AdblockPlus::Filter::TYPE_BLOCKING, filterEngine->GetMatchResult(
+      BLOCKED_URL, FilterEngine::CONTENT_TYPE_IMAGE, documentUrls).type);
+    ASSERT_FALSE(filterEngine->IsDocumentWhitelisted(BLOCKED_URL, documentUrls));
+  }
+  JsEngine::OperationCounts counts = CountsSince(start);
+  ASSERT_EQ(0u, counts.contextEntries);
+  ASSERT_EQ(0u, counts.functionCalls);
+}
+
+TEST_F(PerformanceTest, MatchesBatchEntersOnce)
+{
+  if (!enabled)
+    return;
+  std::vector<FilterEngine::MatchRequest> requests(50);
+  for (auto& request : requests)
+  {
+    request.url = BLOCKED_URL;
+    request.contentTypeMask = FilterEngine::CONTENT_TYPE_IMAGE;
+    request.documentUrls = documentUrls;
+  }
+  filterEngine->MatchesBatch(requests);
+  JsEngine::OperationCounts start = jsEngine->GetOperationCounts();
+  {
+    std::vector<FilterPtr> filters = filterEngine->MatchesBatch(requests);
+    ASSERT_EQ(requests.size(), filters.size());
+    ASSERT_EQ(1u, CountsSince(start).contextEntries);
+  }
+  // Releasing each filter object still enters the engine.
+  ASSERT_GE(1u + requests.size(), CountsSince(start).contextEntries);
+}
+
+TEST_F(PerformanceTest, AllocationsPerLookup)
+{
+  if (!enabled)
+    return;
+  const std::string urls[] = {
+    UNMATCHED_URL, BLOCKED_URL, "http://ads.example.com/some/path?x=1&y=2",
+    "http://www.example.net/path/to/a/long/resource/name/with/many/tokens.js?query=string&and=more"
+  };
+  const int lookups = 100;
+  filterEngine->GetMatchResult(BLOCKED_URL, FilterEngine::CONTENT_TYPE_IMAGE, documentUrls);
+  allocationCount = 0;
+  countAllocations = true;
+  for (int i = 0; i < lookups; i++)
+  {
+    const std::string& url = urls[i % (sizeof(urls) / sizeof(urls[0]))];
+    filterEngine->GetMatchResult(url, FilterEngine::CONTENT_TYPE_IMAGE, documentUrls);
+  }
+  countAllocations = false;
+  // The document and the request are matched, each about ten allocations.
+  ASSERT_GE(40u * lookups, allocationCount.load());
+}
+
+TEST_F(PerformanceTest, ApiCallsDoNotCompileScripts)
+{
+  if (!enabled)
+    return;
+  auto callApis = [this]
+  {
+    filterEngine->GetPref("savestats");
+    filterEngine->SetPref("savestats", jsEngine->NewValue(false));
+    filterEngine->GetFilter("adbanner.gif");
+    filterEngine->GetListedFilters();
+    filterEngine->GetListedSubscriptions();
+    filterEngine->GetElementHidingSelectors("example.org");
+    filterEngine->Matches(BLOCKED_URL, FilterEngine::CONTENT_TYPE_IMAGE, documentUrls);
+  };
+  // The API functions are looked up once and cached.
+  callApis();
+  JsEngine::OperationCounts start = jsEngine->GetOperationCounts();
+  for (int i = 0; i < 10; i++)
+    callApis();
+  ASSERT_EQ(0u, CountsSince(start).scriptCompilations);
+}
@@ -30,6 +30,12 @@ namespace
   {
   public:
     std::string prefsContents;
+    int prefsWriteCount;
+
+    TestFileSystem()
+      : prefsWriteCount(0)
+    {
+    }
 
     std::shared_ptr<std::istream> Read(const std::string& path) const
     {
@@ -46,6 +52,7 @@ namespace
         std::stringstream ss;
         ss << content.rdbuf();
         prefsContents = ss.str();
+        prefsWriteCount++;
       }
       else
         LazyFileSystem::Write(path, content);
@@ -117,6 +124,39 @@ TEST_F(PrefsTest, PrefsGetSet)
   ASSERT_FALSE(filterEngine->GetPref("subscriptions_autoupdate").AsBool());
 }
 
+TEST_F(PrefsTest, CachedPrefs)
+{
+  fileSystem->prefsContents = "{\"patternsbackupinterval\": 12}";
+  auto filterEngine = CreateFilterEngine();
+  std::string stringValue;
+  int64_t intValue = 0;
+  bool boolValue = false;
+  ASSERT_TRUE(filterEngine->GetCachedPref("patternsfile", stringValue));
+  ASSERT_EQ("patterns.ini", stringValue);
+  ASSERT_TRUE(filterEngine->GetCachedPref("patternsbackupinterval", intValue));
+  ASSERT_EQ(12, intValue);
+  ASSERT_TRUE(filterEngine->GetCachedPref("subscriptions_autoupdate", boolValue));
+  ASSERT_TRUE(boolValue);
+  ASSERT_FALSE(filterEngine->GetCachedPref("patternsfile", boolValue));
+  ASSERT_FALSE(filterEngine->GetCachedPref("notificationdata", stringValue));
+  ASSERT_FALSE(filterEngine->GetCachedPref("foobar", stringValue));
+
+  filterEngine->SetPref("patternsfile", jsEngine->NewValue("filters.ini"));
+  filterEngine->SetPref("subscriptions_autoupdate", jsEngine->NewValue(false));
+  ASSERT_TRUE(filterEngine->GetCachedPref("patternsfile", stringValue));
+  ASSERT_EQ("filters.ini", stringValue);
+  ASSERT_TRUE(filterEngine->GetCachedPref("subscriptions_autoupdate", boolValue));
+  ASSERT_FALSE(boolValue);
+  ASSERT_TRUE(filterEngine->GetPref("notificationdata").IsObject());
+
+  std::string connectionType = "wifi";
+  filterEngine->SetAllowedConnectionType(&connectionType);
+  ASSERT_TRUE(filterEngine->GetAllowedConnectionType());
+  ASSERT_EQ("wifi", *filterEngine->GetAllowedConnectionType());
+  filterEngine->SetAllowedConnectionType(nullptr);
+  ASSERT_FALSE(filterEngine->GetAllowedConnectionType());
+}
+
 TEST_F(PrefsTest, PrefsPersist)
 {
   {
@@ -216,3 +256,36 @@ TEST_F(PrefsTest, PrefsPersistWhenPreconfigured)
     ASSERT_FALSE(filterEngine->GetPref("suppress_first_run_page").AsBool());
   }
 }
+
+TEST_F(PrefsTest, PrefsSaveDelayCoalescesWrites)
+{
+  AdblockPlus::FilterEngine::CreationParameters createParams;
+  createParams.prefsSaveDelay = 1000;
+  auto filterEngine = AdblockPlus::FilterEngine::Create(jsEngine, createParams);
+
+  filterEngine->SetPref("patternsfile", jsEngine->NewValue("filters.ini"));
+  filterEngine->SetPref("patternsbackupinterval", jsEngine->NewValue(48));
+  filterEngine->SetPref("subscriptions_autoupdate", jsEngine->NewValue(false));
+  AdblockPlus::Sleep(100);
+  // NoopTimer never fires, so nothing is written until the prefs are flushed.
+  ASSERT_EQ(0, fileSystem->prefsWriteCount);
+
+  filterEngine->FlushPrefs();
+  ASSERT_EQ(1, fileSystem->prefsWriteCount);
+  filterEngine->FlushPrefs();
+  ASSERT_EQ(1, fileSystem->prefsWriteCount);
+
+  ResetJsEngine();
+  filterEngine = CreateFilterEngine();
+  ASSERT_EQ("filters.ini", filterEngine->GetPref("patternsfile").AsString());
+  ASSERT_EQ(48, filterEngine->GetPref("patternsbackupinterval").AsInt());
+  ASSERT_FALSE(filterEngine->GetPref("subscriptions_autoupdate").AsBool());
+}
+
+TEST_F(PrefsTest, FlushPrefsWithoutSaveDelay)
+{
+  auto filterEngine = CreateFilterEngine();
+  filterEngine->SetPref("patternsbackupinterval", jsEngine->NewValue(48));
+  filterEngine->FlushPrefs();
+  ASSERT_NE(std::string::npos, fileSystem->prefsContents.find("48"));
+}
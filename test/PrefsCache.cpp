@@ -0,0 +1,82 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "../src/PrefsCache.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  PrefsCache::Value StringValue(const std::string& stringValue)
+  {
+    PrefsCache::Value value;
+    value.type = PrefsCache::Value::TYPE_STRING;
+    value.stringValue = stringValue;
+    return value;
+  }
+}
+
+TEST(PrefsCacheTest, GetSetRemove)
+{
+  PrefsCache cache;
+  PrefsCache::Value value;
+  ASSERT_FALSE(cache.Get("foo", value));
+
+  cache.Set("foo", StringValue("bar"));
+  ASSERT_TRUE(cache.Get("foo", value));
+  ASSERT_EQ(PrefsCache::Value::TYPE_STRING, value.type);
+  ASSERT_EQ("bar", value.stringValue);
+
+  PrefsCache::Value boolValue;
+  boolValue.type = PrefsCache::Value::TYPE_BOOL;
+  boolValue.boolValue = true;
+  cache.Set("foo", boolValue);
+  ASSERT_TRUE(cache.Get("foo", value));
+  ASSERT_EQ(PrefsCache::Value::TYPE_BOOL, value.type);
+  ASSERT_TRUE(value.boolValue);
+
+  cache.Remove("foo");
+  ASSERT_FALSE(cache.Get("foo", value));
+  cache.Remove("foo");
+  ASSERT_FALSE(cache.Get("foo", value));
+}
+
+TEST(PrefsCacheTest, ConcurrentReads)
+{
+  PrefsCache cache;
+  cache.Set("foo", StringValue("0"));
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++)
+  {
+    readers.push_back(std::thread([&cache]
+    {
+      for (int j = 0; j < 10000; j++)
+      {
+        PrefsCache::Value value;
+        ASSERT_TRUE(cache.Get("foo", value));
+        ASSERT_FALSE(value.stringValue.empty());
+      }
+    }));
+  }
+  for (int i = 0; i < 1000; i++)
+    cache.Set("foo", StringValue(std::to_string(i)));
+  for (auto& reader : readers)
+    reader.join();
+}
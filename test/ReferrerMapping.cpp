@@ -84,3 +84,72 @@ TEST(ReferrerMappingTest, CacheOnlyFiveUrls)
   ASSERT_EQ("sixth", referrerChain[4]);
   ASSERT_EQ("seventh", referrerChain[5]);
 }
+
+TEST(ReferrerMappingTest, ReAddedUrlIsKept)
+{
+  AdblockPlus::ReferrerMapping referrerMapping(3);
+  referrerMapping.Add("second", "first");
+  referrerMapping.Add("third", "second");
+  referrerMapping.Add("fourth", "third");
+  // Moves "second" to the end, "third" is evicted first.
+  referrerMapping.Add("second", "other");
+  referrerMapping.Add("fifth", "fourth");
+  std::vector<std::string> referrerChain =
+    referrerMapping.BuildReferrerChain("second");
+  ASSERT_EQ(2u, referrerChain.size());
+  ASSERT_EQ("other", referrerChain[0]);
+  ASSERT_EQ("second", referrerChain[1]);
+  referrerChain = referrerMapping.BuildReferrerChain("fifth");
+  ASSERT_EQ(3u, referrerChain.size());
+  ASSERT_EQ("third", referrerChain[0]);
+  ASSERT_EQ("fourth", referrerChain[1]);
+  ASSERT_EQ("fifth", referrerChain[2]);
+}
+
+TEST(ReferrerMappingTest, ReferrerLoop)
+{
+  AdblockPlus::ReferrerMapping referrerMapping;
+  referrerMapping.Add("first", "second");
+  referrerMapping.Add("second", "first");
+  referrerMapping.Add("self", "self");
+  ASSERT_EQ(11u, referrerMapping.BuildReferrerChain("first").size());
+  ASSERT_EQ(11u, referrerMapping.BuildReferrerChain("self").size());
+}
+
+TEST(ReferrerMappingTest, SharedReferrerChain)
+{
+  AdblockPlus::ReferrerMapping referrerMapping;
+  referrerMapping.Add("second", "first");
+  referrerMapping.Add("third", "second");
+  AdblockPlus::SharedUrlList referrerChain;
+  referrerMapping.BuildReferrerChain("third", referrerChain);
+  ASSERT_EQ(3u, referrerChain.size());
+  ASSERT_EQ("first", *referrerChain[0]);
+  ASSERT_EQ("second", *referrerChain[1]);
+  ASSERT_EQ("third", *referrerChain[2]);
+
+  // The URLs are shared between the chains rather than copied.
+  AdblockPlus::SharedUrlList otherChain;
+  referrerMapping.BuildReferrerChain("second", otherChain);
+  ASSERT_EQ(2u, otherChain.size());
+  ASSERT_EQ(referrerChain[0], otherChain[0]);
+  ASSERT_EQ(referrerChain[1], otherChain[1]);
+
+  referrerMapping.BuildReferrerChain("unknown", referrerChain);
+  ASSERT_EQ(1u, referrerChain.size());
+  ASSERT_EQ("unknown", *referrerChain[0]);
+}
+
+TEST(ReferrerMappingTest, SharedReferrerChainOutlivesMapping)
+{
+  AdblockPlus::SharedUrlList referrerChain;
+  {
+    AdblockPlus::ReferrerMapping referrerMapping(1);
+    referrerMapping.Add("second", "first");
+    referrerMapping.BuildReferrerChain("second", referrerChain);
+    referrerMapping.Add("third", "second");
+  }
+  ASSERT_EQ(2u, referrerChain.size());
+  ASSERT_EQ("first", *referrerChain[0]);
+  ASSERT_EQ("second", *referrerChain[1]);
+}
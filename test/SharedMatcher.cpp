@@ -0,0 +1,212 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <AdblockPlus/SharedMatcher.h>
+
+#include "../src/CompiledRuleset.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  class MemoryFileSystem : public FileSystem
+  {
+  public:
+    MemoryFileSystem()
+      : failMoveOntoExisting(false)
+    {
+    }
+
+    std::shared_ptr<std::istream> Read(const std::string& path) const
+    {
+      std::map<std::string, std::string>::const_iterator it = files.find(path);
+      if (it == files.end())
+        throw std::runtime_error("File not found: " + path);
+      return std::shared_ptr<std::istream>(new std::istringstream(it->second));
+    }
+
+    void Write(const std::string& path, std::istream& data)
+    {
+      std::stringstream content;
+      content << data.rdbuf();
+      files[path] = content.str();
+    }
+
+    void Move(const std::string& fromPath, const std::string& toPath)
+    {
+      if (failMoveOntoExisting && files.count(toPath))
+        throw std::runtime_error("File exists: " + toPath);
+      files[toPath] = files[fromPath];
+      files.erase(fromPath);
+    }
+
+    void Remove(const std::string& path)
+    {
+      if (!files.erase(path))
+        throw std::runtime_error("File not found: " + path);
+    }
+
+    StatResult Stat(const std::string& path) const
+    {
+      StatResult result;
+      if (files.count(path))
+      {
+        result.exists = true;
+        result.isFile = true;
+      }
+      return result;
+    }
+
+    std::string Resolve(const std::string& path) const
+    {
+      return path;
+    }
+
+    std::map<std::string, std::string> files;
+    bool failMoveOntoExisting;
+  };
+
+  class SharedMatcherTest : public ::testing::Test
+  {
+  protected:
+    std::shared_ptr<MemoryFileSystem> fileSystem;
+
+    void SetUp()
+    {
+      fileSystem = std::make_shared<MemoryFileSystem>();
+    }
+
+    uint64_t Publish(const std::vector<std::string>& filters)
+    {
+      return CompiledRuleset::Publish(*fileSystem, "ruleset", filters);
+    }
+  };
+}
+
+TEST_F(SharedMatcherTest, NothingPublished)
+{
+  SharedMatcher matcher(fileSystem, "ruleset");
+  EXPECT_EQ(0u, matcher.GetGeneration());
+  EXPECT_FALSE(matcher.Refresh());
+  EXPECT_FALSE(matcher.GetMatchResult("http://example.com/ad.png",
+    FilterEngine::CONTENT_TYPE_IMAGE).IsMatch());
+  EXPECT_TRUE(matcher.GetElementHidingSelectors("example.com").empty());
+}
+
+TEST_F(SharedMatcherTest, MatchesPublishedFilters)
+{
+  std::vector<std::string> filters;
+  filters.push_back("||example.com/ad^");
+  filters.push_back("@@||example.com/ad/ok.png$image");
+  filters.push_back("##.banner");
+  filters.push_back("example.com#@#.banner");
+  ASSERT_EQ(1u, Publish(filters));
+
+  SharedMatcher matcher(fileSystem, "ruleset");
+  EXPECT_EQ(1u, matcher.GetGeneration());
+
+  MatchResult result = matcher.GetMatchResult("http://example.com/ad/1.png",
+    FilterEngine::CONTENT_TYPE_IMAGE);
+  EXPECT_EQ(Filter::TYPE_BLOCKING, result.type);
+  EXPECT_EQ("||example.com/ad^", result.text);
+
+  result = matcher.GetMatchResult("http://example.com/ad/ok.png",
+    FilterEngine::CONTENT_TYPE_IMAGE);
+  EXPECT_EQ(Filter::TYPE_EXCEPTION, result.type);
+
+  EXPECT_FALSE(matcher.GetMatchResult("http://example.com/content.png",
+    FilterEngine::CONTENT_TYPE_IMAGE).IsMatch());
+
+  std::vector<std::string> selectors = matcher.GetElementHidingSelectors("foo.com");
+  ASSERT_EQ(1u, selectors.size());
+  EXPECT_EQ(".banner", selectors[0]);
+  EXPECT_TRUE(matcher.GetElementHidingSelectors("example.com").empty());
+}
+
+TEST_F(SharedMatcherTest, DocumentWhitelisting)
+{
+  std::vector<std::string> filters;
+  filters.push_back("||ads.com^");
+  filters.push_back("@@||trusted.com^$document");
+  Publish(filters);
+  SharedMatcher matcher(fileSystem, "ruleset");
+
+  std::vector<std::string> documentUrls;
+  documentUrls.push_back("http://example.com/");
+  EXPECT_EQ(Filter::TYPE_BLOCKING, matcher.GetMatchResult("http://ads.com/ad.js",
+    FilterEngine::CONTENT_TYPE_SCRIPT, documentUrls).type);
+
+  documentUrls.push_back("http://trusted.com/");
+  MatchResult result = matcher.GetMatchResult("http://ads.com/ad.js",
+    FilterEngine::CONTENT_TYPE_SCRIPT, documentUrls);
+  EXPECT_EQ(Filter::TYPE_EXCEPTION, result.type);
+  EXPECT_EQ("@@||trusted.com^$document", result.text);
+}
+
+TEST_F(SharedMatcherTest, RefreshSwitchesGenerations)
+{
+  Publish(std::vector<std::string>(1, "||first.com^"));
+  SharedMatcher matcher(fileSystem, "ruleset");
+  EXPECT_TRUE(matcher.GetMatchResult("http://first.com/",
+    FilterEngine::CONTENT_TYPE_OTHER).IsMatch());
+
+  ASSERT_EQ(2u, Publish(std::vector<std::string>(1, "||second.com^")));
+  EXPECT_EQ(1u, matcher.GetGeneration());
+  EXPECT_TRUE(matcher.GetMatchResult("http://first.com/",
+    FilterEngine::CONTENT_TYPE_OTHER).IsMatch());
+
+  EXPECT_TRUE(matcher.Refresh());
+  EXPECT_EQ(2u, matcher.GetGeneration());
+  EXPECT_FALSE(matcher.Refresh());
+  EXPECT_FALSE(matcher.GetMatchResult("http://first.com/",
+    FilterEngine::CONTENT_TYPE_OTHER).IsMatch());
+  EXPECT_TRUE(matcher.GetMatchResult("http://second.com/",
+    FilterEngine::CONTENT_TYPE_OTHER).IsMatch());
+}
+
+TEST_F(SharedMatcherTest, OldGenerationsAreRemoved)
+{
+  fileSystem->failMoveOntoExisting = true;
+  for (int i = 0; i < 3; i++)
+    Publish(std::vector<std::string>(1, "||example.com^"));
+  EXPECT_EQ(3u, CompiledRuleset::GetPublishedGeneration(*fileSystem, "ruleset"));
+  EXPECT_FALSE(fileSystem->Stat("ruleset.1").exists);
+  EXPECT_TRUE(fileSystem->Stat("ruleset.2").exists);
+  EXPECT_TRUE(fileSystem->Stat("ruleset.3").exists);
+  EXPECT_FALSE(fileSystem->Stat("ruleset.tmp").exists);
+}
+
+TEST_F(SharedMatcherTest, InvalidRulesetKeepsCurrentOne)
+{
+  Publish(std::vector<std::string>(1, "||example.com^"));
+  SharedMatcher matcher(fileSystem, "ruleset");
+
+  fileSystem->files["ruleset.2"] = "invalid";
+  fileSystem->files["ruleset"] = "2\n";
+  EXPECT_THROW(matcher.Refresh(), std::runtime_error);
+  EXPECT_EQ(1u, matcher.GetGeneration());
+  EXPECT_TRUE(matcher.GetMatchResult("http://example.com/",
+    FilterEngine::CONTENT_TYPE_OTHER).IsMatch());
+
+  fileSystem->files["ruleset"] = "garbage";
+  EXPECT_THROW(matcher.Refresh(), std::runtime_error);
+  EXPECT_EQ(1u, matcher.GetGeneration());
+}
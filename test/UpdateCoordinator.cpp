@@ -0,0 +1,214 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/UpdateCoordinator.h>
+#include "BaseJsTest.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  class UpdateCoordinatorTest : public ::testing::Test
+  {
+  protected:
+    DelayedWebRequest::SharedTasks webRequestTasks;
+    DelayedTimer::SharedTasks timerTasks;
+    UpdateCoordinator::Settings settings;
+
+    UpdateCoordinatorPtr CreateCoordinator()
+    {
+      return UpdateCoordinator::New(settings,
+        DelayedWebRequest::New(webRequestTasks), DelayedTimer::New(timerTasks));
+    }
+
+    static ServerResponse CreateResponse(const std::string& text)
+    {
+      ServerResponse response;
+      response.status = IWebRequest::NS_OK;
+      response.responseStatus = 200;
+      response.responseText = text;
+      return response;
+    }
+  };
+}
+
+TEST_F(UpdateCoordinatorTest, EnginesShareDownloadsOfTheSameUrl)
+{
+  auto coordinator = CreateCoordinator();
+  auto firstWebRequest = coordinator->CreateWebRequest();
+  auto secondWebRequest = coordinator->CreateWebRequest();
+  std::vector<std::string> responses;
+  auto callback = [&responses](const ServerResponse& response)
+  {
+    responses.push_back(response.responseText);
+  };
+  firstWebRequest->GET("https://example.com/list.txt?downloadCount=1",
+    HeaderList(), callback);
+  secondWebRequest->GET("https://example.com/list.txt?downloadCount=4",
+    HeaderList(), callback);
+  ASSERT_EQ(1u, webRequestTasks->size());
+  EXPECT_EQ("https://example.com/list.txt?downloadCount=1",
+    webRequestTasks->front().url);
+
+  webRequestTasks->front().getCallback(CreateResponse("[Adblock Plus 2.0]"));
+  ASSERT_EQ(2u, responses.size());
+  EXPECT_EQ("[Adblock Plus 2.0]", responses[0]);
+  EXPECT_EQ("[Adblock Plus 2.0]", responses[1]);
+
+  // Later requests get the stored response.
+  secondWebRequest->GET("https://example.com/list.txt", HeaderList(), callback);
+  EXPECT_EQ(2u, responses.size());
+  DelayedTimer::ProcessImmediateTimers(timerTasks);
+  ASSERT_EQ(3u, responses.size());
+  EXPECT_EQ("[Adblock Plus 2.0]", responses[2]);
+  EXPECT_EQ(1u, webRequestTasks->size());
+
+  UpdateCoordinator::Stats stats = coordinator->GetStats();
+  EXPECT_EQ(3u, stats.requests);
+  EXPECT_EQ(1u, stats.downloads);
+  EXPECT_EQ(2u, stats.sharedResponses);
+  EXPECT_EQ(0u, stats.activeDownloads);
+}
+
+TEST_F(UpdateCoordinatorTest, OnlyDownloadStatisticsAreIgnoredInTheUrl)
+{
+  auto coordinator = CreateCoordinator();
+  auto firstWebRequest = coordinator->CreateWebRequest();
+  auto secondWebRequest = coordinator->CreateWebRequest();
+  auto callback = [](const ServerResponse&) {};
+  firstWebRequest->GET("https://example.com/list.php?id=1&addonName=a&downloadCount=1",
+    HeaderList(), callback);
+  secondWebRequest->GET("https://example.com/list.php?id=2&addonName=a&downloadCount=1",
+    HeaderList(), callback);
+  EXPECT_EQ(2u, webRequestTasks->size());
+  secondWebRequest->GET("https://example.com/list.php?addonName=b&id=2&downloadCount=4",
+    HeaderList(), callback);
+  EXPECT_EQ(2u, webRequestTasks->size());
+
+  UpdateCoordinator::Stats stats = coordinator->GetStats();
+  EXPECT_EQ(3u, stats.requests);
+  EXPECT_EQ(2u, stats.downloads);
+  EXPECT_EQ(1u, stats.sharedResponses);
+}
+
+TEST_F(UpdateCoordinatorTest, DiscardedResultsAreDownloadedAgain)
+{
+  auto coordinator = CreateCoordinator();
+  auto webRequest = coordinator->CreateWebRequest();
+  std::vector<std::string> responses;
+  auto callback = [&responses](const ServerResponse& response)
+  {
+    responses.push_back(response.responseText);
+  };
+  webRequest->GET("https://example.com/list.txt?downloadCount=1",
+    HeaderList(), callback);
+  ASSERT_EQ(1u, webRequestTasks->size());
+  webRequestTasks->front().getCallback(CreateResponse("[Adblock Plus 2.0]"));
+  webRequestTasks->clear();
+
+  coordinator->DiscardResult("https://example.com/list.txt");
+  webRequest->GET("https://example.com/list.txt?downloadCount=2",
+    HeaderList(), callback);
+  DelayedTimer::ProcessImmediateTimers(timerTasks);
+  EXPECT_EQ(1u, responses.size());
+  ASSERT_EQ(1u, webRequestTasks->size());
+  webRequestTasks->front().getCallback(CreateResponse("! updated"));
+  ASSERT_EQ(2u, responses.size());
+  EXPECT_EQ("! updated", responses[1]);
+
+  UpdateCoordinator::Stats stats = coordinator->GetStats();
+  EXPECT_EQ(2u, stats.downloads);
+  EXPECT_EQ(0u, stats.sharedResponses);
+}
+
+TEST_F(UpdateCoordinatorTest, FailedDownloadsAreNotReused)
+{
+  auto coordinator = CreateCoordinator();
+  auto webRequest = coordinator->CreateWebRequest();
+  int calls = 0;
+  auto callback = [&calls](const ServerResponse&)
+  {
+    calls++;
+  };
+  webRequest->GET("https://example.com/list.txt", HeaderList(), callback);
+  ServerResponse response;
+  response.status = IWebRequest::NS_ERROR_NET_TIMEOUT;
+  webRequestTasks->front().getCallback(response);
+  EXPECT_EQ(1, calls);
+
+  webRequest->GET("https://example.com/list.txt", HeaderList(), callback);
+  EXPECT_EQ(2u, webRequestTasks->size());
+  EXPECT_EQ(2u, coordinator->GetStats().downloads);
+}
+
+TEST_F(UpdateCoordinatorTest, ConcurrentDownloadsAreCapped)
+{
+  settings.maxConcurrentDownloads = 2;
+  auto coordinator = CreateCoordinator();
+  auto webRequest = coordinator->CreateWebRequest();
+  std::vector<std::string> responses;
+  auto callback = [&responses](const ServerResponse& response)
+  {
+    responses.push_back(response.responseText);
+  };
+  webRequest->GET("https://example.com/a.txt", HeaderList(), callback);
+  webRequest->GET("https://example.com/b.txt", HeaderList(), callback);
+  webRequest->GET("https://example.com/c.txt", HeaderList(), callback);
+  ASSERT_EQ(2u, webRequestTasks->size());
+  UpdateCoordinator::Stats stats = coordinator->GetStats();
+  EXPECT_EQ(2u, stats.activeDownloads);
+  EXPECT_EQ(1u, stats.queuedDownloads);
+
+  webRequestTasks->front().getCallback(CreateResponse("a"));
+  ASSERT_EQ(3u, webRequestTasks->size());
+  EXPECT_EQ("https://example.com/c.txt", webRequestTasks->back().url);
+  stats = coordinator->GetStats();
+  EXPECT_EQ(2u, stats.activeDownloads);
+  EXPECT_EQ(0u, stats.queuedDownloads);
+}
+
+TEST_F(UpdateCoordinatorTest, StaggerDelaysTasksUpToMaxJitter)
+{
+  settings.maxJitter = std::chrono::milliseconds(5000);
+  auto coordinator = CreateCoordinator();
+  int calls = 0;
+  for (int i = 0; i < 20; i++)
+    coordinator->Stagger([&calls] { calls++; });
+  EXPECT_EQ(0, calls);
+  ASSERT_EQ(20u, timerTasks->size());
+  bool delaysDiffer = false;
+  for (const auto& task : *timerTasks)
+  {
+    EXPECT_LE(0, task.timeout.count());
+    EXPECT_GE(5000, task.timeout.count());
+    if (task.timeout != timerTasks->front().timeout)
+      delaysDiffer = true;
+    task.callback();
+  }
+  EXPECT_TRUE(delaysDiffer);
+  EXPECT_EQ(20, calls);
+}
+
+TEST_F(UpdateCoordinatorTest, StaggerWithoutJitterRunsImmediately)
+{
+  settings.maxJitter = std::chrono::milliseconds(0);
+  auto coordinator = CreateCoordinator();
+  bool called = false;
+  coordinator->Stagger([&called] { called = true; });
+  EXPECT_TRUE(called);
+  EXPECT_TRUE(timerTasks->empty());
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../src/UrlTokenizer.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  std::vector<std::string> GetTokens(const UrlTokenizer::Tokens& tokens)
+  {
+    std::vector<std::string> result;
+    for (const auto& token : tokens.tokens)
+      result.push_back(tokens.GetToken(token));
+    return result;
+  }
+
+  void ExpectSameTokens(const std::string& url)
+  {
+    UrlTokenizer::Tokens tokens;
+    UrlTokenizer::Tokens scalarTokens;
+    UrlTokenizer::Tokenize(url, tokens);
+    UrlTokenizer::TokenizeScalar(url, scalarTokens);
+    EXPECT_EQ(scalarTokens.lowerUrl, tokens.lowerUrl) << url;
+    ASSERT_EQ(scalarTokens.tokens.size(), tokens.tokens.size()) << url;
+    for (size_t i = 0; i < tokens.tokens.size(); i++)
+    {
+      EXPECT_EQ(scalarTokens.tokens[i].start, tokens.tokens[i].start) << url;
+      EXPECT_EQ(scalarTokens.tokens[i].length, tokens.tokens[i].length) << url;
+      EXPECT_EQ(scalarTokens.tokens[i].hash, tokens.tokens[i].hash) << url;
+    }
+  }
+}
+
+TEST(UrlTokenizerTest, Tokens)
+{
+  UrlTokenizer::Tokens tokens;
+  UrlTokenizer::Tokenize("http://WWW.Example.com/ad-banner_1.gif?x=%20y", tokens);
+  EXPECT_EQ("http://www.example.com/ad-banner_1.gif?x=%20y", tokens.lowerUrl);
+  std::vector<std::string> expected;
+  expected.push_back("http");
+  expected.push_back("www");
+  expected.push_back("example");
+  expected.push_back("com");
+  expected.push_back("banner");
+  expected.push_back("gif");
+  expected.push_back("%20y");
+  EXPECT_EQ(expected, GetTokens(tokens));
+  ASSERT_EQ(7u, tokens.tokens.size());
+  EXPECT_EQ(UrlTokenizer::HashToken("example", 7), tokens.tokens[2].hash);
+}
+
+TEST(UrlTokenizerTest, EmptyAndShortUrls)
+{
+  UrlTokenizer::Tokens tokens;
+  UrlTokenizer::Tokenize("", tokens);
+  EXPECT_EQ("", tokens.lowerUrl);
+  EXPECT_TRUE(tokens.tokens.empty());
+  UrlTokenizer::Tokenize("ab/cd", tokens);
+  EXPECT_TRUE(tokens.tokens.empty());
+  UrlTokenizer::Tokenize("abc", tokens);
+  EXPECT_EQ(1u, tokens.tokens.size());
+}
+
+TEST(UrlTokenizerTest, MatchesScalarImplementation)
+{
+  ExpectSameTokens("http://example.com/");
+  // Tokens spanning blocks and ending exactly at a block boundary.
+  ExpectSameTokens("http://example.com/abcdefghijklmnopqrstuvwxyz0123456789");
+  ExpectSameTokens(std::string(16, 'a'));
+  ExpectSameTokens(std::string(32, 'A') + "/" + std::string(15, 'b'));
+  ExpectSameTokens("\xC3\xA4\xC3\xB6" "abc/\x80\xFF" "DEF" + std::string(40, '%'));
+
+  std::string url;
+  const char chars[] = "aZ0%/.-_\x80@[`{";
+  for (size_t i = 0; i < 200; i++)
+  {
+    url += chars[(i * 7 + i / 3) % (sizeof(chars) - 1)];
+    ExpectSameTokens(url);
+  }
+}
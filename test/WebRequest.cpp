@@ -15,6 +15,7 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <sstream>
 #include "BaseJsTest.h"
 #include "../src/Thread.h"
@@ -76,6 +77,126 @@ namespace
     mutable std::map<std::string, std::set<std::string>> requestHeaderNames;
   };
 
+  class ConcurrencyCountingWebRequest : public AdblockPlus::WebRequest
+  {
+  public:
+    ConcurrencyCountingWebRequest()
+      : running(0), maxRunning(0)
+    {
+    }
+
+    AdblockPlus::ServerResponse GET(const std::string& url, const AdblockPlus::HeaderList& requestHeaders) const
+    {
+      int current = ++running;
+      int max = maxRunning;
+      while (current > max && !maxRunning.compare_exchange_weak(max, current))
+      {
+      }
+      AdblockPlus::Sleep(20);
+      --running;
+
+      AdblockPlus::ServerResponse result;
+      result.status = IWebRequest::NS_OK;
+      result.responseStatus = 200;
+      result.responseText = url;
+      return result;
+    }
+
+    mutable std::atomic<int> running;
+    mutable std::atomic<int> maxRunning;
+  };
+
+  class HostCountingWebRequest : public AdblockPlus::WebRequest
+  {
+  public:
+    HostCountingWebRequest()
+      : requestCount(0), maxRunningPerHost(0)
+    {
+    }
+
+    AdblockPlus::ServerResponse GET(const std::string& url, const AdblockPlus::HeaderList& requestHeaders) const
+    {
+      std::string host = url.substr(0, url.find('/', 7));
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        requestCount++;
+        maxRunningPerHost = std::max(maxRunningPerHost, ++running[host]);
+      }
+      AdblockPlus::Sleep(20);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        running[host]--;
+      }
+
+      AdblockPlus::ServerResponse result;
+      result.status = IWebRequest::NS_OK;
+      result.responseStatus = 200;
+      result.responseText = url;
+      return result;
+    }
+
+    mutable std::mutex mutex;
+    mutable std::map<std::string, int> running;
+    mutable int requestCount;
+    mutable int maxRunningPerHost;
+  };
+
+  class FailingWebRequest : public AdblockPlus::WebRequest
+  {
+  public:
+    AdblockPlus::ServerResponse GET(const std::string& url, const AdblockPlus::HeaderList& requestHeaders) const
+    {
+      AdblockPlus::Sleep(20);
+      throw std::runtime_error("Request failed");
+    }
+  };
+
+  class ChunkedWebRequest : public AdblockPlus::IWebRequest
+  {
+  public:
+    void GET(const std::string& url, const AdblockPlus::HeaderList& requestHeaders, const GetCallback& getCallback) override
+    {
+      throw std::runtime_error("Unexpected GET without data callback: " + url);
+    }
+
+    void GET(const std::string& url, const AdblockPlus::HeaderList& requestHeaders,
+      const DataCallback& dataCallback, const GetCallback& getCallback) override
+    {
+      // The first chunk ends in the middle of the UTF-8 sequence of "\u00e9".
+      const std::string body = "caf\xC3\xA9\n[Adblock Plus 2.0]";
+      dataCallback(body.data(), 4);
+      dataCallback(body.data() + 4, 6);
+      dataCallback(body.data() + 10, body.size() - 10);
+
+      AdblockPlus::ServerResponse result;
+      result.status = IWebRequest::NS_OK;
+      result.responseStatus = 200;
+      result.receivedBytes = body.size();
+      getCallback(result);
+    }
+  };
+
+  class TimedWebRequest : public AdblockPlus::IWebRequest
+  {
+  public:
+    void GET(const std::string& url, const AdblockPlus::HeaderList& requestHeaders, const GetCallback& getCallback) override
+    {
+      AdblockPlus::ServerResponse result;
+      result.status = url.find("fail") == std::string::npos ?
+        IWebRequest::NS_OK : IWebRequest::NS_ERROR_CONNECTION_REFUSED;
+      result.responseStatus = 200;
+      result.receivedBytes = 100;
+      result.timing.dnsLookup = 10;
+      result.timing.connect = 20;
+      result.timing.tlsHandshake = 30;
+      result.timing.firstByte = 1000;
+      result.timing.total = 2000;
+      result.connectionReused = url.find("reused") != std::string::npos;
+      result.protocolVersion = "HTTP/2";
+      getCallback(result);
+    }
+  };
+
   template<class T>
   class WebRequestTest : public ::testing::Test
   {
@@ -130,6 +251,167 @@ namespace
 
 }
 
+TEST(DefaultWebRequestConcurrencyTest, LimitsConcurrentRequests)
+{
+  auto syncImpl = std::make_shared<ConcurrencyCountingWebRequest>();
+  std::atomic<int> completed(0);
+  {
+    AdblockPlus::DefaultWebRequest webRequest(syncImpl, 2);
+    for (int i = 0; i < 6; i++)
+    {
+      webRequest.GET("http://example.com/" + std::to_string(i), AdblockPlus::HeaderList(),
+        [&completed](const AdblockPlus::ServerResponse& response)
+        {
+          completed++;
+        });
+    }
+    while (completed < 6)
+      AdblockPlus::Sleep(10);
+  }
+  EXPECT_EQ(6, completed);
+  EXPECT_LE(syncImpl->maxRunning, 2);
+}
+
+TEST(DefaultWebRequestConcurrencyTest, LimitsRequestsPerHost)
+{
+  auto syncImpl = std::make_shared<HostCountingWebRequest>();
+  std::atomic<int> completed(0);
+  {
+    AdblockPlus::DefaultWebRequest webRequest(syncImpl, 4, 1);
+    for (int i = 0; i < 6; i++)
+    {
+      webRequest.GET("http://" + std::string(i % 2 ? "a" : "b") + ".example.com/" + std::to_string(i),
+        AdblockPlus::HeaderList(), [&completed](const AdblockPlus::ServerResponse& response)
+        {
+          completed++;
+        });
+    }
+    while (completed < 6)
+      AdblockPlus::Sleep(10);
+  }
+  EXPECT_EQ(6, syncImpl->requestCount);
+  EXPECT_EQ(1, syncImpl->maxRunningPerHost);
+}
+
+TEST(DefaultWebRequestConcurrencyTest, JoinsIdenticalRequests)
+{
+  auto syncImpl = std::make_shared<HostCountingWebRequest>();
+  std::mutex mutex;
+  std::vector<std::string> results;
+  auto callback = [&mutex, &results](const AdblockPlus::ServerResponse& response)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    results.push_back(response.responseText);
+  };
+  {
+    AdblockPlus::DefaultWebRequest webRequest(syncImpl, 1);
+    // The first request keeps the only thread busy, the others are queued.
+    webRequest.GET("http://example.com/first", AdblockPlus::HeaderList(), callback);
+    AdblockPlus::HeaderList headers;
+    headers.push_back(std::make_pair("X", "Y"));
+    for (int i = 0; i < 3; i++)
+      webRequest.GET("http://example.com/list", AdblockPlus::HeaderList(), callback);
+    webRequest.GET("http://example.com/list", headers, callback);
+    while (true)
+    {
+      AdblockPlus::Sleep(10);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (results.size() == 5)
+        break;
+    }
+  }
+  EXPECT_EQ(3, syncImpl->requestCount);
+  EXPECT_EQ(4, std::count(results.begin(), results.end(), "http://example.com/list"));
+}
+
+TEST(DefaultWebRequestConcurrencyTest, FailedRequestNotifiesAllCallbacks)
+{
+  auto syncImpl = std::make_shared<FailingWebRequest>();
+  std::mutex mutex;
+  std::vector<int> statuses;
+  auto callback = [&mutex, &statuses](const AdblockPlus::ServerResponse& response)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    statuses.push_back(static_cast<int>(response.status));
+    // A throwing callback must not keep the others from being called.
+    throw std::runtime_error("Callback failed");
+  };
+  {
+    AdblockPlus::DefaultWebRequest webRequest(syncImpl, 1);
+    webRequest.GET("http://example.com/first", AdblockPlus::HeaderList(), callback);
+    for (int i = 0; i < 3; i++)
+      webRequest.GET("http://example.com/list", AdblockPlus::HeaderList(), callback);
+    while (true)
+    {
+      AdblockPlus::Sleep(10);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (statuses.size() == 4)
+        break;
+    }
+  }
+  EXPECT_EQ(4, std::count(statuses.begin(), statuses.end(),
+    static_cast<int>(AdblockPlus::IWebRequest::NS_ERROR_FAILURE)));
+}
+
+TEST(StreamingWebRequestTest, ChunksAreJoined)
+{
+  JsEngineCreationParameters jsEngineParams;
+  jsEngineParams.webRequest.reset(new ChunkedWebRequest());
+  auto jsEngine = CreateJsEngine(std::move(jsEngineParams));
+  jsEngine->Evaluate("_webRequest.GET('http://example.com/', {}, function(result) {foo = result;} )");
+  ASSERT_EQ(IWebRequest::NS_OK, jsEngine->Evaluate("foo.status").AsInt());
+  ASSERT_EQ(200, jsEngine->Evaluate("foo.responseStatus").AsInt());
+  ASSERT_EQ("caf\xC3\xA9\n[Adblock Plus 2.0]", jsEngine->Evaluate("foo.responseText").AsString());
+  ASSERT_EQ(23, jsEngine->Evaluate("foo.responseText.length").AsInt());
+  ASSERT_EQ(24, jsEngine->Evaluate("foo.receivedBytes").AsInt());
+}
+
+TEST(WebRequestMetricsTest, AggregatedByHost)
+{
+  JsEngineCreationParameters jsEngineParams;
+  jsEngineParams.webRequest.reset(new TimedWebRequest());
+  auto jsEngine = CreateJsEngine(std::move(jsEngineParams));
+  ASSERT_TRUE(jsEngine->GetWebRequestMetrics().empty());
+  jsEngine->Evaluate("_webRequest.GET('https://example.com/list', {}, function() {})");
+  jsEngine->Evaluate("_webRequest.GET('https://example.com/reused', {}, function() {})");
+  jsEngine->Evaluate("_webRequest.GET('http://example.org/fail', {}, function() {})");
+
+  std::vector<AdblockPlus::WebRequestHostMetrics> metrics = jsEngine->GetWebRequestMetrics();
+  ASSERT_EQ(2u, metrics.size());
+  ASSERT_EQ("example.com", metrics[0].host);
+  ASSERT_EQ(2u, metrics[0].requestCount);
+  ASSERT_EQ(0u, metrics[0].failedCount);
+  ASSERT_EQ(1u, metrics[0].reusedConnectionCount);
+  ASSERT_EQ(200u, metrics[0].receivedBytes);
+  ASSERT_EQ("HTTP/2", metrics[0].protocolVersion);
+  ASSERT_EQ(5u, metrics[0].timings.size());
+  ASSERT_EQ("DnsLookup", metrics[0].timings[0].name);
+  ASSERT_EQ(2u, metrics[0].timings[0].count);
+  ASSERT_EQ("Total", metrics[0].timings[4].name);
+  ASSERT_EQ(4000u, metrics[0].timings[4].totalMicroseconds);
+  ASSERT_EQ("example.org", metrics[1].host);
+  ASSERT_EQ(1u, metrics[1].failedCount);
+
+  jsEngine->ResetWebRequestMetrics();
+  ASSERT_TRUE(jsEngine->GetWebRequestMetrics().empty());
+}
+
+TEST(WebRequestMetricsTest, UnknownTimingsAreNotCounted)
+{
+  JsEngineCreationParameters jsEngineParams;
+  jsEngineParams.webRequest.reset(new ChunkedWebRequest());
+  auto jsEngine = CreateJsEngine(std::move(jsEngineParams));
+  jsEngine->Evaluate("_webRequest.GET('http://example.com/', {}, function() {})");
+  std::vector<AdblockPlus::WebRequestHostMetrics> metrics = jsEngine->GetWebRequestMetrics();
+  ASSERT_EQ(1u, metrics.size());
+  ASSERT_EQ(1u, metrics[0].requestCount);
+  ASSERT_EQ(24u, metrics[0].receivedBytes);
+  ASSERT_EQ(0u, metrics[0].reusedConnectionCount);
+  ASSERT_EQ("", metrics[0].protocolVersion);
+  for (const auto& timing : metrics[0].timings)
+    ASSERT_EQ(0u, timing.count);
+}
+
 TEST_F(MockWebRequestTest, BadCall)
 {
   ASSERT_ANY_THROW(jsEngine->Evaluate("_webRequest.GET()"));
@@ -149,6 +431,7 @@ TEST_F(MockWebRequestTest, SuccessfulRequest)
   ASSERT_EQ(123, jsEngine->Evaluate("foo.responseStatus").AsInt());
   ASSERT_EQ("http://example.com/\nX\nY", jsEngine->Evaluate("foo.responseText").AsString());
   ASSERT_EQ("{\"Foo\":\"Bar\"}", jsEngine->Evaluate("JSON.stringify(foo.responseHeaders)").AsString());
+  ASSERT_EQ(-1, jsEngine->Evaluate("foo.receivedBytes").AsInt());
 }
 
 #if defined(HAVE_CURL) || defined(_WIN32)
@@ -165,6 +448,9 @@ TEST_F(DefaultWebRequestTest, RealWebRequest)
   ASSERT_EQ("text/plain", jsEngine->Evaluate("foo.responseHeaders['content-type'].substr(0, 10)").AsString());
 #if defined(HAVE_CURL)
   ASSERT_EQ("gzip", jsEngine->Evaluate("foo.responseHeaders['content-encoding'].substr(0, 4)").AsString());
+  // The compressed list is considerably smaller.
+  ASSERT_GT(jsEngine->Evaluate("foo.receivedBytes").AsInt(), 0);
+  ASSERT_LT(jsEngine->Evaluate("foo.receivedBytes").AsInt(), jsEngine->Evaluate("foo.responseText.length").AsInt());
 #endif
   ASSERT_TRUE(jsEngine->Evaluate("foo.responseHeaders['location']").IsUndefined());
 }
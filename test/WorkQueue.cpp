@@ -0,0 +1,203 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-2017 eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../src/WorkQueue.h"
+
+using AdblockPlus::WorkQueue;
+
+TEST(WorkQueueTest, RunsTasksInOrderOnWorkerThread)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<int> results;
+  std::thread::id workerThreadId;
+  WorkQueue queue;
+  for (int i = 0; i < 10; i++)
+  {
+    queue.Post([&, i]
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      results.push_back(i);
+      workerThreadId = std::this_thread::get_id();
+      cv.notify_one();
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&]()->bool
+  {
+    return results.size() == 10;
+  }));
+  for (int i = 0; i < 10; i++)
+    EXPECT_EQ(i, results[i]);
+  EXPECT_NE(std::this_thread::get_id(), workerThreadId);
+}
+
+TEST(WorkQueueTest, ThrowingTaskDoesNotStopWorker)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+  WorkQueue queue;
+  queue.Post([]
+  {
+    throw std::runtime_error("error");
+  });
+  queue.Post([&]
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    cv.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&]()->bool
+  {
+    return done;
+  }));
+}
+
+TEST(WorkQueueTest, DestroyedFromTask)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+  WorkQueue* queue = new WorkQueue();
+  queue->Post([&]
+  {
+    delete queue;
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    cv.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&]()->bool
+  {
+    return done;
+  }));
+}
+
+TEST(WorkQueueTest, TasksWithSameKeyRunInOrder)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<int> results;
+  int running = 0;
+  bool overlapped = false;
+  WorkQueue queue(4);
+  for (int i = 0; i < 20; i++)
+  {
+    queue.Post([&, i]
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        overlapped = overlapped || running > 0;
+        ++running;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      std::lock_guard<std::mutex> lock(mutex);
+      --running;
+      results.push_back(i);
+      cv.notify_one();
+    }, "key");
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&]()->bool
+  {
+    return results.size() == 20;
+  }));
+  EXPECT_FALSE(overlapped);
+  for (int i = 0; i < 20; i++)
+    EXPECT_EQ(i, results[i]);
+}
+
+TEST(WorkQueueTest, TasksRunInParallel)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  int started = 0;
+  bool release = false;
+  int finished = 0;
+  WorkQueue queue(2);
+  for (int i = 0; i < 2; i++)
+  {
+    // Both tasks have to run at the same time to finish.
+    queue.Post([&]
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ++started;
+      release = release || started == 2;
+      cv.notify_all();
+      cv.wait_for(lock, std::chrono::seconds(5), [&]()->bool
+      {
+        return release;
+      });
+      if (release)
+        ++finished;
+      cv.notify_all();
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(10), [&]()->bool
+  {
+    return finished == 2;
+  }));
+}
+
+
+TEST(WorkQueueTest, PendingCount)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool started = false;
+  bool released = false;
+  WorkQueue queue;
+  EXPECT_EQ(0u, queue.GetPendingCount());
+  queue.Post([&]
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    started = true;
+    cv.notify_all();
+    cv.wait(lock, [&]()->bool
+    {
+      return released;
+    });
+  });
+  queue.Post([]
+  {
+  });
+  queue.Post([]
+  {
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&]()->bool
+    {
+      return started;
+    }));
+  }
+  EXPECT_EQ(2u, queue.GetPendingCount());
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+  }
+  cv.notify_all();
+}